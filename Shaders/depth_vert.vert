@@ -0,0 +1,32 @@
+#version 450
+
+// vertex stage of the depth only passes, binding 0 of gltfVertex is all it
+// reads; same sets and push constant layout as swapchain_vert
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+
+layout(set = 1, binding = 0) readonly buffer Transforms {
+    mat4 transforms[];
+};
+
+struct Quantization {
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+layout(set = 1, binding = 1) readonly buffer Quantizations {
+    Quantization quantizations[];
+};
+
+void main() {
+    Quantization quantization = quantizations[gl_InstanceIndex];
+    vec3 position = quantization.positionOffset.xyz +
+                    inPosition * quantization.positionScale.xyz;
+    gl_Position = ubo.proj * ubo.view * ubo.model * transforms[gl_InstanceIndex] *
+                  vec4(position, 1.0);
+}
@@ -0,0 +1,55 @@
+#version 450
+
+// the scene's view atlases, see ImpostorBaker::packTexel
+layout(std430, set = 1, binding = 0) readonly buffer Texels {
+    uint texels[];
+};
+
+const uint kFrameSize = 32u;
+
+layout(location = 0) in vec2 inUv;
+layout(location = 1) flat in uint inTexelBase;
+layout(location = 2) in vec4 inClip;
+layout(location = 3) flat in vec4 inClipDepth;
+
+layout(location = 0) out vec4 outColor;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// the shading of swapchain_vert.vert, from the baked normal
+vec3 shade(vec3 normal) {
+    if (dot(vec3(1.0, 0.0, 0.0), normal) > 0.0) {
+        return vec3(1.0, 0.0, 0.0);
+    } else if (dot(vec3(0.0, 1.0, 0.0), normal) > 0.0) {
+        return vec3(0.0, 1.0, 0.0);
+    } else if (dot(vec3(0.0, 0.0, 1.0), normal) > 0.0) {
+        return vec3(0.0, 0.0, 1.0);
+    } else if (dot(vec3(0.0, 0.0, -1.0), normal) > 0.0) {
+        return vec3(0.0, 0.0, 1.0);
+    } else if (dot(vec3(0.0, -1.0, 0.0), normal) > 0.0) {
+        return vec3(0.0, 1.0, 0.0);
+    }
+    return normal;
+}
+
+void main() {
+    uvec2 texel = min(uvec2(inUv * float(kFrameSize)), uvec2(kFrameSize - 1u));
+    uint value = texels[inTexelBase + texel.y * kFrameSize + texel.x];
+    if (value == 0u) {
+        discard;
+    }
+    vec2 e = vec2(float(value & 0xffu), float((value >> 8) & 0xffu)) / 255.0;
+    vec3 normal = decodeOctahedral(e * 2.0 - 1.0);
+    float depth = float((value >> 16) - 1u) / 65534.0;
+
+    // the surface the texel saw, behind the quad on the view's near plane
+    vec4 clip = inClip + inClipDepth * depth;
+    gl_FragDepth = clip.z / clip.w;
+    outColor = vec4(shade(normal), 0.0);
+}
@@ -0,0 +1,72 @@
+#version 450
+
+// ImpostorRenderer: one quad per active HLOD impostor, six vertices without
+// vertex buffers. The quad lies on the near plane of the baked view closest
+// to the camera and is oriented like it, so the view's texels map straight
+// onto it.
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// ImpostorRenderer::ImpostorDraw
+struct Impostor {
+    vec4 sphere;  // world space group bounds
+    uint group;
+    uint frame;
+    uint padding0;
+    uint padding1;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer Impostors {
+    Impostor impostors[];
+};
+
+// matches ImpostorBaker
+const uint kViewGrid = 8u;
+const uint kFrameTexels = 32u * 32u;
+
+layout(location = 0) out vec2 outUv;
+layout(location = 1) flat out uint outTexelBase;
+// clip position of the quad and the clip space step across the group's
+// diameter along the view; the fragment shader finds the baked depth with
+// them, the scene's uniforms are not visible to it
+layout(location = 2) out vec4 outClip;
+layout(location = 3) flat out vec4 outClipDepth;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+const vec2 kCorners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0),
+                                vec2(1.0, 1.0), vec2(-1.0, -1.0),
+                                vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main() {
+    Impostor impostor = impostors[gl_InstanceIndex];
+    vec2 cell = vec2(float(impostor.frame % kViewGrid),
+                     float(impostor.frame / kViewGrid)) + 0.5;
+    vec3 direction = decodeOctahedral(cell / float(kViewGrid) * 2.0 - 1.0);
+    // ImpostorBaker::frameBasis
+    vec3 worldUp = abs(direction.y) < 0.99 ? vec3(0.0, 1.0, 0.0)
+                                           : vec3(0.0, 0.0, 1.0);
+    vec3 right = normalize(cross(worldUp, direction));
+    vec3 up = cross(direction, right);
+
+    vec2 corner = kCorners[gl_VertexIndex];
+    float radius = impostor.sphere.w;
+    vec3 position = impostor.sphere.xyz + direction * radius +
+                    (right * corner.x + up * corner.y) * radius;
+    mat4 modelViewProj = ubo.proj * ubo.view * ubo.model;
+    gl_Position = modelViewProj * vec4(position, 1.0);
+    outUv = corner * 0.5 + 0.5;
+    outTexelBase = (impostor.group * kViewGrid * kViewGrid + impostor.frame) *
+                   kFrameTexels;
+    outClip = gl_Position;
+    outClipDepth = modelViewProj * vec4(-direction * (2.0 * radius), 0.0);
+}
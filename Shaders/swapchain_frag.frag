@@ -6,6 +6,38 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 layout(binding = 1) uniform sampler2D texSampler;
 
+// texture streaming feedback: lowest mip each texture was sampled at. The
+// NO_TEXTURE_FEEDBACK variant is for devices without
+// fragmentStoresAndAtomics and never writes it.
+#ifdef NO_TEXTURE_FEEDBACK
+layout(binding = 2) readonly buffer TextureFeedback {
+#else
+layout(binding = 2) buffer TextureFeedback {
+#endif
+    uint requestedMip[];
+} feedback;
+
+layout(push_constant) uniform FeedbackConstants {
+    vec2 textureSize;
+    uint textureId;
+} feedbackConstants;
+
+void writeTextureFeedback(vec2 uv) {
+#ifndef NO_TEXTURE_FEEDBACK
+    // one in eight pixels is enough to find the mip and keeps atomics cheap
+    if (((uint(gl_FragCoord.x) ^ uint(gl_FragCoord.y)) & 7u) != 0u) {
+        return;
+    }
+    // lod against the full resolution texture, the bound view only holds
+    // the resident mips
+    vec2 texel = uv * feedbackConstants.textureSize;
+    float rho = max(length(dFdx(texel)), length(dFdy(texel)));
+    uint mip = uint(max(floor(log2(max(rho, 1e-6))), 0.0));
+    atomicMin(feedback.requestedMip[feedbackConstants.textureId], mip);
+#endif
+}
+
 void main() {
+    writeTextureFeedback(fragTexCoord);
     outColor = vec4(fragColor, 0.0);
-}
\ No newline at end of file
+}
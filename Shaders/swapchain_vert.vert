@@ -6,28 +6,58 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 proj;
 } ubo;
 
+// gltfVertex: unorm16 position, octahedral snorm16 normal, half float uv
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+layout(location = 1) in vec2 inNormal;
 layout(location = 2) in vec2 inTexCoord;
 
+// placements of the scene's meshes, see glTFModel::getTransformBuffer; every
+// draw starts its instances at the mesh's first transform
+layout(set = 1, binding = 0) readonly buffer Transforms {
+    mat4 transforms[];
+};
+
+// dequantization of each transform's mesh, see VertexQuantization
+struct Quantization {
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+layout(set = 1, binding = 1) readonly buffer Quantizations {
+    Quantization quantizations[];
+};
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    Quantization quantization = quantizations[gl_InstanceIndex];
+    vec3 position = quantization.positionOffset.xyz +
+                    inPosition * quantization.positionScale.xyz;
+    vec3 normal = decodeOctahedral(inNormal);
+    gl_Position = ubo.proj * ubo.view * ubo.model * transforms[gl_InstanceIndex] *
+                  vec4(position, 1.0);
     fragTexCoord = inTexCoord;
-    fragColor = inNormal;
+    fragColor = normal;
 
-    if(dot(vec3(1.0f, 0.0f, 0.0f), inNormal) > 0.0f) {
+    if(dot(vec3(1.0f, 0.0f, 0.0f), normal) > 0.0f) {
         fragColor = vec3(1.0f, 0.0f, 0.0f);
-    } else if(dot(vec3(0.0f, 1.0f, 0.0f), inNormal) > 0.0f){
+    } else if(dot(vec3(0.0f, 1.0f, 0.0f), normal) > 0.0f){
         fragColor = vec3(0.0f, 1.0f, 0.0f);
-    } else if(dot(vec3(0.0f, 0.0f, 1.0f), inNormal) > 0.0f){
+    } else if(dot(vec3(0.0f, 0.0f, 1.0f), normal) > 0.0f){
         fragColor = vec3(0.0f, 0.0f, 1.0f);
-    } else if(dot(vec3(0.0f, 0.0f, -1.0f), inNormal) > 0.0f){
+    } else if(dot(vec3(0.0f, 0.0f, -1.0f), normal) > 0.0f){
         fragColor = vec3(0.0f, 0.0f, 1.0f);
-    } else if(dot(vec3(0.0f, -1.0f, 0.0f), inNormal) > 0.0f){
+    } else if(dot(vec3(0.0f, -1.0f, 0.0f), normal) > 0.0f){
         fragColor = vec3(0.0f, 1.0f, 0.0f);
     }
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef ACCESSOR_DECODER_HPP
+#define ACCESSOR_DECODER_HPP
+#include <cstddef>
+#include <cstdint>
+#include <tiny_gltf.h>
+
+namespace hiddenpiggy {
+
+// Decodes gltf accessors straight out of tinygltf's buffers. Every component
+// type is accepted and converted, normalized integers are mapped to [0, 1] or
+// [-1, 1], and sparse accessors are applied on top of the dense data.
+namespace AccessorDecoder {
+
+uint32_t getComponentCount(const tinygltf::Accessor &accessor);
+uint32_t getComponentSize(const tinygltf::Accessor &accessor);
+
+// writes accessor.count elements of `components` floats each to dst, one
+// element every dstStride bytes; missing components are left untouched
+void decodeFloats(const tinygltf::Model &model,
+                  const tinygltf::Accessor &accessor, uint32_t components,
+                  void *dst, size_t dstStride);
+
+// writes accessor.count indices to dst, each offset by baseVertex
+void decodeIndices(const tinygltf::Model &model,
+                   const tinygltf::Accessor &accessor, uint32_t *dst,
+                   uint32_t baseVertex = 0);
+
+} // namespace AccessorDecoder
+} // namespace hiddenpiggy
+#endif
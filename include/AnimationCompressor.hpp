@@ -0,0 +1,54 @@
+#ifndef ANIMATION_COMPRESSOR_HPP
+#define ANIMATION_COMPRESSOR_HPP
+#include "AnimationEvaluator.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Import time compression of an AnimationLibrary, sampler by sampler:
+//   reduce   - linear keys that interpolating their neighbours rebuilds
+//              within the tolerance are dropped, as are step keys repeating
+//              the value before them; the first and last key always stay
+//   quantize - rotations become smallest-three 48-bit words, translations
+//              and scales 16-bit steps of the sampler's own range
+// Cubic spline keys are kept as they are, since dropping one would need
+// refitted tangents, and their rotations stay floats as the tangents are no
+// unit quaternions. The error is measured against the source at every
+// source key and halfway between keys, so it includes the quantization.
+namespace AnimationCompressor {
+
+struct Settings {
+  float translationTolerance = 1e-4f; // distance, in scene units
+  float rotationTolerance = 1e-4f;    // angle, in radians
+  float scaleTolerance = 1e-4f;       // per component
+  bool quantize = true;
+};
+
+struct ClipStats {
+  std::string name;
+  uint32_t keysBefore = 0;
+  uint32_t keysAfter = 0;
+  size_t bytesBefore = 0;
+  size_t bytesAfter = 0;
+  // worst difference to the source, in the units of the tolerances
+  float translationError = 0.0f;
+  float rotationError = 0.0f;
+  float scaleError = 0.0f;
+
+  float ratio() const {
+    return bytesAfter ? float(double(bytesBefore) / double(bytesAfter)) : 0.0f;
+  }
+};
+
+// clears compressed and fills it with source's clips, in the same order and
+// with the same channels; returns one ClipStats per clip
+std::vector<ClipStats> compress(const AnimationLibrary &source,
+                                AnimationLibrary &compressed,
+                                const Settings &settings = {});
+
+} // namespace AnimationCompressor
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,169 @@
+#ifndef ANIMATION_EVALUATOR_HPP
+#define ANIMATION_EVALUATOR_HPP
+#include "ThreadPool.hpp"
+#include "TransformHierarchy.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace hiddenpiggy {
+
+enum class AnimationPath { Translation, Rotation, Scale };
+enum class AnimationInterpolation { Linear, Step, CubicSpline };
+// how a sampler's values are stored: floats, 16-bit steps of the sampler's
+// range, or smallest-three rotations (SimdMath::decodeSmallestThree)
+enum class AnimationEncoding { Float, Quantized, SmallestThree };
+
+// Keyframes of a set of clips, immutable once loaded and shared by every
+// AnimationPlayer that plays them. Key times of all samplers live in one
+// array and values in one array per component, so a sampler's keys are
+// contiguous runs the search and the interpolation stream through.
+// AnimationCompressor builds a smaller library from a loaded one.
+class AnimationLibrary {
+public:
+  struct Sampler {
+    uint32_t firstKey; // into the time array
+    uint32_t keyCount;
+    // into the float or the quantized value arrays, as encoding says; 3 per
+    // key for cubic splines
+    uint32_t firstValue;
+    AnimationInterpolation interpolation;
+    AnimationEncoding encoding;
+    // value = origin + extent * step / 65535 for Quantized
+    glm::vec3 origin;
+    glm::vec3 extent;
+  };
+
+  struct Channel {
+    uint32_t sampler;
+    uint32_t node; // TransformHierarchy node
+    AnimationPath path;
+  };
+
+  struct Clip {
+    std::string name;
+    uint32_t firstChannel;
+    uint32_t channelCount;
+    float start;
+    float end;
+  };
+
+  // values holds components floats per key, in tangent, value and out
+  // tangent per key for cubic splines; times must not decrease. Returns the
+  // sampler's index for addChannel.
+  uint32_t addSampler(AnimationInterpolation interpolation, const float *times,
+                      uint32_t keyCount, const float *values,
+                      uint32_t components);
+  // the same with values already encoded, three words per value
+  uint32_t addQuantizedSampler(AnimationInterpolation interpolation,
+                               const float *times, uint32_t keyCount,
+                               AnimationEncoding encoding,
+                               const uint16_t *words, const glm::vec3 &origin,
+                               const glm::vec3 &extent);
+  // channels are added to the clip begun last
+  uint32_t beginClip(const std::string &name);
+  void addChannel(uint32_t sampler, uint32_t node, AnimationPath path);
+  void clear();
+
+  const std::vector<Clip> &getClips() const { return m_clips; }
+  const std::vector<Channel> &getChannels() const { return m_channels; }
+  const std::vector<Sampler> &getSamplers() const { return m_samplers; }
+  const float *getTimes() const { return m_times.data(); }
+  // component c (x, y, z, w) of every float value
+  const float *getValues(uint32_t c) const { return m_values[c].data(); }
+  // word c of every quantized value
+  const uint16_t *getQuantized(uint32_t c) const {
+    return m_quantized[c].data();
+  }
+  size_t getKeyCount() const { return m_times.size(); }
+  static uint32_t getValueCount(const Sampler &sampler) {
+    return sampler.keyCount *
+           (sampler.interpolation == AnimationInterpolation::CubicSpline ? 3
+                                                                         : 1);
+  }
+  // key times and values the sampler occupies
+  size_t getSamplerBytes(uint32_t sampler) const;
+
+  // The values an evaluation at some time reads: one held value, the two
+  // keys around it, or value, out tangent, in tangent and value of a cubic
+  // spline interval. values index the sampler's own values.
+  struct Segment {
+    uint32_t valueCount;
+    uint32_t values[4];
+    float u;  // position in the interval
+    float dt; // interval length
+  };
+  // key is the last one not after time, or the first
+  Segment getSegment(const Sampler &sampler, uint32_t key, float time) const;
+  static glm::vec4 interpolate(const Segment &segment, AnimationPath path,
+                               const glm::vec4 *values);
+  // value of the sampler, decoded one at a time; rotations are x, y, z, w
+  glm::vec4 getValue(const Sampler &sampler, uint32_t value) const;
+  // one sampler at time with a binary search, for tools and import
+  glm::vec4 sample(uint32_t sampler, AnimationPath path, float time) const;
+
+private:
+  std::vector<Clip> m_clips;
+  std::vector<Channel> m_channels;
+  std::vector<Sampler> m_samplers;
+  std::vector<float> m_times;
+  std::vector<float> m_values[4];
+  std::vector<uint16_t> m_quantized[3];
+};
+
+// The playback state of one animated instance: the clip and, per channel, a
+// cursor on the key interval the last evaluation was in. Playing forward
+// moves each cursor by a key or two, so a lookup is O(1) amortized; seeks
+// and loops fall back to a binary search. Quantized keys are decoded with
+// the SimdMath kernels, all channels of a clip at once.
+class AnimationPlayer {
+public:
+  // forward steps tried before a cursor gives up and searches
+  static constexpr uint32_t kMaxCursorSteps = 4;
+
+  void setClip(const AnimationLibrary &library, uint32_t clip);
+  uint32_t getClip() const { return m_clip; }
+
+  // writes the clip's channels at time into transforms, which marks the
+  // targets dirty for the next TransformHierarchy::update
+  void evaluate(const AnimationLibrary &library, float time,
+                TransformHierarchy &transforms);
+
+  struct Job {
+    AnimationPlayer *player;
+    TransformHierarchy *transforms;
+    float time;
+  };
+  // evaluates the jobs spread over pool's workers and updates their
+  // hierarchies' world matrices; every job needs its own player and
+  // hierarchy
+  static void evaluateAll(ThreadPool &pool, const AnimationLibrary &library,
+                          std::span<const Job> jobs);
+
+private:
+  uint32_t findKey(const AnimationLibrary &library,
+                   const AnimationLibrary::Sampler &sampler, uint32_t channel,
+                   float time);
+
+  uint32_t m_clip = UINT32_MAX;
+  std::vector<uint32_t> m_cursors; // per channel of the clip
+
+  // Evaluation scratch, reused every call. Each channel gets four value
+  // slots; quantized values are gathered and decoded in one batch per
+  // encoding before any channel interpolates.
+  std::vector<AnimationLibrary::Segment> m_segments;
+  std::vector<glm::vec4> m_slots;
+  std::vector<uint16_t> m_rotationWords[3];
+  std::vector<uint32_t> m_rotationSlots;
+  std::vector<glm::quat> m_rotations;
+  std::vector<uint16_t> m_steps; // three per vector value
+  std::vector<float> m_origins;
+  std::vector<float> m_extents;
+  std::vector<uint32_t> m_vectorSlots;
+  std::vector<float> m_vectors;
+};
+} // namespace hiddenpiggy
+#endif
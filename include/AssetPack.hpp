@@ -0,0 +1,110 @@
+#ifndef ASSET_PACK_HPP
+#define ASSET_PACK_HPP
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// On disk layout of an asset pack. Every asset is cut into chunks of at most
+// AssetPack::kChunkSize bytes that are compressed on their own, so one asset
+// decompresses on as many threads as it has chunks.
+//
+//   header | chunk data | entries | chunks | names
+struct AssetPackHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t chunkCount;
+  uint64_t entryOffset;
+  uint64_t chunkOffset;
+  uint64_t nameOffset;
+  uint64_t nameSize;
+};
+
+// entries are sorted by name
+struct AssetPackEntry {
+  uint64_t nameOffset; // into the name blob
+  uint32_t nameLength;
+  uint32_t firstChunk;
+  uint32_t chunkCount;
+  uint32_t reserved;
+  uint64_t size;
+};
+
+struct AssetPackChunk {
+  uint64_t offset;
+  uint32_t compressedSize; // equal to size if the chunk is stored as is
+  uint32_t size;
+};
+
+class AssetPack {
+public:
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kChunkSize = 256 * 1024;
+
+  // a pack stands in for the directory of the same name
+  static std::string packPathFor(const std::string &directory);
+
+  bool open(const std::string &packPath);
+  void close();
+  bool isOpen() const { return m_header != nullptr; }
+
+  // names are relative paths with '/' separators; null if not packed
+  const AssetPackEntry *find(const std::string &name) const;
+
+  // decompresses the asset into dst, which holds entry.size bytes. Chunks are
+  // spread over the pool when there is more than one
+  bool read(const AssetPackEntry &entry, void *dst, ThreadPool *pool,
+            std::string *err) const;
+
+  // (name, file on disk) pairs; chunks are compressed in parallel on the pool
+  static bool write(const std::string &packPath,
+                    const std::vector<std::pair<std::string, std::string>> &files,
+                    ThreadPool &pool, std::string *err);
+
+  // Makes the pack's contents visible under directory to every loader that
+  // reads through AssetReader; mounted packs are searched before the disk.
+  // Mount before any loads start, the table is not locked.
+  static bool mount(const std::string &packPath, const std::string &directory);
+  static void unmountAll();
+  // false if no mounted pack holds path
+  static bool isMounted(const std::string &path);
+  // the size of the packed asset and the last write time of its pack, what
+  // caches derived from the asset key on; false if path is not packed
+  static bool statMounted(const std::string &path, uint64_t *size,
+                          int64_t *packWriteTime);
+  // also false for paths that are not packed, check isMounted first
+  static bool readMounted(const std::string &path,
+                          std::vector<unsigned char> *out, std::string *err);
+
+private:
+  std::span<const AssetPackEntry> getEntries() const {
+    return {reinterpret_cast<const AssetPackEntry *>(m_file.data() +
+                                                     m_header->entryOffset),
+            m_header->entryCount};
+  }
+  std::span<const AssetPackChunk> getChunks() const {
+    return {reinterpret_cast<const AssetPackChunk *>(m_file.data() +
+                                                     m_header->chunkOffset),
+            m_header->chunkCount};
+  }
+  std::string_view getName(const AssetPackEntry &entry) const {
+    return {reinterpret_cast<const char *>(m_file.data() +
+                                           m_header->nameOffset +
+                                           entry.nameOffset),
+            entry.nameLength};
+  }
+  bool readChunk(const AssetPackChunk &chunk, uint8_t *dst) const;
+
+  MappedFile m_file;
+  const AssetPackHeader *m_header = nullptr;
+};
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,97 @@
+#ifndef ASSET_READER_HPP
+#define ASSET_READER_HPP
+#include "ThreadPool.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Batched whole-file reads. Callers submit every file they need up front and
+// consume completions in whatever order the storage delivers them. Reads go
+// through io_uring on linux; where the kernel or a seccomp profile refuses
+// it, a small thread pool issuing pread takes over.
+class AssetReader {
+public:
+  struct Completion {
+    uint32_t ticket = 0;
+    std::vector<unsigned char> data;
+    // empty on success
+    std::string error;
+  };
+
+  AssetReader();
+  AssetReader(const AssetReader &) = delete;
+  AssetReader &operator=(const AssetReader &) = delete;
+  ~AssetReader();
+
+  // queueDepth bounds the reads in flight at once
+  void OnCreate(uint32_t queueDepth = 64);
+  void OnDestroy();
+
+  // queues a read of the whole file and returns its ticket
+  uint32_t submit(const std::string &path);
+
+  // blocks until one read finished; false once nothing is outstanding
+  bool wait(Completion &completion);
+
+  bool isUsingIoUring() const { return m_ringFd >= 0; }
+
+  // single synchronous read for callers with nothing to overlap it with
+  static bool readFile(const std::string &path,
+                       std::vector<unsigned char> *out, std::string *err);
+
+private:
+  struct PendingRead {
+    uint32_t ticket;
+    std::string path;
+  };
+
+  // io_uring backend
+  struct Slot;
+  bool setupRing(uint32_t entries);
+  void teardownRing();
+  void fillRing();
+  bool startRead(Slot &slot);
+  void queueRead(Slot &slot);
+  void submitAndWait(uint32_t minComplete);
+  void reapRing();
+
+  // pread fallback
+  void fallbackRead(PendingRead read);
+
+  uint32_t m_nextTicket = 0;
+  uint32_t m_outstanding = 0;
+  std::deque<PendingRead> m_pending;
+
+  int m_ringFd = -1;
+  uint32_t m_queueDepth = 0;
+  uint32_t m_toSubmit = 0;
+  void *m_sqRing = nullptr;
+  size_t m_sqRingSize = 0;
+  void *m_cqRing = nullptr;
+  size_t m_cqRingSize = 0;
+  void *m_sqes = nullptr;
+  size_t m_sqesSize = 0;
+  unsigned *m_sqHead = nullptr;
+  unsigned *m_sqTail = nullptr;
+  unsigned *m_sqMask = nullptr;
+  unsigned *m_sqArray = nullptr;
+  unsigned *m_cqHead = nullptr;
+  unsigned *m_cqTail = nullptr;
+  unsigned *m_cqMask = nullptr;
+  void *m_cqes = nullptr;
+  std::vector<std::unique_ptr<Slot>> m_slots;
+  std::vector<uint32_t> m_freeSlots;
+  std::deque<Completion> m_ready;
+
+  std::unique_ptr<ThreadPool> m_pPool;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+};
+} // namespace hiddenpiggy
+#endif
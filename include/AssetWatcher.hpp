@@ -0,0 +1,37 @@
+#ifndef ASSET_WATCHER_HPP
+#define ASSET_WATCHER_HPP
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Reports files that were rewritten under the watched directories, using
+// inotify on linux (a no-op elsewhere). Editors save in bursts, so a path is
+// only reported once it has been quiet for the settle time.
+class AssetWatcher {
+public:
+  void OnCreate(std::chrono::milliseconds settleTime =
+                    std::chrono::milliseconds(200));
+  void OnDestroy();
+
+  // watches directory and every directory below it
+  void watchDirectory(const std::string &directory);
+
+  // non blocking; returns the paths that settled since the last call
+  std::vector<std::string> poll();
+
+private:
+  void addWatch(const std::string &directory);
+  void readEvents();
+
+  int m_fd = -1;
+  std::chrono::milliseconds m_settleTime{0};
+  std::unordered_map<int, std::string> m_directories;
+  // path -> time of its last write
+  std::unordered_map<std::string, std::chrono::steady_clock::time_point>
+      m_changed;
+};
+} // namespace hiddenpiggy
+#endif
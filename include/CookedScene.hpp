@@ -0,0 +1,331 @@
+#ifndef COOKED_SCENE_HPP
+#define COOKED_SCENE_HPP
+#include "GpuCodec.hpp"
+#include "MappedFile.hpp"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// On disk layout of a cooked scene. Every table and blob starts at an offset
+// aligned to CookedScene::kBlobAlignment so the blobs can be copied to the
+// gpu straight out of the mapping. The vertex and index blobs are GpuCodec
+// streams that the GpuDecompressor expands on the gpu; vertexSize and
+// indexSize are the decoded sizes.
+//
+//   header | dependencies and texture images | nodes | node instances |
+//   batch members | meshes | primitives | materials | meshlet tables |
+//   impostor groups | impostor texels | vertex stream | index stream
+
+// post transform cache numbers of the mesh optimizer, kept so a cached load
+// can report them too
+struct CookedMeshStats {
+  float acmrBefore;
+  float acmrAfter;
+  float atvrBefore;
+  float atvrAfter;
+};
+
+struct CookedSceneHeader {
+  char magic[4];
+  uint32_t version;
+  // hash over the size and last write time of the source file and every
+  // file it depends on, see CookedScene::stampSources
+  uint64_t sourceStamp;
+
+  uint32_t dependencyCount;
+  uint32_t nodeCount;
+  uint32_t meshCount;
+  uint32_t primitiveCount;
+  uint32_t materialCount;
+  // image files of the glTF textures, stored after the dependencies
+  uint32_t textureCount;
+  uint32_t vertexStride;
+  uint32_t flags; // CookedScene::kFlag*
+  CookedMeshStats meshStats;
+
+  uint64_t dependencyOffset;
+  uint64_t nodeOffset;
+  uint64_t meshOffset;
+  uint64_t primitiveOffset;
+  uint64_t materialOffset;
+  uint64_t vertexOffset;
+  uint64_t vertexSize;
+  uint64_t vertexStreamSize;
+  uint64_t indexOffset;
+  uint64_t indexSize;
+  uint64_t indexStreamSize;
+  uint64_t meshletOffset;
+  uint64_t meshletCount;
+  uint64_t meshletVertexOffset;
+  uint64_t meshletVertexCount;
+  uint64_t meshletTriangleOffset;
+  uint64_t meshletTriangleSize;
+  uint64_t nodeInstanceOffset;
+  uint64_t nodeInstanceCount;
+  uint64_t batchMemberOffset;
+  uint64_t batchMemberCount;
+  uint64_t impostorGroupOffset;
+  uint64_t impostorGroupCount;
+  uint64_t impostorTexelOffset;
+  uint64_t impostorTexelCount;
+};
+
+struct CookedNode {
+  float matrix[16]; // local transform, column major
+  int32_t parent;   // -1 for scene roots
+  int32_t mesh;     // -1 if the node carries no geometry
+  // EXT_mesh_gpu_instancing copies of the mesh in the node instance table;
+  // with none the node places its mesh once
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+  // the HLOD group the node is drawn as an impostor with at distance, -1
+  // for none
+  int32_t impostorGroup;
+};
+
+// one copy of a node's mesh, relative to the node
+struct CookedInstance {
+  float matrix[16]; // column major
+};
+
+// the share of a static batch that came from one source node, see
+// StaticBatcher::Member
+struct CookedBatchMember {
+  uint32_t node;
+  uint32_t mesh;
+  float boundsMin[3]; // world space
+  float boundsMax[3];
+};
+
+// bounding sphere of an HLOD group in world space, see ImpostorBaker
+struct CookedImpostorGroup {
+  float center[3];
+  float radius;
+};
+
+struct CookedMesh {
+  uint32_t firstPrimitive;
+  uint32_t primitiveCount;
+  // the mesh's quantized positions decode to offset + value * scale
+  float positionOffset[4];
+  float positionScale[4];
+};
+
+// levels of detail per primitive, the full mesh included
+constexpr uint32_t kMaxLods = 4;
+
+// a simplified index range over the primitive's vertices; error is the
+// deviation from the full mesh in model units
+struct CookedLod {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  float error;
+};
+
+// a MeshOptimizer::Meshlet with its bounds, laid out for std430 so the
+// table is uploaded as is. Vertices are relative to baseVertex, the
+// primitive's vertexOffset.
+struct CookedMeshlet {
+  uint32_t vertexOffset;   // into the meshlet vertex table
+  uint32_t triangleOffset; // into the meshlet triangle table, in bytes
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+  float center[3];
+  float radius;
+  float coneApex[3];
+  float coneCutoff;
+  float coneAxis[3];
+  int32_t baseVertex;
+};
+static_assert(sizeof(CookedMeshlet) == 64, "CookedMeshlet is shared with the gpu");
+
+// offsets are absolute within the vertex and index blobs; firstIndex counts
+// in units of the primitive's own index size
+struct CookedPrimitive {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  uint32_t firstVertex;
+  uint32_t vertexCount;
+  int32_t vertexOffset;
+  uint32_t materialIndex;
+  uint32_t indexSize; // 2 or 4 bytes
+  // order for the position only passes, same range when there is none
+  uint32_t depthFirstIndex;
+  uint32_t depthIndexCount;
+  // lodCount - 1 coarser levels follow the full mesh
+  uint32_t lodCount;
+  CookedLod lods[kMaxLods - 1];
+  // model space bounding sphere, what LOD selection projects
+  float boundsCenter[3];
+  float boundsRadius;
+  // culling clusters of the full mesh, none for unindexed primitives
+  uint32_t firstMeshlet;
+  uint32_t meshletCount;
+  // over the decoded vertex and index bytes, compared on hot reload
+  uint64_t contentHash;
+};
+
+struct CookedMaterial {
+  float baseColorFactor[4];
+  float emissiveFactor[4];
+  float metallicFactor;
+  float roughnessFactor;
+  float alphaCutoff;
+  uint32_t alphaMode; // 0 opaque, 1 mask, 2 blend
+  int32_t baseColorTexture;
+  int32_t metallicRoughnessTexture;
+  int32_t normalTexture;
+  int32_t occlusionTexture;
+  int32_t emissiveTexture;
+  uint32_t doubleSided;
+};
+
+// everything the writer needs, gathered by the importer; the geometry is
+// passed decoded and compressed by write
+struct CookedSceneData {
+  std::vector<std::string> dependencies; // relative to the source directory
+  // the image file of each glTF texture, relative to the source directory
+  // and empty for embedded images; what the material texture indices pick
+  std::vector<std::string> textureImages;
+  std::vector<CookedNode> nodes;
+  std::vector<CookedInstance> nodeInstances;
+  std::vector<CookedBatchMember> batchMembers;
+  std::vector<CookedMesh> meshes;
+  std::vector<CookedPrimitive> primitives;
+  std::vector<CookedMaterial> materials;
+  std::vector<CookedMeshlet> meshlets;
+  std::vector<uint32_t> meshletVertices;
+  std::vector<uint8_t> meshletTriangles;
+  std::vector<CookedImpostorGroup> impostorGroups;
+  std::vector<uint32_t> impostorTexels;
+  const void *vertexData = nullptr;
+  uint64_t vertexSize = 0;
+  uint32_t vertexStride = 0;
+  // words after which the vertex data repeats its layout, what the codec
+  // predicts from; the vertex stride in words when 0
+  uint32_t vertexStreamPeriod = 0;
+  const void *indexData = nullptr;
+  uint64_t indexSize = 0;
+  uint32_t flags = 0;
+  CookedMeshStats meshStats{};
+};
+
+class CookedScene {
+public:
+  static constexpr uint32_t kVersion = 16;
+  // geometry went through MeshOptimizer
+  static constexpr uint32_t kFlagOptimizedMeshes = 1;
+  // static nodes were merged by StaticBatcher
+  static constexpr uint32_t kFlagStaticBatching = 2;
+  // static groups were baked to impostors by ImpostorBaker
+  static constexpr uint32_t kFlagImpostors = 4;
+  static constexpr uint64_t kBlobAlignment = 256;
+
+  // cooked files live next to their source
+  static std::string cookedPathFor(const std::string &sourcePath) {
+    return sourcePath + ".cooked";
+  }
+
+  // maps the cooked file; fails if it is missing, from another version,
+  // cooked with other flags or if any of the sources it was cooked from
+  // changed since
+  bool open(const std::string &cookedPath, const std::string &sourcePath,
+            uint32_t expectedVertexStride, uint32_t expectedFlags);
+  void close();
+
+  static bool write(const std::string &cookedPath,
+                    const std::string &sourcePath,
+                    const CookedSceneData &data);
+
+  // keys the cook on the sources' sizes and last write times, or on their
+  // pack entries when they are packed, so checking it reads no contents
+  static uint64_t stampSources(const std::string &sourcePath,
+                               const std::vector<std::string> &dependencies);
+
+  bool isOpen() const { return m_header != nullptr; }
+  const CookedSceneHeader &getHeader() const { return *m_header; }
+
+  // see CookedSceneData::textureImages
+  const std::vector<std::string> &getTextureImages() const {
+    return m_textureImages;
+  }
+
+  std::span<const CookedNode> getNodes() const {
+    return table<CookedNode>(m_header->nodeOffset, m_header->nodeCount);
+  }
+  std::span<const CookedInstance> getNodeInstances() const {
+    return table<CookedInstance>(m_header->nodeInstanceOffset,
+                                 m_header->nodeInstanceCount);
+  }
+  std::span<const CookedBatchMember> getBatchMembers() const {
+    return table<CookedBatchMember>(m_header->batchMemberOffset,
+                                    m_header->batchMemberCount);
+  }
+  std::span<const CookedMesh> getMeshes() const {
+    return table<CookedMesh>(m_header->meshOffset, m_header->meshCount);
+  }
+  std::span<const CookedPrimitive> getPrimitives() const {
+    return table<CookedPrimitive>(m_header->primitiveOffset,
+                                  m_header->primitiveCount);
+  }
+  std::span<const CookedMaterial> getMaterials() const {
+    return table<CookedMaterial>(m_header->materialOffset,
+                                 m_header->materialCount);
+  }
+
+  // compressed geometry, validated by open
+  std::span<const uint32_t> getVertexStream() const {
+    return table<uint32_t>(m_header->vertexOffset,
+                           m_header->vertexStreamSize / sizeof(uint32_t));
+  }
+  uint64_t getVertexSize() const { return m_header->vertexSize; }
+  std::span<const uint32_t> getIndexStream() const {
+    return table<uint32_t>(m_header->indexOffset,
+                           m_header->indexStreamSize / sizeof(uint32_t));
+  }
+  uint64_t getIndexSize() const { return m_header->indexSize; }
+
+  // meshlet tables, stored as they are; open checks every meshlet's ranges
+  std::span<const CookedMeshlet> getMeshlets() const {
+    return table<CookedMeshlet>(m_header->meshletOffset,
+                                m_header->meshletCount);
+  }
+  std::span<const uint32_t> getMeshletVertices() const {
+    return table<uint32_t>(m_header->meshletVertexOffset,
+                           m_header->meshletVertexCount);
+  }
+  std::span<const uint8_t> getMeshletTriangles() const {
+    return table<uint8_t>(m_header->meshletTriangleOffset,
+                          m_header->meshletTriangleSize);
+  }
+
+  // HLOD groups and their view atlases, ImpostorBaker::kGroupTexels each
+  std::span<const CookedImpostorGroup> getImpostorGroups() const {
+    return table<CookedImpostorGroup>(m_header->impostorGroupOffset,
+                                      m_header->impostorGroupCount);
+  }
+  std::span<const uint32_t> getImpostorTexels() const {
+    return table<uint32_t>(m_header->impostorTexelOffset,
+                           m_header->impostorTexelCount);
+  }
+
+  // start reading the blobs in ahead of the upload
+  void adviseBlobs() const;
+
+private:
+  // open checked that every table lies within the mapping
+  template <typename T>
+  std::span<const T> table(uint64_t offset, uint64_t count) const {
+    return {reinterpret_cast<const T *>(m_file.data() + offset),
+            static_cast<size_t>(count)};
+  }
+
+  MappedFile m_file;
+  const CookedSceneHeader *m_header = nullptr;
+  std::vector<std::string> m_textureImages;
+};
+} // namespace hiddenpiggy
+#endif
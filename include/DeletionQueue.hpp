@@ -0,0 +1,51 @@
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// gpu resources replaced at runtime; each one is destroyed once every frame
+// that could still reference it has completed
+class DeletionQueue {
+public:
+  explicit DeletionQueue(uint32_t framesInFlight = 1)
+      : m_framesInFlight(framesInFlight) {}
+
+  void push(std::function<void()> destroy) {
+    m_pending.push_back({std::move(destroy), m_frame});
+  }
+
+  // call once per frame after the oldest frame in flight has been waited on
+  void OnUpdate() {
+    m_frame++;
+    auto it = m_pending.begin();
+    while (it != m_pending.end()) {
+      if (m_frame - it->frame > m_framesInFlight) {
+        it->destroy();
+        it = m_pending.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void flush() {
+    for (auto &entry : m_pending) {
+      entry.destroy();
+    }
+    m_pending.clear();
+  }
+
+private:
+  struct Entry {
+    std::function<void()> destroy;
+    uint64_t frame;
+  };
+  std::vector<Entry> m_pending;
+  uint64_t m_frame = 0;
+  uint32_t m_framesInFlight;
+};
+} // namespace hiddenpiggy
+#endif
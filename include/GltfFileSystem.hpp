@@ -0,0 +1,33 @@
+#ifndef GLTF_FILE_SYSTEM_HPP
+#define GLTF_FILE_SYSTEM_HPP
+#include <string>
+#include <tiny_gltf.h>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// tinygltf file access through mmap instead of buffered ifstream reads
+namespace GltfFileSystem {
+
+// ReadWholeFile still has to fill tinygltf's vector, but copies straight out
+// of the mapping and drops the source pages behind the copy
+tinygltf::FsCallbacks getMappedCallbacks();
+
+// reads a whole file through a mapping, dropping pages behind the copy.
+// Files in a mounted AssetPack are decompressed from the pack instead
+bool readFile(const std::string &filepath, std::vector<unsigned char> *out,
+              std::string *err);
+
+// loads .gltf and .glb files; the json or glb container is parsed directly
+// from the mapping without an intermediate copy. .gltf files go through
+// GltfJsonParser first. Without loadImages the image bytes are never kept.
+bool loadModel(tinygltf::TinyGLTF &loader, tinygltf::Model *model,
+               std::string *err, std::string *warn,
+               const std::string &filename, bool loadImages = true);
+
+// frees the raw buffer and image memory once it has been uploaded
+void releaseData(tinygltf::Model &model);
+
+} // namespace GltfFileSystem
+} // namespace hiddenpiggy
+#endif
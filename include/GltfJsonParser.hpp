@@ -0,0 +1,24 @@
+#ifndef GLTF_JSON_PARSER_HPP
+#define GLTF_JSON_PARSER_HPP
+#include <cstddef>
+#include <string>
+#include <tiny_gltf.h>
+
+namespace hiddenpiggy {
+
+// Single pass, on-demand parser for the json of a .gltf file. Values are read
+// straight from the source text into the tinygltf::Model without building a
+// dom; members the loaders never look at (extras, cameras, morph targets) are
+// skipped without being materialized.
+namespace GltfJsonParser {
+
+// Fills model from json, then loads the buffers relative to baseDir. Images
+// are left encoded with as_is set, or not loaded at all without loadImages.
+// Returns false on malformed input and for files that use extensions, which
+// are left to tinygltf.
+bool parse(const char *json, size_t size, const std::string &baseDir,
+           tinygltf::Model *model, std::string *err, bool loadImages = true);
+
+} // namespace GltfJsonParser
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,60 @@
+#ifndef GPU_CODEC_HPP
+#define GPU_CODEC_HPP
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Lossless codec for 32 bit word streams (vertex and index blobs) that a
+// compute shader can decode with one thread per word. The words are cut into
+// blocks of kBlockWords; each block is bit packed on its own with one of two
+// predictors, so any block decodes without touching its neighbours:
+//
+//   offset   - value - min over the block, for indices
+//   anchor   - value xor the same attribute of the block's first vertex,
+//              for interleaved float vertices where sign and exponent
+//              rarely change between neighbours
+//
+// stream:  wordCount | stride | blockCount | blockCount + 1 block offsets |
+//          blocks
+// block:   mode | bits << 8, then the offset base or the stride anchor
+//          words, then the residuals packed lsb first, bits each
+//
+// Block offsets count words from the first block. Shaders/decompress.comp
+// is the gpu decoder and must stay in sync with decodeRange.
+namespace GpuCodec {
+
+constexpr uint32_t kBlockWords = 64;
+constexpr uint32_t kHeaderWords = 3;
+constexpr uint32_t kModeOffset = 0;
+constexpr uint32_t kModeAnchor = 1;
+
+struct StreamInfo {
+  uint32_t wordCount;
+  uint32_t stride;
+  uint32_t blockCount;
+};
+
+// stride is the vertex size in words, 1 for index data
+std::vector<uint32_t> encode(const uint32_t *words, size_t wordCount,
+                             uint32_t stride);
+
+// false if the header or the block table do not fit the stream
+bool readInfo(std::span<const uint32_t> stream, StreamInfo &info);
+
+std::span<const uint32_t> getBlockTable(std::span<const uint32_t> stream);
+
+// walks every block header once; a stream that passes can be handed to the
+// gpu decoder, which does no bounds checks of its own
+bool validate(std::span<const uint32_t> stream);
+
+// reference decoder; decodes words [firstWord, endWord), dst[0] receives
+// firstWord
+bool decodeRange(std::span<const uint32_t> stream, uint32_t firstWord,
+                 uint32_t endWord, uint32_t *dst);
+
+} // namespace GpuCodec
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,100 @@
+#ifndef GPU_DECOMPRESSOR_HPP
+#define GPU_DECOMPRESSOR_HPP
+#include "GpuCodec.hpp"
+#include "ResourceUploadHeap.hpp"
+#include "VkBufferPool.hpp"
+#include "VkContext.hpp"
+#include "vulkan/vulkan.hpp"
+#include <span>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Decodes GpuCodec streams straight into device buffers. The compressed
+// blocks go to a host visible staging buffer as they are and
+// Shaders/decompress.comp expands them into the destination, which needs
+// eStorageBuffer usage. If the pipeline cannot be built or its output does
+// not match the cpu reference decoder, the words are decoded on the cpu and
+// uploaded through the ResourceUploadHeap instead. The dispatches between
+// beginBatch and endBatch go out in one submit with one fence wait.
+class GpuDecompressor {
+public:
+  GpuDecompressor(VkContext *context, BufferPool *bufferPool,
+                  ResourceUploadHeap *resourceUploadHeap)
+      : m_pContext(context), m_pBufferPool(bufferPool),
+        m_pResourceUploadHeap(resourceUploadHeap) {}
+
+  // allowGpu false forces the cpu path, e.g. to compare the two
+  void OnCreate(bool allowGpu = true);
+  void OnDestroy();
+
+  // decodes words [firstWord, endWord) of a validated stream into dst at the
+  // same word offsets. Inside a batch the data is in place after endBatch,
+  // otherwise when decode returns.
+  void decode(std::span<const uint32_t> stream, uint32_t firstWord,
+              uint32_t endWord, BufferWrapper &dst);
+
+  // the stream is copied out when decode is called, it need not outlive the
+  // batch. A batch that outgrows the staging buffer or its descriptor sets
+  // is submitted early.
+  void beginBatch();
+  void endBatch();
+
+  bool isUsingGpu() const { return static_cast<bool>(m_pipeline); }
+
+  // rebuilds the pipeline after decompress.spv changed and keeps it only if
+  // it passes the self test; false leaves the previous pipeline in place
+  bool reloadShaders();
+
+private:
+  struct DecodeConstants {
+    uint32_t firstBlock;
+    uint32_t blockCount;
+    uint32_t firstWord;
+    uint32_t endWord;
+    uint32_t wordCount;
+    uint32_t stride;
+    uint32_t outputBase;
+  };
+
+  bool createPipeline();
+  // decompress.spv against m_pipelineLayout, null if it does not build
+  vk::Pipeline buildPipeline();
+  void destroyPipeline();
+  // decodes a synthetic stream on both paths and compares the results
+  bool selfTest();
+  // records the dispatch into the open batch
+  void decodeOnGpu(std::span<const uint32_t> stream, uint32_t firstWord,
+                   uint32_t endWord, BufferWrapper &dst);
+  // submits the recorded dispatches and waits for them
+  void submitBatch();
+  void decodeOnCpu(std::span<const uint32_t> stream, uint32_t firstWord,
+                   uint32_t endWord, BufferWrapper &dst);
+  void reserveStaging(vk::DeviceSize size);
+
+  VkContext *m_pContext;
+  BufferPool *m_pBufferPool;
+  ResourceUploadHeap *m_pResourceUploadHeap;
+
+  vk::DescriptorSetLayout m_descriptorSetLayout;
+  vk::DescriptorPool m_descriptorPool;
+  // one set per dispatch of a batch
+  std::vector<vk::DescriptorSet> m_descriptorSets;
+  vk::PipelineLayout m_pipelineLayout;
+  vk::Pipeline m_pipeline;
+  vk::CommandPool m_commandPool;
+  vk::CommandBuffer m_commandBuffer;
+  vk::Fence m_fence;
+  vk::DeviceSize m_storageAlignment = 4;
+
+  bool m_batchOpen = false;
+  uint32_t m_batchDispatches = 0;
+
+  // grows to the largest batch decoded so far, m_stagingUsed is the open
+  // batch's part
+  BufferWrapper m_staging{};
+  vk::DeviceSize m_stagingSize = 0;
+  vk::DeviceSize m_stagingUsed = 0;
+};
+} // namespace hiddenpiggy
+#endif
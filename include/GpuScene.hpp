@@ -0,0 +1,106 @@
+#ifndef GPU_SCENE_HPP
+#define GPU_SCENE_HPP
+#include "DeletionQueue.hpp"
+#include "VkBufferPool.hpp"
+#include "VkContext.hpp"
+#include "glTFScene.hpp"
+#include "vulkan/vulkan.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// GPU driven drawing of a glTFModel. The model keeps its instances, their
+// transforms and bounds resident (glTFModel::getInstanceBuffer);
+// Shaders/scene_cull.comp tests every instance against the frustum, picks
+// its LOD by projected error with the hysteresis of glTFModel::selectLods
+// (each instance's last pick stays in glTFModel::getSelectedLodBuffer) and
+// appends a VkDrawIndexedIndirectCommand per survivor. The whole scene then
+// goes out in one indirect draw per index type with the scene pipeline, so
+// the cpu cost of a frame does not depend on the instance count. Instances
+// whose transform an HLOD impostor stands in for are skipped, and so are
+// the clustered ones when a MeshletCuller draws them.
+// Without drawIndirectCount the command list is cleared every frame and
+// drawn at full length, the culled tail as empty draws.
+//
+// Per frame: beginFrame, then cull each scene outside the render pass and
+// draw it inside with the ticket cull returned. Frames are expected to be
+// waited on before the next beginFrame, like Renderer does.
+class GpuScene {
+public:
+  GpuScene(VkContext *context, BufferPool *bufferPool)
+      : m_pContext(context), m_pBufferPool(bufferPool) {}
+
+  void OnCreate();
+  void OnDestroy();
+
+  void beginFrame() { m_usedSlots = 0; }
+  // records the culling of scene's instances; returns the ticket for draw,
+  // -1 if the scene is not fully resident or has no instances.
+  // skipClustered leaves out the instances a MeshletCuller draws.
+  int cull(vk::CommandBuffer cmdBuf, const glTFModel &scene,
+           bool skipClustered, const glm::mat4 &model, const glm::mat4 &view,
+           const glm::mat4 &projection, float viewportHeight,
+           float errorPixels = glTFModel::kLodErrorPixels);
+  // draws what survived, inside the render pass with the scene pipeline,
+  // its sets and its push constants bound; the commands' firstInstance
+  // picks the transform
+  void draw(vk::CommandBuffer cmdBuf, const glTFModel &scene, int ticket);
+
+  bool isEnabled() const { return m_enabled; }
+  void setEnabled(bool enabled) { m_enabled = enabled && m_cullPipeline; }
+
+  // rebuilds the culling pipeline after scene_cull.spv changed; the old one
+  // goes to deletionQueue, or stays if the new shader does not build
+  bool reloadShaders(DeletionQueue &deletionQueue);
+
+private:
+  // matches CullConstants in scene_cull.comp, std140
+  struct CullConstants {
+    glm::mat4 model;
+    glm::mat4 view;
+    // world space planes, normals pointing inside
+    glm::vec4 frustumPlanes[6];
+    // pixels per unit at distance 1 over the allowed error in pixels
+    float lodScale;
+    uint32_t instanceCount;
+    // commands per index type, where the 16 bit draws start
+    uint32_t commandCapacity;
+    uint32_t skipClustered;
+    // glTFModel::kLodHysteresis
+    float lodHysteresis;
+    uint32_t padding[3];
+  };
+
+  // everything one cull of one scene writes, reused frame after frame
+  struct Slot {
+    BufferWrapper constants{};
+    // 32 bit draws, then 16 bit draws, instanceCapacity of each
+    BufferWrapper commands{};
+    BufferWrapper drawCounts{};
+    uint32_t instanceCapacity = 0;
+    // glTFModel::getHiddenTransforms, host visible
+    BufferWrapper hiddenTransforms{};
+    uint32_t transformCapacity = 0;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSet descriptorSet;
+  };
+
+  bool createCullPipeline();
+  Slot &acquireSlot();
+  void prepareSlot(Slot &slot, const glTFModel &scene);
+
+  VkContext *m_pContext;
+  BufferPool *m_pBufferPool;
+
+  vk::DescriptorSetLayout m_descriptorSetLayout;
+  vk::PipelineLayout m_cullLayout;
+  vk::Pipeline m_cullPipeline;
+  bool m_drawIndirectCount = false;
+
+  std::vector<Slot> m_slots;
+  uint32_t m_usedSlots = 0;
+  bool m_enabled = false;
+};
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,135 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace hiddenpiggy {
+
+// streaming xxHash64, used to key cooked asset caches on source contents
+class Hash64 {
+public:
+  explicit Hash64(uint64_t seed = 0) { reset(seed); }
+
+  void reset(uint64_t seed = 0) {
+    m_v[0] = seed + kPrime1 + kPrime2;
+    m_v[1] = seed + kPrime2;
+    m_v[2] = seed;
+    m_v[3] = seed - kPrime1;
+    m_seed = seed;
+    m_totalLength = 0;
+    m_bufferSize = 0;
+  }
+
+  void update(const void *data, size_t size) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    const uint8_t *end = p + size;
+    m_totalLength += size;
+
+    // finish a partially filled stripe first
+    if (m_bufferSize > 0) {
+      size_t fill = std::min<size_t>(32 - m_bufferSize, size);
+      memcpy(m_buffer + m_bufferSize, p, fill);
+      m_bufferSize += fill;
+      p += fill;
+      if (m_bufferSize < 32) {
+        return;
+      }
+      consumeStripe(m_buffer);
+      m_bufferSize = 0;
+    }
+
+    while (p + 32 <= end) {
+      consumeStripe(p);
+      p += 32;
+    }
+
+    m_bufferSize = static_cast<size_t>(end - p);
+    memcpy(m_buffer, p, m_bufferSize);
+  }
+
+  uint64_t digest() const {
+    uint64_t h;
+    if (m_totalLength >= 32) {
+      h = rotl(m_v[0], 1) + rotl(m_v[1], 7) + rotl(m_v[2], 12) +
+          rotl(m_v[3], 18);
+      for (uint64_t v : m_v) {
+        h = (h ^ round(0, v)) * kPrime1 + kPrime4;
+      }
+    } else {
+      h = m_seed + kPrime5;
+    }
+    h += m_totalLength;
+
+    const uint8_t *p = m_buffer;
+    const uint8_t *end = m_buffer + m_bufferSize;
+    while (p + 8 <= end) {
+      h ^= round(0, read64(p));
+      h = rotl(h, 27) * kPrime1 + kPrime4;
+      p += 8;
+    }
+    if (p + 4 <= end) {
+      h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+      h = rotl(h, 23) * kPrime2 + kPrime3;
+      p += 4;
+    }
+    while (p < end) {
+      h ^= (*p) * kPrime5;
+      h = rotl(h, 11) * kPrime1;
+      p++;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+  }
+
+  static uint64_t hash(const void *data, size_t size, uint64_t seed = 0) {
+    Hash64 hasher(seed);
+    hasher.update(data, size);
+    return hasher.digest();
+  }
+
+private:
+  static constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+  static constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+  static constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+  static constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+  static constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+  static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+  static uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  static uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+  }
+
+  void consumeStripe(const uint8_t *p) {
+    m_v[0] = round(m_v[0], read64(p));
+    m_v[1] = round(m_v[1], read64(p + 8));
+    m_v[2] = round(m_v[2], read64(p + 16));
+    m_v[3] = round(m_v[3], read64(p + 24));
+  }
+
+  uint64_t m_v[4];
+  uint64_t m_seed = 0;
+  uint64_t m_totalLength = 0;
+  uint8_t m_buffer[32];
+  size_t m_bufferSize = 0;
+};
+} // namespace hiddenpiggy
+#endif
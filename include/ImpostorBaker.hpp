@@ -0,0 +1,59 @@
+#ifndef IMPOSTOR_BAKER_HPP
+#define IMPOSTOR_BAKER_HPP
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Import time hierarchical LOD. Static nodes (see
+// StaticBatcher::resolveSceneGraph) are grouped by the cell of a uniform
+// grid their bounds are centered in, and every group is rendered offscreen,
+// on the cpu, from kViewCount directions spread over the sphere by an
+// octahedral map. A texel keeps the normal and the depth of the nearest
+// surface seen through it, so an impostor shades like the meshes it stands
+// in for and can write their depth. At distance the group's meshes are
+// hidden and one quad shows the view closest to the camera, see
+// ImpostorRenderer.
+namespace ImpostorBaker {
+
+// grid cells along the longest axis of the static geometry's bounds
+constexpr uint32_t kCellsPerAxis = 4;
+// views per axis of the octahedral map
+constexpr uint32_t kViewGrid = 8;
+constexpr uint32_t kViewCount = kViewGrid * kViewGrid;
+// texels per side of one view
+constexpr uint32_t kFrameSize = 32;
+constexpr uint32_t kGroupTexels = kViewCount * kFrameSize * kFrameSize;
+
+struct Group {
+  float center[3]; // world space bounding sphere of the members
+  float radius;
+};
+
+struct Result {
+  std::vector<Group> groups;
+  // per node, -1 for nodes that never turn into an impostor
+  std::vector<int32_t> nodeGroups;
+  // kGroupTexels per group, view after view, rows bottom up; see packTexel
+  std::vector<uint32_t> texels;
+};
+
+// octahedral normal in the low two bytes, depth behind the view's near
+// plane over the group's diameter in the high 16 bits; 0 where the view
+// sees nothing
+uint32_t packTexel(const glm::vec3 &normal, float depth);
+
+// unit vector from the group toward the eye of view frame
+glm::vec3 frameDirection(uint32_t frame);
+// the view whose direction is closest to direction
+uint32_t nearestFrame(const glm::vec3 &direction);
+// screen axes of the view looking along -direction
+void frameBasis(const glm::vec3 &direction, glm::vec3 &right, glm::vec3 &up);
+
+Result bake(const tinygltf::Model &model);
+
+} // namespace ImpostorBaker
+} // namespace hiddenpiggy
+#endif
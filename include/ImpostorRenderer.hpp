@@ -0,0 +1,86 @@
+#ifndef IMPOSTOR_RENDERER_HPP
+#define IMPOSTOR_RENDERER_HPP
+#include "DeletionQueue.hpp"
+#include "VkBufferPool.hpp"
+#include "VkContext.hpp"
+#include "glTFScene.hpp"
+#include "vulkan/vulkan.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Draws the HLOD impostors glTFModel::selectImpostors switched on, one quad
+// per group facing the camera with the baked view closest to it
+// (Shaders/impostor_vert.vert, impostor_frag.frag). The quads are expanded
+// from a per frame draw list, so there is no vertex buffer; the atlases are
+// read straight from the scene's impostor texel buffer.
+//
+// Per frame: beginFrame, then draw each scene inside the render pass after
+// its meshes. Frames are expected to be waited on before the next
+// beginFrame, like Renderer does.
+class ImpostorRenderer {
+public:
+  ImpostorRenderer(VkContext *context, BufferPool *bufferPool)
+      : m_pContext(context), m_pBufferPool(bufferPool) {}
+
+  // set 0 of the pipeline is the scene's, for its uniforms
+  void OnCreate(vk::DescriptorSetLayout sceneSetLayout,
+                vk::RenderPass renderPass);
+  void OnDestroy();
+
+  void beginFrame() { m_usedSlots = 0; }
+  // draws scene's active impostors that are inside the frustum of
+  // modelViewProj, cameraPosition in the scene's space; returns the draw
+  // calls recorded. Leaves its own pipeline bound.
+  uint32_t draw(vk::CommandBuffer cmdBuf, const glTFModel &scene,
+                vk::DescriptorSet sceneSet, const glm::mat4 &modelViewProj,
+                const glm::vec3 &cameraPosition);
+
+  bool isEnabled() const { return m_enabled; }
+
+  // rebuilds the pipeline after impostor_vert.spv or impostor_frag.spv
+  // changed; the old one goes to deletionQueue, or stays if the new shaders
+  // do not build
+  bool reloadShaders(DeletionQueue &deletionQueue);
+
+private:
+  // matches Impostor in impostor_vert.vert, std430
+  struct ImpostorDraw {
+    glm::vec4 sphere;
+    uint32_t group;
+    uint32_t frame;
+    uint32_t padding[2];
+  };
+
+  // the draw list of one scene, reused frame after frame
+  struct Slot {
+    BufferWrapper draws{};
+    vk::DeviceSize drawCapacity = 0;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSet descriptorSet;
+  };
+
+  bool createPipeline(vk::DescriptorSetLayout sceneSetLayout,
+                      vk::RenderPass renderPass);
+  Slot &acquireSlot();
+
+  VkContext *m_pContext;
+  BufferPool *m_pBufferPool;
+
+  vk::DescriptorSetLayout m_descriptorSetLayout;
+  vk::PipelineLayout m_pipelineLayout;
+  vk::Pipeline m_pipeline;
+  // what the pipeline is rebuilt against
+  vk::DescriptorSetLayout m_sceneSetLayout;
+  vk::RenderPass m_renderPass;
+
+  std::vector<Slot> m_slots;
+  uint32_t m_usedSlots = 0;
+  // the active groups' spheres, for SimdMath::cullSpheres
+  std::vector<float> m_sphereX, m_sphereY, m_sphereZ, m_sphereRadius;
+  std::vector<uint8_t> m_visible;
+  bool m_enabled = true;
+};
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,30 @@
+#ifndef LZ4_HPP
+#define LZ4_HPP
+#include <cstddef>
+#include <cstdint>
+
+namespace hiddenpiggy {
+
+// LZ4 block format codec. Only raw blocks, no frame header or checksums; the
+// container keeps the sizes. Output is readable by the reference lz4
+// decoder and the decoder accepts anything the reference encoder produces.
+namespace Lz4 {
+
+// worst case output size for srcSize bytes of incompressible input
+constexpr size_t compressBound(size_t srcSize) {
+  return srcSize + srcSize / 255 + 16;
+}
+
+// greedy single pass compressor; returns the compressed size, 0 if the
+// result does not fit in dstCapacity
+size_t compress(const uint8_t *src, size_t srcSize, uint8_t *dst,
+                size_t dstCapacity);
+
+// decodes a whole block into exactly dstSize bytes; false on malformed input
+// or a size mismatch, never reads or writes out of bounds
+bool decompress(const uint8_t *src, size_t srcSize, uint8_t *dst,
+                size_t dstSize);
+
+} // namespace Lz4
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,95 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace hiddenpiggy {
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      std::swap(m_data, other.m_data);
+      std::swap(m_size, other.m_size);
+    }
+    return *this;
+  }
+  ~MappedFile() { close(); }
+
+  bool open(const std::string &filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                      MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      return false;
+    }
+    m_data = static_cast<const uint8_t *>(data);
+    m_size = static_cast<size_t>(st.st_size);
+    return true;
+  }
+
+  void close() {
+    if (m_data != nullptr) {
+      munmap(const_cast<uint8_t *>(m_data), m_size);
+      m_data = nullptr;
+      m_size = 0;
+    }
+  }
+
+  // hint that [offset, offset + size) is about to be read front to back
+  void adviseSequential(size_t offset = 0, size_t size = SIZE_MAX) const {
+    advise(offset, size, MADV_SEQUENTIAL);
+    advise(offset, size, MADV_WILLNEED);
+  }
+
+  // drop the resident pages of a range that has been consumed; they are
+  // faulted back in from the file if touched again
+  void release(size_t offset = 0, size_t size = SIZE_MAX) const {
+    advise(offset, size, MADV_DONTNEED);
+  }
+
+  bool isOpen() const { return m_data != nullptr; }
+  const uint8_t *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+private:
+  void advise(size_t offset, size_t size, int advice) const {
+    if (m_data == nullptr || offset >= m_size) {
+      return;
+    }
+    // madvise wants a page aligned start
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t alignedOffset = offset & ~(pageSize - 1);
+    size_t end = size > m_size - offset ? m_size : offset + size;
+    madvise(const_cast<uint8_t *>(m_data) + alignedOffset, end - alignedOffset,
+            advice);
+  }
+
+  const uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+};
+} // namespace hiddenpiggy
+#endif
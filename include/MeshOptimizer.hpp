@@ -0,0 +1,149 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Import time reordering of indexed triangle lists. Vertices are opaque
+// blobs of `stride` bytes, possibly quantized; the overdraw pass takes float3
+// positions on the side instead. Indices are local to the mesh, i.e. in
+// [0, vertexCount).
+//
+// optimizeMesh runs the whole chain:
+//   weld        - bitwise identical vertices are merged
+//   cache       - Forsyth's linear speed vertex cache optimization
+//   overdraw    - cache friendly clusters sorted front to back (Sander et al.)
+//   fetch       - vertices renumbered in first use order, unused ones dropped
+//
+// simplify builds the LOD chains and buildMeshlets the culling clusters on
+// top of the optimized mesh.
+namespace MeshOptimizer {
+
+// fifo size the statistics are measured with, a typical post transform cache
+constexpr uint32_t kCacheSize = 16;
+// how much cache efficiency the overdraw pass may give up, 1.05 is 5%
+constexpr float kOverdrawThreshold = 1.05f;
+
+struct CacheStats {
+  uint64_t transformed = 0; // vertex shader invocations
+  uint64_t triangles = 0;
+  uint64_t vertices = 0;
+
+  // average cache miss ratio, transformed vertices per triangle
+  float acmr() const {
+    return triangles ? float(double(transformed) / double(triangles)) : 0.0f;
+  }
+  // average transformed to vertex ratio, 1.0 is perfect
+  float atvr() const {
+    return vertices ? float(double(transformed) / double(vertices)) : 0.0f;
+  }
+  CacheStats &operator+=(const CacheStats &other) {
+    transformed += other.transformed;
+    triangles += other.triangles;
+    vertices += other.vertices;
+    return *this;
+  }
+};
+
+CacheStats analyzeVertexCache(std::span<const uint32_t> indices,
+                              size_t vertexCount,
+                              uint32_t cacheSize = kCacheSize);
+
+// remap[i] is the welded index of vertex i, numbered in first occurrence
+// order; returns the number of unique vertices
+size_t generateVertexRemap(const void *vertices, size_t vertexCount,
+                           size_t stride, std::vector<uint32_t> &remap);
+// same, comparing only the first size bytes of every vertex
+size_t generateVertexRemap(const void *vertices, size_t vertexCount,
+                           size_t stride, size_t size,
+                           std::vector<uint32_t> &remap);
+
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount);
+
+// expects cache optimized input and keeps most of its locality; positions
+// are tightly packed float3
+void optimizeOverdraw(std::span<uint32_t> indices, const float *positions,
+                      size_t vertexCount, float threshold = kOverdrawThreshold);
+
+// reorders the vertices in place; returns the number still referenced, the
+// rest of the array is left unspecified
+size_t optimizeVertexFetch(void *vertices, size_t vertexCount, size_t stride,
+                           std::span<uint32_t> indices);
+
+// index order for passes that read positions only: vertices whose first
+// positionSize bytes match collapse onto the first of them, triangles that
+// become degenerate are dropped and the rest is cache optimized. The indices
+// still address the full vertex array.
+void generatePositionIndices(std::span<const uint32_t> indices,
+                             const void *vertices, size_t vertexCount,
+                             size_t stride, size_t positionSize,
+                             std::vector<uint32_t> &positionIndices);
+
+// quadric error simplification (Garland and Heckbert) down to about
+// targetIndexCount indices, stopping early once a collapse would cost more
+// than targetError. Edges collapse onto one of their vertices, so the result
+// indexes the same vertex array and LODs can share it. Vertices on an
+// attribute seam stay, open borders only move along themselves. positions
+// holds a float3 every positionStride bytes; resultError receives the worst
+// collapse as a distance in the same units.
+std::vector<uint32_t> simplify(std::span<const uint32_t> indices,
+                               const float *positions, size_t positionStride,
+                               size_t vertexCount, size_t targetIndexCount,
+                               float targetError, float *resultError = nullptr);
+
+// clusters of at most maxVertices vertices and maxTriangles triangles,
+// filled greedily in index order so cache optimized input gives compact
+// ones. meshletVertices lists each meshlet's vertices, meshletTriangles its
+// triangles as three local byte indices; every meshlet's triangles start on
+// a 4 byte boundary.
+struct Meshlet {
+  uint32_t vertexOffset;   // into meshletVertices
+  uint32_t triangleOffset; // into meshletTriangles, in bytes
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+};
+
+// 64 and 124 fit the usual mesh shader output limits, 124 triangles keep
+// the local index bytes of a meshlet within 372 bytes
+constexpr uint32_t kMeshletMaxVertices = 64;
+constexpr uint32_t kMeshletMaxTriangles = 124;
+
+void buildMeshlets(std::span<const uint32_t> indices, size_t vertexCount,
+                   std::vector<Meshlet> &meshlets,
+                   std::vector<uint32_t> &meshletVertices,
+                   std::vector<uint8_t> &meshletTriangles,
+                   uint32_t maxVertices = kMeshletMaxVertices,
+                   uint32_t maxTriangles = kMeshletMaxTriangles);
+
+// Bounding sphere and backface cone of a meshlet. The meshlet faces away
+// from a camera at p when
+//   dot(normalize(coneApex - p), coneAxis) >= coneCutoff
+// a cutoff of 1 means the normals spread too far to ever cull.
+struct MeshletBounds {
+  float center[3];
+  float radius;
+  float coneApex[3];
+  float coneAxis[3];
+  float coneCutoff;
+};
+
+MeshletBounds computeMeshletBounds(const Meshlet &meshlet,
+                                   std::span<const uint32_t> meshletVertices,
+                                   std::span<const uint8_t> meshletTriangles,
+                                   const float *positions,
+                                   size_t positionStride);
+
+// all of the above; positions holds the float3 of every input vertex, one
+// every positionStride bytes. Returns the new vertex count, stats receive
+// the numbers before and after.
+size_t optimizeMesh(void *vertices, size_t vertexCount, size_t stride,
+                    const float *positions, size_t positionStride,
+                    std::span<uint32_t> indices, CacheStats *before = nullptr,
+                    CacheStats *after = nullptr);
+
+} // namespace MeshOptimizer
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,148 @@
+#ifndef MESHLET_CULLER_HPP
+#define MESHLET_CULLER_HPP
+#include "DeletionQueue.hpp"
+#include "VertexLayout.hpp"
+#include "VkBufferPool.hpp"
+#include "VkContext.hpp"
+#include "glTFScene.hpp"
+#include "vulkan/vulkan.hpp"
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Culls the meshlets of a glTFModel against the view frustum and their
+// normal cones on the gpu. On devices with VK_EXT_mesh_shader a task shader
+// does the culling and a mesh shader emits the surviving meshlets
+// (Shaders/meshlet_task.task, meshlet_mesh.mesh). Elsewhere
+// Shaders/meshlet_cull.comp writes the indices of the surviving triangles
+// into a compacted index buffer, which is drawn indirectly with the scene
+// pipeline the caller has bound, one draw per placement. Every visible
+// transform of the scene is a placement; the work items pair a meshlet with
+// the placement it is culled and drawn at.
+//
+// Per frame: beginFrame, then cull each scene outside the render pass and
+// draw it inside with the ticket cull returned. Frames are expected to be
+// waited on before the next beginFrame, like Renderer does.
+class MeshletCuller {
+public:
+  MeshletCuller(VkContext *context, BufferPool *bufferPool)
+      : m_pContext(context), m_pBufferPool(bufferPool) {}
+
+  // the mesh shader path reuses the scene's fragment shader, so its layout
+  // starts with sceneSetLayout and the scene's push constant ranges
+  void OnCreate(vk::DescriptorSetLayout sceneSetLayout,
+                std::span<const vk::PushConstantRange> scenePushConstants,
+                vk::RenderPass renderPass);
+  void OnDestroy();
+
+  void beginFrame() { m_usedSlots = 0; }
+  // records the culling of the meshlets of scene's placed meshes at every
+  // transform no impostor stands in for; returns the ticket for draw, -1 if
+  // the scene has nothing to cull yet. With a ticket the clustered
+  // primitives are this path's alone: GpuScene::cull and glTFModel::draw are
+  // told to skip them.
+  int cull(vk::CommandBuffer cmdBuf, const glTFModel &scene,
+           const glm::mat4 &model, const glm::mat4 &viewProj,
+           const glm::vec3 &cameraPosition);
+  // draws the meshlets that survived, inside the render pass with the scene
+  // pipeline, its sets and its push constants bound. The mesh shader
+  // pipeline's layout is compatible with the scene's, so those stay bound.
+  void draw(vk::CommandBuffer cmdBuf, const glTFModel &scene, int ticket);
+
+  bool isUsingMeshShaders() const { return static_cast<bool>(m_meshPipeline); }
+  bool isEnabled() const { return m_enabled; }
+  void setEnabled(bool enabled) { m_enabled = enabled; }
+  // meshlets handed to the gpu this frame, before culling
+  uint32_t getSubmittedMeshletCount() const { return m_submittedMeshlets; }
+  void setConeCulling(bool coneCulling) { m_coneCulling = coneCulling; }
+
+  // rebuilds whichever pipeline culls, after its shaders or the scene's
+  // fragment shader changed; the old one goes to deletionQueue, or stays if
+  // the new shaders do not build
+  bool reloadShaders(DeletionQueue &deletionQueue);
+
+private:
+  // matches CullConstants in the culling shaders, std140
+  struct CullConstants {
+    uint32_t itemCount;
+    uint32_t attributeOffset; // in words
+    uint32_t coneCulling;
+    uint32_t placementCount;
+  };
+
+  // one transform of the scene, matches Placement in the culling shaders,
+  // std430
+  struct Placement {
+    glm::mat4 modelViewProj;
+    // model space planes, normals pointing inside
+    glm::vec4 frustumPlanes[6];
+    glm::vec4 cameraPosition;
+    // the dequantization of the mesh at that transform
+    VertexQuantization quantization;
+  };
+
+  // a meshlet of the scene culled at a placement, uvec2 in the shaders
+  struct WorkItem {
+    uint32_t meshlet;
+    uint32_t placement;
+  };
+
+  // a buffer that only grows
+  struct GrowingBuffer {
+    BufferWrapper buffer{};
+    vk::DeviceSize capacity = 0;
+  };
+
+  // everything one cull of one scene writes, reused frame after frame
+  struct Slot {
+    BufferWrapper constants{};
+    GrowingBuffer placements;
+    GrowingBuffer workItems;
+    GrowingBuffer indices;
+    // one indexed indirect draw per placement
+    GrowingBuffer drawArgs;
+    uint32_t itemCount = 0;
+    uint32_t placementCount = 0;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSet descriptorSet;
+  };
+
+  bool createComputePipeline();
+  bool createMeshPipeline(
+      vk::DescriptorSetLayout sceneSetLayout,
+      std::span<const vk::PushConstantRange> scenePushConstants,
+      vk::RenderPass renderPass);
+  Slot &acquireSlot();
+  // host visible buffers are mapped
+  void reserve(GrowingBuffer &buffer, vk::DeviceSize size,
+               vk::BufferUsageFlags usage, bool hostVisible);
+  void writeDescriptors(Slot &slot, const glTFModel &scene);
+
+  VkContext *m_pContext;
+  BufferPool *m_pBufferPool;
+
+  vk::DescriptorSetLayout m_descriptorSetLayout;
+  vk::PipelineLayout m_computeLayout;
+  vk::Pipeline m_computePipeline;
+  vk::PipelineLayout m_meshLayout;
+  vk::Pipeline m_meshPipeline;
+  PFN_vkCmdDrawMeshTasksEXT m_vkCmdDrawMeshTasksEXT = nullptr;
+  // what the mesh shader pipeline is rebuilt against
+  vk::DescriptorSetLayout m_sceneSetLayout;
+  std::vector<vk::PushConstantRange> m_scenePushConstants;
+  vk::RenderPass m_renderPass;
+
+  std::vector<Slot> m_slots;
+  // what cull gathers for the gpu, kept to reuse their storage
+  std::vector<Placement> m_placements;
+  std::vector<WorkItem> m_workItems;
+  std::vector<vk::DrawIndexedIndirectCommand> m_draws;
+  uint32_t m_usedSlots = 0;
+  uint32_t m_submittedMeshlets = 0;
+  bool m_enabled = true;
+  bool m_coneCulling = true;
+};
+} // namespace hiddenpiggy
+#endif
@@ -4,6 +4,7 @@
 #include "glm/glm.hpp"
 #include "vk_mem_alloc.h"
 #include "vulkan/vulkan.hpp"
+#include "VertexLayout.hpp"
 #include "VkBufferPool.hpp"
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_handles.hpp"
@@ -16,38 +17,23 @@ public:
   glm::vec3 normal;
   glm::vec2 texCoord;
 
+  // plain floats, matching the members above
+  using Layout = VertexLayout<
+      VertexAttribute<VertexSemantic::Position, 0, VertexFormat::Float3>,
+      VertexAttribute<VertexSemantic::Normal, 1, VertexFormat::Float3>,
+      VertexAttribute<VertexSemantic::Uv0, 2, VertexFormat::Float2>>;
+
   static vk::VertexInputBindingDescription getBindingDescription() {
-    vk::VertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(Vertex);
-    bindingDescription.inputRate = vk::VertexInputRate::eVertex;
-    return bindingDescription;
+    return Layout::getBindingDescription();
   }
 
   static std::array<vk::VertexInputAttributeDescription, 3>
   getAttributeDescriptions() {
-    std::array<vk::VertexInputAttributeDescription, 3> attributeDescriptions{};
-
-    // Position attribute
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;
-    attributeDescriptions[0].offset = offsetof(Vertex, position);
-
-    // Normal attribute
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
-    attributeDescriptions[1].offset = offsetof(Vertex, normal);
-
-    // Texture coordinate attribute
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = vk::Format::eR32G32Sfloat;
-    attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-    return attributeDescriptions;
+    return Layout::getAttributeDescriptions();
   }
 };
+static_assert(sizeof(Vertex) == Vertex::Layout::kStride,
+              "Vertex members and layout disagree");
 
 class Mesh {
 public:
@@ -1,5 +1,7 @@
 #ifndef RENDERER_HPP
 #define RENDERER_HPP
+#include "AssetWatcher.hpp"
+#include "DeletionQueue.hpp"
 #include "Timer.hpp"
 #include "Camera.hpp"
 #include "UniformBuffers.hpp"
@@ -11,8 +13,14 @@
 #include "VkCommandBuffers.hpp"
 #include "VkBufferPool.hpp"
 #include "ResourceUploadHeap.hpp"
+#include "GpuDecompressor.hpp"
+#include "GpuScene.hpp"
+#include "ImpostorRenderer.hpp"
+#include "MeshletCuller.hpp"
 #include "Model.hpp"
 #include "VkTexture.hpp"
+#include "VkTextureStreamer.hpp"
+#include "SceneLoader.hpp"
 #include "glTFScene.hpp"
 #include "vulkan/vulkan_handles.hpp"
 #include "vulkan/vulkan_structs.hpp"
@@ -35,6 +43,14 @@ public:
   }
 
 private:
+  // hot reload of files edited while the app runs
+  void reloadAsset(const std::string &path);
+  void reloadPipeline();
+  // rebuilds the pipelines built from Shaders/<name>.spv
+  void reloadShader(const std::string &name);
+  // count sets of the instance layout, valid for this frame only
+  std::vector<vk::DescriptorSet> acquireInstanceSets(uint32_t count);
+
   std::string m_AppName;
   GLFWwindow *m_pWindow;
   int m_width, m_height;
@@ -42,12 +58,18 @@ private:
   // Memory Management
   BufferPool *m_pBufferPool;
   ResourceUploadHeap *m_pResourceUploadHeap;
+  GpuDecompressor *m_pDecompressor = nullptr;
 
   // swapchain related handles
   VkSwapchain m_swapchain;
   SwapchainRenderPass *m_pSwapchainRenderPass = nullptr;
   VkSwapchainFramebuffers *m_pFramebuffers = nullptr;
   VkSwapchainGraphicsPipeline *m_swapchainPipeline = nullptr;
+  // gpu driven drawing of the resident scenes; meshlet culling takes the
+  // scenes it cannot draw, the cpu draw loop whatever is left
+  GpuScene *m_pGpuScene = nullptr;
+  MeshletCuller *m_pMeshletCuller = nullptr;
+  ImpostorRenderer *m_pImpostorRenderer = nullptr;
 
    // swapchain resource binding
    struct ResourceBinding {
@@ -59,6 +81,11 @@ private:
 
 
   ResourceBinding m_swapchainResourceBinding;
+  // set 1 of the scene pipeline, the transform table of the scene being
+  // drawn; one set per scene, allocated again every frame
+  vk::DescriptorSetLayout m_instanceSetLayout;
+  vk::DescriptorPool m_instanceDescriptorPool;
+  uint32_t m_instanceSetCapacity = 0;
 
   //command buffers
   VkCommandBuffers *m_pCommandBuffers;
@@ -67,11 +94,17 @@ private:
   //Uniform Buffers
   UniformBuffers *m_pUniformBuffers;
 
-  //Model
-  std::vector<glTFModel> m_models;
+  //Model, streamed in by the scene loader while frames keep rendering
+  SceneLoader *m_pSceneLoader = nullptr;
+  uint32_t m_scene = 0;
 
   //Texture
-  std::vector<VulkanTexture *> m_textures;
+  TextureStreamer *m_pTextureStreamer = nullptr;
+  uint32_t m_sceneTexture = 0;
+
+  //Hot reload, replaced resources wait here until no frame uses them
+  AssetWatcher m_assetWatcher;
+  DeletionQueue m_deletionQueue;
 
   //Cameras
   std::vector<Camera> m_cameras;
@@ -85,7 +85,8 @@ public:
     m_bufferPool->freeBuffer(stagingBuffer);
   }
 
-  void transitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
+  void transitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+                             uint32_t baseMipLevel = 0, uint32_t levelCount = 1) {
     m_commandBuffer.reset();
     vk::CommandBufferBeginInfo beginInfo(
         vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
@@ -101,8 +102,8 @@ public:
       image,     //image
       {
         vk::ImageAspectFlagBits::eColor,
-        0,   //base miplevel
-        1,   //level count
+        baseMipLevel,   //base miplevel
+        levelCount,   //level count
         0,     //base array layer
         1 //layer count
       }, //subresourceRange
@@ -160,7 +161,7 @@ public:
 
   void uploadImageData(const void *data, uint32_t size, uint32_t width, uint32_t height,
                         vk::Image &destinationImage,
-                        VmaAllocation destinationAllocation) {
+                        VmaAllocation destinationAllocation, uint32_t mipLevel = 0) {
     // Create a staging buffer and allocate memory for it
     vk::BufferCreateInfo stagingBufferCreateInfo(
         {}, size, vk::BufferUsageFlagBits::eTransferSrc);
@@ -189,7 +190,7 @@ public:
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.mipLevel = mipLevel;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
     region.imageOffset = vk::Offset3D(0, 0, 0);
@@ -0,0 +1,115 @@
+#ifndef SCENE_LOADER_HPP
+#define SCENE_LOADER_HPP
+#include "DeletionQueue.hpp"
+#include "GpuDecompressor.hpp"
+#include "ResourceUploadHeap.hpp"
+#include "ThreadPool.hpp"
+#include "VkBufferPool.hpp"
+#include "VkTextureStreamer.hpp"
+#include "glTFScene.hpp"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Loads scenes without blocking the frame. Parsing or opening the cooked file
+// runs on a worker thread; the gpu upload happens on the render thread in
+// OnUpdate, limited to a byte budget per frame, and primitives become
+// drawable as soon as their geometry is resident. The images a scene's
+// textures read are registered with the TextureStreamer once it is parsed.
+class SceneLoader {
+public:
+  enum class State { Loading, Uploading, Ready, Cancelled, Failed };
+
+  SceneLoader(BufferPool *bufferPool, ResourceUploadHeap *resourceUploadHeap,
+              GpuDecompressor *decompressor, TextureStreamer *textureStreamer,
+              uint32_t queueFamilyIndex)
+      : m_pBufferPool(bufferPool), m_pResourceUploadHeap(resourceUploadHeap),
+        m_pDecompressor(decompressor), m_pTextureStreamer(textureStreamer),
+        m_queueFamilyIndex(queueFamilyIndex) {}
+
+  void OnCreate(vk::DeviceSize uploadBudgetPerFrame,
+                DeletionQueue *pDeletionQueue);
+  // call once per frame from the render thread, outside of command recording
+  void OnUpdate();
+  void OnDestroy();
+
+  // run imports through the MeshOptimizer, on by default; scenes cooked
+  // the other way are imported again
+  void setMeshOptimization(bool enabled) { m_optimizeMeshes = enabled; }
+  // merge static nodes into spatial batches at import, off by default;
+  // picking maps hits back through glTFModel::findBatchedNode
+  void setStaticBatching(bool enabled) { m_staticBatching = enabled; }
+  // bake HLOD impostors of static groups at import, off by default
+  void setImpostors(bool enabled) { m_impostors = enabled; }
+
+  // returns immediately with a handle for the other queries
+  uint32_t loadAsync(const std::string &path);
+  // stops the load; geometry already on the gpu is released in the next
+  // OnUpdate, a parse in flight is dropped when it returns
+  void cancel(uint32_t handle);
+
+  // re-imports every ready scene that reads changedPath, on the worker. The
+  // old geometry stays on screen until the new one is resident; if the
+  // layout is unchanged only the modified primitives are uploaded. Returns
+  // true if any scene depends on the file.
+  bool reloadChanged(const std::string &changedPath);
+
+  uint32_t getSceneCount() const {
+    return static_cast<uint32_t>(m_scenes.size());
+  }
+  State getState(uint32_t handle) const { return m_scenes[handle]->state; }
+  const std::string &getPath(uint32_t handle) const {
+    return m_scenes[handle]->path;
+  }
+  const std::string &getError(uint32_t handle) const {
+    return m_scenes[handle]->error;
+  }
+  // uploaded fraction of the geometry, 0 while still parsing
+  float getProgress(uint32_t handle) const;
+  bool isBusy() const;
+
+  // null until at least part of the scene can be drawn
+  glTFModel *getModel(uint32_t handle);
+
+private:
+  struct Scene {
+    std::string path;
+    State state = State::Loading;
+    std::string error;
+    std::shared_ptr<std::atomic<bool>> cancelled;
+    std::future<std::unique_ptr<glTFModel>> pending;
+    std::unique_ptr<glTFModel> model;
+    // hot reload in flight, swapped in once fully resident
+    std::future<std::unique_ptr<glTFModel>> pendingReload;
+    std::unique_ptr<glTFModel> replacement;
+  };
+
+  std::future<std::unique_ptr<glTFModel>>
+  parseAsync(const std::string &path,
+             std::shared_ptr<std::atomic<bool>> cancelled);
+  void updateReload(Scene &scene, vk::DeviceSize &budget);
+  void registerTextures(glTFModel &model);
+  void retireModel(std::unique_ptr<glTFModel> model);
+  void releaseScene(Scene &scene);
+
+  BufferPool *m_pBufferPool;
+  ResourceUploadHeap *m_pResourceUploadHeap;
+  // expands cooked geometry on the gpu
+  GpuDecompressor *m_pDecompressor;
+  TextureStreamer *m_pTextureStreamer;
+  uint32_t m_queueFamilyIndex;
+  bool m_optimizeMeshes = true;
+  bool m_staticBatching = false;
+  bool m_impostors = false;
+  vk::DeviceSize m_uploadBudget = 0;
+  DeletionQueue *m_pDeletionQueue = nullptr;
+  // one worker; scenes parse in request order and leave the render thread free
+  std::unique_ptr<ThreadPool> m_pWorker;
+  std::vector<std::unique_ptr<Scene>> m_scenes;
+};
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,95 @@
+#ifndef SIMD_MATH_HPP
+#define SIMD_MATH_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace hiddenpiggy {
+
+// Batched transform, bounds, culling and key decoding math. Builds targeting
+// AVX2 and FMA (RENDERER_AVX2 in CMakeLists.txt) run 8 lanes wide, other x86
+// builds use SSE2 and everything else the scalar kernels in
+// SimdMath::Scalar, which are also what the vector ones are checked against
+// (tools/MathBenchmark.cpp). The wide kernels compute the same expressions,
+// so results only differ by rounding, and by fused multiply-adds on AVX2.
+//
+// Matrices are glm's, column major; the culling and decoding kernels take
+// structure of arrays so every lane loads contiguous values.
+namespace SimdMath {
+
+// "avx2", "sse2" or "scalar"
+const char *getInstructionSet();
+// items the culling and composition kernels process per step
+uint32_t getLaneCount();
+
+struct SpheresSoA {
+  const float *x;
+  const float *y;
+  const float *z;
+  const float *radius;
+};
+
+struct BoxesSoA {
+  const float *minX;
+  const float *minY;
+  const float *minZ;
+  const float *maxX;
+  const float *maxY;
+  const float *maxZ;
+};
+
+// out[i] = T * R * S, as glm::translate * glm::mat4_cast * glm::scale
+void composeTrs(const glm::vec3 *translations, const glm::quat *rotations,
+                const glm::vec3 *scales, glm::mat4 *out, size_t count);
+// out[i] = a[i] * b[i]; out may alias either
+void multiply(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out,
+              size_t count);
+// bounds of box i under matrices[i], as vkglTF::BoundingBox::getAABB
+void transformAabbs(const glm::mat4 *matrices, const glm::vec3 *mins,
+                    const glm::vec3 *maxs, glm::vec3 *outMins,
+                    glm::vec3 *outMaxs, size_t count);
+
+// Gribb-Hartmann planes of a clip matrix, normalized so the sphere test
+// can compare distances against radii
+void extractFrustumPlanes(const glm::mat4 &clip, glm::vec4 planes[6]);
+// visible[i] is 1 where item i is not entirely outside one of the planes
+void cullSpheres(const glm::vec4 planes[6], const SpheresSoA &spheres,
+                 uint8_t *visible, size_t count);
+void cullBoxes(const glm::vec4 planes[6], const BoxesSoA &boxes,
+               uint8_t *visible, size_t count);
+
+// Smallest-three rotations in 48 bits, three words per rotation: the
+// components other than the largest one, in x, y, z, w order, each in the
+// top 15 bits of a word as a step of [-1/sqrt(2), 1/sqrt(2)]. The low bits of
+// the first two words hold the index of the largest component, which is
+// made positive before encoding as q and -q are the same rotation.
+void encodeSmallestThree(const glm::quat &rotation, uint16_t words[3]);
+void decodeSmallestThree(const uint16_t *a, const uint16_t *b,
+                         const uint16_t *c, glm::quat *out, size_t count);
+// out[i] = origins[i] + extents[i] * quantized[i] / 65535
+void dequantize(const uint16_t *quantized, const float *origins,
+                const float *extents, float *out, size_t count);
+
+// the reference kernels, one item at a time
+namespace Scalar {
+void composeTrs(const glm::vec3 *translations, const glm::quat *rotations,
+                const glm::vec3 *scales, glm::mat4 *out, size_t count);
+void multiply(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out,
+              size_t count);
+void transformAabbs(const glm::mat4 *matrices, const glm::vec3 *mins,
+                    const glm::vec3 *maxs, glm::vec3 *outMins,
+                    glm::vec3 *outMaxs, size_t count);
+void cullSpheres(const glm::vec4 planes[6], const SpheresSoA &spheres,
+                 uint8_t *visible, size_t count);
+void cullBoxes(const glm::vec4 planes[6], const BoxesSoA &boxes,
+               uint8_t *visible, size_t count);
+void decodeSmallestThree(const uint16_t *a, const uint16_t *b,
+                         const uint16_t *c, glm::quat *out, size_t count);
+void dequantize(const uint16_t *quantized, const float *origins,
+                const float *extents, float *out, size_t count);
+} // namespace Scalar
+
+} // namespace SimdMath
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,63 @@
+#ifndef STATIC_BATCHER_HPP
+#define STATIC_BATCHER_HPP
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Import time static batching. The geometry of nodes whose placement can
+// never change is transformed to world space and merged into one primitive
+// per material, vertex layout and cell of a uniform grid over the static
+// geometry, so a level built from thousands of props goes out in a few
+// draws while frustum culling still has cells to reject.
+//
+// A node is static when no animation targets it or any of its ancestors, it
+// is not skinned, it has no EXT_mesh_gpu_instancing copies, its mesh is
+// placed by no other node and every primitive of that mesh is a plain
+// triangle list without morph targets. Shared meshes stay instanced.
+//
+// batch rewrites the tinygltf model in place, ahead of the regular import:
+// the merged geometry goes to one new buffer, each batch becomes a mesh of
+// one primitive placed by a new identity root node, and the static nodes
+// keep their place in the hierarchy without a mesh. Meshes nobody places
+// any more are dropped. Node indices of the source stay valid.
+namespace StaticBatcher {
+
+// grid cells along the longest axis of the static geometry's bounds
+constexpr uint32_t kCellsPerAxis = 8;
+// a batch is closed once it holds this many vertices, so the optimizer can
+// still pack it with 16 bit indices
+constexpr uint32_t kMaxBatchVertices = 1u << 16;
+
+// the part of one batch that came from one source node, what picking maps a
+// hit on the batch back with
+struct Member {
+  uint32_t node; // source node, now without a mesh
+  uint32_t mesh; // batch mesh in the rewritten model
+  float boundsMin[3]; // world space
+  float boundsMax[3];
+};
+
+struct Stats {
+  // placed primitives before and after, one draw each without instancing
+  uint32_t drawsBefore = 0;
+  uint32_t drawsAfter = 0;
+  uint32_t staticNodes = 0;
+};
+
+std::vector<Member> batch(tinygltf::Model &model, Stats *stats = nullptr);
+
+// world transform of every node and whether an animation moves it or any
+// of its ancestors; shared with the other import steps that look for
+// static geometry
+struct SceneGraph {
+  std::vector<glm::mat4> world;
+  std::vector<bool> moving;
+};
+SceneGraph resolveSceneGraph(const tinygltf::Model &model);
+
+} // namespace StaticBatcher
+} // namespace hiddenpiggy
+#endif
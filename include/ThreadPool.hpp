@@ -0,0 +1,122 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// fixed set of worker threads consuming a shared fifo of jobs
+class ThreadPool {
+public:
+  explicit ThreadPool(
+      uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+    for (uint32_t i = 0; i < threadCount; ++i) {
+      m_workers.emplace_back([this] { workerLoop(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (auto &worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  uint32_t getThreadCount() const {
+    return static_cast<uint32_t>(m_workers.size());
+  }
+
+  // exceptions thrown by the job are rethrown from the future's get()
+  template <typename F> auto submit(F &&job) -> std::future<decltype(job())> {
+    using Result = decltype(job());
+    auto task =
+        std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+    std::future<Result> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.emplace([task] { (*task)(); });
+    }
+    m_condition.notify_one();
+    return future;
+  }
+
+  // runs fn(i) for every i in [0, count) and waits for all of them. The
+  // waiting thread runs queued jobs meanwhile, so a worker may call this
+  // without every worker ending up blocked on jobs nobody picks up.
+  template <typename F> void parallelFor(size_t count, F &&fn) {
+    std::vector<std::future<void>> futures;
+    futures.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      futures.push_back(submit([&fn, i] { fn(i); }));
+    }
+    // every job borrows fn, so all of them finish before an error propagates
+    for (auto &future : futures) {
+      while (future.wait_for(std::chrono::seconds(0)) !=
+             std::future_status::ready) {
+        // whatever is left of this loop runs on other threads
+        if (!runPendingJob()) {
+          future.wait();
+        }
+      }
+    }
+    for (auto &future : futures) {
+      future.get();
+    }
+  }
+
+private:
+  // runs the oldest queued job on the calling thread, false if there is none
+  bool runPendingJob() {
+    std::function<void()> job;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_jobs.empty()) {
+        return false;
+      }
+      job = std::move(m_jobs.front());
+      m_jobs.pop();
+    }
+    job();
+    return true;
+  }
+
+  void workerLoop() {
+    for (;;) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+        if (m_stopping && m_jobs.empty()) {
+          return;
+        }
+        job = std::move(m_jobs.front());
+        m_jobs.pop();
+      }
+      job();
+    }
+  }
+
+  std::vector<std::thread> m_workers;
+  std::queue<std::function<void()>> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stopping = false;
+};
+} // namespace hiddenpiggy
+#endif
@@ -0,0 +1,85 @@
+#ifndef TRANSFORM_HIERARCHY_HPP
+#define TRANSFORM_HIERARCHY_HPP
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// Node transforms of a scene graph, flattened. The local TRS values live in
+// one array per component, ordered depth first so every parent comes before
+// its children and a subtree is one contiguous range. update computes world
+// matrices in a single linear pass, and only for nodes whose local transform
+// was set since the last update or whose parent moved.
+//
+// Nodes are addressed by their index in the source (the glTF node index);
+// the table from node to slot makes every lookup O(1).
+class TransformHierarchy {
+public:
+  // parents[i] is the parent of node i, -1 for roots; throws unless the
+  // parents form a forest. Every node starts at identity and dirty.
+  void build(const std::vector<int32_t> &parents);
+  void clear();
+
+  uint32_t getNodeCount() const {
+    return static_cast<uint32_t>(m_slots.size());
+  }
+  uint32_t getSlot(uint32_t node) const { return m_slots[node]; }
+  // slots [getSlot(node), getSubtreeEnd(node)) are node and its descendants
+  uint32_t getSubtreeEnd(uint32_t node) const {
+    return m_subtreeEnds[m_slots[node]];
+  }
+
+  void setTranslation(uint32_t node, const glm::vec3 &translation);
+  void setRotation(uint32_t node, const glm::quat &rotation);
+  void setScale(uint32_t node, const glm::vec3 &scale);
+  // applied after the TRS, for glTF nodes given as a matrix
+  void setMatrix(uint32_t node, const glm::mat4 &matrix);
+  const glm::vec3 &getTranslation(uint32_t node) const {
+    return m_translations[m_slots[node]];
+  }
+  const glm::quat &getRotation(uint32_t node) const {
+    return m_rotations[m_slots[node]];
+  }
+  const glm::vec3 &getScale(uint32_t node) const {
+    return m_scales[m_slots[node]];
+  }
+
+  // brings the world matrices of dirty nodes and their subtrees up to date;
+  // returns how many were recomputed
+  uint32_t update();
+  void markAllDirty();
+
+  // as of the last update
+  const glm::mat4 &getWorldMatrix(uint32_t node) const {
+    return m_world[m_slots[node]];
+  }
+  // whether the last update recomputed node's world matrix
+  bool isChanged(uint32_t node) const { return m_changed[m_slots[node]] != 0; }
+
+private:
+  void markDirty(uint32_t slot) {
+    m_dirty[slot] = 1;
+    m_anyDirty = true;
+  }
+
+  // by slot
+  std::vector<glm::vec3> m_translations;
+  std::vector<glm::quat> m_rotations;
+  std::vector<glm::vec3> m_scales;
+  std::vector<glm::mat4> m_matrices;
+  std::vector<uint8_t> m_hasMatrix;
+  std::vector<int32_t> m_parents; // slot of the parent, -1 for roots
+  std::vector<uint32_t> m_subtreeEnds;
+  std::vector<glm::mat4> m_locals; // scratch for update
+  std::vector<glm::mat4> m_world;
+  std::vector<uint8_t> m_dirty;   // local transform set since the last update
+  std::vector<uint8_t> m_changed; // world recomputed by the last update
+
+  std::vector<uint32_t> m_slots; // node to slot
+  uint32_t m_changedCount = 0;
+  bool m_anyDirty = false;
+};
+} // namespace hiddenpiggy
+#endif
@@ -5,6 +5,7 @@
 #include <imgui_impl_glfw.h>
 #include "VkContext.hpp"
 #include "VkCommandBuffers.hpp"
+#include "SceneLoader.hpp"
 #include "imgui.h"
 #include "vulkan/vulkan_core.h"
 #include <algorithm>
@@ -88,9 +89,45 @@ public:
     }
 
     ImGui::Text("FPS: %f", m_uivars.fps);
+    ShowDrawStats();
+    ShowLoadingProgress();
     ImGui::End();
   }
 
+  // cpu cost of the scene draws, with the batching switch to compare
+  void ShowDrawStats() {
+    ImGui::Checkbox("Multi draw", &m_uivars.multiDraw);
+    ImGui::Text("Scene draw calls: %u", m_uivars.drawCalls);
+    ImGui::Text("Recording: %.3f ms", m_uivars.recordMilliseconds);
+  }
+
+  // one progress bar per scene that is still streaming in
+  void ShowLoadingProgress() {
+    if (m_pSceneLoader == nullptr) {
+      return;
+    }
+    for (uint32_t i = 0; i < m_pSceneLoader->getSceneCount(); ++i) {
+      SceneLoader::State state = m_pSceneLoader->getState(i);
+      if (state == SceneLoader::State::Failed) {
+        ImGui::Text("Failed: %s", m_pSceneLoader->getError(i).c_str());
+        continue;
+      }
+      if (state != SceneLoader::State::Loading &&
+          state != SceneLoader::State::Uploading) {
+        continue;
+      }
+      ImGui::PushID(static_cast<int>(i));
+      ImGui::TextUnformatted(m_pSceneLoader->getPath(i).c_str());
+      ImGui::ProgressBar(m_pSceneLoader->getProgress(i), ImVec2(-1.0f, 0.0f),
+                         state == SceneLoader::State::Loading ? "parsing"
+                                                              : nullptr);
+      if (ImGui::Button("Cancel")) {
+        m_pSceneLoader->cancel(i);
+      }
+      ImGui::PopID();
+    }
+  }
+
   void OnDraw(VkCommandBuffer cmdBuf) {
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuf);
   }
@@ -104,12 +141,27 @@ public:
     this->m_uivars.fps = fps;
   }
 
+  void setDrawStats(uint32_t drawCalls, float recordMilliseconds) {
+    m_uivars.drawCalls = drawCalls;
+    m_uivars.recordMilliseconds = recordMilliseconds;
+  }
+
+  bool isMultiDrawEnabled() const { return m_uivars.multiDraw; }
+
+  void setSceneLoader(SceneLoader *sceneLoader) {
+    m_pSceneLoader = sceneLoader;
+  }
+
 private:
     VkDevice m_device;
     VkDescriptorPool m_imguiPool;
+    SceneLoader *m_pSceneLoader = nullptr;
 
     struct UIVariables {
       float fps = 0.0f;
+      bool multiDraw = true;
+      uint32_t drawCalls = 0;
+      float recordMilliseconds = 0.0f;
     } m_uivars;
 
 };
@@ -0,0 +1,206 @@
+#ifndef VERTEX_LAYOUT_HPP
+#define VERTEX_LAYOUT_HPP
+#include "vulkan/vulkan.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace hiddenpiggy {
+
+// Interleaved vertex layouts declared once, as a list of attributes:
+//
+//   using Layout = VertexLayout<
+//       VertexAttribute<VertexSemantic::Position, 0, VertexFormat::Float3>,
+//       VertexAttribute<VertexSemantic::Normal, 1, VertexFormat::Float3>>;
+//
+// Offsets, stride, the vulkan input descriptions and the loader side encoder
+// all follow from the declaration, so the shader inputs are the only other
+// place that has to agree with it.
+
+enum class VertexSemantic { Position, Normal, Uv0, Uv1 };
+
+// position = offset + value * scale for QuantizedPosition, one per mesh and
+// read by the vertex shaders per draw, see glTFModel::getQuantizationBuffer
+struct VertexQuantization {
+  float positionOffset[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float positionScale[4] = {1.0f, 1.0f, 1.0f, 0.0f};
+};
+
+// round to nearest even, overflow goes to infinity
+inline uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000u;
+  uint32_t magnitude = bits & 0x7fffffffu;
+  if (magnitude >= 0x7f800000u) {
+    // inf stays inf, nan stays a quiet nan
+    return static_cast<uint16_t>(sign | (magnitude > 0x7f800000u ? 0x7e00u
+                                                                 : 0x7c00u));
+  }
+  if (magnitude >= 0x477ff000u) {
+    return static_cast<uint16_t>(sign | 0x7c00u);
+  }
+  if (magnitude < 0x38800000u) {
+    // subnormal half, shift the mantissa with its implicit bit into place
+    if (magnitude < 0x33000000u) {
+      return static_cast<uint16_t>(sign);
+    }
+    uint32_t exponent = magnitude >> 23;
+    uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+    uint32_t shift = 126 - exponent;
+    uint32_t half = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+      ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+  uint32_t half = (magnitude - 0x38000000u) >> 13;
+  uint32_t remainder = magnitude & 0x1fffu;
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+    ++half;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+// Each format knows its vulkan format, its size and how to encode one value
+// from floats. Integer and normalized accessors (KHR_mesh_quantization)
+// arrive here already converted by the AccessorDecoder.
+namespace VertexFormat {
+
+struct Float2 {
+  static constexpr vk::Format kFormat = vk::Format::eR32G32Sfloat;
+  static constexpr uint32_t kSize = 8;
+  static void encode(const float *value, uint8_t *dst,
+                     const VertexQuantization &) {
+    memcpy(dst, value, kSize);
+  }
+};
+
+struct Float3 {
+  static constexpr vk::Format kFormat = vk::Format::eR32G32B32Sfloat;
+  static constexpr uint32_t kSize = 12;
+  static void encode(const float *value, uint8_t *dst,
+                     const VertexQuantization &) {
+    memcpy(dst, value, kSize);
+  }
+};
+
+struct Half2 {
+  static constexpr vk::Format kFormat = vk::Format::eR16G16Sfloat;
+  static constexpr uint32_t kSize = 4;
+  static void encode(const float *value, uint8_t *dst,
+                     const VertexQuantization &) {
+    uint16_t half[2] = {floatToHalf(value[0]), floatToHalf(value[1])};
+    memcpy(dst, half, kSize);
+  }
+};
+
+// 16 bit unorm within the mesh bounds, the fourth channel pads to 8 bytes
+struct QuantizedPosition {
+  static constexpr vk::Format kFormat = vk::Format::eR16G16B16A16Unorm;
+  static constexpr uint32_t kSize = 8;
+  static void encode(const float *value, uint8_t *dst,
+                     const VertexQuantization &quantization) {
+    uint16_t quantized[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 3; ++i) {
+      float scale = quantization.positionScale[i];
+      float t = scale > 0.0f
+                    ? (value[i] - quantization.positionOffset[i]) / scale
+                    : 0.0f;
+      quantized[i] = static_cast<uint16_t>(
+          std::lround(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+    }
+    memcpy(dst, quantized, kSize);
+  }
+};
+
+// unit vector folded onto the octahedron, 2 x 16 bit snorm
+struct OctahedralNormal {
+  static constexpr vk::Format kFormat = vk::Format::eR16G16Snorm;
+  static constexpr uint32_t kSize = 4;
+  static void encode(const float *value, uint8_t *dst,
+                     const VertexQuantization &) {
+    float length =
+        std::fabs(value[0]) + std::fabs(value[1]) + std::fabs(value[2]);
+    float x = length > 0.0f ? value[0] / length : 0.0f;
+    float y = length > 0.0f ? value[1] / length : 0.0f;
+    if (value[2] < 0.0f) {
+      float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+      float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+      x = foldedX;
+      y = foldedY;
+    }
+    int16_t snorm[2] = {
+        static_cast<int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f)),
+        static_cast<int16_t>(
+            std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f))};
+    memcpy(dst, snorm, kSize);
+  }
+};
+
+} // namespace VertexFormat
+
+template <VertexSemantic Semantic, uint32_t Location, typename Format>
+struct VertexAttribute {
+  static constexpr VertexSemantic kSemantic = Semantic;
+  static constexpr uint32_t kLocation = Location;
+  using AttributeFormat = Format;
+};
+
+template <typename... Attributes> struct VertexLayout {
+  static constexpr uint32_t kAttributeCount = sizeof...(Attributes);
+  static constexpr uint32_t kStride =
+      (0 + ... + Attributes::AttributeFormat::kSize);
+
+  // attributes are packed in declaration order
+  static constexpr std::array<uint32_t, kAttributeCount> kOffsets = [] {
+    std::array<uint32_t, kAttributeCount> offsets{};
+    uint32_t offset = 0;
+    uint32_t i = 0;
+    ((offsets[i++] = offset, offset += Attributes::AttributeFormat::kSize),
+     ...);
+    return offsets;
+  }();
+
+  static constexpr bool has(VertexSemantic semantic) {
+    return ((Attributes::kSemantic == semantic) || ...);
+  }
+
+  static vk::VertexInputBindingDescription
+  getBindingDescription(uint32_t binding = 0) {
+    return {binding, kStride, vk::VertexInputRate::eVertex};
+  }
+
+  static std::array<vk::VertexInputAttributeDescription, kAttributeCount>
+  getAttributeDescriptions(uint32_t binding = 0) {
+    std::array<vk::VertexInputAttributeDescription, kAttributeCount>
+        descriptions{};
+    uint32_t i = 0;
+    ((descriptions[i] = vk::VertexInputAttributeDescription{
+          Attributes::kLocation, binding, Attributes::AttributeFormat::kFormat,
+          kOffsets[i]},
+      ++i),
+     ...);
+    return descriptions;
+  }
+
+  // writes one value of `semantic` into the vertex; a layout without the
+  // semantic drops it
+  static void encode(VertexSemantic semantic, const float *value,
+                     void *vertex, const VertexQuantization &quantization) {
+    uint8_t *bytes = static_cast<uint8_t *>(vertex);
+    uint32_t i = 0;
+    ((Attributes::kSemantic == semantic
+          ? Attributes::AttributeFormat::encode(value, bytes + kOffsets[i],
+                                                quantization)
+          : void(),
+      ++i),
+     ...);
+  }
+};
+} // namespace hiddenpiggy
+#endif
@@ -31,6 +31,23 @@ public:
   vk::Queue getPresentQueue() const { return m_presentQueue; }
   vk::Queue getComputeQueue() const { return m_computeQueue; }
 
+  // VK_EXT_mesh_shader with task and mesh shaders, enabled when the device
+  // has it
+  bool isMeshShaderSupported() const { return m_meshShaderSupported; }
+  // multi draw indirect with firstInstance, what GpuScene needs at least;
+  // the count variant lets it skip the culled draws entirely
+  bool isMultiDrawIndirectSupported() const {
+    return m_multiDrawIndirectSupported;
+  }
+  bool isDrawIndirectCountSupported() const {
+    return m_drawIndirectCountSupported;
+  }
+  // storage writes from fragment shaders, needed by the texture streaming
+  // feedback pass
+  bool isFragmentStoresAndAtomicsSupported() const {
+    return m_fragmentStoresAndAtomicsSupported;
+  }
+
 protected:
   vk::Instance m_Instance;
   vk::PhysicalDevice m_PhysicalDevice;
@@ -42,6 +59,11 @@ protected:
   vk::Queue m_computeQueue;
 
 
+  bool m_meshShaderSupported = false;
+  bool m_multiDrawIndirectSupported = false;
+  bool m_drawIndirectCountSupported = false;
+  bool m_fragmentStoresAndAtomicsSupported = false;
+
   VkDebugUtilsMessengerEXT m_debugUtilsMessenger;
   struct QueueFamilyIndex m_queueFamilyIndices;
 
@@ -0,0 +1,30 @@
+#ifndef DEPTH_ONLY_PIPELINE_HPP
+#define DEPTH_ONLY_PIPELINE_HPP
+#include "VkPipelineBase.hpp"
+#include "VkShaderModuleFactory.hpp"
+#include "vulkan/vulkan.hpp"
+namespace hiddenpiggy {
+// Depth pre-pass and shadow map pipeline: vertex stage only, fed by the
+// position stream of gltfVertex and drawn with glTFModel::drawDepth. The
+// render pass needs a depth attachment in subpass 0 and no color; viewport
+// and scissor are dynamic since shadow maps have their own size.
+class VkDepthOnlyPipeline : public VkPipelineBase {
+public:
+  VkDepthOnlyPipeline(vk::Device device, vk::PipelineLayout pipelineLayout,
+                      vk::RenderPass renderPass, bool depthBias = false)
+      : VkPipelineBase(device, pipelineLayout, renderPass),
+        m_depthBias(depthBias) {}
+  void OnCreate() override;
+  void OnDestroy() override;
+  vk::Pipeline getPipeline() override;
+
+private:
+  void createShaderStages();
+
+  vk::ShaderModule m_vertexModule;
+  // shadow maps set the bias per draw with vkCmdSetDepthBias
+  bool m_depthBias = false;
+};
+} // namespace hiddenpiggy
+
+#endif
@@ -1,21 +1,16 @@
 #ifndef SHADER_MODULE_HPP
 #define SHADER_MODULE_HPP
+#include "AssetReader.hpp"
 #include "vulkan/vulkan.hpp"
-#include <fstream>
 namespace hiddenpiggy {
 class VkShaderModuleFactory {
 public:
   static std::vector<char> ReadFile(const std::string &fileName) {
-    std::ifstream file(fileName, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
+    std::vector<unsigned char> data;
+    if (!AssetReader::readFile(fileName, &data, nullptr)) {
       throw std::runtime_error("failed to open file!");
     }
-    size_t fileSize = (size_t)file.tellg();
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
+    return std::vector<char>(data.begin(), data.end());
   };
 
   static vk::ShaderModule CreateShaderModule(vk::Device device,
@@ -10,9 +10,11 @@ public:
   VkSwapchainGraphicsPipeline(vk::Device device,
                               vk::PipelineLayout pipelineLayout,
                               vk::RenderPass renderPass,
-                              VkSwapchain* pSwapchain)
+                              VkSwapchain* pSwapchain,
+                              bool textureFeedback = true)
       : VkPipelineBase(device, pipelineLayout, renderPass) {
         m_pSwapchain = pSwapchain;
+        m_textureFeedback = textureFeedback;
       }
     void OnCreate() override;
     void OnDestroy() override;
@@ -25,6 +27,8 @@ private:
 
 
     VkSwapchain *m_pSwapchain;
+    // false selects the fragment shader without the feedback writes
+    bool m_textureFeedback = true;
 };
 } // namespace hiddenpiggy
 
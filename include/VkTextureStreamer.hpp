@@ -0,0 +1,201 @@
+#ifndef VK_TEXTURE_STREAMER_HPP
+#define VK_TEXTURE_STREAMER_HPP
+
+#include "ResourceUploadHeap.hpp"
+#include "ThreadPool.hpp"
+#include "VkBufferPool.hpp"
+#include "VkContext.hpp"
+#include "vulkan/vulkan.hpp"
+#include "vulkan/vulkan_handles.hpp"
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// one page is one mip level of one streamed texture
+using TexturePageId = uint32_t;
+
+inline TexturePageId makeTexturePageId(uint32_t textureId, uint32_t mipLevel) {
+  return (textureId << 8) | (mipLevel & 0xFF);
+}
+
+// push constant block shared with the fragment shader feedback writer
+struct TextureFeedbackPushConstants {
+  float textureWidth;
+  float textureHeight;
+  uint32_t textureId;
+  uint32_t padding;
+};
+
+// decoded rgba8 mips, highest resolution first
+using MipChain = std::vector<std::vector<uint8_t>>;
+
+// mip chain size and the decoded mips that stay resident for good
+struct TextureTail {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipLevels = 0;
+  uint32_t firstTailMip = 0;
+  std::vector<std::vector<uint8_t>> mips;
+};
+
+// a texture whose high resolution mips are streamed in on demand
+struct StreamingTexture {
+  std::string filename;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipLevels = 0;
+
+  // lowest (highest resolution) mip currently stored on the gpu
+  uint32_t residentMip = 0;
+  // lowest mip requested by the feedback pass
+  uint32_t requestedMip = UINT32_MAX;
+
+  // first mip of the tail that stays resident for the texture's lifetime
+  uint32_t firstTailMip = 0;
+
+  ImageWrapper image{};
+  vk::ImageView view;
+  vk::Sampler sampler;
+
+  // set while a worker thread decodes the streamed mips [0, firstTailMip)
+  bool loading = false;
+  std::future<std::shared_ptr<const MipChain>> pendingMips;
+  uint32_t pendingMip = 0;
+
+  // the streamed mips of the last decode, kept so that streaming back in
+  // after an eviction does not decode the file again
+  std::shared_ptr<const MipChain> decoded;
+  uint64_t decodedFrame = 0;
+
+  // set when the file changed on disk; the new tail decodes on a worker
+  bool reloadRequested = false;
+  bool reloading = false;
+  std::future<TextureTail> pendingReload;
+  // false while the first decode is in flight and a placeholder is bound
+  bool tailLoaded = false;
+};
+
+class TextureStreamer {
+public:
+  TextureStreamer(VkContext *pContext, BufferPool *pBufferPool,
+                  ResourceUploadHeap *pResourceUploadHeap)
+      : m_pContext(pContext), m_pBufferPool(pBufferPool),
+        m_pResourceUploadHeap(pResourceUploadHeap) {}
+
+  // feedbackSlots should match the number of frames that can be recorded
+  // before their feedback is read back (the swapchain image count here).
+  // Without feedback (no fragmentStoresAndAtomics) every texture asks for
+  // its full chain and the budget alone decides what stays resident.
+  void OnCreate(uint32_t feedbackSlots, vk::DeviceSize budgetBytes,
+                bool feedback = true, uint32_t maxTextures = 1024);
+  void OnDestroy();
+
+  // reads back the feedback of the frame that used this slot last time,
+  // schedules the requested mips and records the uploads of what finished
+  // loading into cmd, ahead of the frame's render pass
+  void OnUpdate(uint32_t slot, vk::CommandBuffer cmd);
+
+  // returns at once with a 1x1 placeholder bound; the mip tail decodes on a
+  // worker and shows up in getChangedTextures when it is resident. A file
+  // that is already registered gets its existing id.
+  uint32_t registerTexture(const std::string &filename);
+
+  // re-reads the file after it changed on disk. The texture drops back to
+  // its new mip tail and streams up again; the old image is released once no
+  // frame in flight uses it. Returns false if filename is not registered.
+  bool reloadTexture(const std::string &filename);
+
+  vk::ImageView getImageView(uint32_t textureId) const {
+    return m_textures[textureId].view;
+  }
+  vk::Sampler getSampler(uint32_t textureId) const {
+    return m_textures[textureId].sampler;
+  }
+  uint32_t getResidentMip(uint32_t textureId) const {
+    return m_textures[textureId].residentMip;
+  }
+  TextureFeedbackPushConstants getPushConstants(uint32_t textureId) const;
+
+  BufferWrapper getFeedbackBuffer(uint32_t slot) const {
+    return m_feedbackBuffers[slot];
+  }
+  vk::DeviceSize getFeedbackBufferSize() const {
+    return sizeof(uint32_t) * m_maxTextures;
+  }
+
+  // textures whose image view changed during the last OnUpdate; descriptor
+  // sets referencing them must be rewritten before the next draw
+  const std::vector<uint32_t> &getChangedTextures() const {
+    return m_changedTextures;
+  }
+
+  vk::DeviceSize getResidentBytes() const { return m_residentBytes; }
+
+  // mips up to this size are loaded at registration and never evicted
+  static constexpr uint32_t kTailSize = 128;
+  // at most this many pages are uploaded per update to bound the frame cost
+  static constexpr uint32_t kMaxUploadsPerUpdate = 2;
+  // system memory kept for decoded mip chains, least recently used go first
+  static constexpr size_t kDecodedCacheBytes = 256ull * 1024 * 1024;
+
+private:
+  void readFeedback(uint32_t slot);
+  void scheduleLoads();
+  void finishLoads(vk::CommandBuffer cmd);
+  void scheduleReloads();
+  void finishReloads();
+  void createTailImage(StreamingTexture &texture, const TextureTail &tail);
+  void evictToBudget(vk::CommandBuffer cmd, vk::DeviceSize incomingBytes,
+                     uint32_t protectedTexture);
+  void setResidentMip(vk::CommandBuffer cmd, uint32_t textureId,
+                      uint32_t newResidentMip,
+                      std::span<const std::vector<uint8_t>> newMips);
+  void trimDecodedCache(uint32_t protectedTexture);
+  void touchPage(TexturePageId page);
+  void releaseRetired(bool all);
+
+  vk::DeviceSize mipBytes(const StreamingTexture &texture,
+                          uint32_t mipLevel) const;
+  vk::DeviceSize residentBytes(const StreamingTexture &texture) const;
+
+  VkContext *m_pContext;
+  BufferPool *m_pBufferPool;
+  ResourceUploadHeap *m_pResourceUploadHeap;
+
+  bool m_feedback = true;
+  uint32_t m_maxTextures = 0;
+  vk::DeviceSize m_budgetBytes = 0;
+  vk::DeviceSize m_residentBytes = 0;
+  size_t m_decodedBytes = 0;
+  uint64_t m_frameCounter = 0;
+
+  // decodes the tails and streamed mips off the render thread
+  std::unique_ptr<ThreadPool> m_pDecodePool;
+  std::vector<StreamingTexture> m_textures;
+  std::vector<BufferWrapper> m_feedbackBuffers;
+  std::vector<uint32_t> m_changedTextures;
+
+  // least recently requested pages at the front
+  std::list<TexturePageId> m_lru;
+  std::unordered_map<TexturePageId, std::list<TexturePageId>::iterator>
+      m_lruLookup;
+
+  // images replaced by a residency change and the staging buffers of their
+  // uploads, destroyed once no frame in flight can reference them anymore
+  struct RetiredImage {
+    ImageWrapper image;
+    vk::ImageView view;
+    BufferWrapper staging;
+    uint64_t retiredFrame;
+  };
+  std::vector<RetiredImage> m_retired;
+};
+} // namespace hiddenpiggy
+#endif
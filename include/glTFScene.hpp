@@ -1,70 +1,100 @@
 #ifndef GLTF_SCENE_HPP
 #define GLTF_SCENE_HPP
+#include "AccessorDecoder.hpp"
+#include "CookedScene.hpp"
+#include "GltfFileSystem.hpp"
+#include "GpuDecompressor.hpp"
+#include "Hash.hpp"
+#include "ImpostorBaker.hpp"
+#include "MeshOptimizer.hpp"
 #include "ResourceUploadHeap.hpp"
+#include "SimdMath.hpp"
+#include "StaticBatcher.hpp"
+#include "VertexLayout.hpp"
 #include "VkBufferPool.hpp"
 #include "vulkan/vulkan.hpp"
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_handles.hpp"
 #include "vulkan/vulkan_structs.hpp"
-#include <filesystem>
-#include <fstream>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/quaternion_geometric.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/quaternion.hpp>
-#include <ios>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
 #include <stdexcept>
 #include <tiny_gltf.h>
 #include <vector>
 
 namespace hiddenpiggy {
 
+// 20 bytes instead of the 40 of plain floats: positions are 16 bit unorm
+// within the bounds of their mesh, dequantized per draw by the mesh's
+// VertexQuantization (see getQuantizationBuffer), normals are octahedral and
+// uvs half floats.
+//
+// The vertex buffer holds two streams, every position first and the shading
+// attributes behind them, so depth and shadow passes bind binding 0 alone and
+// fetch 8 bytes per vertex. The importer works on whole vertices and splits
+// them just before cooking, see splitVertexStreams.
 struct gltfVertex {
-  glm::vec3 position;
-  glm::vec3 normal;
-  glm::vec2 uv0;
-  glm::vec2 uv1;
+  using PositionLayout = VertexLayout<VertexAttribute<
+      VertexSemantic::Position, 0, VertexFormat::QuantizedPosition>>;
+  using AttributeLayout = VertexLayout<
+      VertexAttribute<VertexSemantic::Normal, 1,
+                      VertexFormat::OctahedralNormal>,
+      VertexAttribute<VertexSemantic::Uv0, 2, VertexFormat::Half2>,
+      VertexAttribute<VertexSemantic::Uv1, 3, VertexFormat::Half2>>;
+  static constexpr uint32_t kPositionBinding = 0;
+  static constexpr uint32_t kAttributeBinding = 1;
 
-  static vk::VertexInputBindingDescription getBindingDescription() {
-    vk::VertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(gltfVertex);
-    bindingDescription.inputRate = vk::VertexInputRate::eVertex;
-    return bindingDescription;
+  uint8_t position[PositionLayout::kStride];
+  uint8_t attributes[AttributeLayout::kStride];
+
+  static std::array<vk::VertexInputBindingDescription, 2>
+  getBindingDescriptions() {
+    return {PositionLayout::getBindingDescription(kPositionBinding),
+            AttributeLayout::getBindingDescription(kAttributeBinding)};
   }
 
-  static std::array<vk::VertexInputAttributeDescription, 4>
+  static std::array<vk::VertexInputAttributeDescription,
+                    PositionLayout::kAttributeCount +
+                        AttributeLayout::kAttributeCount>
   getAttributeDescriptions() {
-    std::array<vk::VertexInputAttributeDescription, 4> attributeDescriptions{};
-
-    // Position attribute
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;
-    attributeDescriptions[0].offset = offsetof(gltfVertex, position);
-
-    // Normal attribute
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
-    attributeDescriptions[1].offset = offsetof(gltfVertex, normal);
-
-    // Texture coordinate attribute
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = vk::Format::eR32G32Sfloat;
-    attributeDescriptions[2].offset = offsetof(gltfVertex, uv0);
-
-    // Texture coordinate attribute
-    attributeDescriptions[3].binding = 0;
-    attributeDescriptions[3].location = 2;
-    attributeDescriptions[3].format = vk::Format::eR32G32Sfloat;
-    attributeDescriptions[3].offset = offsetof(gltfVertex, uv1);
-    return attributeDescriptions;
+    auto positions = PositionLayout::getAttributeDescriptions(kPositionBinding);
+    auto attributes =
+        AttributeLayout::getAttributeDescriptions(kAttributeBinding);
+    std::array<vk::VertexInputAttributeDescription,
+               PositionLayout::kAttributeCount +
+                   AttributeLayout::kAttributeCount>
+        descriptions{};
+    std::copy(positions.begin(), positions.end(), descriptions.begin());
+    std::copy(attributes.begin(), attributes.end(),
+              descriptions.begin() + positions.size());
+    return descriptions;
+  }
+
+  // vertex input of the depth only pipelines
+  static vk::VertexInputBindingDescription getPositionBindingDescription() {
+    return PositionLayout::getBindingDescription(kPositionBinding);
+  }
+
+  static std::array<vk::VertexInputAttributeDescription,
+                    PositionLayout::kAttributeCount>
+  getPositionAttributeDescriptions() {
+    return PositionLayout::getAttributeDescriptions(kPositionBinding);
   }
 };
+static_assert(sizeof(gltfVertex) == gltfVertex::PositionLayout::kStride +
+                                        gltfVertex::AttributeLayout::kStride,
+              "gltfVertex must not be padded");
 
 struct Primitive {
   uint32_t indexCount = -1;
@@ -73,22 +103,643 @@ struct Primitive {
   int32_t vertexOffset = 0;
   uint32_t firstVertex = 0;
   uint32_t materialIndex = 0;
+  // 16 bit when the optimizer packed the primitive, firstIndex counts in
+  // units of this type
+  vk::IndexType indexType = vk::IndexType::eUint32;
+  // drawn by the position only passes; positions shared by several vertices
+  // are welded, so this can reuse more than the shading order. Follows the
+  // shading indices in the buffer, or equals them when welding found nothing.
+  uint32_t depthFirstIndex = -1;
+  uint32_t depthIndexCount = -1;
+  // coarser index ranges over the same vertices, lods[0] is the level
+  // after the full mesh
+  uint32_t lodCount = 1;
+  CookedLod lods[kMaxLods - 1] = {};
+  float boundsCenter[3] = {0.0f, 0.0f, 0.0f};
+  float boundsRadius = 0.0f;
+  // culling clusters of the full mesh, see MeshletCuller
+  uint32_t firstMeshlet = 0;
+  uint32_t meshletCount = 0;
 };
 
 struct gltfMesh {
-  std::vector<gltfVertex> vertices;
-  std::vector<uint32_t> indices;
   std::vector<Primitive> primitives;
+  // the mesh's positions decode to offset + value * scale
+  VertexQuantization quantization{};
+  // the mesh's range of the transform table, one instance each
+  uint32_t firstTransform = 0;
+  uint32_t transformCount = 0;
+  // runs of transforms in the same HLOD group; hiding groups splits the
+  // instanced draws along them, at most this many per primitive
+  uint32_t groupRuns = 1;
 };
 
+// the meshlets of a placed mesh, what MeshletCuller culls at each of the
+// mesh's transforms
+struct MeshletRange {
+  uint32_t firstTransform;
+  uint32_t transformCount;
+  uint32_t firstMeshlet;
+  uint32_t meshletCount;
+  // indices of the triangles of those meshlets
+  uint32_t indexCount;
+};
+
+// one primitive at one of its mesh's placements, what GpuScene culls;
+// std430, lod 0 is the full mesh
+struct GpuInstance {
+  float boundsCenter[3];
+  float boundsRadius;
+  uint32_t transformIndex;
+  uint32_t indexType; // 0 for 32 bit indices, 1 for 16 bit
+  int32_t vertexOffset;
+  uint32_t lodCount;
+  uint32_t firstIndex[kMaxLods];
+  uint32_t indexCount[kMaxLods];
+  float lodError[kMaxLods];
+  uint32_t clustered; // 1 if the primitive has meshlets, see GpuScene::cull
+  uint32_t padding[3];
+};
+static_assert(sizeof(GpuInstance) == 96, "GpuInstance is shared with the gpu");
+
 class glTFModel {
 public:
-  void loadModel(const char *filePath) {
+  // loads the cooked copy of the scene if it is up to date, otherwise imports
+  // the gltf file and cooks it for the next run. optimizeMeshes runs the
+  // import through MeshOptimizer, staticBatching merges the static nodes
+  // through StaticBatcher first and impostors bakes HLOD impostors of them
+  // with ImpostorBaker; the result is cached like the rest.
+  void loadModel(const char *filePath, bool optimizeMeshes = true,
+                 bool staticBatching = false, bool impostors = false) {
+    std::string cookedPath = CookedScene::cookedPathFor(filePath);
+    uint32_t flags =
+        (optimizeMeshes ? CookedScene::kFlagOptimizedMeshes : 0) |
+        (staticBatching ? CookedScene::kFlagStaticBatching : 0) |
+        (impostors ? CookedScene::kFlagImpostors : 0);
+    m_pCooked = std::make_unique<CookedScene>();
+    if (m_pCooked->open(cookedPath, filePath, sizeof(gltfVertex), flags)) {
+      loadCooked();
+      buildInstances();
+      buildMeshletRanges();
+      resolveTexturePaths(filePath, m_pCooked->getTextureImages());
+      if (optimizeMeshes) {
+        reportMeshStats(filePath, m_pCooked->getHeader().meshStats);
+      }
+      return;
+    }
+    m_pCooked.reset();
+
+    CookedSceneData cookedData{};
+    cookedData.flags = flags;
+    importModel(filePath, cookedData, optimizeMeshes, staticBatching,
+                impostors);
+    buildInstances();
+    buildMeshletRanges();
+    resolveTexturePaths(filePath, cookedData.textureImages);
+    if (optimizeMeshes) {
+      reportMeshStats(filePath, cookedData.meshStats);
+    }
+
+    cookedData.vertexData = vertexStreams.data();
+    cookedData.vertexSize = vertexStreams.size();
+    cookedData.vertexStride = sizeof(gltfVertex);
+    cookedData.vertexStreamPeriod = kVertexStreamPeriod;
+    cookedData.indexData = indices.data();
+    cookedData.indexSize = indices.size() * sizeof(uint32_t);
+    cookedData.meshlets = m_meshlets;
+    cookedData.meshletVertices = m_meshletVertices;
+    cookedData.meshletTriangles = m_meshletTriangles;
+    cookedData.impostorGroups = m_impostorGroups;
+    cookedData.impostorTexels = m_impostorTexels;
+    hashPrimitives();
+    for (size_t i = 0; i < cookedData.primitives.size(); ++i) {
+      cookedData.primitives[i].contentHash = m_primitiveHashes[i];
+    }
+    if (!CookedScene::write(cookedPath, filePath, cookedData)) {
+      std::cerr << "Warning: failed to cook " << filePath << std::endl;
+    }
+  }
+
+  void AllocateBuffersAndUpload(BufferPool *bufferPool,
+                                ResourceUploadHeap *resourceUploadHeap,
+                                GpuDecompressor *decompressor,
+                                uint32_t queueFamilyIndex) {
+    beginUpload(bufferPool, decompressor, queueFamilyIndex);
+    uploadSome(resourceUploadHeap, std::numeric_limits<vk::DeviceSize>::max());
+  }
+
+  // allocates the gpu buffers; the data follows through uploadSome. Cooked
+  // geometry is expanded by the decompressor, so the buffers are storage
+  // buffers as well.
+  void beginUpload(BufferPool *bufferPool, GpuDecompressor *decompressor,
+                   uint32_t queueFamilyIndex) {
+    m_bufferPool = bufferPool;
+    m_pDecompressor = decompressor;
+    setSourceData();
+
+    // vertex buffer creation
+    {
+      vk::BufferCreateInfo vertexBufferCreateInfo{
+          {},
+          m_vertexSize,
+          vk::BufferUsageFlagBits::eVertexBuffer |
+              vk::BufferUsageFlagBits::eStorageBuffer |
+              vk::BufferUsageFlagBits::eTransferDst,
+          vk::SharingMode::eExclusive,
+          1,
+          &queueFamilyIndex,
+          nullptr};
+
+      // memory allocinfo
+      VmaAllocationCreateInfo allocCreateInfo{};
+      allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+      vertexBuffer =
+          bufferPool->allocateMemory(vertexBufferCreateInfo, allocCreateInfo);
+    }
+
+    // index buffer creation
+    if (this->hasIndices) {
+      vk::BufferCreateInfo indexBufferCreateInfo{
+          {},
+          m_indexSize,
+          vk::BufferUsageFlagBits::eIndexBuffer |
+              vk::BufferUsageFlagBits::eStorageBuffer |
+              vk::BufferUsageFlagBits::eTransferDst,
+          vk::SharingMode::eExclusive,
+          1,
+          &queueFamilyIndex,
+          nullptr};
+
+      // memory allocinfo
+      VmaAllocationCreateInfo allocCreateInfo{};
+      allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+      indexBuffer =
+          bufferPool->allocateMemory(indexBufferCreateInfo, allocCreateInfo);
+    }
+
+    createTableBuffers(bufferPool, queueFamilyIndex);
+
+    m_residentPrimitives = 0;
+    m_uploadedPositionEnd = 0;
+    m_uploadedAttributeEnd = getAttributeStreamOffset(m_vertexSize);
+    m_uploadedIndexBytes = 0;
+    m_uploadStarted = true;
+  }
+
+  // Hot reload path: when the new import has the same primitive ranges as
+  // the model on screen, take over its buffers and upload only the
+  // primitives whose contents changed. previous keeps nothing to free.
+  bool adoptBuffers(glTFModel &previous,
+                    ResourceUploadHeap *resourceUploadHeap,
+                    GpuDecompressor *decompressor) {
+    if (!previous.isUploaded() || hasIndices != previous.hasIndices ||
+        !sameRanges(previous)) {
+      return false;
+    }
+    m_bufferPool = previous.m_bufferPool;
+    vertexBuffer = previous.vertexBuffer;
+    indexBuffer = previous.indexBuffer;
+    meshletBuffer = previous.meshletBuffer;
+    meshletVertexBuffer = previous.meshletVertexBuffer;
+    meshletTriangleBuffer = previous.meshletTriangleBuffer;
+    instanceBuffer = previous.instanceBuffer;
+    selectedLodBuffer = previous.selectedLodBuffer;
+    transformBuffer = previous.transformBuffer;
+    quantizationBuffer = previous.quantizationBuffer;
+    impostorTexelBuffer = previous.impostorTexelBuffer;
+    m_meshletCount = previous.m_meshletCount;
+    m_meshletVertexCount = previous.m_meshletVertexCount;
+    m_meshletTriangleSize = previous.m_meshletTriangleSize;
+    m_instanceCount = previous.m_instanceCount;
+    m_transformCount = previous.m_transformCount;
+    m_impostorTexelCount = previous.m_impostorTexelCount;
+    previous.m_uploadStarted = false;
+
+    m_pDecompressor = decompressor;
+    setSourceData();
+    // the tables are small next to the geometry, they go again as a whole
+    m_tablesUploaded = false;
+    uploadTables(resourceUploadHeap);
+    // the changed primitives decode in one submit
+    m_pDecompressor->beginBatch();
+    uint32_t ordinal = 0;
+    for (auto &mesh : meshes) {
+      for (auto &primitive : mesh.primitives) {
+        if (m_primitiveHashes[ordinal] !=
+            previous.m_primitiveHashes[ordinal]) {
+          vk::DeviceSize positionStart = getPositionStart(primitive);
+          uploadRange(resourceUploadHeap, m_vertexData, m_vertexStream,
+                      vertexBuffer, positionStart, getPositionEnd(primitive),
+                      std::numeric_limits<vk::DeviceSize>::max());
+          vk::DeviceSize attributeStart = getAttributeStart(primitive);
+          uploadRange(resourceUploadHeap, m_vertexData, m_vertexStream,
+                      vertexBuffer, attributeStart, getAttributeEnd(primitive),
+                      std::numeric_limits<vk::DeviceSize>::max());
+          if (hasIndices && primitive.indexCount != UINT32_MAX) {
+            vk::DeviceSize indexStart = getIndexStart(primitive);
+            uploadRange(resourceUploadHeap, m_indexData, m_indexStream,
+                        indexBuffer, indexStart, getIndexEnd(primitive),
+                        std::numeric_limits<vk::DeviceSize>::max());
+          }
+        }
+        ordinal++;
+      }
+    }
+    m_pDecompressor->endBatch();
+
+    m_uploadStarted = true;
+    m_residentPrimitives = ordinal;
+    m_uploadedPositionEnd = getAttributeStreamOffset(m_vertexSize);
+    m_uploadedAttributeEnd = m_vertexSize;
+    m_uploadedIndexBytes = m_indexSize;
+    vertexStreams = {};
+    indices = {};
+    m_pCooked.reset();
+    m_vertexData = nullptr;
+    m_indexData = nullptr;
+    m_vertexStream = {};
+    m_indexStream = {};
+    return true;
+  }
+
+  // uploads primitives in order until about budget bytes went out; a
+  // primitive becomes drawable once both its vertex and index ranges are
+  // resident. Returns the number of bytes uploaded.
+  vk::DeviceSize uploadSome(ResourceUploadHeap *resourceUploadHeap,
+                            vk::DeviceSize budget) {
+    // the decodes of the whole call go out in one submit, waited on here
+    m_pDecompressor->beginBatch();
+    vk::DeviceSize uploaded = uploadPrimitives(resourceUploadHeap, budget);
+    m_pDecompressor->endBatch();
+
+    if (isUploaded()) {
+      // the gpu owns the geometry now
+      vertexStreams = {};
+      indices = {};
+      m_pCooked.reset();
+      m_vertexData = nullptr;
+      m_indexData = nullptr;
+      m_vertexStream = {};
+      m_indexStream = {};
+    }
+    return uploaded;
+  }
+
+  bool isUploaded() const {
+    return m_uploadStarted && m_residentPrimitives == getPrimitiveCount();
+  }
+
+  bool isUploadStarted() const { return m_uploadStarted; }
+
+  vk::DeviceSize getUploadSize() const { return m_vertexSize + m_indexSize; }
+
+  vk::DeviceSize getUploadedSize() const {
+    return m_uploadedPositionEnd +
+           (m_uploadedAttributeEnd - getAttributeStreamOffset(m_vertexSize)) +
+           m_uploadedIndexBytes;
+  }
+
+  uint32_t getPrimitiveCount() const {
+    uint32_t count = 0;
+    for (const auto &mesh : meshes) {
+      count += static_cast<uint32_t>(mesh.primitives.size());
+    }
+    return count;
+  }
+
+  // skipClustered leaves out the primitives a MeshletCuller draws.
+  // multiDraw needs multiDrawIndirect and drawIndirectFirstInstance, see
+  // recordDraws.
+  void draw(vk::CommandBuffer cmdBuf, bool skipClustered = false,
+            bool multiDraw = false) {
+    if (m_residentPrimitives == 0) {
+      m_drawCalls = 0;
+      return;
+    }
+    bindVertexStreams(cmdBuf);
+    recordDraws(cmdBuf, skipClustered, multiDraw, 0,
+                [](const Primitive &primitive) {
+                  return CookedLod{primitive.firstIndex, primitive.indexCount,
+                                   0.0f};
+                });
+  }
+
+  // for pipelines built with gltfVertex::getPositionBindingDescription;
+  // binds the position stream alone and draws the depth index order
+  void drawDepth(vk::CommandBuffer cmdBuf, bool multiDraw = false) {
+    if (m_residentPrimitives == 0) {
+      m_drawCalls = 0;
+      return;
+    }
+    vk::DeviceSize offset = 0;
+    cmdBuf.bindVertexBuffers(gltfVertex::kPositionBinding, vertexBuffer.buffer,
+                             offset);
+    // the depth order only exists for the full mesh
+    recordDraws(cmdBuf, false, multiDraw, 1, [](const Primitive &primitive) {
+      return CookedLod{primitive.depthFirstIndex, primitive.depthIndexCount,
+                       0.0f};
+    });
+  }
+
+  // draw calls recorded by the last draw or drawDepth
+  uint32_t getDrawCallCount() const { return m_drawCalls; }
+
+  // screen space error a LOD may have, GpuScene selects with it as well
+  static constexpr float kLodErrorPixels = 1.0f;
+  // a coarser LOD needs its error this far below the threshold, on the gpu
+  // as well
+  static constexpr float kLodHysteresis = 0.75f;
+
+  // Picks every primitive's LOD for this frame from its error projected to
+  // pixels: modelView places the scene, projection is the camera's, whose
+  // [1][1] is the focal length in half viewports. Instances of a primitive
+  // share its LOD, the one the closest of them needs. A coarser LOD takes
+  // over only once its error drops below kLodHysteresis of the threshold,
+  // so primitives near the boundary do not pop back and forth.
+  void selectLods(const glm::mat4 &modelView, const glm::mat4 &projection,
+                  float viewportHeight, float errorPixels = kLodErrorPixels) {
+    float pixelsPerUnit = std::fabs(projection[1][1]) * 0.5f * viewportHeight;
+    m_selectedLods.resize(getPrimitiveCount(), 0);
+    m_drawnTriangles = 0;
+    uint32_t ordinal = 0;
+    for (const auto &mesh : meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        // distance of the closest point of any instance's sphere, in units
+        // of the primitive's own model space; inside a sphere the full mesh
+        // is used
+        float distance = std::numeric_limits<float>::max();
+        for (uint32_t t = 0; t < mesh.transformCount; ++t) {
+          glm::mat4 placed =
+              modelView * m_instanceTransforms[mesh.firstTransform + t];
+          float scale = std::max({glm::length(glm::vec3(placed[0])),
+                                  glm::length(glm::vec3(placed[1])),
+                                  glm::length(glm::vec3(placed[2]))});
+          if (scale <= 0.0f) {
+            continue;
+          }
+          glm::vec3 center = glm::vec3(
+              placed * glm::vec4(glm::make_vec3(primitive.boundsCenter), 1.0f));
+          distance = std::min(distance, glm::length(center) / scale -
+                                            primitive.boundsRadius);
+        }
+        auto projected = [&](uint32_t lod) {
+          return distance > 0.0f
+                     ? primitive.lods[lod - 1].error / distance * pixelsPerUnit
+                     : std::numeric_limits<float>::max();
+        };
+        uint32_t lod = std::min(m_selectedLods[ordinal], primitive.lodCount - 1);
+        while (lod > 0 && projected(lod) > errorPixels) {
+          --lod;
+        }
+        while (lod + 1 < primitive.lodCount &&
+               projected(lod + 1) <= errorPixels * kLodHysteresis) {
+          ++lod;
+        }
+        m_selectedLods[ordinal++] = lod;
+        m_drawnTriangles +=
+            uint64_t(lod == 0 ? primitive.indexCount
+                              : primitive.lods[lod - 1].indexCount) /
+            3 * countVisibleTransforms(mesh);
+      }
+    }
+  }
+
+  // triangles drawn with the LODs of the last selectLods
+  uint64_t getDrawnTriangleCount() const { return m_drawnTriangles; }
+
+  // groups smaller than this on screen, in pixels across, are drawn as
+  // impostors; a view texel then covers at most 1.5 pixels
+  static constexpr float kImpostorPixels = 1.5f * ImpostorBaker::kFrameSize;
+
+  // Swaps HLOD groups for their impostors: a group whose bounding sphere
+  // projects to fewer than kImpostorPixels turns into one, with the same
+  // hysteresis as the LODs on the way back. Its transforms are hidden from
+  // draw, GpuScene and MeshletCuller; ImpostorRenderer draws what is
+  // active. Call before culling the frame. Groups only switch once the
+  // atlases are resident.
+  void selectImpostors(const glm::mat4 &modelView, const glm::mat4 &projection,
+                       float viewportHeight) {
+    m_activeImpostors.clear();
+    std::fill(m_hiddenTransforms.begin(), m_hiddenTransforms.end(), 0);
+    if (m_impostorGroups.empty() || !m_uploadStarted || !m_tablesUploaded) {
+      return;
+    }
+    float pixelsPerUnit = std::fabs(projection[1][1]) * 0.5f * viewportHeight;
+    float scale = std::max({glm::length(glm::vec3(modelView[0])),
+                            glm::length(glm::vec3(modelView[1])),
+                            glm::length(glm::vec3(modelView[2]))});
+    for (size_t g = 0; g < m_impostorGroups.size(); ++g) {
+      const CookedImpostorGroup &group = m_impostorGroups[g];
+      glm::vec3 center = glm::vec3(
+          modelView * glm::vec4(glm::make_vec3(group.center), 1.0f));
+      float radius = group.radius * scale;
+      float distance = glm::length(center);
+      // the camera inside the sphere always sees the meshes
+      float pixels = distance > radius
+                         ? 2.0f * radius / distance * pixelsPerUnit
+                         : std::numeric_limits<float>::max();
+      float threshold =
+          m_impostorActive[g] ? kImpostorPixels / kLodHysteresis
+                              : kImpostorPixels;
+      m_impostorActive[g] = pixels < threshold;
+      if (m_impostorActive[g]) {
+        m_activeImpostors.push_back(static_cast<uint32_t>(g));
+      }
+    }
+    for (size_t t = 0; t < m_transformGroups.size(); ++t) {
+      int32_t group = m_transformGroups[t];
+      m_hiddenTransforms[t] = group >= 0 && m_impostorActive[group] ? 1 : 0;
+    }
+  }
+
+  // what ImpostorRenderer draws: the groups, the active ones of the last
+  // selectImpostors and the atlases, ImpostorBaker::kGroupTexels per group
+  const std::vector<CookedImpostorGroup> &getImpostorGroups() const {
+    return m_impostorGroups;
+  }
+  const std::vector<uint32_t> &getActiveImpostors() const {
+    return m_activeImpostors;
+  }
+  const BufferWrapper &getImpostorTexelBuffer() const {
+    return impostorTexelBuffer;
+  }
+  // one per transform, 1 where an active impostor stands in for it
+  const std::vector<uint32_t> &getHiddenTransforms() const {
+    return m_hiddenTransforms;
+  }
+
+  // both vertex streams for the pipelines built with gltfVertex's bindings
+  void bindVertexStreams(vk::CommandBuffer cmdBuf) const {
+    vk::Buffer buffers[] = {vertexBuffer.buffer, vertexBuffer.buffer};
+    vk::DeviceSize offsets[] = {0, getAttributeStreamOffset(m_vertexSize)};
+    cmdBuf.bindVertexBuffers(gltfVertex::kPositionBinding, buffers, offsets);
+  }
+
+  // the image file of each glTF texture, empty where the image is embedded;
+  // the material texture indices point in here
+  const std::vector<std::string> &getTexturePaths() const {
+    return m_texturePaths;
+  }
+  // TextureStreamer ids of the texture paths, set once they are registered;
+  // kNoTexture where there is no file
+  static constexpr uint32_t kNoTexture = UINT32_MAX;
+  void setTextureIds(std::vector<uint32_t> textureIds) {
+    m_textureIds = std::move(textureIds);
+  }
+  const std::vector<uint32_t> &getTextureIds() const { return m_textureIds; }
+
+  // what MeshletCuller reads; the buffers are valid once isUploaded
+  uint32_t getMeshletCount() const { return m_meshletCount; }
+  // one per mesh that has meshlets and is placed, in transform order
+  const std::vector<MeshletRange> &getMeshletRanges() const {
+    return m_meshletRanges;
+  }
+  const BufferWrapper &getMeshletBuffer() const { return meshletBuffer; }
+  const BufferWrapper &getMeshletVertexBuffer() const {
+    return meshletVertexBuffer;
+  }
+  const BufferWrapper &getMeshletTriangleBuffer() const {
+    return meshletTriangleBuffer;
+  }
+  const BufferWrapper &getVertexBuffer() const { return vertexBuffer; }
+  const BufferWrapper &getIndexBuffer() const { return indexBuffer; }
+
+  // what GpuScene reads; no instances when some primitive is unindexed
+  uint32_t getInstanceCount() const { return m_instanceCount; }
+  const BufferWrapper &getInstanceBuffer() const { return instanceBuffer; }
+  // the LOD GpuScene picked for every instance last frame, one uint each;
+  // written by the gpu only, zero after upload
+  const BufferWrapper &getSelectedLodBuffer() const {
+    return selectedLodBuffer;
+  }
+
+  // the placements of the meshes, what the scene shaders read as
+  // transforms[gl_InstanceIndex]; the buffer is resident before any
+  // primitive is
+  uint32_t getTransformCount() const { return m_transformCount; }
+  const std::vector<glm::mat4> &getTransforms() const {
+    return m_instanceTransforms;
+  }
+  const BufferWrapper &getTransformBuffer() const { return transformBuffer; }
+  // the dequantization of each transform's mesh, read beside the transforms
+  // as quantizations[gl_InstanceIndex]
+  const std::vector<VertexQuantization> &getQuantizations() const {
+    return m_transformQuantizations;
+  }
+  const BufferWrapper &getQuantizationBuffer() const {
+    return quantizationBuffer;
+  }
+
+  // picking through static batches: the source node a hit at point (world
+  // space of the scene, before the model matrix) on mesh came from. The
+  // member whose bounds lie closest wins, the smaller one on ties. Returns
+  // -1 if mesh is not a batch.
+  int32_t findBatchedNode(uint32_t mesh, const glm::vec3 &point) const {
+    int32_t best = -1;
+    float bestDistance = std::numeric_limits<float>::max();
+    float bestVolume = std::numeric_limits<float>::max();
+    for (const auto &member : batchMembers) {
+      if (member.mesh != mesh) {
+        continue;
+      }
+      glm::vec3 lower = glm::make_vec3(member.boundsMin);
+      glm::vec3 upper = glm::make_vec3(member.boundsMax);
+      float distance = glm::length(point - glm::clamp(point, lower, upper));
+      glm::vec3 extent = upper - lower;
+      float volume = extent.x * extent.y * extent.z;
+      if (distance < bestDistance ||
+          (distance == bestDistance && volume < bestVolume)) {
+        best = static_cast<int32_t>(member.node);
+        bestDistance = distance;
+        bestVolume = volume;
+      }
+    }
+    return best;
+  }
+  vk::DeviceSize getAttributeStreamOffset() const {
+    return getAttributeStreamOffset(m_vertexSize);
+  }
+
+  void destroy() {
+    // clean mesh data
+    meshes.clear();
+    nodes.clear();
+    nodeInstances.clear();
+    batchMembers.clear();
+    m_impostorGroups.clear();
+    materials.clear();
+
+    // destroy buffer
+    if (m_uploadStarted) {
+      m_bufferPool->freeBuffer(vertexBuffer);
+      if (hasIndices) {
+        m_bufferPool->freeBuffer(indexBuffer);
+      }
+      if (m_meshletCount > 0) {
+        m_bufferPool->freeBuffer(meshletBuffer);
+        m_bufferPool->freeBuffer(meshletVertexBuffer);
+        m_bufferPool->freeBuffer(meshletTriangleBuffer);
+      }
+      if (m_instanceCount > 0) {
+        m_bufferPool->freeBuffer(instanceBuffer);
+        m_bufferPool->freeBuffer(selectedLodBuffer);
+      }
+      if (m_transformCount > 0) {
+        m_bufferPool->freeBuffer(transformBuffer);
+        m_bufferPool->freeBuffer(quantizationBuffer);
+      }
+      if (m_impostorTexelCount > 0) {
+        m_bufferPool->freeBuffer(impostorTexelBuffer);
+      }
+      m_uploadStarted = false;
+    }
+    // not handed over by adoptBuffers, every model frees its own
+    if (drawCommandBuffer.buffer) {
+      m_bufferPool->freeBuffer(drawCommandBuffer);
+      drawCommandBuffer = {};
+    }
+  }
+
+
+  glm::mat4 getModelMatrix() {
+    glm::vec3 scales(scale);
+    glm::mat4 matrix;
+    SimdMath::composeTrs(&position, &rotation, &scales, &matrix, 1);
+    return matrix;
+  }
+
+  void setScale(float scale) {
+    this->scale = scale;
+  }
+
+  void setRotation(float yaw, float pitch, float roll) {
+    this->rotation = glm::quat(glm::vec3(yaw, pitch, roll));
+  }
+
+  void rotate(float delta, glm::vec3 axis) {
+    axis = glm::normalize(axis);
+    this->rotation *= glm::quat(cos(delta/2), axis.x * sin(delta/2), axis.y * sin(delta/2), axis.z * sin(delta/2));
+  }
+
+
+private:
+  // one vertex as decoded from the accessors, before encoding
+  struct SourceVertex {
+    float position[3];
+    float normal[3];
+    float uv0[2];
+    float uv1[2];
+  };
+
+  void importModel(const char *filePath, CookedSceneData &cookedData,
+                   bool optimizeMeshes, bool staticBatching, bool impostors) {
     tinygltf::Model model;
     tinygltf::TinyGLTF loader;
     std::string err;
     std::string warn;
-    bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, filePath);
+    // only geometry is cooked, the images are never decoded
+    bool ret = GltfFileSystem::loadModel(loader, &model, &err, &warn, filePath,
+                                         false);
     if (!err.empty()) {
       throw std::runtime_error(err);
     }
@@ -99,299 +750,1344 @@ public:
       throw std::runtime_error("model load failed");
     }
 
-    // handle byte buffer objects
-    struct ByteBuffer {
-      uint8_t *pData = nullptr;
-      uint32_t byteLength;
-    };
-    std::vector<ByteBuffer> byteBuffers{};
-
-    // iterate over buffers
+    // tinygltf already holds every buffer in memory, decode from there
     for (auto &buffer : model.buffers) {
-      std::filesystem::path path{filePath};
-      std::ifstream opened_file{path.remove_filename().string() + buffer.uri,
-                                std::ios_base::in | std::ios_base::binary};
-      if (!opened_file.is_open()) {
-        throw std::runtime_error("cannot open the binary file");
+      // the cooked file goes stale when any external buffer changes
+      if (!buffer.uri.empty() && buffer.uri.rfind("data:", 0) != 0) {
+        cookedData.dependencies.push_back(buffer.uri);
       }
-      // get the buffer size
-      opened_file.seekg(0, std::ios::end);
-      std::streamsize fileSize = opened_file.tellg();
-      opened_file.seekg(0, std::ios::beg);
-
-      ByteBuffer byteBuffer{};
-      byteBuffer.byteLength = fileSize;
-      byteBuffer.pData = new uint8_t[fileSize];
+    }
 
-      // read file data to the buffer
-      if (!opened_file.read(reinterpret_cast<char *>(byteBuffer.pData),
-                            fileSize)) {
-        throw std::runtime_error("buffer read failed");
+    // everything below sees the batches as ordinary meshes
+    if (staticBatching) {
+      StaticBatcher::Stats stats{};
+      for (const auto &member : StaticBatcher::batch(model, &stats)) {
+        CookedBatchMember cooked{member.node, member.mesh};
+        std::copy(std::begin(member.boundsMin), std::end(member.boundsMin),
+                  cooked.boundsMin);
+        std::copy(std::begin(member.boundsMax), std::end(member.boundsMax),
+                  cooked.boundsMax);
+        batchMembers.push_back(cooked);
       }
+      std::cout << filePath << ": " << stats.staticNodes
+                << " static nodes batched, " << stats.drawsBefore << " -> "
+                << stats.drawsAfter << " draws" << std::endl;
+    }
 
-      byteBuffers.push_back(byteBuffer);
+    // size the scene wide arrays exactly before decoding anything
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for (const auto &mesh : model.meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        auto position = primitive.attributes.find("POSITION");
+        if (position != primitive.attributes.end()) {
+          vertexCount += model.accessors[position->second].count;
+        }
+        if (primitive.indices >= 0) {
+          indexCount += model.accessors[primitive.indices].count;
+        }
+      }
     }
+    vertices.reserve(vertexCount);
+    indices.reserve(indexCount);
+    MeshOptimizer::CacheStats statsBefore{};
+    MeshOptimizer::CacheStats statsAfter{};
 
     for (size_t i = 0; i < model.meshes.size(); ++i) {
       gltfMesh gltfMesh{};
       const tinygltf::Mesh &mesh = model.meshes[i];
+      gltfMesh.quantization = computeQuantization(model, mesh);
+      const VertexQuantization &quantization = gltfMesh.quantization;
+      CookedMesh cookedMesh{static_cast<uint32_t>(cookedData.primitives.size()),
+                            static_cast<uint32_t>(mesh.primitives.size())};
+      memcpy(cookedMesh.positionOffset, quantization.positionOffset,
+             sizeof(cookedMesh.positionOffset));
+      memcpy(cookedMesh.positionScale, quantization.positionScale,
+             sizeof(cookedMesh.positionScale));
       for (size_t j = 0; j < mesh.primitives.size(); j++) {
         Primitive gltfPrimitive{};
         const tinygltf::Primitive &primitive = mesh.primitives[j];
-        // handle primitive data
-        std::vector<glm::vec3> positions{};
-        std::vector<glm::vec3> normals{};
-        std::vector<glm::vec2> uv0{};
-        std::vector<glm::vec2> uv1{};
-        for (auto it = primitive.attributes.begin();
-             it != primitive.attributes.end(); it++) {
-          const std::string &attributeName = it->first;
-          int accessorIndex = it->second;
-          const tinygltf::Accessor &accessor = model.accessors[accessorIndex];
-
-          if (attributeName == "POSITION") {
-
-            if (accessor.componentType != 5126) {
-              throw std::runtime_error("Component type is not float!");
-            }
-
-            auto bufferView = model.bufferViews[accessor.bufferView];
-            auto pointer = byteBuffers[bufferView.buffer].pData +
-                           bufferView.byteOffset + accessor.byteOffset;
-            size_t count = accessor.count;
-
-            while (count--) {
-              glm::vec3 data = *(reinterpret_cast<glm::vec3 *>(pointer));
-              pointer += bufferView.byteStride > 0 ? bufferView.byteStride
-                                                   : sizeof(glm::vec3);
-              positions.push_back(data);
-            }
-          }
-
-          if (attributeName == "NORMAL") {
-
-            if (accessor.componentType != 5126) {
-              throw std::runtime_error("Component type is not float!");
-            }
+        auto position = primitive.attributes.find("POSITION");
+        if (position == primitive.attributes.end()) {
+          throw std::runtime_error("primitive without positions");
+        }
+        size_t count = model.accessors[position->second].count;
 
-            auto bufferView = model.bufferViews[accessor.bufferView];
-            auto pointer = byteBuffers[bufferView.buffer].pData +
-                           bufferView.byteOffset + accessor.byteOffset;
-            size_t count = accessor.count;
+        // all meshes share one vertex and one index buffer, so offsets are
+        // absolute and vertexOffset counts vertices, not bytes
+        gltfPrimitive.vertexOffset = vertices.size();
+        gltfPrimitive.firstVertex = vertices.size();
+        gltfPrimitive.vertexCount = count;
+        gltfPrimitive.materialIndex =
+            primitive.material >= 0 ? primitive.material : 0;
 
-            while (count--) {
-              glm::vec3 data = *(reinterpret_cast<glm::vec3 *>(pointer));
-              pointer += bufferView.byteStride > 0 ? bufferView.byteStride
-                                                   : sizeof(glm::vec3);
-              normals.push_back(data);
-            }
+        // decode every attribute to floats, then encode the interleaved
+        // vertices; attributes the primitive lacks stay zero
+        std::vector<SourceVertex> source(count);
+        for (const auto &[attributeName, accessorIndex] :
+             primitive.attributes) {
+          const tinygltf::Accessor &accessor = model.accessors[accessorIndex];
+          if (accessor.count != count) {
+            throw std::runtime_error("attribute count mismatch");
           }
-
-          if (attributeName == "TEXCOORD_0") {
-            if (accessor.componentType != 5126) {
-              throw std::runtime_error("Component type is not float!");
-            }
-
-            auto bufferView = model.bufferViews[accessor.bufferView];
-            auto pointer = byteBuffers[bufferView.buffer].pData +
-                           bufferView.byteOffset + accessor.byteOffset;
-            size_t count = accessor.count;
-
-            while (count--) {
-              glm::vec2 data = *(reinterpret_cast<glm::vec2 *>(pointer));
-              pointer += bufferView.byteStride > 0 ? bufferView.byteStride
-                                                   : sizeof(glm::vec2);
-              uv0.push_back(data);
-            }
+          if (attributeName == "POSITION") {
+            AccessorDecoder::decodeFloats(model, accessor, 3,
+                                          source[0].position,
+                                          sizeof(SourceVertex));
+          } else if (attributeName == "NORMAL") {
+            AccessorDecoder::decodeFloats(model, accessor, 3, source[0].normal,
+                                          sizeof(SourceVertex));
+          } else if (attributeName == "TEXCOORD_0") {
+            AccessorDecoder::decodeFloats(model, accessor, 2, source[0].uv0,
+                                          sizeof(SourceVertex));
+          } else if (attributeName == "TEXCOORD_1") {
+            AccessorDecoder::decodeFloats(model, accessor, 2, source[0].uv1,
+                                          sizeof(SourceVertex));
           }
         }
-
-        gltfPrimitive.vertexOffset =
-            gltfMesh.vertices.size() * sizeof(glm::vec3);
-        gltfPrimitive.firstVertex = gltfMesh.vertices.size();
-        for (size_t i = 0; i < positions.size(); ++i) {
-          gltfVertex vertex{positions[i],
-                            normals.size() > 0 ? normals[i] : glm::vec3(0.0f),
-                            uv0.size() > 0 ? uv0[i] : glm::vec3(0.0f)};
-          gltfMesh.vertices.push_back(vertex);
+        vertices.resize(vertices.size() + count);
+        for (size_t k = 0; k < count; ++k) {
+          gltfVertex &vertex = vertices[gltfPrimitive.firstVertex + k];
+          gltfVertex::PositionLayout::encode(VertexSemantic::Position,
+                                             source[k].position,
+                                             vertex.position, quantization);
+          gltfVertex::AttributeLayout::encode(VertexSemantic::Normal,
+                                              source[k].normal,
+                                              vertex.attributes, quantization);
+          gltfVertex::AttributeLayout::encode(VertexSemantic::Uv0,
+                                              source[k].uv0, vertex.attributes,
+                                              quantization);
+          gltfVertex::AttributeLayout::encode(VertexSemantic::Uv1,
+                                              source[k].uv1, vertex.attributes,
+                                              quantization);
         }
 
         if (primitive.indices >= 0) {
           this->hasIndices = true;
           const tinygltf::Accessor &accessor =
               model.accessors[primitive.indices];
-          auto bufferView = model.bufferViews[accessor.bufferView];
-          auto pointer = byteBuffers[bufferView.buffer].pData +
-                         bufferView.byteOffset + accessor.byteOffset;
-          size_t count = accessor.count;
-
-          gltfPrimitive.indexCount = count;
-          gltfPrimitive.firstIndex = gltfMesh.indices.size();
-
-          while (count--) {
-            // ushort
-            if (accessor.componentType == 5123) {
-              auto data = *(reinterpret_cast<uint16_t *>(pointer));
-              pointer += bufferView.byteStride > 0 ? bufferView.byteStride
-                                                   : sizeof(uint16_t);
-              gltfMesh.indices.push_back(data);
-            }
-
-            // uint
-            if (accessor.componentType == 5125) {
-              auto data = *(reinterpret_cast<uint32_t *>(pointer));
-              pointer += bufferView.byteStride > 0 ? bufferView.byteStride
-                                                   : sizeof(uint32_t);
-              gltfMesh.indices.push_back(data);
-            }
+          gltfPrimitive.indexCount = accessor.count;
+          gltfPrimitive.firstIndex = indices.size();
+          indices.resize(indices.size() + accessor.count);
+          AccessorDecoder::decodeIndices(model, accessor,
+                                         indices.data() +
+                                             gltfPrimitive.firstIndex);
+          // the optimizer and the meshlet builder index per vertex tables
+          if (std::any_of(indices.begin() + gltfPrimitive.firstIndex,
+                          indices.end(),
+                          [count](uint32_t index) { return index >= count; })) {
+            throw std::runtime_error("primitive index out of range");
           }
         }
 
+        gltfPrimitive.depthFirstIndex = gltfPrimitive.firstIndex;
+        gltfPrimitive.depthIndexCount = gltfPrimitive.indexCount;
+        computeBounds(gltfPrimitive, source);
+        if (optimizeMeshes && primitive.mode == TINYGLTF_MODE_TRIANGLES) {
+          optimizePrimitive(gltfPrimitive, source, quantization, statsBefore,
+                            statsAfter);
+        } else if (primitive.mode == TINYGLTF_MODE_TRIANGLES &&
+                   primitive.indices >= 0) {
+          buildMeshlets(gltfPrimitive, quantization);
+        }
+
         gltfMesh.primitives.push_back(gltfPrimitive);
+        cookedData.primitives.push_back(
+            {gltfPrimitive.firstIndex, gltfPrimitive.indexCount,
+             gltfPrimitive.firstVertex, gltfPrimitive.vertexCount,
+             gltfPrimitive.vertexOffset, gltfPrimitive.materialIndex,
+             getIndexSize(gltfPrimitive), gltfPrimitive.depthFirstIndex,
+             gltfPrimitive.depthIndexCount, gltfPrimitive.lodCount});
+        CookedPrimitive &cooked = cookedData.primitives.back();
+        std::copy(std::begin(gltfPrimitive.lods), std::end(gltfPrimitive.lods),
+                  cooked.lods);
+        std::copy(std::begin(gltfPrimitive.boundsCenter),
+                  std::end(gltfPrimitive.boundsCenter), cooked.boundsCenter);
+        cooked.boundsRadius = gltfPrimitive.boundsRadius;
+        cooked.firstMeshlet = gltfPrimitive.firstMeshlet;
+        cooked.meshletCount = gltfPrimitive.meshletCount;
       }
       this->meshes.push_back(gltfMesh);
+      cookedData.meshes.push_back(cookedMesh);
     }
 
-    // clean buffers
-    for (auto &byteBuffer : byteBuffers) {
-      delete[] byteBuffer.pData;
+    // node hierarchy, parents are resolved from the children lists
+    nodes.resize(model.nodes.size());
+    for (size_t i = 0; i < model.nodes.size(); ++i) {
+      const tinygltf::Node &node = model.nodes[i];
+      glm::mat4 matrix = glm::identity<glm::mat4>();
+      if (node.matrix.size() == 16) {
+        for (int k = 0; k < 16; ++k) {
+          glm::value_ptr(matrix)[k] = static_cast<float>(node.matrix[k]);
+        }
+      } else {
+        glm::mat4 translation = glm::identity<glm::mat4>();
+        glm::mat4 rotation = glm::identity<glm::mat4>();
+        glm::mat4 scale = glm::identity<glm::mat4>();
+        if (node.translation.size() == 3) {
+          translation = glm::translate(
+              translation, glm::vec3(glm::make_vec3(node.translation.data())));
+        }
+        if (node.rotation.size() == 4) {
+          glm::quat q = glm::make_quat(node.rotation.data());
+          rotation = glm::mat4(q);
+        }
+        if (node.scale.size() == 3) {
+          scale = glm::scale(scale, glm::vec3(glm::make_vec3(node.scale.data())));
+        }
+        matrix = translation * rotation * scale;
+      }
+      memcpy(nodes[i].matrix, glm::value_ptr(matrix), sizeof(nodes[i].matrix));
+      nodes[i].mesh = node.mesh;
+      nodes[i].parent = -1;
+      nodes[i].impostorGroup = -1;
+    }
+    for (size_t i = 0; i < model.nodes.size(); ++i) {
+      for (int child : model.nodes[i].children) {
+        nodes[child].parent = static_cast<int32_t>(i);
+      }
+    }
+    for (size_t i = 0; i < model.nodes.size(); ++i) {
+      importNodeInstances(model, model.nodes[i], nodes[i]);
+    }
+    if (impostors) {
+      ImpostorBaker::Result baked = ImpostorBaker::bake(model);
+      for (size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].impostorGroup = baked.nodeGroups[i];
+      }
+      for (const auto &group : baked.groups) {
+        CookedImpostorGroup cooked{};
+        std::copy(std::begin(group.center), std::end(group.center),
+                  cooked.center);
+        cooked.radius = group.radius;
+        m_impostorGroups.push_back(cooked);
+      }
+      m_impostorTexels = std::move(baked.texels);
+      std::cout << filePath << ": " << m_impostorGroups.size()
+                << " impostor groups baked" << std::endl;
+    }
+
+    // materials
+    for (const auto &material : model.materials) {
+      const auto &pbr = material.pbrMetallicRoughness;
+      CookedMaterial cookedMaterial{};
+      for (size_t k = 0; k < 4 && k < pbr.baseColorFactor.size(); ++k) {
+        cookedMaterial.baseColorFactor[k] =
+            static_cast<float>(pbr.baseColorFactor[k]);
+      }
+      for (size_t k = 0; k < 3 && k < material.emissiveFactor.size(); ++k) {
+        cookedMaterial.emissiveFactor[k] =
+            static_cast<float>(material.emissiveFactor[k]);
+      }
+      cookedMaterial.metallicFactor = static_cast<float>(pbr.metallicFactor);
+      cookedMaterial.roughnessFactor = static_cast<float>(pbr.roughnessFactor);
+      cookedMaterial.alphaCutoff = static_cast<float>(material.alphaCutoff);
+      cookedMaterial.alphaMode = material.alphaMode == "MASK"    ? 1
+                                 : material.alphaMode == "BLEND" ? 2
+                                                                 : 0;
+      cookedMaterial.baseColorTexture = pbr.baseColorTexture.index;
+      cookedMaterial.metallicRoughnessTexture =
+          pbr.metallicRoughnessTexture.index;
+      cookedMaterial.normalTexture = material.normalTexture.index;
+      cookedMaterial.occlusionTexture = material.occlusionTexture.index;
+      cookedMaterial.emissiveTexture = material.emissiveTexture.index;
+      cookedMaterial.doubleSided = material.doubleSided ? 1 : 0;
+      materials.push_back(cookedMaterial);
     }
+    // the texture streamer decodes the image files itself; embedded images
+    // are left out
+    for (const auto &texture : model.textures) {
+      std::string image;
+      if (texture.source >= 0 &&
+          static_cast<size_t>(texture.source) < model.images.size()) {
+        const std::string &uri = model.images[texture.source].uri;
+        if (!uri.empty() && uri.rfind("data:", 0) != 0) {
+          tinygltf::URIDecode(uri, &image, nullptr);
+        }
+      }
+      cookedData.textureImages.push_back(image);
+    }
+
+    cookedData.nodes = nodes;
+    cookedData.nodeInstances = nodeInstances;
+    cookedData.batchMembers = batchMembers;
+    cookedData.materials = materials;
+    cookedData.meshStats = {statsBefore.acmr(), statsAfter.acmr(),
+                            statsBefore.atvr(), statsAfter.atvr()};
+    splitVertexStreams();
   }
 
-  void AllocateBuffersAndUpload(BufferPool *bufferPool,
-                                ResourceUploadHeap *resourceUploadHeap,
-                                uint32_t queueFamilyIndex) {
-    m_bufferPool = bufferPool;
-    // vertex buffer creation and upload data
-    {
-      // Calc total size of vertex buffer
-      vk::DeviceSize vertexBufferSize = 0;
-      for (auto &mesh : meshes) {
-        vertexBufferSize += sizeof(gltfVertex) * mesh.vertices.size();
+  // whole vertices to the two streams the buffer holds, same total size
+  void splitVertexStreams() {
+    constexpr size_t positionStride = gltfVertex::PositionLayout::kStride;
+    constexpr size_t attributeStride = gltfVertex::AttributeLayout::kStride;
+    vertexStreams.resize(vertices.size() * sizeof(gltfVertex));
+    uint8_t *positions = vertexStreams.data();
+    uint8_t *attributes = positions + vertices.size() * positionStride;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      memcpy(positions + i * positionStride, vertices[i].position,
+             positionStride);
+      memcpy(attributes + i * attributeStride, vertices[i].attributes,
+             attributeStride);
+    }
+    vertices = {};
+    // the stream offsets derive from it, hashPrimitives needs them already
+    m_vertexSize = vertexStreams.size();
+  }
+
+  // welds and reorders the primitive at the end of the scene arrays, which
+  // may shrink both; unindexed triangles get indices first. Primitives with
+  // fewer than 65536 vertices are packed to 16 bit indices.
+  void optimizePrimitive(Primitive &primitive,
+                         const std::vector<SourceVertex> &source,
+                         const VertexQuantization &quantization,
+                         MeshOptimizer::CacheStats &statsBefore,
+                         MeshOptimizer::CacheStats &statsAfter) {
+    if (primitive.indexCount == UINT32_MAX) {
+      primitive.firstIndex = static_cast<uint32_t>(indices.size());
+      primitive.indexCount = primitive.vertexCount;
+      for (uint32_t i = 0; i < primitive.vertexCount; ++i) {
+        indices.push_back(i);
       }
-      // Allocate Vertex Buffers
-      vk::BufferCreateInfo vertexBufferCreateInfo{
-          {},
-          vertexBufferSize,
-          vk::BufferUsageFlagBits::eVertexBuffer |
-              vk::BufferUsageFlagBits::eTransferDst,
-          vk::SharingMode::eExclusive,
-          1,
-          &queueFamilyIndex,
-          nullptr};
+      hasIndices = true;
+    }
 
-      // memory allocinfo
-      VmaAllocationCreateInfo allocCreateInfo{};
-      allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-      vertexBuffer =
-          bufferPool->allocateMemory(vertexBufferCreateInfo, allocCreateInfo);
+    MeshOptimizer::CacheStats before{};
+    MeshOptimizer::CacheStats after{};
+    size_t vertexCount = MeshOptimizer::optimizeMesh(
+        vertices.data() + primitive.firstVertex, primitive.vertexCount,
+        sizeof(gltfVertex), source[0].position, sizeof(SourceVertex),
+        std::span<uint32_t>(indices.data() + primitive.firstIndex,
+                            primitive.indexCount),
+        &before, &after);
+    statsBefore += before;
+    statsAfter += after;
+    primitive.vertexCount = static_cast<uint32_t>(vertexCount);
+    vertices.resize(primitive.firstVertex + vertexCount);
 
-      uint32_t offset = 0;
-      for (auto &mesh : meshes) {
-        resourceUploadHeap->uploadBufferData(
-            mesh.vertices.data(), mesh.vertices.size() * sizeof(gltfVertex),
-            vertexBuffer.buffer, vertexBuffer.allocation, offset);
-        offset += mesh.vertices.size() * sizeof(gltfVertex);
+    // welding by position alone merges what normal and uv seams split; the
+    // depth order goes right behind the shading one when that saves anything
+    std::vector<uint32_t> depthIndices;
+    MeshOptimizer::generatePositionIndices(
+        std::span<const uint32_t>(indices.data() + primitive.firstIndex,
+                                  primitive.indexCount),
+        vertices.data() + primitive.firstVertex, vertexCount,
+        sizeof(gltfVertex), gltfVertex::PositionLayout::kStride, depthIndices);
+    primitive.depthFirstIndex = primitive.firstIndex;
+    primitive.depthIndexCount = primitive.indexCount;
+    if (MeshOptimizer::analyzeVertexCache(depthIndices, vertexCount)
+            .transformed < after.transformed) {
+      primitive.depthFirstIndex = primitive.firstIndex + primitive.indexCount;
+      primitive.depthIndexCount = static_cast<uint32_t>(depthIndices.size());
+      indices.insert(indices.end(), depthIndices.begin(), depthIndices.end());
+    }
+    buildLods(primitive, quantization);
+    buildMeshlets(primitive, quantization);
+
+    if (vertexCount < 65536) {
+      // pack both orders two per word in place, the write position never
+      // passes the read position; the range stays word aligned for the
+      // decompressor
+      uint32_t wordStart = primitive.firstIndex;
+      uint32_t count = static_cast<uint32_t>(indices.size()) - wordStart;
+      uint8_t *bytes = reinterpret_cast<uint8_t *>(indices.data() + wordStart);
+      for (uint32_t i = 0; i < count; ++i) {
+        uint16_t index = static_cast<uint16_t>(indices[wordStart + i]);
+        memcpy(bytes + size_t(i) * sizeof(uint16_t), &index, sizeof(index));
+      }
+      indices.resize(wordStart + (count + 1) / 2);
+      if (count % 2 != 0) {
+        memset(bytes + size_t(count) * sizeof(uint16_t), 0, sizeof(uint16_t));
+      }
+      primitive.firstIndex = wordStart * 2;
+      primitive.depthFirstIndex =
+          wordStart * 2 + (primitive.depthFirstIndex - wordStart);
+      for (uint32_t lod = 1; lod < primitive.lodCount; ++lod) {
+        CookedLod &range = primitive.lods[lod - 1];
+        range.firstIndex = wordStart * 2 + (range.firstIndex - wordStart);
       }
+      primitive.indexType = vk::IndexType::eUint16;
     }
+  }
 
-    // index buffer creation and upload data
-    if (this->hasIndices) {
-      vk::DeviceSize indexBufferSize = 0;
-      for (auto &mesh : meshes) {
-        indexBufferSize += sizeof(uint32_t) * mesh.indices.size();
+  // Simplified levels behind the primitive's other indices, each aiming at
+  // half the previous index count and simplified from the full mesh so the
+  // errors compare against what the artist made. The chain ends when a
+  // level saves too little or would deviate by more than kLodMaxError of the
+  // primitive's radius.
+  void buildLods(Primitive &primitive, const VertexQuantization &quantization) {
+    std::vector<float> positions = decodePositions(primitive, quantization);
+    std::vector<uint32_t> base(indices.begin() + primitive.firstIndex,
+                               indices.begin() + primitive.firstIndex +
+                                   primitive.indexCount);
+
+    size_t previous = base.size();
+    float previousError = 0.0f;
+    primitive.lodCount = 1;
+    while (primitive.lodCount < kMaxLods) {
+      size_t target = previous / 2 / 3 * 3;
+      if (target < kLodMinIndexCount) {
+        break;
       }
-      // Allocate Vertex Buffers
-      vk::BufferCreateInfo indexBufferCreateInfo{
+      float error = 0.0f;
+      std::vector<uint32_t> lod = MeshOptimizer::simplify(
+          base, positions.data(), 3 * sizeof(float), primitive.vertexCount,
+          target, kLodMaxError * primitive.boundsRadius, &error);
+      if (lod.empty() || lod.size() > previous * kLodMinReduction) {
+        break;
+      }
+      MeshOptimizer::optimizeVertexCache(lod, primitive.vertexCount);
+      previousError = std::max(error, previousError);
+      primitive.lods[primitive.lodCount - 1] = {
+          static_cast<uint32_t>(indices.size()),
+          static_cast<uint32_t>(lod.size()), previousError};
+      indices.insert(indices.end(), lod.begin(), lod.end());
+      previous = lod.size();
+      primitive.lodCount++;
+    }
+  }
+
+  // Culling clusters of the full mesh, in its 32 bit indices; runs before
+  // they are packed. Bounds come from the quantized positions, what the gpu
+  // actually draws.
+  void buildMeshlets(Primitive &primitive,
+                     const VertexQuantization &quantization) {
+    std::vector<MeshOptimizer::Meshlet> meshlets;
+    MeshOptimizer::buildMeshlets(
+        std::span<const uint32_t>(indices.data() + primitive.firstIndex,
+                                  primitive.indexCount),
+        primitive.vertexCount, meshlets, m_meshletVertices, m_meshletTriangles);
+    std::vector<float> positions = decodePositions(primitive, quantization);
+    primitive.firstMeshlet = static_cast<uint32_t>(m_meshlets.size());
+    primitive.meshletCount = static_cast<uint32_t>(meshlets.size());
+    for (const auto &meshlet : meshlets) {
+      MeshOptimizer::MeshletBounds bounds = MeshOptimizer::computeMeshletBounds(
+          meshlet, m_meshletVertices, m_meshletTriangles, positions.data(),
+          3 * sizeof(float));
+      CookedMeshlet cooked{meshlet.vertexOffset, meshlet.triangleOffset,
+                           meshlet.vertexCount, meshlet.triangleCount};
+      std::copy(std::begin(bounds.center), std::end(bounds.center),
+                cooked.center);
+      cooked.radius = bounds.radius;
+      std::copy(std::begin(bounds.coneApex), std::end(bounds.coneApex),
+                cooked.coneApex);
+      cooked.coneCutoff = bounds.coneCutoff;
+      std::copy(std::begin(bounds.coneAxis), std::end(bounds.coneAxis),
+                cooked.coneAxis);
+      cooked.baseVertex = primitive.vertexOffset;
+      m_meshlets.push_back(cooked);
+    }
+  }
+
+  // the meshlets of each placed mesh, contiguous since they are built
+  // primitive after primitive; needs the transforms and the cpu copy of the
+  // meshlets
+  void buildMeshletRanges() {
+    m_meshletRanges.clear();
+    for (const auto &mesh : meshes) {
+      MeshletRange range{mesh.firstTransform, mesh.transformCount, 0, 0, 0};
+      uint32_t end = 0;
+      for (const auto &primitive : mesh.primitives) {
+        if (primitive.meshletCount == 0) {
+          continue;
+        }
+        range.firstMeshlet = end == 0
+                                 ? primitive.firstMeshlet
+                                 : std::min(range.firstMeshlet,
+                                            primitive.firstMeshlet);
+        end = std::max(end, primitive.firstMeshlet + primitive.meshletCount);
+        for (uint32_t i = 0; i < primitive.meshletCount; ++i) {
+          range.indexCount +=
+              m_meshlets[primitive.firstMeshlet + i].triangleCount * 3;
+        }
+      }
+      range.meshletCount = end - range.firstMeshlet;
+      if (range.meshletCount > 0 && range.transformCount > 0) {
+        m_meshletRanges.push_back(range);
+      }
+    }
+  }
+
+  // the primitive's quantized positions back to floats, three per vertex
+  std::vector<float>
+  decodePositions(const Primitive &primitive,
+                  const VertexQuantization &quantization) const {
+    std::vector<float> positions(size_t(primitive.vertexCount) * 3);
+    for (uint32_t i = 0; i < primitive.vertexCount; ++i) {
+      uint16_t quantized[4];
+      memcpy(quantized, vertices[primitive.firstVertex + i].position,
+             sizeof(quantized));
+      for (int k = 0; k < 3; ++k) {
+        positions[size_t(i) * 3 + k] =
+            quantization.positionOffset[k] +
+            float(quantized[k]) / 65535.0f * quantization.positionScale[k];
+      }
+    }
+    return positions;
+  }
+
+  // EXT_mesh_gpu_instancing: the node's mesh is drawn once per element of
+  // its TRANSLATION, ROTATION and SCALE accessors, each of them optional
+  void importNodeInstances(const tinygltf::Model &model,
+                           const tinygltf::Node &node, CookedNode &cooked) {
+    auto extension = node.extensions.find("EXT_mesh_gpu_instancing");
+    if (extension == node.extensions.end() ||
+        !extension->second.Has("attributes")) {
+      return;
+    }
+    const tinygltf::Value &attributes = extension->second.Get("attributes");
+    size_t count = 0;
+    auto decode = [&](const char *name, uint32_t components) {
+      std::vector<float> values;
+      if (!attributes.Has(name)) {
+        return values;
+      }
+      int index = attributes.Get(name).GetNumberAsInt();
+      if (index < 0 || static_cast<size_t>(index) >= model.accessors.size()) {
+        throw std::runtime_error("instancing accessor out of range");
+      }
+      const tinygltf::Accessor &accessor = model.accessors[index];
+      if (count != 0 && accessor.count != count) {
+        throw std::runtime_error("instancing accessors differ in count");
+      }
+      count = accessor.count;
+      values.resize(accessor.count * components);
+      AccessorDecoder::decodeFloats(model, accessor, components, values.data(),
+                                    components * sizeof(float));
+      return values;
+    };
+    std::vector<float> translations = decode("TRANSLATION", 3);
+    std::vector<float> rotations = decode("ROTATION", 4);
+    std::vector<float> scales = decode("SCALE", 3);
+
+    cooked.firstInstance = static_cast<uint32_t>(nodeInstances.size());
+    cooked.instanceCount = static_cast<uint32_t>(count);
+    glm::mat4 identity = glm::identity<glm::mat4>();
+    for (size_t i = 0; i < count; ++i) {
+      glm::mat4 translation =
+          translations.empty()
+              ? identity
+              : glm::translate(identity, glm::make_vec3(&translations[3 * i]));
+      glm::mat4 rotation =
+          rotations.empty() ? identity
+                            : glm::mat4(glm::make_quat(&rotations[4 * i]));
+      glm::mat4 scale =
+          scales.empty() ? identity
+                         : glm::scale(identity, glm::make_vec3(&scales[3 * i]));
+      glm::mat4 matrix = translation * rotation * scale;
+      CookedInstance instance{};
+      memcpy(instance.matrix, glm::value_ptr(matrix), sizeof(instance.matrix));
+      nodeInstances.push_back(instance);
+    }
+  }
+
+  uint32_t countVisibleTransforms(const gltfMesh &mesh) const {
+    uint32_t visible = 0;
+    for (uint32_t t = 0; t < mesh.transformCount; ++t) {
+      visible += m_hiddenTransforms[mesh.firstTransform + t] ? 0 : 1;
+    }
+    return visible;
+  }
+
+  // Places the meshes: every node that carries one adds its world transform
+  // to the transform table, once per EXT_mesh_gpu_instancing copy if it has
+  // any. The table is grouped by mesh, so the nodes sharing a mesh sit next
+  // to each other and draw covers all of them with one instanced draw per
+  // primitive. Scenes without mesh nodes place every mesh once at the
+  // origin. GpuScene culls the same placements one primitive at a time, from
+  // m_instances; those only exist when every primitive is indexed.
+  // Within a mesh the placements are sorted by HLOD group, so hiding a group
+  // leaves few runs to draw.
+  void buildInstances() {
+    m_instances.clear();
+    m_instanceTransforms.clear();
+    m_transformQuantizations.clear();
+    m_transformGroups.clear();
+
+    // parents can follow their children in the table
+    std::vector<glm::mat4> world(nodes.size());
+    std::vector<bool> resolved(nodes.size(), false);
+    std::function<const glm::mat4 &(size_t)> resolve =
+        [&](size_t node) -> const glm::mat4 & {
+      if (!resolved[node]) {
+        resolved[node] = true; // also breaks cycles in broken files
+        world[node] = glm::make_mat4(nodes[node].matrix);
+        int32_t parent = nodes[node].parent;
+        if (parent >= 0 && static_cast<size_t>(parent) < nodes.size()) {
+          world[node] = resolve(parent) * world[node];
+        }
+      }
+      return world[node];
+    };
+    // HLOD group, transform
+    std::vector<std::vector<std::pair<int32_t, glm::mat4>>> placements(
+        meshes.size());
+    bool placed = false;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      const CookedNode &node = nodes[i];
+      if (node.mesh < 0 || static_cast<size_t>(node.mesh) >= meshes.size()) {
+        continue;
+      }
+      placed = true;
+      const glm::mat4 &nodeWorld = resolve(i);
+      if (node.impostorGroup >= 0 &&
+          static_cast<size_t>(node.impostorGroup) >= m_impostorGroups.size()) {
+        throw std::runtime_error("impostor group out of range");
+      }
+      if (node.instanceCount == 0) {
+        placements[node.mesh].emplace_back(node.impostorGroup, nodeWorld);
+        continue;
+      }
+      if (uint64_t(node.firstInstance) + node.instanceCount >
+          nodeInstances.size()) {
+        throw std::runtime_error("node instances out of range");
+      }
+      for (uint32_t k = 0; k < node.instanceCount; ++k) {
+        placements[node.mesh].emplace_back(
+            node.impostorGroup,
+            nodeWorld *
+                glm::make_mat4(nodeInstances[node.firstInstance + k].matrix));
+      }
+    }
+    if (!placed) {
+      for (auto &meshPlacements : placements) {
+        meshPlacements.emplace_back(-1, glm::identity<glm::mat4>());
+      }
+    }
+
+    bool indexed = hasIndices;
+    for (const auto &mesh : meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        indexed = indexed && primitive.indexCount != UINT32_MAX;
+      }
+    }
+    for (size_t m = 0; m < meshes.size(); ++m) {
+      gltfMesh &mesh = meshes[m];
+      std::stable_sort(
+          placements[m].begin(), placements[m].end(),
+          [](const auto &a, const auto &b) { return a.first < b.first; });
+      mesh.firstTransform = static_cast<uint32_t>(m_instanceTransforms.size());
+      mesh.transformCount = static_cast<uint32_t>(placements[m].size());
+      mesh.groupRuns = 1;
+      for (size_t t = 0; t < placements[m].size(); ++t) {
+        if (t > 0 && placements[m][t].first != placements[m][t - 1].first) {
+          mesh.groupRuns++;
+        }
+        m_transformGroups.push_back(placements[m][t].first);
+        m_instanceTransforms.push_back(placements[m][t].second);
+        m_transformQuantizations.push_back(mesh.quantization);
+      }
+      if (!indexed) {
+        continue;
+      }
+      for (uint32_t t = 0; t < mesh.transformCount; ++t) {
+        for (const auto &primitive : mesh.primitives) {
+          GpuInstance instance{};
+          std::copy(std::begin(primitive.boundsCenter),
+                    std::end(primitive.boundsCenter), instance.boundsCenter);
+          instance.boundsRadius = primitive.boundsRadius;
+          instance.transformIndex = mesh.firstTransform + t;
+          instance.indexType = primitive.indexType == vk::IndexType::eUint16;
+          instance.vertexOffset = primitive.vertexOffset;
+          instance.lodCount = primitive.lodCount;
+          instance.clustered = primitive.meshletCount > 0 ? 1 : 0;
+          instance.firstIndex[0] = primitive.firstIndex;
+          instance.indexCount[0] = primitive.indexCount;
+          for (uint32_t lod = 1; lod < primitive.lodCount; ++lod) {
+            instance.firstIndex[lod] = primitive.lods[lod - 1].firstIndex;
+            instance.indexCount[lod] = primitive.lods[lod - 1].indexCount;
+            instance.lodError[lod] = primitive.lods[lod - 1].error;
+          }
+          m_instances.push_back(instance);
+        }
+      }
+    }
+    m_hiddenTransforms.assign(m_instanceTransforms.size(), 0);
+    m_impostorActive.assign(m_impostorGroups.size(), false);
+    m_activeImpostors.clear();
+  }
+
+  // Records the resident primitives in order, each as one instanced draw
+  // over its mesh's transforms; firstInstance is the mesh's first transform,
+  // so gl_InstanceIndex indexes the transform table. With multiDraw every
+  // run of indexed primitives sharing an index type goes out as one
+  // drawIndexedIndirect over commands written to the mapped draw buffer,
+  // otherwise each primitive is its own drawIndexed. region picks the half
+  // of the draw buffer, so draw and drawDepth can both be recorded in a
+  // frame; the buffer is rewritten next time, after the frame has been
+  // waited on.
+  template <typename FullRange>
+  void recordDraws(vk::CommandBuffer cmdBuf, bool skipClustered,
+                   bool multiDraw, uint32_t region, FullRange fullRange) {
+    m_drawCalls = 0;
+    multiDraw = multiDraw && hasIndices;
+    if (multiDraw && !drawCommandBuffer.buffer) {
+      createDrawCommandBuffer();
+    }
+    auto *commands =
+        multiDraw ? static_cast<vk::DrawIndexedIndirectCommand *>(
+                        drawCommandBuffer.allocationInfo.pMappedData) +
+                        region * m_drawCommandRegion
+                  : nullptr;
+    uint32_t written = 0;
+    uint32_t batchStart = 0;
+    auto flush = [&]() {
+      if (written == batchStart) {
+        return;
+      }
+      vk::DeviceSize offset =
+          (region * m_drawCommandRegion + batchStart) *
+          sizeof(vk::DrawIndexedIndirectCommand);
+      cmdBuf.drawIndexedIndirect(drawCommandBuffer.buffer, offset,
+                                 written - batchStart,
+                                 sizeof(vk::DrawIndexedIndirectCommand));
+      ++m_drawCalls;
+      batchStart = written;
+    };
+
+    // 16 and 32 bit primitives share the buffer, rebind only when the type
+    // changes
+    vk::IndexType boundType = vk::IndexType::eUint32;
+    if (hasIndices) {
+      cmdBuf.bindIndexBuffer(indexBuffer.buffer, 0, boundType);
+    }
+    // primitives are uploaded in order, stop at the first one still missing
+    uint32_t remaining = m_residentPrimitives;
+    uint32_t ordinal = 0;
+    for (const auto &mesh : meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        if (remaining == 0) {
+          break;
+        }
+        --remaining;
+        uint32_t lod = getSelectedLod(primitive, ordinal++);
+        if ((skipClustered && primitive.meshletCount > 0) ||
+            mesh.transformCount == 0) {
+          continue;
+        }
+        if (hasIndices && primitive.indexType != boundType) {
+          flush();
+          boundType = primitive.indexType;
+          cmdBuf.bindIndexBuffer(indexBuffer.buffer, 0, boundType);
+        }
+        CookedLod range =
+            lod == 0 ? fullRange(primitive) : primitive.lods[lod - 1];
+        // one instanced draw per run of transforms no impostor replaces
+        uint32_t end = mesh.firstTransform + mesh.transformCount;
+        for (uint32_t first = mesh.firstTransform; first < end;) {
+          if (m_hiddenTransforms[first]) {
+            ++first;
+            continue;
+          }
+          uint32_t last = first + 1;
+          while (last < end && !m_hiddenTransforms[last]) {
+            ++last;
+          }
+          uint32_t count = last - first;
+          if (!hasIndices) {
+            cmdBuf.draw(primitive.vertexCount, count, primitive.firstVertex,
+                        first);
+            ++m_drawCalls;
+          } else if (!multiDraw) {
+            cmdBuf.drawIndexed(range.indexCount, count, range.firstIndex,
+                               primitive.vertexOffset, first);
+            ++m_drawCalls;
+          } else {
+            commands[written++] = vk::DrawIndexedIndirectCommand{
+                range.indexCount, count, range.firstIndex,
+                primitive.vertexOffset, first};
+            if (written - batchStart == kMaxMultiDrawCount) {
+              flush();
+            }
+          }
+          first = last;
+        }
+      }
+    }
+    flush();
+    if (written > 0) {
+      vmaFlushAllocation(m_bufferPool->getAllocator(),
+                         drawCommandBuffer.allocation, 0, VK_WHOLE_SIZE);
+    }
+  }
+
+  // host written commands for recordDraws, one region for draw and one for
+  // drawDepth
+  void createDrawCommandBuffer() {
+    // every primitive may be split into its mesh's group runs
+    m_drawCommandRegion = 0;
+    for (const auto &mesh : meshes) {
+      m_drawCommandRegion +=
+          static_cast<uint32_t>(mesh.primitives.size()) * mesh.groupRuns;
+    }
+    vk::BufferCreateInfo bufferCreateInfo{
+        {},
+        2 * m_drawCommandRegion * sizeof(vk::DrawIndexedIndirectCommand),
+        vk::BufferUsageFlagBits::eIndirectBuffer};
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocCreateInfo.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+        VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    drawCommandBuffer =
+        m_bufferPool->allocateMemory(bufferCreateInfo, allocCreateInfo);
+  }
+
+  void createTableBuffers(BufferPool *bufferPool, uint32_t queueFamilyIndex) {
+    m_meshletCount = static_cast<uint32_t>(m_meshlets.size());
+    m_meshletVertexCount = m_meshletVertices.size();
+    m_meshletTriangleSize = m_meshletTriangles.size();
+    m_instanceCount = static_cast<uint32_t>(m_instances.size());
+    m_transformCount = static_cast<uint32_t>(m_instanceTransforms.size());
+    m_impostorTexelCount = m_impostorTexels.size();
+    m_tablesUploaded = m_meshletCount == 0 && m_instanceCount == 0 &&
+                       m_transformCount == 0 && m_impostorTexelCount == 0;
+    auto create = [&](vk::DeviceSize size) {
+      vk::BufferCreateInfo bufferCreateInfo{
           {},
-          indexBufferSize,
-          vk::BufferUsageFlagBits::eIndexBuffer |
+          size,
+          vk::BufferUsageFlagBits::eStorageBuffer |
               vk::BufferUsageFlagBits::eTransferDst,
           vk::SharingMode::eExclusive,
           1,
           &queueFamilyIndex,
           nullptr};
-
-      // memory allocinfo
       VmaAllocationCreateInfo allocCreateInfo{};
       allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-      indexBuffer =
-          bufferPool->allocateMemory(indexBufferCreateInfo, allocCreateInfo);
+      return bufferPool->allocateMemory(bufferCreateInfo, allocCreateInfo);
+    };
+    if (m_meshletCount > 0) {
+      meshletBuffer = create(m_meshlets.size() * sizeof(CookedMeshlet));
+      meshletVertexBuffer =
+          create(m_meshletVertices.size() * sizeof(uint32_t));
+      meshletTriangleBuffer = create(m_meshletTriangles.size());
+    }
+    if (m_instanceCount > 0) {
+      instanceBuffer = create(m_instances.size() * sizeof(GpuInstance));
+      selectedLodBuffer = create(m_instances.size() * sizeof(uint32_t));
+    }
+    if (m_transformCount > 0) {
+      transformBuffer =
+          create(m_instanceTransforms.size() * sizeof(glm::mat4));
+      quantizationBuffer = create(m_transformQuantizations.size() *
+                                  sizeof(VertexQuantization));
+    }
+    if (m_impostorTexelCount > 0) {
+      impostorTexelBuffer = create(m_impostorTexels.size() * sizeof(uint32_t));
+    }
+  }
 
-      uint32_t offset = 0;
-      for (auto &mesh : meshes) {
-        resourceUploadHeap->uploadBufferData(
-            mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t),
-            indexBuffer.buffer, indexBuffer.allocation, offset);
-        offset += mesh.indices.size() * sizeof(gltfVertex);
-      }
+  // the meshlet and instance tables go in one piece ahead of the geometry;
+  // returns the bytes uploaded
+  vk::DeviceSize uploadTables(ResourceUploadHeap *resourceUploadHeap) {
+    if (m_tablesUploaded) {
+      return 0;
     }
+    vk::DeviceSize uploaded = 0;
+    vk::DeviceSize total = 0;
+    total += uploadRange(resourceUploadHeap, m_meshlets.data(), {},
+                         meshletBuffer, uploaded,
+                         m_meshlets.size() * sizeof(CookedMeshlet),
+                         std::numeric_limits<vk::DeviceSize>::max());
+    uploaded = 0;
+    total += uploadRange(resourceUploadHeap, m_meshletVertices.data(), {},
+                         meshletVertexBuffer, uploaded,
+                         m_meshletVertices.size() * sizeof(uint32_t),
+                         std::numeric_limits<vk::DeviceSize>::max());
+    uploaded = 0;
+    total += uploadRange(resourceUploadHeap, m_meshletTriangles.data(), {},
+                         meshletTriangleBuffer, uploaded,
+                         m_meshletTriangles.size(),
+                         std::numeric_limits<vk::DeviceSize>::max());
+    uploaded = 0;
+    total += uploadRange(resourceUploadHeap, m_instances.data(), {},
+                         instanceBuffer, uploaded,
+                         m_instances.size() * sizeof(GpuInstance),
+                         std::numeric_limits<vk::DeviceSize>::max());
+    // every instance starts at the full mesh
+    std::vector<uint32_t> selectedLods(m_instances.size(), 0);
+    uploaded = 0;
+    total += uploadRange(resourceUploadHeap, selectedLods.data(), {},
+                         selectedLodBuffer, uploaded,
+                         selectedLods.size() * sizeof(uint32_t),
+                         std::numeric_limits<vk::DeviceSize>::max());
+    uploaded = 0;
+    total += uploadRange(resourceUploadHeap, m_instanceTransforms.data(), {},
+                         transformBuffer, uploaded,
+                         m_instanceTransforms.size() * sizeof(glm::mat4),
+                         std::numeric_limits<vk::DeviceSize>::max());
+    uploaded = 0;
+    total += uploadRange(resourceUploadHeap, m_transformQuantizations.data(),
+                         {}, quantizationBuffer, uploaded,
+                         m_transformQuantizations.size() *
+                             sizeof(VertexQuantization),
+                         std::numeric_limits<vk::DeviceSize>::max());
+    uploaded = 0;
+    total += uploadRange(resourceUploadHeap, m_impostorTexels.data(), {},
+                         impostorTexelBuffer, uploaded,
+                         m_impostorTexels.size() * sizeof(uint32_t),
+                         std::numeric_limits<vk::DeviceSize>::max());
+    m_tablesUploaded = true;
+    m_meshlets = {};
+    m_meshletVertices = {};
+    m_meshletTriangles = {};
+    m_impostorTexels = {};
+    // the transforms stay for the LOD selection
+    m_instances = {};
+    return total;
   }
 
-  void draw(vk::CommandBuffer cmdBuf) {
-    vk::Buffer buffers[] = {vertexBuffer.buffer};
-    size_t offsets[] = {0};
-    cmdBuf.bindVertexBuffers(0, buffers, offsets);
-    cmdBuf.bindIndexBuffer(indexBuffer.buffer, 0, vk::IndexType::eUint32);
-    if (hasIndices) {
-      for (auto &mesh : meshes) {
-        for (auto &primitive : mesh.primitives) {
-            cmdBuf.drawIndexed(primitive.indexCount, 1, primitive.firstIndex,
-                             primitive.vertexOffset, 0);
-        }
+  // sphere around the box of the decoded positions
+  static void computeBounds(Primitive &primitive,
+                            const std::vector<SourceVertex> &source) {
+    if (source.empty()) {
+      return;
+    }
+    glm::vec3 lower = glm::make_vec3(source[0].position);
+    glm::vec3 upper = lower;
+    for (const auto &vertex : source) {
+      lower = glm::min(lower, glm::make_vec3(vertex.position));
+      upper = glm::max(upper, glm::make_vec3(vertex.position));
+    }
+    glm::vec3 center = (lower + upper) * 0.5f;
+    float radius = 0.0f;
+    for (const auto &vertex : source) {
+      radius = std::max(radius,
+                        glm::length(glm::make_vec3(vertex.position) - center));
+    }
+    memcpy(primitive.boundsCenter, glm::value_ptr(center),
+           sizeof(primitive.boundsCenter));
+    primitive.boundsRadius = radius;
+  }
+
+  uint32_t getSelectedLod(const Primitive &primitive, uint32_t ordinal) const {
+    return ordinal < m_selectedLods.size()
+               ? std::min(m_selectedLods[ordinal], primitive.lodCount - 1)
+               : 0;
+  }
+
+  // position bounds of one mesh; its quantized positions are relative to
+  // them, so they are known before the first vertex is encoded. Per mesh
+  // rather than per scene, so a small mesh far from the origin keeps its
+  // precision.
+  static VertexQuantization computeQuantization(const tinygltf::Model &model,
+                                                const tinygltf::Mesh &mesh) {
+    float lower[3] = {std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::max()};
+    float upper[3] = {std::numeric_limits<float>::lowest(),
+                      std::numeric_limits<float>::lowest(),
+                      std::numeric_limits<float>::lowest()};
+    std::vector<float> positions;
+    for (const auto &primitive : mesh.primitives) {
+      auto position = primitive.attributes.find("POSITION");
+      if (position == primitive.attributes.end()) {
+        continue;
       }
-    } else {
-      for (auto &mesh : meshes) {
-        for (auto &primitive : mesh.primitives) {
-          cmdBuf.draw(primitive.vertexCount, 1, primitive.firstVertex, 0);
-        }
+      // min and max of quantized accessors are not in model units, decode
+      // instead of trusting them
+      const tinygltf::Accessor &accessor = model.accessors[position->second];
+      positions.assign(accessor.count * 3, 0.0f);
+      AccessorDecoder::decodeFloats(model, accessor, 3, positions.data(),
+                                    3 * sizeof(float));
+      for (size_t k = 0; k < positions.size(); ++k) {
+        lower[k % 3] = std::min(lower[k % 3], positions[k]);
+        upper[k % 3] = std::max(upper[k % 3], positions[k]);
+      }
+    }
+    VertexQuantization quantization{};
+    for (int k = 0; k < 3; ++k) {
+      if (lower[k] <= upper[k]) {
+        quantization.positionOffset[k] = lower[k];
+        quantization.positionScale[k] = upper[k] - lower[k];
       }
     }
+    return quantization;
   }
 
-  void destroy() {
-    // clean mesh data
-    for (auto &mesh : meshes) {
-      mesh.vertices.clear();
-      mesh.indices.clear();
-      mesh.primitives.clear();
+  static void reportMeshStats(const char *filePath,
+                              const CookedMeshStats &stats) {
+    std::cout << filePath << ": ACMR " << stats.acmrBefore << " -> "
+              << stats.acmrAfter << ", ATVR " << stats.atvrBefore << " -> "
+              << stats.atvrAfter << std::endl;
+  }
+
+  static uint32_t getIndexSize(const Primitive &primitive) {
+    return primitive.indexType == vk::IndexType::eUint16 ? sizeof(uint16_t)
+                                                         : sizeof(uint32_t);
+  }
+
+  // byte range of a primitive's indices, all orders and LODs; 16 bit ranges
+  // are padded to whole words
+  static vk::DeviceSize getIndexStart(const Primitive &primitive) {
+    return vk::DeviceSize(primitive.firstIndex) * getIndexSize(primitive);
+  }
+  static vk::DeviceSize getIndexEnd(const Primitive &primitive) {
+    vk::DeviceSize end =
+        std::max(vk::DeviceSize(primitive.firstIndex) + primitive.indexCount,
+                 vk::DeviceSize(primitive.depthFirstIndex) +
+                     primitive.depthIndexCount);
+    for (uint32_t lod = 1; lod < primitive.lodCount; ++lod) {
+      end = std::max(end, vk::DeviceSize(primitive.lods[lod - 1].firstIndex) +
+                              primitive.lods[lod - 1].indexCount);
     }
+    end *= getIndexSize(primitive);
+    return (end + sizeof(uint32_t) - 1) & ~vk::DeviceSize(3);
+  }
 
-    // destroy buffer
-    m_bufferPool->freeBuffer(vertexBuffer);
-    m_bufferPool->freeBuffer(indexBuffer);
+  // the attribute stream starts behind every position, vertexBytes being
+  // the size of both
+  static vk::DeviceSize getAttributeStreamOffset(vk::DeviceSize vertexBytes) {
+    return vertexBytes / sizeof(gltfVertex) *
+           gltfVertex::PositionLayout::kStride;
+  }
+  static vk::DeviceSize getPositionStart(const Primitive &primitive) {
+    return vk::DeviceSize(primitive.firstVertex) *
+           gltfVertex::PositionLayout::kStride;
+  }
+  static vk::DeviceSize getPositionEnd(const Primitive &primitive) {
+    return (vk::DeviceSize(primitive.firstVertex) + primitive.vertexCount) *
+           gltfVertex::PositionLayout::kStride;
+  }
+  vk::DeviceSize getAttributeStart(const Primitive &primitive) const {
+    return getAttributeStreamOffset(m_vertexSize) +
+           vk::DeviceSize(primitive.firstVertex) *
+               gltfVertex::AttributeLayout::kStride;
+  }
+  vk::DeviceSize getAttributeEnd(const Primitive &primitive) const {
+    return getAttributeStreamOffset(m_vertexSize) +
+           (vk::DeviceSize(primitive.firstVertex) + primitive.vertexCount) *
+               gltfVertex::AttributeLayout::kStride;
   }
 
+  void setSourceData() {
+    // cooked geometry stays compressed in the mapping until it is decoded
+    // on the gpu
+    m_vertexData = vertexStreams.data();
+    m_vertexSize = vertexStreams.size();
+    m_indexData = indices.data();
+    m_indexSize = indices.size() * sizeof(uint32_t);
+    m_vertexStream = {};
+    m_indexStream = {};
+    if (m_pCooked) {
+      m_vertexData = nullptr;
+      m_vertexSize = m_pCooked->getVertexSize();
+      m_vertexStream = m_pCooked->getVertexStream();
+      m_indexData = nullptr;
+      m_indexSize = m_pCooked->getIndexSize();
+      m_indexStream = m_pCooked->getIndexStream();
+    }
+  }
 
-  glm::mat4 getModelMatrix() {
-    glm::mat4 identity = glm::identity<glm::mat4>();
-    auto scaleMatrix = glm::scale(identity, glm::vec3(scale));
-    glm::mat4 rotationMatrix = glm::toMat4(this->rotation);
-    glm::mat4 translationMatrix = glm::translate(identity, position);
-    return translationMatrix * rotationMatrix * scaleMatrix;
+  // one hash per primitive over its vertex and index bytes, so a reload can
+  // tell which ranges actually changed. Computed at import and cooked, the
+  // compressed blobs are never decoded on the cpu to hash them.
+  void hashPrimitives() {
+    m_primitiveHashes.clear();
+    for (const auto &mesh : meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        Hash64 hash;
+        vk::DeviceSize positionStart = getPositionStart(primitive);
+        hash.update(vertexStreams.data() + positionStart,
+                    getPositionEnd(primitive) - positionStart);
+        vk::DeviceSize attributeStart = getAttributeStart(primitive);
+        hash.update(vertexStreams.data() + attributeStart,
+                    getAttributeEnd(primitive) - attributeStart);
+        if (hasIndices && primitive.indexCount != UINT32_MAX) {
+          vk::DeviceSize indexStart = getIndexStart(primitive);
+          hash.update(reinterpret_cast<const uint8_t *>(indices.data()) +
+                          indexStart,
+                      getIndexEnd(primitive) - indexStart);
+        }
+        m_primitiveHashes.push_back(hash.digest());
+      }
+    }
   }
 
-  void setScale(float scale) {
-    this->scale = scale;
+  bool sameRanges(const glTFModel &other) const {
+    if (meshes.size() != other.meshes.size() ||
+        getSourceVertexSize() != other.m_vertexSize ||
+        getSourceIndexSize() != other.m_indexSize ||
+        m_meshletVertices.size() != other.m_meshletVertexCount ||
+        m_meshletTriangles.size() != other.m_meshletTriangleSize ||
+        m_instances.size() != other.m_instanceCount ||
+        m_instanceTransforms.size() != other.m_transformCount ||
+        m_impostorTexels.size() != other.m_impostorTexelCount) {
+      return false;
+    }
+    for (size_t i = 0; i < meshes.size(); ++i) {
+      const auto &a = meshes[i].primitives;
+      const auto &b = other.meshes[i].primitives;
+      if (a.size() != b.size()) {
+        return false;
+      }
+      for (size_t j = 0; j < a.size(); ++j) {
+        if (a[j].firstVertex != b[j].firstVertex ||
+            a[j].vertexCount != b[j].vertexCount ||
+            a[j].firstIndex != b[j].firstIndex ||
+            a[j].indexCount != b[j].indexCount ||
+            a[j].indexType != b[j].indexType ||
+            a[j].depthFirstIndex != b[j].depthFirstIndex ||
+            a[j].depthIndexCount != b[j].depthIndexCount ||
+            a[j].lodCount != b[j].lodCount ||
+            a[j].firstMeshlet != b[j].firstMeshlet ||
+            a[j].meshletCount != b[j].meshletCount ||
+            memcmp(a[j].lods, b[j].lods, sizeof(a[j].lods)) != 0 ||
+            a[j].vertexOffset != b[j].vertexOffset) {
+          return false;
+        }
+      }
+    }
+    return true;
   }
 
-  void setRotation(float yaw, float pitch, float roll) {
-    this->rotation = glm::quat(glm::vec3(yaw, pitch, roll));
+  // sizes of the not yet uploaded source data
+  vk::DeviceSize getSourceVertexSize() const {
+    return m_pCooked ? m_pCooked->getVertexSize()
+                     : vertexStreams.size();
+  }
+  vk::DeviceSize getSourceIndexSize() const {
+    return m_pCooked ? m_pCooked->getIndexSize()
+                     : indices.size() * sizeof(uint32_t);
   }
 
-  void rotate(float delta, glm::vec3 axis) {
-    axis = glm::normalize(axis);
-    this->rotation *= glm::quat(cos(delta/2), axis.x * sin(delta/2), axis.y * sin(delta/2), axis.z * sin(delta/2));
+  // the primitive loop of uploadSome
+  vk::DeviceSize uploadPrimitives(ResourceUploadHeap *resourceUploadHeap,
+                                  vk::DeviceSize budget) {
+    vk::DeviceSize uploaded = uploadTables(resourceUploadHeap);
+    uint32_t ordinal = 0;
+    for (auto &mesh : meshes) {
+      for (auto &primitive : mesh.primitives) {
+        if (ordinal++ < m_residentPrimitives) {
+          continue;
+        }
+        vk::DeviceSize positionEnd = getPositionEnd(primitive);
+        vk::DeviceSize attributeEnd = getAttributeEnd(primitive);
+        vk::DeviceSize indexEnd =
+            hasIndices && primitive.indexCount != UINT32_MAX
+                ? getIndexEnd(primitive)
+                : m_uploadedIndexBytes;
+        uploaded += uploadRange(resourceUploadHeap, m_vertexData,
+                                m_vertexStream, vertexBuffer,
+                                m_uploadedPositionEnd, positionEnd,
+                                budget - uploaded);
+        uploaded += uploadRange(resourceUploadHeap, m_vertexData,
+                                m_vertexStream, vertexBuffer,
+                                m_uploadedAttributeEnd, attributeEnd,
+                                budget - uploaded);
+        uploaded += uploadRange(resourceUploadHeap, m_indexData,
+                                m_indexStream, indexBuffer,
+                                m_uploadedIndexBytes, indexEnd,
+                                budget - uploaded);
+        if (m_uploadedPositionEnd < positionEnd ||
+            m_uploadedAttributeEnd < attributeEnd ||
+            m_uploadedIndexBytes < indexEnd) {
+          return uploaded;
+        }
+        ++m_residentPrimitives;
+        if (uploaded >= budget) {
+          return uploaded;
+        }
+      }
+    }
+    return uploaded;
   }
 
+  // copies [uploaded, end) of data to buffer, at most budget bytes; a non
+  // empty stream is decoded into the buffer instead. The budget counts
+  // decoded bytes.
+  vk::DeviceSize uploadRange(ResourceUploadHeap *resourceUploadHeap,
+                             const void *data,
+                             std::span<const uint32_t> stream,
+                             BufferWrapper &buffer, vk::DeviceSize &uploaded,
+                             vk::DeviceSize end, vk::DeviceSize budget) {
+    vk::DeviceSize total = 0;
+    while (uploaded < end && total < budget) {
+      // uploadBufferData takes 32 bit sizes and offsets
+      vk::DeviceSize size = std::min<vk::DeviceSize>(
+          {end - uploaded, budget - total, kMaxUploadChunk});
+      if (!stream.empty()) {
+        // the decoder works in whole words, end is always word aligned
+        size = (size + sizeof(uint32_t) - 1) & ~vk::DeviceSize(3);
+        m_pDecompressor->decode(
+            stream, static_cast<uint32_t>(uploaded / sizeof(uint32_t)),
+            static_cast<uint32_t>((uploaded + size) / sizeof(uint32_t)),
+            buffer);
+      } else {
+        resourceUploadHeap->uploadBufferData(
+            static_cast<const uint8_t *>(data) + uploaded,
+            static_cast<uint32_t>(size), buffer.buffer, buffer.allocation,
+            static_cast<uint32_t>(uploaded));
+      }
+      uploaded += size;
+      total += size;
+    }
+    return total;
+  }
+
+  void resolveTexturePaths(const char *filePath,
+                           const std::vector<std::string> &images) {
+    std::string directory = std::filesystem::path(filePath)
+                                .remove_filename()
+                                .string();
+    m_texturePaths.clear();
+    for (const auto &image : images) {
+      m_texturePaths.push_back(image.empty() ? image : directory + image);
+    }
+  }
+
+  // tables are small and copied out, the blobs stay mapped until upload
+  void loadCooked() {
+    auto cookedPrimitives = m_pCooked->getPrimitives();
+    for (const auto &cookedMesh : m_pCooked->getMeshes()) {
+      gltfMesh gltfMesh{};
+      memcpy(gltfMesh.quantization.positionOffset, cookedMesh.positionOffset,
+             sizeof(cookedMesh.positionOffset));
+      memcpy(gltfMesh.quantization.positionScale, cookedMesh.positionScale,
+             sizeof(cookedMesh.positionScale));
+      for (uint32_t i = 0; i < cookedMesh.primitiveCount; ++i) {
+        const CookedPrimitive &cooked =
+            cookedPrimitives[cookedMesh.firstPrimitive + i];
+        Primitive primitive{};
+        primitive.firstIndex = cooked.firstIndex;
+        primitive.indexCount = cooked.indexCount;
+        primitive.firstVertex = cooked.firstVertex;
+        primitive.vertexCount = cooked.vertexCount;
+        primitive.vertexOffset = cooked.vertexOffset;
+        primitive.materialIndex = cooked.materialIndex;
+        primitive.indexType = cooked.indexSize == sizeof(uint16_t)
+                                  ? vk::IndexType::eUint16
+                                  : vk::IndexType::eUint32;
+        primitive.depthFirstIndex = cooked.depthFirstIndex;
+        primitive.depthIndexCount = cooked.depthIndexCount;
+        primitive.lodCount = cooked.lodCount;
+        std::copy(std::begin(cooked.lods), std::end(cooked.lods),
+                  primitive.lods);
+        std::copy(std::begin(cooked.boundsCenter),
+                  std::end(cooked.boundsCenter), primitive.boundsCenter);
+        primitive.boundsRadius = cooked.boundsRadius;
+        primitive.firstMeshlet = cooked.firstMeshlet;
+        primitive.meshletCount = cooked.meshletCount;
+        gltfMesh.primitives.push_back(primitive);
+        m_primitiveHashes.push_back(cooked.contentHash);
+      }
+      meshes.push_back(gltfMesh);
+    }
+    auto cookedNodes = m_pCooked->getNodes();
+    nodes.assign(cookedNodes.begin(), cookedNodes.end());
+    auto cookedNodeInstances = m_pCooked->getNodeInstances();
+    nodeInstances.assign(cookedNodeInstances.begin(),
+                         cookedNodeInstances.end());
+    auto cookedBatchMembers = m_pCooked->getBatchMembers();
+    batchMembers.assign(cookedBatchMembers.begin(), cookedBatchMembers.end());
+    auto cookedMaterials = m_pCooked->getMaterials();
+    materials.assign(cookedMaterials.begin(), cookedMaterials.end());
+    hasIndices = m_pCooked->getIndexSize() > 0;
+    auto cookedMeshlets = m_pCooked->getMeshlets();
+    m_meshlets.assign(cookedMeshlets.begin(), cookedMeshlets.end());
+    auto cookedMeshletVertices = m_pCooked->getMeshletVertices();
+    m_meshletVertices.assign(cookedMeshletVertices.begin(),
+                             cookedMeshletVertices.end());
+    auto cookedMeshletTriangles = m_pCooked->getMeshletTriangles();
+    m_meshletTriangles.assign(cookedMeshletTriangles.begin(),
+                              cookedMeshletTriangles.end());
+    auto cookedImpostorGroups = m_pCooked->getImpostorGroups();
+    m_impostorGroups.assign(cookedImpostorGroups.begin(),
+                            cookedImpostorGroups.end());
+    auto cookedImpostorTexels = m_pCooked->getImpostorTexels();
+    m_impostorTexels.assign(cookedImpostorTexels.begin(),
+                            cookedImpostorTexels.end());
+    // the blobs are read front to back by the upload
+    m_pCooked->adviseBlobs();
+  }
 
-private:
   std::vector<gltfMesh> meshes{};
-  std::vector<tinygltf::Material> materials{};
-  std::vector<tinygltf::Texture> textures{};
+  std::vector<CookedNode> nodes{};
+  // EXT_mesh_gpu_instancing transforms, see CookedNode::firstInstance
+  std::vector<CookedInstance> nodeInstances{};
+  // which source node each part of a static batch came from
+  std::vector<CookedBatchMember> batchMembers{};
+  std::vector<CookedMaterial> materials{};
+  std::vector<std::string> m_texturePaths;
+  std::vector<uint32_t> m_textureIds;
+  // scene wide geometry, only alive between import and upload; vertices
+  // until the import is done, vertexStreams after
+  std::vector<gltfVertex> vertices{};
+  std::vector<uint8_t> vertexStreams{};
+  std::vector<uint32_t> indices{};
+  std::unique_ptr<CookedScene> m_pCooked;
   bool hasIndices = false;
+  // progressive upload state, see uploadSome
+  static constexpr vk::DeviceSize kMaxUploadChunk = 64 * 1024 * 1024;
+  // LOD generation
+  static constexpr float kLodMaxError = 0.1f;   // of the bounding radius
+  static constexpr float kLodMinReduction = 0.85f;
+  static constexpr size_t kLodMinIndexCount = 3 * 64;
+  // both streams repeat after 24 bytes, three positions or two attribute
+  // sets, so the codec predicts from the same attribute in either
+  static constexpr uint32_t kVertexStreamPeriod =
+      std::lcm(gltfVertex::PositionLayout::kStride,
+               gltfVertex::AttributeLayout::kStride) /
+      sizeof(uint32_t);
+  const void *m_vertexData = nullptr;
+  const void *m_indexData = nullptr;
+  std::span<const uint32_t> m_vertexStream;
+  std::span<const uint32_t> m_indexStream;
+  GpuDecompressor *m_pDecompressor = nullptr;
+  vk::DeviceSize m_vertexSize = 0;
+  vk::DeviceSize m_indexSize = 0;
+  // byte offsets into the vertex buffer, one per stream
+  vk::DeviceSize m_uploadedPositionEnd = 0;
+  vk::DeviceSize m_uploadedAttributeEnd = 0;
+  vk::DeviceSize m_uploadedIndexBytes = 0;
+  uint32_t m_residentPrimitives = 0;
+  bool m_uploadStarted = false;
+  std::vector<uint64_t> m_primitiveHashes;
+  // LOD of every primitive in draw order, kept between frames for the
+  // hysteresis
+  std::vector<uint32_t> m_selectedLods;
+  uint64_t m_drawnTriangles = 0;
+  uint32_t m_drawCalls = 0;
+  // the minimum maxDrawIndirectCount of devices with multiDrawIndirect
+  static constexpr uint32_t kMaxMultiDrawCount = 65535;
+  BufferWrapper drawCommandBuffer{};
+  // commands per region of drawCommandBuffer, draws first, then depth
+  uint32_t m_drawCommandRegion = 0;
   BufferWrapper vertexBuffer;
   BufferWrapper indexBuffer;
+  // meshlet tables, the cpu side only until uploaded
+  std::vector<CookedMeshlet> m_meshlets;
+  std::vector<uint32_t> m_meshletVertices;
+  std::vector<uint8_t> m_meshletTriangles;
+  uint32_t m_meshletCount = 0;
+  std::vector<MeshletRange> m_meshletRanges;
+  size_t m_meshletVertexCount = 0;
+  size_t m_meshletTriangleSize = 0;
+  BufferWrapper meshletBuffer;
+  BufferWrapper meshletVertexBuffer;
+  BufferWrapper meshletTriangleBuffer;
+  // instance tables, likewise; the transforms are kept on the cpu as well
+  std::vector<GpuInstance> m_instances;
+  std::vector<glm::mat4> m_instanceTransforms;
+  std::vector<VertexQuantization> m_transformQuantizations;
+  uint32_t m_instanceCount = 0;
+  uint32_t m_transformCount = 0;
+  BufferWrapper instanceBuffer;
+  BufferWrapper selectedLodBuffer;
+  BufferWrapper transformBuffer;
+  BufferWrapper quantizationBuffer;
+  // HLOD: the group of every transform, -1 for none, and which transforms
+  // the active impostors hide this frame
+  std::vector<int32_t> m_transformGroups;
+  std::vector<uint32_t> m_hiddenTransforms;
+  std::vector<bool> m_impostorActive;
+  std::vector<uint32_t> m_activeImpostors;
+  // the view atlases, cpu side only until uploaded; the groups stay
+  std::vector<CookedImpostorGroup> m_impostorGroups;
+  std::vector<uint32_t> m_impostorTexels;
+  size_t m_impostorTexelCount = 0;
+  BufferWrapper impostorTexelBuffer;
+  bool m_tablesUploaded = false;
   BufferPool *m_bufferPool;
 
   glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
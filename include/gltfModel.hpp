@@ -0,0 +1,287 @@
+#ifndef GLTF_MODEL_HPP
+#define GLTF_MODEL_HPP
+#include "AnimationEvaluator.hpp"
+#include "ResourceUploadHeap.hpp"
+#include "TransformHierarchy.hpp"
+#include "VkBufferPool.hpp"
+#include "VkCommandBuffers.hpp"
+#include "VkContext.hpp"
+#include "vulkan/vulkan.hpp"
+#include <cfloat>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <string>
+#include <tiny_gltf.h>
+#include <vector>
+
+namespace hiddenpiggy {
+
+// full featured gltf scene (node hierarchy, pbr materials, skins and
+// animations); kept in its own namespace so it does not clash with the light
+// weight glTFModel in glTFScene.hpp
+namespace vkglTF {
+
+constexpr uint32_t MAX_NUM_JOINTS = 128u;
+
+struct Node;
+
+struct BoundingBox {
+  glm::vec3 min;
+  glm::vec3 max;
+  bool valid = false;
+  BoundingBox();
+  BoundingBox(glm::vec3 min, glm::vec3 max);
+  BoundingBox getAABB(glm::mat4 m);
+};
+
+struct TextureSampler {
+  vk::Filter magFilter;
+  vk::Filter minFilter;
+  vk::SamplerAddressMode addressModeU;
+  vk::SamplerAddressMode addressModeV;
+  vk::SamplerAddressMode addressModeW;
+};
+
+struct Texture {
+  VkContext *context = nullptr;
+  VkCommandBuffers *commandBuffers = nullptr;
+  BufferPool *bufferPool = nullptr;
+  VmaAllocator allocator = VK_NULL_HANDLE;
+
+  vk::Image image;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  VmaAllocationInfo allocationInfo{};
+  vk::ImageLayout imageLayout;
+  vk::ImageView view;
+  vk::Sampler sampler;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipLevels = 0;
+  uint32_t layerCount = 1;
+  vk::DescriptorImageInfo descriptor;
+
+  void updateDescriptor();
+  void setContext(VkContext *context);
+  void setCommandBuffers(VkCommandBuffers *commandBuffers);
+  void setAllocator(VmaAllocator allocator);
+  void setBufferPool(BufferPool *pBufferPool);
+  void destroy();
+  void fromglTFImage(tinygltf::Image &gltfimage, TextureSampler textureSampler,
+                     vk::Queue copyQueue,
+                     ResourceUploadHeap *resourceUploadHeap);
+};
+
+struct Material {
+  enum AlphaMode { ALPHAMODE_OPAQUE, ALPHAMODE_MASK, ALPHAMODE_BLEND };
+  AlphaMode alphaMode = ALPHAMODE_OPAQUE;
+  float alphaCutoff = 1.0f;
+  float metallicFactor = 1.0f;
+  float roughnessFactor = 1.0f;
+  glm::vec4 baseColorFactor = glm::vec4(1.0f);
+  glm::vec4 emissiveFactor = glm::vec4(0.0f);
+  Texture *baseColorTexture = nullptr;
+  Texture *metallicRoughnessTexture = nullptr;
+  Texture *normalTexture = nullptr;
+  Texture *occlusionTexture = nullptr;
+  Texture *emissiveTexture = nullptr;
+  bool doubleSided = false;
+  struct TexCoordSets {
+    uint8_t baseColor = 0;
+    uint8_t metallicRoughness = 0;
+    uint8_t specularGlossiness = 0;
+    uint8_t normal = 0;
+    uint8_t occlusion = 0;
+    uint8_t emissive = 0;
+  } texCoordSets;
+  struct Extension {
+    Texture *specularGlossinessTexture = nullptr;
+    Texture *diffuseTexture = nullptr;
+    glm::vec4 diffuseFactor = glm::vec4(1.0f);
+    glm::vec3 specularFactor = glm::vec3(0.0f);
+  } extension;
+  struct PbrWorkflows {
+    bool metallicRoughness = true;
+    bool specularGlossiness = false;
+  } pbrWorkflows;
+  vk::DescriptorSet descriptorSet;
+};
+
+struct Primitive {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  uint32_t vertexCount;
+  Material &material;
+  bool hasIndices;
+  BoundingBox bb;
+  Primitive(uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount,
+            Material &material);
+  void setBoundingBox(glm::vec3 min, glm::vec3 max);
+};
+
+struct glTFMesh {
+  vk::Device device;
+  std::vector<Primitive *> primitives;
+  BoundingBox bb;
+  BoundingBox aabb;
+  struct UniformBuffer {
+    vk::Buffer buffer;
+    vk::DeviceMemory memory;
+    vk::DescriptorBufferInfo descriptor;
+    vk::DescriptorSet descriptorSet;
+    void *mapped = nullptr;
+  } uniformBuffer;
+  struct UniformBlock {
+    glm::mat4 matrix;
+    glm::mat4 jointMatrix[MAX_NUM_JOINTS]{};
+    float jointcount{0};
+  } uniformBlock;
+  BufferPool *bufferPool = nullptr;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  VmaAllocationInfo allocationInfo{};
+
+  glTFMesh(VkContext *context, BufferPool *bufferPool, glm::mat4 matrix);
+  ~glTFMesh();
+  void setBoundingBox(glm::vec3 min, glm::vec3 max);
+};
+
+struct Skin {
+  std::string name;
+  Node *skeletonRoot = nullptr;
+  std::vector<glm::mat4> inverseBindMatrices;
+  std::vector<Node *> joints;
+};
+
+// the local transform lives in the model's TransformHierarchy, under the
+// node's index
+struct Node {
+  Node *parent = nullptr;
+  uint32_t index;
+  std::vector<Node *> children;
+  std::string name;
+  glTFMesh *mesh = nullptr;
+  Skin *skin = nullptr;
+  int32_t skinIndex = -1;
+  TransformHierarchy *transforms = nullptr;
+  BoundingBox bvh;
+  BoundingBox aabb;
+  // world matrix as of the last TransformHierarchy::update
+  const glm::mat4 &getMatrix() const;
+  // writes the world matrix, and the joint matrices of a skinned mesh, to
+  // the mesh's uniform buffer
+  void update();
+  ~Node();
+};
+
+struct Vertex {
+  glm::vec3 pos;
+  glm::vec3 normal;
+  glm::vec2 uv0;
+  glm::vec2 uv1;
+  glm::vec4 joint0;
+  glm::vec4 weight0;
+  glm::vec4 color;
+};
+
+class glTFModel {
+public:
+  vk::Device device;
+  VkContext *context = nullptr;
+  BufferPool *bufferPool = nullptr;
+  VkCommandBuffers *commandBuffers = nullptr;
+  ResourceUploadHeap *resourceUploadHeap = nullptr;
+
+  struct Vertices {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory;
+    VmaAllocation bufferAllocation;
+    VmaAllocationInfo bufferAllocationInfo;
+  } vertices;
+  struct Indices {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory;
+    VmaAllocation bufferAllocation;
+    VmaAllocationInfo bufferAllocationInfo;
+  } indices;
+
+  glm::mat4 aabb;
+
+  std::vector<Node *> nodes;
+  std::vector<Node *> linearNodes;
+  // by glTF node index, nullptr for nodes outside the scene
+  std::vector<Node *> nodeTable;
+  TransformHierarchy transforms;
+
+  std::vector<Skin *> skins;
+
+  std::vector<Texture> textures;
+  std::vector<TextureSampler> textureSamplers;
+  std::vector<Material> materials;
+  // clips of the file and the state of the one updateAnimation plays
+  AnimationLibrary animationLibrary;
+  AnimationPlayer animationPlayer;
+  std::vector<std::string> extensions;
+
+  struct Dimensions {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+  } dimensions;
+
+  // output range of one primitive instance, fixed by the serial pass so the
+  // decode jobs write to disjoint parts of the shared arrays
+  struct PrimitiveRange {
+    const tinygltf::Primitive *primitive = nullptr;
+    uint32_t vertexStart = 0;
+    uint32_t vertexCount = 0;
+    uint32_t indexStart = 0;
+    uint32_t indexCount = 0;
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+  };
+
+  struct LoaderInfo {
+    uint32_t *indexBuffer = nullptr;
+    Vertex *vertexBuffer = nullptr;
+    // filled by getNodeProps in the order loadNode visits the primitives
+    std::vector<PrimitiveRange> primitives;
+    size_t primitivePos = 0;
+  };
+
+  void destroy(vk::Device device);
+  void loadNode(Node *parent, const tinygltf::Node &node, uint32_t nodeIndex,
+                const tinygltf::Model &model, LoaderInfo &loaderInfo,
+                float globalscale);
+  void getNodeProps(const tinygltf::Node &node, const tinygltf::Model &model,
+                    LoaderInfo &loaderInfo);
+  static void loadPrimitive(const tinygltf::Model &model,
+                            PrimitiveRange &range, LoaderInfo &loaderInfo);
+  static void decodeImage(tinygltf::Image &image);
+  void loadTransforms(const tinygltf::Model &model);
+  void loadSkins(tinygltf::Model &gltfModel);
+  void loadTextures(tinygltf::Model &gltfModel, VkContext *context,
+                    VkCommandBuffers *commandBuffers, BufferPool *bufferPool,
+                    ResourceUploadHeap *resourceUploadHeap,
+                    vk::Queue transferQueue);
+  vk::SamplerAddressMode getVkWrapMode(int32_t wrapMode);
+  vk::Filter getVkFilterMode(int32_t filterMode);
+  void loadTextureSamplers(tinygltf::Model &gltfModel);
+  void loadMaterials(tinygltf::Model &gltfModel);
+  void loadAnimations(tinygltf::Model &gltfModel);
+  void loadFromFile(std::string filename, BufferPool *bufferPool,
+                    VkContext *context, ResourceUploadHeap *resourceUploadHeap,
+                    VkCommandBuffers *commandBuffers, VkQueue transferQueue,
+                    float scale = 1.0f);
+  void drawNode(Node *node, VkCommandBuffer commandBuffer);
+  void draw(vk::CommandBuffer commandBuffer);
+  void calculateBoundingBox(Node *node, Node *parent);
+  void getSceneDimensions();
+  void updateAnimation(uint32_t index, float time);
+  // brings world matrices up to date and rewrites the uniforms of the
+  // meshes that moved
+  void updateNodes();
+  Node *nodeFromIndex(uint32_t index);
+};
+} // namespace vkglTF
+} // namespace hiddenpiggy
+#endif
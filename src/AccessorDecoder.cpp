@@ -0,0 +1,342 @@
+#include "AccessorDecoder.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hiddenpiggy {
+namespace AccessorDecoder {
+
+namespace {
+
+template <typename T> float normalizeScale() {
+  return 1.0f / static_cast<float>(std::numeric_limits<T>::max());
+}
+
+// generic per-component conversion, used for 32 bit integers and as the
+// fallback when sse2 is unavailable
+template <typename T>
+void convertScalar(const uint8_t *src, size_t srcStride, uint8_t *dst,
+                   size_t dstStride, size_t count, uint32_t components,
+                   bool normalized) {
+  float scale = normalized ? normalizeScale<T>() : 1.0f;
+  for (size_t i = 0; i < count; ++i) {
+    float values[4];
+    for (uint32_t c = 0; c < components; ++c) {
+      T value;
+      memcpy(&value, src + c * sizeof(T), sizeof(T));
+      values[c] = static_cast<float>(value) * scale;
+      if (normalized && std::is_signed_v<T>) {
+        values[c] = std::max(values[c], -1.0f);
+      }
+    }
+    memcpy(dst, values, components * sizeof(float));
+    src += srcStride;
+    dst += dstStride;
+  }
+}
+
+#if defined(__SSE2__)
+// eight 16 bit lanes to two vectors of four 32 bit lanes
+template <bool Signed> void widen16(__m128i v, __m128i *out) {
+  if constexpr (Signed) {
+    out[0] = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    out[1] = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+  } else {
+    const __m128i zero = _mm_setzero_si128();
+    out[0] = _mm_unpacklo_epi16(v, zero);
+    out[1] = _mm_unpackhi_epi16(v, zero);
+  }
+}
+
+// four elements of four components of T to one 32 bit vector each
+template <typename T> void widenBlock(const uint8_t *block, __m128i *out) {
+  constexpr bool kSigned = std::is_signed_v<T>;
+  if constexpr (sizeof(T) == 1) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+    __m128i low, high;
+    if constexpr (kSigned) {
+      low = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+      high = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+    } else {
+      const __m128i zero = _mm_setzero_si128();
+      low = _mm_unpacklo_epi8(v, zero);
+      high = _mm_unpackhi_epi8(v, zero);
+    }
+    widen16<kSigned>(low, out);
+    widen16<kSigned>(high, out + 2);
+  } else {
+    widen16<kSigned>(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(block)), out);
+    widen16<kSigned>(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16)),
+        out + 2);
+  }
+}
+
+// widens 8 or 16 bit components to floats four elements per step. Elements
+// of four components at a stride of four components (rgba8, joints) are
+// loaded straight from the source; anything else is gathered into a block
+// with the missing components zeroed first, touching only the element's
+// own bytes since the last one may end the buffer.
+template <typename T>
+void convertSmallInt(const uint8_t *src, size_t srcStride, uint8_t *dst,
+                     size_t dstStride, size_t count, uint32_t components,
+                     bool normalized) {
+  constexpr size_t kLaneBytes = 4 * sizeof(T);
+  const __m128 scale = _mm_set1_ps(normalized ? normalizeScale<T>() : 1.0f);
+  const __m128 minusOne = _mm_set1_ps(-1.0f);
+  const size_t elementSize = components * sizeof(T);
+  const bool packed = srcStride == kLaneBytes;
+  alignas(16) uint8_t staging[4 * kLaneBytes];
+  for (size_t i = 0; i < count; i += 4) {
+    size_t n = std::min<size_t>(4, count - i);
+    const uint8_t *block = src + i * srcStride;
+    // a packed block that holds the last element could read its padding
+    if (!packed || i + 4 >= count) {
+      memset(staging, 0, sizeof(staging));
+      for (size_t e = 0; e < n; ++e) {
+        memcpy(staging + e * kLaneBytes, block + e * srcStride, elementSize);
+      }
+      block = staging;
+    }
+
+    __m128i widened[4];
+    widenBlock<T>(block, widened);
+    for (size_t e = 0; e < n; ++e) {
+      __m128 floats = _mm_mul_ps(_mm_cvtepi32_ps(widened[e]), scale);
+      if (normalized && std::is_signed_v<T>) {
+        floats = _mm_max_ps(floats, minusOne);
+      }
+      float values[4];
+      _mm_storeu_ps(values, floats);
+      memcpy(dst + (i + e) * dstStride, values, components * sizeof(float));
+    }
+  }
+}
+#else
+template <typename T>
+void convertSmallInt(const uint8_t *src, size_t srcStride, uint8_t *dst,
+                     size_t dstStride, size_t count, uint32_t components,
+                     bool normalized) {
+  convertScalar<T>(src, srcStride, dst, dstStride, count, components,
+                   normalized);
+}
+#endif
+
+void convertFloats(const uint8_t *src, size_t srcStride, uint8_t *dst,
+                   size_t dstStride, size_t count, uint32_t components) {
+  const size_t elementSize = components * sizeof(float);
+  // tightly packed on both sides, one copy for the whole accessor
+  if (srcStride == elementSize && dstStride == elementSize) {
+    memcpy(dst, src, count * elementSize);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(dst, src, elementSize);
+    src += srcStride;
+    dst += dstStride;
+  }
+}
+
+void convert(int componentType, const uint8_t *src, size_t srcStride,
+             uint8_t *dst, size_t dstStride, size_t count, uint32_t components,
+             bool normalized) {
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_FLOAT:
+    convertFloats(src, srcStride, dst, dstStride, count, components);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    convertSmallInt<uint8_t>(src, srcStride, dst, dstStride, count,
+                             components, normalized);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_BYTE:
+    convertSmallInt<int8_t>(src, srcStride, dst, dstStride, count, components,
+                            normalized);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    convertSmallInt<uint16_t>(src, srcStride, dst, dstStride, count,
+                              components, normalized);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_SHORT:
+    convertSmallInt<int16_t>(src, srcStride, dst, dstStride, count,
+                             components, normalized);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    convertScalar<uint32_t>(src, srcStride, dst, dstStride, count, components,
+                            normalized);
+    break;
+  case TINYGLTF_COMPONENT_TYPE_INT:
+    convertScalar<int32_t>(src, srcStride, dst, dstStride, count, components,
+                           normalized);
+    break;
+  default:
+    throw std::runtime_error("unsupported accessor component type");
+  }
+}
+
+// the data of count elements of elementSize bytes, stride apart, at
+// byteOffset into the buffer view; throws unless all of them lie within the
+// view and the view within its buffer
+const uint8_t *viewData(const tinygltf::Model &model, int bufferView,
+                        size_t byteOffset, size_t stride, size_t count,
+                        size_t elementSize) {
+  if (bufferView < 0 ||
+      static_cast<size_t>(bufferView) >= model.bufferViews.size()) {
+    throw std::runtime_error("accessor buffer view out of range");
+  }
+  const tinygltf::BufferView &view = model.bufferViews[bufferView];
+  if (view.buffer < 0 ||
+      static_cast<size_t>(view.buffer) >= model.buffers.size()) {
+    throw std::runtime_error("buffer view buffer out of range");
+  }
+  const std::vector<unsigned char> &data = model.buffers[view.buffer].data;
+  if (view.byteOffset > data.size() ||
+      view.byteLength > data.size() - view.byteOffset) {
+    throw std::runtime_error("buffer view exceeds its buffer");
+  }
+  // overflow safe form of byteOffset + stride * (count - 1) + elementSize
+  // <= byteLength
+  if (count > 0 &&
+      (byteOffset > view.byteLength ||
+       elementSize > view.byteLength - byteOffset ||
+       (count > 1 &&
+        (stride == 0 ||
+         count - 1 > (view.byteLength - byteOffset - elementSize) / stride)))) {
+    throw std::runtime_error("accessor exceeds its buffer view");
+  }
+  return data.data() + view.byteOffset + byteOffset;
+}
+
+uint32_t readIndex(const uint8_t *src, int componentType, size_t i) {
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return src[i];
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+    uint16_t value;
+    memcpy(&value, src + i * sizeof(value), sizeof(value));
+    return value;
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+    uint32_t value;
+    memcpy(&value, src + i * sizeof(value), sizeof(value));
+    return value;
+  }
+  default:
+    throw std::runtime_error("unsupported index component type");
+  }
+}
+} // namespace
+
+uint32_t getComponentCount(const tinygltf::Accessor &accessor) {
+  return static_cast<uint32_t>(
+      tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type)));
+}
+
+uint32_t getComponentSize(const tinygltf::Accessor &accessor) {
+  return static_cast<uint32_t>(
+      tinygltf::GetComponentSizeInBytes(accessor.componentType));
+}
+
+void decodeFloats(const tinygltf::Model &model,
+                  const tinygltf::Accessor &accessor, uint32_t components,
+                  void *dst, size_t dstStride) {
+  uint32_t accessorComponents = getComponentCount(accessor);
+  uint32_t n = std::min(components, accessorComponents);
+  if (n == 0 || n > 4) {
+    throw std::runtime_error("unsupported accessor type");
+  }
+  if (accessor.normalized &&
+      (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT ||
+       accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT ||
+       accessor.componentType == TINYGLTF_COMPONENT_TYPE_INT)) {
+    throw std::runtime_error("normalized accessor of 32 bit components");
+  }
+  size_t elementSize = accessorComponents * getComponentSize(accessor);
+  auto *out = static_cast<uint8_t *>(dst);
+
+  // a sparse accessor without a buffer view starts out as zeros, which the
+  // caller's value initialized destination already holds
+  if (accessor.bufferView >= 0) {
+    const tinygltf::BufferView *view =
+        static_cast<size_t>(accessor.bufferView) < model.bufferViews.size()
+            ? &model.bufferViews[accessor.bufferView]
+            : nullptr;
+    size_t srcStride =
+        view && view->byteStride > 0 ? view->byteStride : elementSize;
+    convert(accessor.componentType,
+            viewData(model, accessor.bufferView, accessor.byteOffset,
+                     srcStride, accessor.count, elementSize),
+            srcStride, out, dstStride, accessor.count, n,
+            accessor.normalized);
+  }
+
+  const auto &sparse = accessor.sparse;
+  if (sparse.isSparse) {
+    if (sparse.count < 0) {
+      throw std::runtime_error("sparse accessor count out of range");
+    }
+    int indexSize = tinygltf::GetComponentSizeInBytes(
+        static_cast<uint32_t>(sparse.indices.componentType));
+    if (indexSize <= 0) {
+      throw std::runtime_error("unsupported index component type");
+    }
+    const uint8_t *indices =
+        viewData(model, sparse.indices.bufferView, sparse.indices.byteOffset,
+                 indexSize, sparse.count, indexSize);
+    const uint8_t *values =
+        viewData(model, sparse.values.bufferView, sparse.values.byteOffset,
+                 elementSize, sparse.count, elementSize);
+    for (int i = 0; i < sparse.count; ++i) {
+      uint32_t index = readIndex(indices, sparse.indices.componentType, i);
+      if (index >= accessor.count) {
+        throw std::runtime_error("sparse accessor index out of range");
+      }
+      convert(accessor.componentType, values + i * elementSize, elementSize,
+              out + index * dstStride, dstStride, 1, n, accessor.normalized);
+    }
+  }
+}
+
+void decodeIndices(const tinygltf::Model &model,
+                   const tinygltf::Accessor &accessor, uint32_t *dst,
+                   uint32_t baseVertex) {
+  if (accessor.bufferView < 0 ||
+      static_cast<size_t>(accessor.bufferView) >= model.bufferViews.size()) {
+    throw std::runtime_error("index accessor without buffer view");
+  }
+  const tinygltf::BufferView &view = model.bufferViews[accessor.bufferView];
+  size_t componentSize = getComponentSize(accessor);
+  size_t count = accessor.count;
+  const uint8_t *src = viewData(
+      model, accessor.bufferView, accessor.byteOffset,
+      view.byteStride > 0 ? view.byteStride : componentSize, count,
+      componentSize);
+
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT &&
+      (view.byteStride == 0 || view.byteStride == componentSize)) {
+    memcpy(dst, src, count * sizeof(uint32_t));
+    if (baseVertex != 0) {
+      for (size_t i = 0; i < count; ++i) {
+        dst[i] += baseVertex;
+      }
+    }
+  } else if (view.byteStride == 0 || view.byteStride == componentSize) {
+    for (size_t i = 0; i < count; ++i) {
+      dst[i] = readIndex(src, accessor.componentType, i) + baseVertex;
+    }
+  } else {
+    // strided indices are legal but rare, read them one at a time
+    for (size_t i = 0; i < count; ++i) {
+      dst[i] = readIndex(src + i * view.byteStride, accessor.componentType, 0) +
+               baseVertex;
+    }
+  }
+}
+
+} // namespace AccessorDecoder
+} // namespace hiddenpiggy
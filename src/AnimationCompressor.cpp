@@ -0,0 +1,213 @@
+#include "AnimationCompressor.hpp"
+#include "SimdMath.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace hiddenpiggy {
+namespace AnimationCompressor {
+
+namespace {
+// keys one reduction step may span, bounding the quadratic search on long
+// constant tracks
+constexpr uint32_t kMaxReducedRun = 256;
+
+float toleranceFor(AnimationPath path, const Settings &settings) {
+  switch (path) {
+  case AnimationPath::Translation:
+    return settings.translationTolerance;
+  case AnimationPath::Rotation:
+    return settings.rotationTolerance;
+  case AnimationPath::Scale:
+    break;
+  }
+  return settings.scaleTolerance;
+}
+
+float difference(AnimationPath path, const glm::vec4 &a, const glm::vec4 &b) {
+  if (path == AnimationPath::Rotation) {
+    // the angle between the rotations from the chord between the
+    // quaternions, which stays accurate for tiny angles where acos does not
+    glm::vec4 other = glm::dot(a, b) < 0.0f ? -b : b;
+    float chord = glm::length(a - other);
+    return 4.0f * std::asin(std::min(chord * 0.5f, 1.0f));
+  }
+  glm::vec3 d = glm::abs(glm::vec3(a) - glm::vec3(b));
+  return path == AnimationPath::Translation ? glm::length(d)
+                                            : std::max({d.x, d.y, d.z});
+}
+
+// indices of the keys to keep, first and last included
+std::vector<uint32_t> reduceKeys(AnimationInterpolation interpolation,
+                                 AnimationPath path, const float *times,
+                                 const std::vector<glm::vec4> &values,
+                                 float tolerance) {
+  const uint32_t count = static_cast<uint32_t>(values.size());
+  std::vector<uint32_t> kept{0};
+  if (interpolation == AnimationInterpolation::Step) {
+    for (uint32_t k = 1; k < count; ++k) {
+      if (k + 1 == count ||
+          difference(path, values[k], values[kept.back()]) > tolerance) {
+        kept.push_back(k);
+      }
+    }
+    return kept;
+  }
+
+  // grow a line from the last kept key for as long as it passes within
+  // tolerance of every key it skips
+  uint32_t anchor = 0;
+  for (uint32_t end = 2; end < count; ++end) {
+    bool fits = end - anchor <= kMaxReducedRun;
+    float span = times[end] - times[anchor];
+    const glm::vec4 ends[2] = {values[anchor], values[end]};
+    for (uint32_t k = anchor + 1; fits && k < end; ++k) {
+      AnimationLibrary::Segment segment{};
+      segment.valueCount = 2;
+      segment.u = span > 0.0f ? (times[k] - times[anchor]) / span : 0.0f;
+      segment.dt = span;
+      glm::vec4 rebuilt = AnimationLibrary::interpolate(segment, path, ends);
+      fits = difference(path, rebuilt, values[k]) <= tolerance;
+    }
+    if (!fits) {
+      anchor = end - 1;
+      kept.push_back(anchor);
+    }
+  }
+  if (count > 1) {
+    kept.push_back(count - 1);
+  }
+  return kept;
+}
+
+uint32_t compressSampler(const AnimationLibrary &source, uint32_t index,
+                         AnimationPath path, const Settings &settings,
+                         AnimationLibrary &compressed) {
+  const AnimationLibrary::Sampler &sampler = source.getSamplers()[index];
+  const float *times = source.getTimes() + sampler.firstKey;
+  const bool cubic =
+      sampler.interpolation == AnimationInterpolation::CubicSpline;
+  const bool rotation = path == AnimationPath::Rotation;
+
+  std::vector<glm::vec4> values(AnimationLibrary::getValueCount(sampler));
+  for (uint32_t v = 0; v < values.size(); ++v) {
+    values[v] = source.getValue(sampler, v);
+  }
+  std::vector<float> keptTimes(times, times + sampler.keyCount);
+  if (!cubic) {
+    std::vector<uint32_t> kept =
+        reduceKeys(sampler.interpolation, path, times, values,
+                   toleranceFor(path, settings));
+    keptTimes.resize(kept.size());
+    for (size_t k = 0; k < kept.size(); ++k) {
+      keptTimes[k] = times[kept[k]];
+      values[k] = values[kept[k]];
+    }
+    values.resize(kept.size());
+  }
+  const uint32_t keyCount = static_cast<uint32_t>(keptTimes.size());
+
+  if (!settings.quantize || (rotation && cubic)) {
+    const uint32_t components = rotation ? 4 : 3;
+    std::vector<float> floats(values.size() * components);
+    for (size_t v = 0; v < values.size(); ++v) {
+      for (uint32_t c = 0; c < components; ++c) {
+        floats[v * components + c] = values[v][c];
+      }
+    }
+    return compressed.addSampler(sampler.interpolation, keptTimes.data(),
+                                 keyCount, floats.data(), components);
+  }
+
+  std::vector<uint16_t> words(values.size() * 3);
+  if (rotation) {
+    for (size_t v = 0; v < values.size(); ++v) {
+      const glm::vec4 &q = values[v];
+      SimdMath::encodeSmallestThree(glm::quat(q.w, q.x, q.y, q.z),
+                                    &words[v * 3]);
+    }
+    return compressed.addQuantizedSampler(
+        sampler.interpolation, keptTimes.data(), keyCount,
+        AnimationEncoding::SmallestThree, words.data(), glm::vec3(0.0f),
+        glm::vec3(0.0f));
+  }
+
+  // 16-bit steps of the range this sampler covers, tangents included
+  glm::vec3 lo(values[0]);
+  glm::vec3 hi(values[0]);
+  for (const glm::vec4 &v : values) {
+    lo = glm::min(lo, glm::vec3(v));
+    hi = glm::max(hi, glm::vec3(v));
+  }
+  glm::vec3 extent = hi - lo;
+  for (size_t v = 0; v < values.size(); ++v) {
+    for (uint32_t c = 0; c < 3; ++c) {
+      float unit =
+          extent[c] > 0.0f ? (values[v][c] - lo[c]) / extent[c] : 0.0f;
+      words[v * 3 + c] = static_cast<uint16_t>(
+          std::lround(std::clamp(unit, 0.0f, 1.0f) * 65535.0f));
+    }
+  }
+  return compressed.addQuantizedSampler(
+      sampler.interpolation, keptTimes.data(), keyCount,
+      AnimationEncoding::Quantized, words.data(), lo, extent);
+}
+} // namespace
+
+std::vector<ClipStats> compress(const AnimationLibrary &source,
+                                AnimationLibrary &compressed,
+                                const Settings &settings) {
+  compressed.clear();
+  const auto &samplers = source.getSamplers();
+  // samplers are compressed once, by the first channel that uses them
+  std::vector<uint32_t> remap(samplers.size(), UINT32_MAX);
+  std::vector<ClipStats> stats;
+  stats.reserve(source.getClips().size());
+
+  for (const AnimationLibrary::Clip &clip : source.getClips()) {
+    ClipStats clipStats{};
+    clipStats.name = clip.name;
+    compressed.beginClip(clip.name);
+    for (uint32_t i = 0; i < clip.channelCount; ++i) {
+      const AnimationLibrary::Channel &channel =
+          source.getChannels()[clip.firstChannel + i];
+      uint32_t &target = remap[channel.sampler];
+      if (target == UINT32_MAX) {
+        target = compressSampler(source, channel.sampler, channel.path,
+                                 settings, compressed);
+        clipStats.keysBefore += samplers[channel.sampler].keyCount;
+        clipStats.keysAfter += compressed.getSamplers()[target].keyCount;
+        clipStats.bytesBefore += source.getSamplerBytes(channel.sampler);
+        clipStats.bytesAfter += compressed.getSamplerBytes(target);
+      }
+      compressed.addChannel(target, channel.node, channel.path);
+
+      // at every source key and halfway to the next
+      const AnimationLibrary::Sampler &keys = samplers[channel.sampler];
+      const float *times = source.getTimes() + keys.firstKey;
+      float error = 0.0f;
+      for (uint32_t k = 0; k < keys.keyCount; ++k) {
+        float at[2] = {times[k], k + 1 < keys.keyCount
+                                     ? 0.5f * (times[k] + times[k + 1])
+                                     : times[k]};
+        for (float time : at) {
+          error = std::max(
+              error,
+              difference(channel.path,
+                         source.sample(channel.sampler, channel.path, time),
+                         compressed.sample(target, channel.path, time)));
+        }
+      }
+      float &clipError = channel.path == AnimationPath::Translation
+                             ? clipStats.translationError
+                         : channel.path == AnimationPath::Rotation
+                             ? clipStats.rotationError
+                             : clipStats.scaleError;
+      clipError = std::max(clipError, error);
+    }
+    stats.push_back(clipStats);
+  }
+  return stats;
+}
+
+} // namespace AnimationCompressor
+} // namespace hiddenpiggy
@@ -0,0 +1,359 @@
+#include "AnimationEvaluator.hpp"
+#include "SimdMath.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace hiddenpiggy {
+
+namespace {
+// glTF stores x, y, z, w
+glm::quat toQuat(const glm::vec4 &v) { return glm::quat(v.w, v.x, v.y, v.z); }
+} // namespace
+
+uint32_t AnimationLibrary::addSampler(AnimationInterpolation interpolation,
+                                      const float *times, uint32_t keyCount,
+                                      const float *values,
+                                      uint32_t components) {
+  if (keyCount == 0) {
+    throw std::runtime_error("animation sampler without keys");
+  }
+  if (components == 0 || components > 4) {
+    throw std::runtime_error("animation sampler component count");
+  }
+  for (uint32_t k = 1; k < keyCount; ++k) {
+    if (times[k] < times[k - 1]) {
+      throw std::runtime_error("animation key times decrease");
+    }
+  }
+  Sampler sampler{};
+  sampler.firstKey = static_cast<uint32_t>(m_times.size());
+  sampler.keyCount = keyCount;
+  sampler.firstValue = static_cast<uint32_t>(m_values[0].size());
+  sampler.interpolation = interpolation;
+  sampler.encoding = AnimationEncoding::Float;
+  m_times.insert(m_times.end(), times, times + keyCount);
+  uint32_t valueCount = getValueCount(sampler);
+  for (uint32_t c = 0; c < 4; ++c) {
+    for (uint32_t v = 0; v < valueCount; ++v) {
+      m_values[c].push_back(c < components ? values[v * components + c]
+                                           : 0.0f);
+    }
+  }
+  m_samplers.push_back(sampler);
+  return static_cast<uint32_t>(m_samplers.size() - 1);
+}
+
+uint32_t AnimationLibrary::addQuantizedSampler(
+    AnimationInterpolation interpolation, const float *times,
+    uint32_t keyCount, AnimationEncoding encoding, const uint16_t *words,
+    const glm::vec3 &origin, const glm::vec3 &extent) {
+  if (keyCount == 0) {
+    throw std::runtime_error("animation sampler without keys");
+  }
+  if (encoding == AnimationEncoding::Float) {
+    throw std::runtime_error("animation sampler is not quantized");
+  }
+  for (uint32_t k = 1; k < keyCount; ++k) {
+    if (times[k] < times[k - 1]) {
+      throw std::runtime_error("animation key times decrease");
+    }
+  }
+  Sampler sampler{};
+  sampler.firstKey = static_cast<uint32_t>(m_times.size());
+  sampler.keyCount = keyCount;
+  sampler.firstValue = static_cast<uint32_t>(m_quantized[0].size());
+  sampler.interpolation = interpolation;
+  sampler.encoding = encoding;
+  sampler.origin = origin;
+  sampler.extent = extent;
+  m_times.insert(m_times.end(), times, times + keyCount);
+  uint32_t valueCount = getValueCount(sampler);
+  for (uint32_t c = 0; c < 3; ++c) {
+    for (uint32_t v = 0; v < valueCount; ++v) {
+      m_quantized[c].push_back(words[v * 3 + c]);
+    }
+  }
+  m_samplers.push_back(sampler);
+  return static_cast<uint32_t>(m_samplers.size() - 1);
+}
+
+uint32_t AnimationLibrary::beginClip(const std::string &name) {
+  Clip clip{};
+  clip.name = name;
+  clip.firstChannel = static_cast<uint32_t>(m_channels.size());
+  m_clips.push_back(clip);
+  return static_cast<uint32_t>(m_clips.size() - 1);
+}
+
+void AnimationLibrary::addChannel(uint32_t sampler, uint32_t node,
+                                  AnimationPath path) {
+  if (m_clips.empty()) {
+    throw std::runtime_error("animation channel outside a clip");
+  }
+  if (sampler >= m_samplers.size()) {
+    throw std::runtime_error("animation sampler out of range");
+  }
+  m_channels.push_back(Channel{sampler, node, path});
+  Clip &clip = m_clips.back();
+  const Sampler &keys = m_samplers[sampler];
+  float start = m_times[keys.firstKey];
+  float end = m_times[keys.firstKey + keys.keyCount - 1];
+  clip.start = clip.channelCount == 0 ? start : std::min(clip.start, start);
+  clip.end = clip.channelCount == 0 ? end : std::max(clip.end, end);
+  ++clip.channelCount;
+}
+
+void AnimationLibrary::clear() {
+  m_clips.clear();
+  m_channels.clear();
+  m_samplers.clear();
+  m_times.clear();
+  for (auto &values : m_values) {
+    values.clear();
+  }
+  for (auto &words : m_quantized) {
+    words.clear();
+  }
+}
+
+size_t AnimationLibrary::getSamplerBytes(uint32_t sampler) const {
+  const Sampler &keys = m_samplers[sampler];
+  size_t valueBytes = keys.encoding == AnimationEncoding::Float
+                          ? 4 * sizeof(float)
+                          : 3 * sizeof(uint16_t);
+  return keys.keyCount * sizeof(float) + getValueCount(keys) * valueBytes;
+}
+
+AnimationLibrary::Segment AnimationLibrary::getSegment(const Sampler &sampler,
+                                                       uint32_t key,
+                                                       float time) const {
+  const float *times = m_times.data() + sampler.firstKey;
+  const bool cubic =
+      sampler.interpolation == AnimationInterpolation::CubicSpline;
+  const uint32_t stride = cubic ? 3 : 1;
+  // the value itself sits between the tangents of a cubic key
+  const uint32_t first = key * stride + (cubic ? 1 : 0);
+  Segment segment{};
+  if (key + 1 == sampler.keyCount || time <= times[key] ||
+      sampler.interpolation == AnimationInterpolation::Step) {
+    // clamped to the ends, or held until the next key
+    segment.valueCount = 1;
+    segment.values[0] = first;
+    return segment;
+  }
+  segment.dt = times[key + 1] - times[key];
+  segment.u = (time - times[key]) / segment.dt;
+  if (!cubic) {
+    segment.valueCount = 2;
+    segment.values[0] = first;
+    segment.values[1] = first + 1;
+  } else {
+    // the out tangent of key and the in tangent of key + 1
+    segment.valueCount = 4;
+    segment.values[0] = first;
+    segment.values[1] = first + 1;
+    segment.values[2] = first + stride - 1;
+    segment.values[3] = first + stride;
+  }
+  return segment;
+}
+
+glm::vec4 AnimationLibrary::interpolate(const Segment &segment,
+                                        AnimationPath path,
+                                        const glm::vec4 *values) {
+  const float u = segment.u;
+  if (segment.valueCount == 1) {
+    return values[0];
+  }
+  if (segment.valueCount == 2 && path == AnimationPath::Rotation) {
+    glm::quat q = glm::slerp(toQuat(values[0]), toQuat(values[1]), u);
+    return glm::vec4(q.x, q.y, q.z, q.w);
+  }
+  if (segment.valueCount == 2) {
+    return glm::mix(values[0], values[1], u);
+  }
+  // Hermite spline with tangents scaled by the interval, as the glTF spec
+  // has it
+  float u2 = u * u;
+  float u3 = u2 * u;
+  return (2.0f * u3 - 3.0f * u2 + 1.0f) * values[0] +
+         (u3 - 2.0f * u2 + u) * segment.dt * values[1] +
+         (-2.0f * u3 + 3.0f * u2) * values[3] +
+         (u3 - u2) * segment.dt * values[2];
+}
+
+glm::vec4 AnimationLibrary::getValue(const Sampler &sampler,
+                                     uint32_t value) const {
+  uint32_t index = sampler.firstValue + value;
+  if (sampler.encoding == AnimationEncoding::Quantized) {
+    glm::vec3 steps(m_quantized[0][index], m_quantized[1][index],
+                    m_quantized[2][index]);
+    return glm::vec4(sampler.origin + sampler.extent * steps / 65535.0f, 0.0f);
+  }
+  if (sampler.encoding == AnimationEncoding::SmallestThree) {
+    glm::quat q;
+    SimdMath::Scalar::decodeSmallestThree(&m_quantized[0][index],
+                                          &m_quantized[1][index],
+                                          &m_quantized[2][index], &q, 1);
+    return glm::vec4(q.x, q.y, q.z, q.w);
+  }
+  return glm::vec4(m_values[0][index], m_values[1][index], m_values[2][index],
+                   m_values[3][index]);
+}
+
+glm::vec4 AnimationLibrary::sample(uint32_t sampler, AnimationPath path,
+                                   float time) const {
+  const Sampler &keys = m_samplers[sampler];
+  const float *times = m_times.data() + keys.firstKey;
+  uint32_t next = static_cast<uint32_t>(
+      std::upper_bound(times, times + keys.keyCount, time) - times);
+  Segment segment = getSegment(keys, next > 0 ? next - 1 : 0, time);
+  glm::vec4 values[4];
+  for (uint32_t v = 0; v < segment.valueCount; ++v) {
+    values[v] = getValue(keys, segment.values[v]);
+  }
+  return interpolate(segment, path, values);
+}
+
+void AnimationPlayer::setClip(const AnimationLibrary &library, uint32_t clip) {
+  m_clip = clip;
+  m_cursors.assign(
+      clip < library.getClips().size() ? library.getClips()[clip].channelCount
+                                       : 0,
+      0);
+}
+
+uint32_t AnimationPlayer::findKey(const AnimationLibrary &library,
+                                  const AnimationLibrary::Sampler &sampler,
+                                  uint32_t channel, float time) {
+  const float *times = library.getTimes() + sampler.firstKey;
+  const uint32_t last = sampler.keyCount - 1;
+  uint32_t &cursor = m_cursors[channel];
+  // forward playback lands in the same interval or a few past it
+  if (time >= times[cursor]) {
+    for (uint32_t step = 0; step <= kMaxCursorSteps; ++step) {
+      if (cursor == last || time < times[cursor + 1]) {
+        return cursor;
+      }
+      ++cursor;
+    }
+  }
+  // the last key not after time, the first key for times before it
+  uint32_t next = static_cast<uint32_t>(
+      std::upper_bound(times, times + sampler.keyCount, time) - times);
+  cursor = next > 0 ? next - 1 : 0;
+  return cursor;
+}
+
+void AnimationPlayer::evaluate(const AnimationLibrary &library, float time,
+                               TransformHierarchy &transforms) {
+  if (m_clip >= library.getClips().size()) {
+    return;
+  }
+  const AnimationLibrary::Clip &clip = library.getClips()[m_clip];
+  m_segments.resize(clip.channelCount);
+  m_slots.resize(size_t(clip.channelCount) * 4);
+  for (auto &words : m_rotationWords) {
+    words.clear();
+  }
+  m_rotationSlots.clear();
+  m_steps.clear();
+  m_origins.clear();
+  m_extents.clear();
+  m_vectorSlots.clear();
+
+  // find every channel's keys; float values go straight to their slots,
+  // quantized ones are gathered for the batch decode
+  for (uint32_t i = 0; i < clip.channelCount; ++i) {
+    const AnimationLibrary::Channel &channel =
+        library.getChannels()[clip.firstChannel + i];
+    const AnimationLibrary::Sampler &sampler =
+        library.getSamplers()[channel.sampler];
+    AnimationLibrary::Segment &segment = m_segments[i];
+    segment = library.getSegment(sampler, findKey(library, sampler, i, time),
+                                 time);
+    for (uint32_t v = 0; v < segment.valueCount; ++v) {
+      uint32_t slot = i * 4 + v;
+      uint32_t index = sampler.firstValue + segment.values[v];
+      switch (sampler.encoding) {
+      case AnimationEncoding::Float:
+        m_slots[slot] = glm::vec4(
+            library.getValues(0)[index], library.getValues(1)[index],
+            library.getValues(2)[index], library.getValues(3)[index]);
+        break;
+      case AnimationEncoding::SmallestThree:
+        for (uint32_t c = 0; c < 3; ++c) {
+          m_rotationWords[c].push_back(library.getQuantized(c)[index]);
+        }
+        m_rotationSlots.push_back(slot);
+        break;
+      case AnimationEncoding::Quantized:
+        for (uint32_t c = 0; c < 3; ++c) {
+          m_steps.push_back(library.getQuantized(c)[index]);
+          m_origins.push_back(sampler.origin[c]);
+          m_extents.push_back(sampler.extent[c]);
+        }
+        m_vectorSlots.push_back(slot);
+        break;
+      }
+    }
+  }
+
+  if (!m_rotationSlots.empty()) {
+    m_rotations.resize(m_rotationSlots.size());
+    SimdMath::decodeSmallestThree(
+        m_rotationWords[0].data(), m_rotationWords[1].data(),
+        m_rotationWords[2].data(), m_rotations.data(), m_rotations.size());
+    for (size_t r = 0; r < m_rotations.size(); ++r) {
+      const glm::quat &q = m_rotations[r];
+      m_slots[m_rotationSlots[r]] = glm::vec4(q.x, q.y, q.z, q.w);
+    }
+  }
+  if (!m_vectorSlots.empty()) {
+    m_vectors.resize(m_steps.size());
+    SimdMath::dequantize(m_steps.data(), m_origins.data(), m_extents.data(),
+                         m_vectors.data(), m_vectors.size());
+    for (size_t v = 0; v < m_vectorSlots.size(); ++v) {
+      m_slots[m_vectorSlots[v]] = glm::vec4(
+          m_vectors[v * 3], m_vectors[v * 3 + 1], m_vectors[v * 3 + 2], 0.0f);
+    }
+  }
+
+  for (uint32_t i = 0; i < clip.channelCount; ++i) {
+    const AnimationLibrary::Channel &channel =
+        library.getChannels()[clip.firstChannel + i];
+    glm::vec4 value = AnimationLibrary::interpolate(
+        m_segments[i], channel.path, &m_slots[size_t(i) * 4]);
+    switch (channel.path) {
+    case AnimationPath::Translation:
+      transforms.setTranslation(channel.node, glm::vec3(value));
+      break;
+    case AnimationPath::Scale:
+      transforms.setScale(channel.node, glm::vec3(value));
+      break;
+    case AnimationPath::Rotation:
+      transforms.setRotation(channel.node, glm::normalize(toQuat(value)));
+      break;
+    }
+  }
+}
+
+void AnimationPlayer::evaluateAll(ThreadPool &pool,
+                                  const AnimationLibrary &library,
+                                  std::span<const Job> jobs) {
+  // a few chunks per worker, so uneven clips still balance out
+  size_t chunkCount =
+      std::min(jobs.size(), size_t(pool.getThreadCount()) * 4);
+  if (chunkCount == 0) {
+    return;
+  }
+  size_t chunkSize = (jobs.size() + chunkCount - 1) / chunkCount;
+  pool.parallelFor(chunkCount, [&](size_t chunk) {
+    size_t end = std::min(jobs.size(), (chunk + 1) * chunkSize);
+    for (size_t j = chunk * chunkSize; j < end; ++j) {
+      jobs[j].player->evaluate(library, jobs[j].time, *jobs[j].transforms);
+      jobs[j].transforms->update();
+    }
+  });
+}
+} // namespace hiddenpiggy
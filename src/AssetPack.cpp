@@ -0,0 +1,342 @@
+#include "AssetPack.hpp"
+#include "AssetReader.hpp"
+#include "Lz4.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace hiddenpiggy {
+
+namespace {
+constexpr char kMagic[4] = {'H', 'P', 'A', 'K'};
+constexpr uint64_t kTableAlignment = 8;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+std::filesystem::path normalizePath(const std::string &path) {
+  std::error_code ec;
+  std::filesystem::path normal =
+      std::filesystem::absolute(path, ec).lexically_normal();
+  // "dir/" and "dir" name the same directory
+  if (!normal.has_filename()) {
+    normal = normal.parent_path();
+  }
+  return normal;
+}
+
+struct Mount {
+  std::filesystem::path directory;
+  std::filesystem::path packPath;
+  std::unique_ptr<AssetPack> pack;
+};
+
+std::vector<Mount> &getMounts() {
+  static std::vector<Mount> mounts;
+  return mounts;
+}
+
+// shared by every mounted pack, created with the first mount
+std::unique_ptr<ThreadPool> &getMountPool() {
+  static std::unique_ptr<ThreadPool> pool;
+  return pool;
+}
+
+const AssetPackEntry *findMounted(const std::string &path,
+                                  const AssetPack **pack,
+                                  const Mount **owner = nullptr) {
+  if (getMounts().empty()) {
+    return nullptr;
+  }
+  std::filesystem::path normal = normalizePath(path);
+  for (const auto &mount : getMounts()) {
+    std::filesystem::path relative = normal.lexically_relative(mount.directory);
+    if (relative.empty() || *relative.begin() == "..") {
+      continue;
+    }
+    if (const AssetPackEntry *entry =
+            mount.pack->find(relative.generic_string())) {
+      *pack = mount.pack.get();
+      if (owner) {
+        *owner = &mount;
+      }
+      return entry;
+    }
+  }
+  return nullptr;
+}
+} // namespace
+
+std::string AssetPack::packPathFor(const std::string &directory) {
+  return normalizePath(directory).string() + ".pak";
+}
+
+bool AssetPack::open(const std::string &packPath) {
+  close();
+  if (!m_file.open(packPath) || m_file.size() < sizeof(AssetPackHeader)) {
+    m_file.close();
+    return false;
+  }
+  const auto *header = reinterpret_cast<const AssetPackHeader *>(m_file.data());
+  uint64_t size = m_file.size();
+  bool valid =
+      memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+      header->version == kVersion &&
+      header->entryOffset <= size &&
+      header->entryCount <= (size - header->entryOffset) /
+                                sizeof(AssetPackEntry) &&
+      header->chunkOffset <= size &&
+      header->chunkCount <= (size - header->chunkOffset) /
+                                sizeof(AssetPackChunk) &&
+      header->nameOffset <= size && header->nameSize <= size - header->nameOffset;
+  if (!valid) {
+    m_file.close();
+    return false;
+  }
+  m_header = header;
+
+  // check every reference once here so reads can trust the tables
+  for (const auto &entry : getEntries()) {
+    if (entry.nameOffset + entry.nameLength > m_header->nameSize ||
+        entry.firstChunk > m_header->chunkCount ||
+        entry.chunkCount > m_header->chunkCount - entry.firstChunk) {
+      close();
+      return false;
+    }
+  }
+  for (const auto &chunk : getChunks()) {
+    if (chunk.offset > size || chunk.compressedSize > size - chunk.offset ||
+        chunk.compressedSize > Lz4::compressBound(chunk.size)) {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void AssetPack::close() {
+  m_header = nullptr;
+  m_file.close();
+}
+
+const AssetPackEntry *AssetPack::find(const std::string &name) const {
+  auto entries = getEntries();
+  auto it = std::lower_bound(entries.begin(), entries.end(), name,
+                             [this](const AssetPackEntry &entry,
+                                    const std::string &name) {
+                               return getName(entry) < name;
+                             });
+  if (it == entries.end() || getName(*it) != name) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+bool AssetPack::readChunk(const AssetPackChunk &chunk, uint8_t *dst) const {
+  const uint8_t *src = m_file.data() + chunk.offset;
+  if (chunk.compressedSize == chunk.size) {
+    memcpy(dst, src, chunk.size);
+    return true;
+  }
+  return Lz4::decompress(src, chunk.compressedSize, dst, chunk.size);
+}
+
+bool AssetPack::read(const AssetPackEntry &entry, void *dst, ThreadPool *pool,
+                     std::string *err) const {
+  auto chunks = getChunks().subspan(entry.firstChunk, entry.chunkCount);
+  std::vector<uint64_t> offsets(chunks.size());
+  uint64_t size = 0;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    offsets[i] = size;
+    size += chunks[i].size;
+  }
+  bool valid = size == entry.size;
+
+  auto *out = static_cast<uint8_t *>(dst);
+  if (valid && (pool == nullptr || chunks.size() == 1)) {
+    for (size_t i = 0; valid && i < chunks.size(); ++i) {
+      valid = readChunk(chunks[i], out + offsets[i]);
+    }
+  } else if (valid) {
+    std::atomic<bool> failed{false};
+    pool->parallelFor(chunks.size(), [&](size_t i) {
+      if (!readChunk(chunks[i], out + offsets[i])) {
+        failed.store(true);
+      }
+    });
+    valid = !failed.load();
+  }
+
+  if (!valid && err) {
+    (*err) += "corrupt packed asset " + std::string(getName(entry)) + "\n";
+  }
+  return valid;
+}
+
+bool AssetPack::write(
+    const std::string &packPath,
+    const std::vector<std::pair<std::string, std::string>> &files,
+    ThreadPool &pool, std::string *err) {
+  auto sorted = files;
+  std::sort(sorted.begin(), sorted.end());
+
+  // write to a temporary file and rename, a torn pack must never be mounted
+  std::string tempPath = packPath + ".tmp";
+  std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    if (err) {
+      (*err) += "cannot write " + packPath + "\n";
+    }
+    return false;
+  }
+  AssetPackHeader header{};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  uint64_t offset = sizeof(header);
+
+  std::vector<AssetPackEntry> entries;
+  std::vector<AssetPackChunk> chunks;
+  std::string names;
+  for (const auto &[name, path] : sorted) {
+    std::vector<unsigned char> data;
+    if (!AssetReader::readFile(path, &data, err)) {
+      out.close();
+      std::remove(tempPath.c_str());
+      return false;
+    }
+
+    AssetPackEntry entry{};
+    entry.nameOffset = names.size();
+    entry.nameLength = static_cast<uint32_t>(name.size());
+    entry.firstChunk = static_cast<uint32_t>(chunks.size());
+    entry.chunkCount =
+        static_cast<uint32_t>((data.size() + kChunkSize - 1) / kChunkSize);
+    entry.size = data.size();
+    names += name;
+
+    std::vector<std::vector<uint8_t>> compressed(entry.chunkCount);
+    pool.parallelFor(entry.chunkCount, [&](size_t i) {
+      size_t begin = i * kChunkSize;
+      size_t size = std::min<size_t>(kChunkSize, data.size() - begin);
+      compressed[i].resize(Lz4::compressBound(size));
+      size_t compressedSize = Lz4::compress(
+          data.data() + begin, size, compressed[i].data(), compressed[i].size());
+      // already compressed formats (jpg, png) usually do not shrink
+      if (compressedSize == 0 || compressedSize >= size) {
+        compressed[i].assign(data.begin() + begin, data.begin() + begin + size);
+      } else {
+        compressed[i].resize(compressedSize);
+      }
+    });
+
+    for (uint32_t i = 0; i < entry.chunkCount; ++i) {
+      AssetPackChunk chunk{};
+      chunk.offset = offset;
+      chunk.compressedSize = static_cast<uint32_t>(compressed[i].size());
+      chunk.size = static_cast<uint32_t>(
+          std::min<size_t>(kChunkSize, data.size() - i * size_t(kChunkSize)));
+      out.write(reinterpret_cast<const char *>(compressed[i].data()),
+                static_cast<std::streamsize>(compressed[i].size()));
+      offset += compressed[i].size();
+      chunks.push_back(chunk);
+    }
+    entries.push_back(entry);
+  }
+
+  auto writeTable = [&](uint64_t &tableOffset, const void *data,
+                        uint64_t size) {
+    static const char zeros[kTableAlignment] = {};
+    uint64_t aligned = alignUp(offset, kTableAlignment);
+    out.write(zeros, static_cast<std::streamsize>(aligned - offset));
+    out.write(static_cast<const char *>(data),
+              static_cast<std::streamsize>(size));
+    tableOffset = aligned;
+    offset = aligned + size;
+  };
+  header.entryCount = static_cast<uint32_t>(entries.size());
+  header.chunkCount = static_cast<uint32_t>(chunks.size());
+  header.nameSize = names.size();
+  writeTable(header.entryOffset, entries.data(),
+             sizeof(AssetPackEntry) * entries.size());
+  writeTable(header.chunkOffset, chunks.data(),
+             sizeof(AssetPackChunk) * chunks.size());
+  writeTable(header.nameOffset, names.data(), names.size());
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.close();
+
+  if (!out) {
+    std::remove(tempPath.c_str());
+    if (err) {
+      (*err) += "cannot write " + packPath + "\n";
+    }
+    return false;
+  }
+  std::error_code error;
+  std::filesystem::rename(tempPath, packPath, error);
+  if (error) {
+    std::remove(tempPath.c_str());
+    if (err) {
+      (*err) += "cannot write " + packPath + ": " + error.message() + "\n";
+    }
+    return false;
+  }
+  return true;
+}
+
+bool AssetPack::mount(const std::string &packPath,
+                      const std::string &directory) {
+  auto pack = std::make_unique<AssetPack>();
+  if (!pack->open(packPath)) {
+    return false;
+  }
+  if (!getMountPool()) {
+    getMountPool() = std::make_unique<ThreadPool>();
+  }
+  getMounts().push_back(
+      {normalizePath(directory), packPath, std::move(pack)});
+  return true;
+}
+
+void AssetPack::unmountAll() {
+  getMounts().clear();
+  getMountPool().reset();
+}
+
+bool AssetPack::isMounted(const std::string &path) {
+  const AssetPack *pack = nullptr;
+  return findMounted(path, &pack) != nullptr;
+}
+
+bool AssetPack::statMounted(const std::string &path, uint64_t *size,
+                            int64_t *packWriteTime) {
+  const AssetPack *pack = nullptr;
+  const Mount *mount = nullptr;
+  const AssetPackEntry *entry = findMounted(path, &pack, &mount);
+  if (entry == nullptr) {
+    return false;
+  }
+  std::error_code error;
+  auto writeTime = std::filesystem::last_write_time(mount->packPath, error);
+  *size = entry->size;
+  *packWriteTime = error ? 0 : writeTime.time_since_epoch().count();
+  return true;
+}
+
+bool AssetPack::readMounted(const std::string &path,
+                            std::vector<unsigned char> *out,
+                            std::string *err) {
+  const AssetPack *pack = nullptr;
+  const AssetPackEntry *entry = findMounted(path, &pack);
+  if (entry == nullptr) {
+    return false;
+  }
+  out->resize(entry->size);
+  return pack->read(*entry, out->data(), getMountPool().get(), err);
+}
+} // namespace hiddenpiggy
@@ -0,0 +1,365 @@
+#include "AssetReader.hpp"
+#include "AssetPack.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace hiddenpiggy {
+
+namespace {
+// one request never asks for more than this, larger files are continued
+// from the completion
+constexpr size_t kMaxReadSize = 256 * 1024 * 1024;
+
+std::string describeError(const std::string &path, int error) {
+  return "failed to read " + path + ": " + strerror(error);
+}
+} // namespace
+
+struct AssetReader::Slot {
+  uint32_t index = 0;
+  uint32_t ticket = 0;
+  std::string path;
+  int fd = -1;
+  size_t offset = 0;
+  std::vector<unsigned char> data;
+  struct iovec iov {};
+};
+
+bool AssetReader::readFile(const std::string &path,
+                           std::vector<unsigned char> *out, std::string *err) {
+  if (AssetPack::isMounted(path)) {
+    return AssetPack::readMounted(path, out, err);
+  }
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (err) {
+      (*err) += describeError(path, errno) + "\n";
+    }
+    return false;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    if (err) {
+      (*err) += describeError(path, errno) + "\n";
+    }
+    ::close(fd);
+    return false;
+  }
+  out->resize(static_cast<size_t>(st.st_size));
+  size_t offset = 0;
+  while (offset < out->size()) {
+    ssize_t n = pread(fd, out->data() + offset,
+                      std::min(out->size() - offset, kMaxReadSize),
+                      static_cast<off_t>(offset));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      if (err) {
+        (*err) += describeError(path, errno) + "\n";
+      }
+      ::close(fd);
+      return false;
+    }
+    if (n == 0) {
+      // truncated while we were reading
+      out->resize(offset);
+      break;
+    }
+    offset += static_cast<size_t>(n);
+  }
+  ::close(fd);
+  return true;
+}
+
+AssetReader::AssetReader() = default;
+AssetReader::~AssetReader() { OnDestroy(); }
+
+void AssetReader::OnCreate(uint32_t queueDepth) {
+  m_queueDepth = std::max(1u, queueDepth);
+  if (setupRing(m_queueDepth)) {
+    m_slots.resize(m_queueDepth);
+    for (uint32_t i = 0; i < m_queueDepth; ++i) {
+      m_slots[i] = std::make_unique<Slot>();
+      m_slots[i]->index = i;
+      m_freeSlots.push_back(m_queueDepth - 1 - i);
+    }
+    return;
+  }
+  // pread is synchronous, so parallelism comes from the workers
+  m_pPool = std::make_unique<ThreadPool>(std::min(m_queueDepth, 4u));
+}
+
+void AssetReader::OnDestroy() {
+  if (m_ringFd >= 0) {
+    // the kernel may still be writing into the slots' buffers
+    while (m_freeSlots.size() < m_slots.size()) {
+      submitAndWait(1);
+      reapRing();
+    }
+    teardownRing();
+  }
+  m_pPool.reset();
+  m_slots.clear();
+  m_freeSlots.clear();
+  m_pending.clear();
+  m_ready.clear();
+  m_outstanding = 0;
+}
+
+uint32_t AssetReader::submit(const std::string &path) {
+  uint32_t ticket = m_nextTicket++;
+  m_outstanding++;
+  if (m_ringFd >= 0 && AssetPack::isMounted(path)) {
+    // packed assets are decompressed on the pack's workers, nothing to queue
+    Completion completion;
+    completion.ticket = ticket;
+    if (!AssetPack::readMounted(path, &completion.data, &completion.error)) {
+      completion.data.clear();
+    }
+    m_ready.push_back(std::move(completion));
+  } else if (m_ringFd >= 0) {
+    // batched; the ring is filled on the next wait
+    m_pending.push_back({ticket, path});
+  } else {
+    m_pPool->submit([this, read = PendingRead{ticket, path}]() mutable {
+      fallbackRead(std::move(read));
+    });
+  }
+  return ticket;
+}
+
+bool AssetReader::wait(Completion &completion) {
+  if (m_outstanding == 0) {
+    return false;
+  }
+  if (m_ringFd >= 0) {
+    for (;;) {
+      fillRing();
+      reapRing();
+      if (!m_ready.empty()) {
+        break;
+      }
+      submitAndWait(1);
+    }
+    completion = std::move(m_ready.front());
+    m_ready.pop_front();
+  } else {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return !m_ready.empty(); });
+    completion = std::move(m_ready.front());
+    m_ready.pop_front();
+  }
+  m_outstanding--;
+  return true;
+}
+
+void AssetReader::fallbackRead(PendingRead read) {
+  Completion completion;
+  completion.ticket = read.ticket;
+  if (!readFile(read.path, &completion.data, &completion.error)) {
+    completion.data.clear();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ready.push_back(std::move(completion));
+  }
+  m_condition.notify_one();
+}
+
+void AssetReader::fillRing() {
+  while (!m_pending.empty() && !m_freeSlots.empty()) {
+    PendingRead read = std::move(m_pending.front());
+    m_pending.pop_front();
+    uint32_t index = m_freeSlots.back();
+    m_freeSlots.pop_back();
+
+    Slot &slot = *m_slots[index];
+    slot.ticket = read.ticket;
+    slot.path = std::move(read.path);
+    if (!startRead(slot)) {
+      m_freeSlots.push_back(index);
+    }
+  }
+}
+
+// opens the file and queues its first read; files that fail to open or are
+// empty complete right away and give their slot back
+bool AssetReader::startRead(Slot &slot) {
+  slot.offset = 0;
+  slot.data = {};
+  slot.fd = ::open(slot.path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st {};
+  if (slot.fd < 0 || fstat(slot.fd, &st) != 0) {
+    m_ready.push_back({slot.ticket, {}, describeError(slot.path, errno)});
+    if (slot.fd >= 0) {
+      ::close(slot.fd);
+    }
+    return false;
+  }
+  if (st.st_size == 0) {
+    ::close(slot.fd);
+    m_ready.push_back({slot.ticket, {}, {}});
+    return false;
+  }
+  slot.data.resize(static_cast<size_t>(st.st_size));
+  queueRead(slot);
+  return true;
+}
+
+#if defined(__linux__)
+bool AssetReader::setupRing(uint32_t entries) {
+  io_uring_params params{};
+  int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+  if (fd < 0) {
+    return false;
+  }
+  m_ringFd = fd;
+
+  m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_cqRingSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (singleMap) {
+    m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+  }
+  m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  m_cqRing = singleMap ? m_sqRing
+                       : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, fd,
+                              IORING_OFF_CQ_RING);
+  m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  m_sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED ||
+      m_sqes == MAP_FAILED) {
+    teardownRing();
+    return false;
+  }
+
+  auto *sq = static_cast<uint8_t *>(m_sqRing);
+  m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  m_sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  auto *cq = static_cast<uint8_t *>(m_cqRing);
+  m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  m_cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  m_cqes = cq + params.cq_off.cqes;
+  // more slots than submission entries would overflow the ring
+  m_queueDepth = std::min(m_queueDepth, params.sq_entries);
+  return true;
+}
+
+void AssetReader::teardownRing() {
+  if (m_sqes != nullptr && m_sqes != MAP_FAILED) {
+    munmap(m_sqes, m_sqesSize);
+  }
+  if (m_cqRing != nullptr && m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) {
+    munmap(m_cqRing, m_cqRingSize);
+  }
+  if (m_sqRing != nullptr && m_sqRing != MAP_FAILED) {
+    munmap(m_sqRing, m_sqRingSize);
+  }
+  m_sqes = m_cqRing = m_sqRing = nullptr;
+  ::close(m_ringFd);
+  m_ringFd = -1;
+}
+
+void AssetReader::queueRead(Slot &slot) {
+  // only this thread produces entries, the kernel only reads the tail
+  unsigned tail = *m_sqTail;
+  unsigned index = tail & *m_sqMask;
+  io_uring_sqe &sqe = static_cast<io_uring_sqe *>(m_sqes)[index];
+  memset(&sqe, 0, sizeof(sqe));
+
+  slot.iov.iov_base = slot.data.data() + slot.offset;
+  slot.iov.iov_len = std::min(slot.data.size() - slot.offset, kMaxReadSize);
+  // readv is the oldest read opcode, so this works on every io_uring kernel
+  sqe.opcode = IORING_OP_READV;
+  sqe.fd = slot.fd;
+  sqe.addr = reinterpret_cast<uint64_t>(&slot.iov);
+  sqe.len = 1;
+  sqe.off = slot.offset;
+  sqe.user_data = slot.index;
+
+  m_sqArray[index] = index;
+  __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+  m_toSubmit++;
+}
+
+void AssetReader::submitAndWait(uint32_t minComplete) {
+  for (;;) {
+    int submitted = static_cast<int>(
+        syscall(__NR_io_uring_enter, m_ringFd, m_toSubmit, minComplete,
+                minComplete > 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+    if (submitted < 0 && errno == EINTR) {
+      continue;
+    }
+    if (submitted > 0) {
+      m_toSubmit -= std::min<uint32_t>(m_toSubmit, submitted);
+    }
+    return;
+  }
+}
+
+// handles every completion the kernel posted; finished files move to the
+// ready queue and short reads are continued from where they stopped
+void AssetReader::reapRing() {
+  unsigned head = *m_cqHead;
+  unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    const io_uring_cqe &cqe =
+        static_cast<io_uring_cqe *>(m_cqes)[head & *m_cqMask];
+    uint32_t index = static_cast<uint32_t>(cqe.user_data);
+    int result = cqe.res;
+    head++;
+
+    Slot &slot = *m_slots[index];
+    if (result == -EINTR || result == -EAGAIN) {
+      queueRead(slot);
+      continue;
+    }
+    if (result > 0) {
+      slot.offset += static_cast<size_t>(result);
+      if (slot.offset < slot.data.size()) {
+        queueRead(slot);
+        continue;
+      }
+    }
+    Completion done;
+    done.ticket = slot.ticket;
+    if (result < 0) {
+      done.error = describeError(slot.path, -result);
+    } else {
+      // a zero byte read means the file shrank underneath us
+      slot.data.resize(slot.offset);
+      done.data = std::move(slot.data);
+    }
+    ::close(slot.fd);
+    slot.fd = -1;
+    m_ready.push_back(std::move(done));
+    m_freeSlots.push_back(index);
+  }
+  __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+}
+#else
+bool AssetReader::setupRing(uint32_t) { return false; }
+void AssetReader::teardownRing() {}
+void AssetReader::queueRead(Slot &) {}
+void AssetReader::submitAndWait(uint32_t) {}
+void AssetReader::reapRing() {}
+#endif
+} // namespace hiddenpiggy
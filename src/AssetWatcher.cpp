@@ -0,0 +1,124 @@
+#include "AssetWatcher.hpp"
+#include <filesystem>
+#include <stdexcept>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace hiddenpiggy {
+
+#if defined(__linux__)
+namespace {
+// a finished write or a file renamed into place, which is how most editors
+// and exporters save; new directories are followed as they appear
+constexpr uint32_t kWatchMask =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF;
+} // namespace
+
+void AssetWatcher::OnCreate(std::chrono::milliseconds settleTime) {
+  m_settleTime = settleTime;
+  m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd < 0) {
+    throw std::runtime_error("failed to initialize inotify");
+  }
+}
+
+void AssetWatcher::OnDestroy() {
+  if (m_fd >= 0) {
+    close(m_fd);
+    m_fd = -1;
+  }
+  m_directories.clear();
+  m_changed.clear();
+}
+
+void AssetWatcher::watchDirectory(const std::string &directory) {
+  std::error_code ec;
+  if (!std::filesystem::is_directory(directory, ec)) {
+    return;
+  }
+  addWatch(directory);
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(directory, ec)) {
+    if (entry.is_directory()) {
+      addWatch(entry.path().string());
+    }
+  }
+}
+
+void AssetWatcher::addWatch(const std::string &directory) {
+  int wd = inotify_add_watch(m_fd, directory.c_str(), kWatchMask);
+  if (wd >= 0) {
+    m_directories[wd] = directory;
+  }
+}
+
+void AssetWatcher::readEvents() {
+  alignas(inotify_event) char buffer[4096];
+  for (;;) {
+    ssize_t length = read(m_fd, buffer, sizeof(buffer));
+    if (length <= 0) {
+      // EAGAIN, nothing left to read
+      return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    for (char *p = buffer; p < buffer + length;) {
+      const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+      p += sizeof(inotify_event) + event->len;
+
+      auto directory = m_directories.find(event->wd);
+      if (directory == m_directories.end()) {
+        continue;
+      }
+      if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+        m_directories.erase(directory);
+        continue;
+      }
+      if (event->len == 0) {
+        continue;
+      }
+      std::string path =
+          (std::filesystem::path(directory->second) / event->name).string();
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          watchDirectory(path);
+        }
+        continue;
+      }
+      // IN_CREATE alone is followed by IN_CLOSE_WRITE once the data is there
+      if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        m_changed[path] = now;
+      }
+    }
+  }
+}
+
+std::vector<std::string> AssetWatcher::poll() {
+  std::vector<std::string> settled;
+  if (m_fd < 0) {
+    return settled;
+  }
+  readEvents();
+  auto now = std::chrono::steady_clock::now();
+  for (auto it = m_changed.begin(); it != m_changed.end();) {
+    if (now - it->second >= m_settleTime) {
+      settled.push_back(it->first);
+      it = m_changed.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return settled;
+}
+#else
+void AssetWatcher::OnCreate(std::chrono::milliseconds settleTime) {
+  m_settleTime = settleTime;
+}
+void AssetWatcher::OnDestroy() {}
+void AssetWatcher::watchDirectory(const std::string &) {}
+void AssetWatcher::addWatch(const std::string &) {}
+void AssetWatcher::readEvents() {}
+std::vector<std::string> AssetWatcher::poll() { return {}; }
+#endif
+} // namespace hiddenpiggy
@@ -0,0 +1,496 @@
+#include "CookedScene.hpp"
+#include "AssetPack.hpp"
+#include "Hash.hpp"
+#include "ImpostorBaker.hpp"
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <utility>
+
+namespace hiddenpiggy {
+
+namespace {
+constexpr char kMagic[4] = {'H', 'P', 'C', 'S'};
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+std::string sourceDirectory(const std::string &sourcePath) {
+  std::filesystem::path path{sourcePath};
+  return path.remove_filename().string();
+}
+
+// count elements of T at offset lie within the file, aligned for T; written
+// so that no sum can wrap around for any header values
+template <typename T>
+bool fitsTable(const MappedFile &file, uint64_t offset, uint64_t count) {
+  uint64_t size = file.size();
+  return offset <= size && offset % alignof(T) == 0 &&
+         count <= (size - offset) / sizeof(T);
+}
+
+// a stream has to decode to exactly the blob size the header promises
+bool validStream(const MappedFile &file, uint64_t offset, uint64_t streamSize,
+                 uint64_t decodedSize) {
+  if (streamSize % sizeof(uint32_t) != 0 ||
+      !fitsTable<uint32_t>(file, offset, streamSize / sizeof(uint32_t))) {
+    return false;
+  }
+  std::span<const uint32_t> stream{
+      reinterpret_cast<const uint32_t *>(file.data() + offset),
+      streamSize / sizeof(uint32_t)};
+  GpuCodec::StreamInfo info{};
+  return GpuCodec::readInfo(stream, info) &&
+         uint64_t(info.wordCount) * sizeof(uint32_t) == decodedSize &&
+         GpuCodec::validate(stream);
+}
+
+template <typename T>
+std::span<const T> tableAt(const MappedFile &file, uint64_t offset,
+                           uint64_t count) {
+  return {reinterpret_cast<const T *>(file.data() + offset),
+          static_cast<size_t>(count)};
+}
+
+// first + count <= size without wrapping
+bool fitsRange(uint64_t first, uint64_t count, uint64_t size) {
+  return first <= size && count <= size - first;
+}
+
+// Every index one table holds into another, and every range into the
+// blobs, checked once so that loadCooked, the upload and the culling
+// shaders can trust them. Runs after the tables were found to lie within
+// the file.
+bool validReferences(const MappedFile &file, const CookedSceneHeader &header) {
+  if (header.vertexStride == 0 ||
+      header.vertexSize % header.vertexStride != 0) {
+    return false;
+  }
+  const uint64_t vertexCount = header.vertexSize / header.vertexStride;
+  auto validIndex = [](int32_t index, uint64_t count) {
+    return index == -1 || (index >= 0 && uint64_t(index) < count);
+  };
+
+  for (const auto &node :
+       tableAt<CookedNode>(file, header.nodeOffset, header.nodeCount)) {
+    if (!validIndex(node.parent, header.nodeCount) ||
+        !validIndex(node.mesh, header.meshCount) ||
+        !validIndex(node.impostorGroup, header.impostorGroupCount) ||
+        !fitsRange(node.firstInstance, node.instanceCount,
+                   header.nodeInstanceCount)) {
+      return false;
+    }
+  }
+  for (const auto &member : tableAt<CookedBatchMember>(
+           file, header.batchMemberOffset, header.batchMemberCount)) {
+    if (member.node >= header.nodeCount || member.mesh >= header.meshCount) {
+      return false;
+    }
+  }
+  for (const auto &material : tableAt<CookedMaterial>(
+           file, header.materialOffset, header.materialCount)) {
+    if (!validIndex(material.baseColorTexture, header.textureCount) ||
+        !validIndex(material.metallicRoughnessTexture, header.textureCount) ||
+        !validIndex(material.normalTexture, header.textureCount) ||
+        !validIndex(material.occlusionTexture, header.textureCount) ||
+        !validIndex(material.emissiveTexture, header.textureCount)) {
+      return false;
+    }
+  }
+  for (const auto &mesh :
+       tableAt<CookedMesh>(file, header.meshOffset, header.meshCount)) {
+    if (!fitsRange(mesh.firstPrimitive, mesh.primitiveCount,
+                   header.primitiveCount)) {
+      return false;
+    }
+  }
+
+  for (const auto &primitive : tableAt<CookedPrimitive>(
+           file, header.primitiveOffset, header.primitiveCount)) {
+    // a scene without materials draws with the default one at index 0
+    if (primitive.materialIndex >= std::max(header.materialCount, 1u) ||
+        !fitsRange(primitive.firstVertex, primitive.vertexCount,
+                   vertexCount) ||
+        primitive.vertexOffset < 0 ||
+        !fitsRange(uint64_t(primitive.vertexOffset), primitive.vertexCount,
+                   vertexCount) ||
+        primitive.lodCount < 1 || primitive.lodCount > kMaxLods ||
+        !fitsRange(primitive.firstMeshlet, primitive.meshletCount,
+                   header.meshletCount)) {
+      return false;
+    }
+    if (primitive.indexCount == 0) {
+      continue;
+    }
+    if (primitive.indexSize != sizeof(uint16_t) &&
+        primitive.indexSize != sizeof(uint32_t)) {
+      return false;
+    }
+    // every level counts in the primitive's own index size
+    const uint64_t indexCount = header.indexSize / primitive.indexSize;
+    if (!fitsRange(primitive.firstIndex, primitive.indexCount, indexCount) ||
+        !fitsRange(primitive.depthFirstIndex, primitive.depthIndexCount,
+                   indexCount)) {
+      return false;
+    }
+    for (uint32_t lod = 1; lod < primitive.lodCount; ++lod) {
+      const CookedLod &range = primitive.lods[lod - 1];
+      if (!fitsRange(range.firstIndex, range.indexCount, indexCount)) {
+        return false;
+      }
+    }
+  }
+
+  // meshlet vertices index the scene's vertices from baseVertex on, their
+  // triangles the meshlet's own vertices
+  auto meshletVertices = tableAt<uint32_t>(file, header.meshletVertexOffset,
+                                           header.meshletVertexCount);
+  auto meshletTriangles = tableAt<uint8_t>(file, header.meshletTriangleOffset,
+                                           header.meshletTriangleSize);
+  for (const auto &meshlet : tableAt<CookedMeshlet>(
+           file, header.meshletOffset, header.meshletCount)) {
+    if (meshlet.vertexCount > MeshOptimizer::kMeshletMaxVertices ||
+        meshlet.triangleCount > MeshOptimizer::kMeshletMaxTriangles ||
+        !fitsRange(meshlet.vertexOffset, meshlet.vertexCount,
+                   header.meshletVertexCount) ||
+        !fitsRange(meshlet.triangleOffset, uint64_t(meshlet.triangleCount) * 3,
+                   header.meshletTriangleSize) ||
+        meshlet.baseVertex < 0 || uint64_t(meshlet.baseVertex) > vertexCount) {
+      return false;
+    }
+    for (uint32_t v = 0; v < meshlet.vertexCount; ++v) {
+      if (meshletVertices[meshlet.vertexOffset + v] >=
+          vertexCount - meshlet.baseVertex) {
+        return false;
+      }
+    }
+    for (uint32_t t = 0; t < meshlet.triangleCount * 3; ++t) {
+      if (meshletTriangles[meshlet.triangleOffset + t] >= meshlet.vertexCount) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// size and last write time of a file, or of its pack entry and the pack
+// when it is only packed; the contents are never read
+bool stampFile(Hash64 &hasher, const std::string &filename) {
+  uint64_t size = 0;
+  int64_t writeTime = 0;
+  if (!AssetPack::statMounted(filename, &size, &writeTime)) {
+    std::error_code error;
+    size = std::filesystem::file_size(filename, error);
+    if (error) {
+      return false;
+    }
+    writeTime =
+        std::filesystem::last_write_time(filename, error).time_since_epoch()
+            .count();
+    if (error) {
+      return false;
+    }
+  }
+  hasher.update(&size, sizeof(size));
+  hasher.update(&writeTime, sizeof(writeTime));
+  return true;
+}
+} // namespace
+
+uint64_t
+CookedScene::stampSources(const std::string &sourcePath,
+                          const std::vector<std::string> &dependencies) {
+  Hash64 hasher(kVersion);
+  if (!stampFile(hasher, sourcePath)) {
+    return 0;
+  }
+  std::string directory = sourceDirectory(sourcePath);
+  for (const auto &dependency : dependencies) {
+    // a missing dependency changes the stamp as well
+    hasher.update(dependency.data(), dependency.size());
+    stampFile(hasher, directory + dependency);
+  }
+  return hasher.digest();
+}
+
+bool CookedScene::open(const std::string &cookedPath,
+                       const std::string &sourcePath,
+                       uint32_t expectedVertexStride,
+                       uint32_t expectedFlags) {
+  close();
+  if (!m_file.open(cookedPath) ||
+      m_file.size() < sizeof(CookedSceneHeader)) {
+    m_file.close();
+    return false;
+  }
+
+  const auto *header =
+      reinterpret_cast<const CookedSceneHeader *>(m_file.data());
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion ||
+      header->vertexStride != expectedVertexStride ||
+      header->flags != expectedFlags) {
+    m_file.close();
+    return false;
+  }
+
+  // every table must lie within the file before anything reads through
+  // it; the culling shaders index through the meshlets unchecked
+  if (header->dependencyOffset > header->nodeOffset ||
+      !fitsTable<uint8_t>(m_file, header->dependencyOffset,
+                          header->nodeOffset - header->dependencyOffset) ||
+      !fitsTable<CookedNode>(m_file, header->nodeOffset, header->nodeCount) ||
+      !fitsTable<CookedInstance>(m_file, header->nodeInstanceOffset,
+                                 header->nodeInstanceCount) ||
+      !fitsTable<CookedBatchMember>(m_file, header->batchMemberOffset,
+                                    header->batchMemberCount) ||
+      !fitsTable<CookedMesh>(m_file, header->meshOffset, header->meshCount) ||
+      !fitsTable<CookedPrimitive>(m_file, header->primitiveOffset,
+                                  header->primitiveCount) ||
+      !fitsTable<CookedMaterial>(m_file, header->materialOffset,
+                                 header->materialCount) ||
+      !fitsTable<CookedMeshlet>(m_file, header->meshletOffset,
+                                header->meshletCount) ||
+      !fitsTable<uint32_t>(m_file, header->meshletVertexOffset,
+                           header->meshletVertexCount) ||
+      !fitsTable<uint8_t>(m_file, header->meshletTriangleOffset,
+                          header->meshletTriangleSize) ||
+      !fitsTable<CookedImpostorGroup>(m_file, header->impostorGroupOffset,
+                                      header->impostorGroupCount) ||
+      !fitsTable<uint32_t>(m_file, header->impostorTexelOffset,
+                           header->impostorTexelCount) ||
+      header->impostorTexelCount !=
+          header->impostorGroupCount * ImpostorBaker::kGroupTexels ||
+      header->indexOffset < header->vertexOffset) {
+    m_file.close();
+    return false;
+  }
+
+  // walk the dependencies and texture images, which end where the nodes
+  // start
+  std::vector<std::string> dependencies;
+  std::vector<std::string> textureImages;
+  uint64_t cursor = header->dependencyOffset;
+  const uint64_t end = header->nodeOffset;
+  for (uint64_t i = 0;
+       i < uint64_t(header->dependencyCount) + header->textureCount; ++i) {
+    uint32_t length;
+    if (end - cursor < sizeof(length)) {
+      m_file.close();
+      return false;
+    }
+    memcpy(&length, m_file.data() + cursor, sizeof(length));
+    cursor += sizeof(length);
+    if (end - cursor < length) {
+      m_file.close();
+      return false;
+    }
+    (i < header->dependencyCount ? dependencies : textureImages)
+        .emplace_back(reinterpret_cast<const char *>(m_file.data() + cursor),
+                      length);
+    cursor += length;
+  }
+
+  if (stampSources(sourcePath, dependencies) != header->sourceStamp) {
+    m_file.close();
+    return false;
+  }
+
+  if (!validReferences(m_file, *header)) {
+    m_file.close();
+    return false;
+  }
+
+  // the gpu decoder trusts the block tables, check them once here
+  if (!validStream(m_file, header->vertexOffset, header->vertexStreamSize,
+                   header->vertexSize) ||
+      !validStream(m_file, header->indexOffset, header->indexStreamSize,
+                   header->indexSize)) {
+    m_file.close();
+    return false;
+  }
+
+  m_header = header;
+  m_textureImages = std::move(textureImages);
+  return true;
+}
+
+void CookedScene::close() {
+  m_header = nullptr;
+  m_textureImages.clear();
+  m_file.close();
+}
+
+void CookedScene::adviseBlobs() const {
+  m_file.adviseSequential(m_header->vertexOffset,
+                          m_header->indexOffset + m_header->indexStreamSize -
+                              m_header->vertexOffset);
+}
+
+bool CookedScene::write(const std::string &cookedPath,
+                        const std::string &sourcePath,
+                        const CookedSceneData &data) {
+  CookedSceneHeader header{};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.sourceStamp = stampSources(sourcePath, data.dependencies);
+  header.dependencyCount = static_cast<uint32_t>(data.dependencies.size());
+  header.nodeCount = static_cast<uint32_t>(data.nodes.size());
+  header.meshCount = static_cast<uint32_t>(data.meshes.size());
+  header.primitiveCount = static_cast<uint32_t>(data.primitives.size());
+  header.materialCount = static_cast<uint32_t>(data.materials.size());
+  header.textureCount = static_cast<uint32_t>(data.textureImages.size());
+  header.vertexStride = data.vertexStride;
+  header.flags = data.flags;
+  header.meshStats = data.meshStats;
+
+  // vertices predict from the same attribute of the block's first vertex,
+  // indices from the block minimum
+  std::vector<uint32_t> vertexStream = GpuCodec::encode(
+      static_cast<const uint32_t *>(data.vertexData),
+      data.vertexSize / sizeof(uint32_t),
+      data.vertexStreamPeriod ? data.vertexStreamPeriod
+                              : data.vertexStride / sizeof(uint32_t));
+  std::vector<uint32_t> indexStream =
+      GpuCodec::encode(static_cast<const uint32_t *>(data.indexData),
+                       data.indexSize / sizeof(uint32_t), 1);
+
+  uint64_t dependencyBytes = 0;
+  for (const auto &dependency : data.dependencies) {
+    dependencyBytes += sizeof(uint32_t) + dependency.size();
+  }
+  for (const auto &image : data.textureImages) {
+    dependencyBytes += sizeof(uint32_t) + image.size();
+  }
+
+  // lay the file out
+  uint64_t offset = alignUp(sizeof(CookedSceneHeader), kBlobAlignment);
+  header.dependencyOffset = offset;
+  offset = alignUp(offset + dependencyBytes, kBlobAlignment);
+  header.nodeOffset = offset;
+  offset = alignUp(offset + sizeof(CookedNode) * data.nodes.size(),
+                   kBlobAlignment);
+  header.nodeInstanceOffset = offset;
+  header.nodeInstanceCount = data.nodeInstances.size();
+  offset = alignUp(offset + sizeof(CookedInstance) * data.nodeInstances.size(),
+                   kBlobAlignment);
+  header.batchMemberOffset = offset;
+  header.batchMemberCount = data.batchMembers.size();
+  offset = alignUp(offset +
+                       sizeof(CookedBatchMember) * data.batchMembers.size(),
+                   kBlobAlignment);
+  header.meshOffset = offset;
+  offset = alignUp(offset + sizeof(CookedMesh) * data.meshes.size(),
+                   kBlobAlignment);
+  header.primitiveOffset = offset;
+  offset = alignUp(offset + sizeof(CookedPrimitive) * data.primitives.size(),
+                   kBlobAlignment);
+  header.materialOffset = offset;
+  offset = alignUp(offset + sizeof(CookedMaterial) * data.materials.size(),
+                   kBlobAlignment);
+  header.meshletOffset = offset;
+  header.meshletCount = data.meshlets.size();
+  offset = alignUp(offset + sizeof(CookedMeshlet) * data.meshlets.size(),
+                   kBlobAlignment);
+  header.meshletVertexOffset = offset;
+  header.meshletVertexCount = data.meshletVertices.size();
+  offset = alignUp(offset + sizeof(uint32_t) * data.meshletVertices.size(),
+                   kBlobAlignment);
+  header.meshletTriangleOffset = offset;
+  header.meshletTriangleSize = data.meshletTriangles.size();
+  offset = alignUp(offset + data.meshletTriangles.size(), kBlobAlignment);
+  header.impostorGroupOffset = offset;
+  header.impostorGroupCount = data.impostorGroups.size();
+  offset = alignUp(offset + sizeof(CookedImpostorGroup) *
+                                data.impostorGroups.size(),
+                   kBlobAlignment);
+  header.impostorTexelOffset = offset;
+  header.impostorTexelCount = data.impostorTexels.size();
+  offset = alignUp(offset + sizeof(uint32_t) * data.impostorTexels.size(),
+                   kBlobAlignment);
+  header.vertexOffset = offset;
+  header.vertexSize = data.vertexSize;
+  header.vertexStreamSize = vertexStream.size() * sizeof(uint32_t);
+  offset = alignUp(offset + header.vertexStreamSize, kBlobAlignment);
+  header.indexOffset = offset;
+  header.indexSize = data.indexSize;
+  header.indexStreamSize = indexStream.size() * sizeof(uint32_t);
+
+  // write to a temporary file and rename, so a crash never leaves a torn
+  // cooked file that would pass the header checks
+  std::string tempPath = cookedPath + ".tmp";
+  std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "Warning: cannot write cooked scene " << cookedPath
+              << std::endl;
+    return false;
+  }
+
+  auto writeAt = [&out](uint64_t position, const void *bytes, uint64_t size) {
+    static const char zeros[kBlobAlignment] = {};
+    uint64_t current = static_cast<uint64_t>(out.tellp());
+    while (current < position) {
+      uint64_t padding = std::min<uint64_t>(position - current, kBlobAlignment);
+      out.write(zeros, static_cast<std::streamsize>(padding));
+      current += padding;
+    }
+    if (size > 0) {
+      out.write(static_cast<const char *>(bytes),
+                static_cast<std::streamsize>(size));
+    }
+  };
+
+  writeAt(0, &header, sizeof(header));
+  writeAt(header.dependencyOffset, nullptr, 0);
+  auto writeString = [&](const std::string &text) {
+    uint32_t length = static_cast<uint32_t>(text.size());
+    out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+    out.write(text.data(), length);
+  };
+  for (const auto &dependency : data.dependencies) {
+    writeString(dependency);
+  }
+  for (const auto &image : data.textureImages) {
+    writeString(image);
+  }
+  writeAt(header.nodeOffset, data.nodes.data(),
+          sizeof(CookedNode) * data.nodes.size());
+  writeAt(header.nodeInstanceOffset, data.nodeInstances.data(),
+          sizeof(CookedInstance) * data.nodeInstances.size());
+  writeAt(header.batchMemberOffset, data.batchMembers.data(),
+          sizeof(CookedBatchMember) * data.batchMembers.size());
+  writeAt(header.meshOffset, data.meshes.data(),
+          sizeof(CookedMesh) * data.meshes.size());
+  writeAt(header.primitiveOffset, data.primitives.data(),
+          sizeof(CookedPrimitive) * data.primitives.size());
+  writeAt(header.materialOffset, data.materials.data(),
+          sizeof(CookedMaterial) * data.materials.size());
+  writeAt(header.meshletOffset, data.meshlets.data(),
+          sizeof(CookedMeshlet) * data.meshlets.size());
+  writeAt(header.meshletVertexOffset, data.meshletVertices.data(),
+          sizeof(uint32_t) * data.meshletVertices.size());
+  writeAt(header.meshletTriangleOffset, data.meshletTriangles.data(),
+          data.meshletTriangles.size());
+  writeAt(header.impostorGroupOffset, data.impostorGroups.data(),
+          sizeof(CookedImpostorGroup) * data.impostorGroups.size());
+  writeAt(header.impostorTexelOffset, data.impostorTexels.data(),
+          sizeof(uint32_t) * data.impostorTexels.size());
+  writeAt(header.vertexOffset, vertexStream.data(), header.vertexStreamSize);
+  writeAt(header.indexOffset, indexStream.data(), header.indexStreamSize);
+  out.close();
+
+  if (!out) {
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  std::error_code error;
+  std::filesystem::rename(tempPath, cookedPath, error);
+  return !error;
+}
+} // namespace hiddenpiggy
@@ -0,0 +1,144 @@
+#include "GltfFileSystem.hpp"
+#include "AssetPack.hpp"
+#include "GltfJsonParser.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+
+namespace hiddenpiggy {
+namespace GltfFileSystem {
+
+namespace {
+// copy granularity; pages behind the copy are dropped after every chunk so
+// large buffers never keep both the file and its copy resident
+constexpr size_t kCopyChunkSize = 64 * 1024 * 1024;
+
+bool readWholeFile(std::vector<unsigned char> *out, std::string *err,
+                   const std::string &filepath, void *) {
+  return readFile(filepath, out, err);
+}
+
+// tinygltf asks before every read
+bool fileExists(const std::string &abs_filename, void *user_data) {
+  return AssetPack::isMounted(abs_filename) ||
+         tinygltf::FileExists(abs_filename, user_data);
+}
+
+// images are decoded by the caller from its own data, keep none of it here
+bool skipImageLoad(tinygltf::Image *, const int, std::string *, std::string *,
+                   int, int, const unsigned char *, int, void *) {
+  return true;
+}
+
+std::string getBaseDirectory(const std::string &filename) {
+  return std::filesystem::path(filename).parent_path().string();
+}
+} // namespace
+
+bool readFile(const std::string &filepath, std::vector<unsigned char> *out,
+              std::string *err) {
+  if (AssetPack::isMounted(filepath)) {
+    return AssetPack::readMounted(filepath, out, err);
+  }
+  MappedFile file;
+  if (!file.open(filepath)) {
+    if (err) {
+      (*err) += "File open error : " + filepath + "\n";
+    }
+    return false;
+  }
+  file.adviseSequential();
+
+  // reserve and append, resize would zero fill the whole vector first
+  out->clear();
+  out->reserve(file.size());
+  for (size_t offset = 0; offset < file.size(); offset += kCopyChunkSize) {
+    size_t size = std::min(kCopyChunkSize, file.size() - offset);
+    out->insert(out->end(), file.data() + offset, file.data() + offset + size);
+    file.release(offset, size);
+  }
+  return true;
+}
+
+tinygltf::FsCallbacks getMappedCallbacks() {
+  tinygltf::FsCallbacks callbacks{};
+  callbacks.FileExists = &fileExists;
+  callbacks.ExpandFilePath = &tinygltf::ExpandFilePath;
+  callbacks.ReadWholeFile = &readWholeFile;
+  callbacks.WriteWholeFile = &tinygltf::WriteWholeFile;
+  callbacks.user_data = nullptr;
+  return callbacks;
+}
+
+bool loadModel(tinygltf::TinyGLTF &loader, tinygltf::Model *model,
+               std::string *err, std::string *warn,
+               const std::string &filename, bool loadImages) {
+  loader.SetFsCallbacks(getMappedCallbacks());
+  if (!loadImages) {
+    loader.SetImageLoader(&skipImageLoad, nullptr);
+  }
+
+  // packed files are decompressed into memory, loose ones are mapped
+  MappedFile file;
+  std::vector<unsigned char> packed;
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+  if (AssetPack::isMounted(filename)) {
+    if (!AssetPack::readMounted(filename, &packed, err)) {
+      return false;
+    }
+    data = packed.data();
+    size = packed.size();
+  } else {
+    if (!file.open(filename)) {
+      if (err) {
+        (*err) += "File open error : " + filename + "\n";
+      }
+      return false;
+    }
+    file.adviseSequential();
+    data = file.data();
+    size = file.size();
+  }
+
+  std::string baseDir = getBaseDirectory(filename);
+  bool binary = std::filesystem::path(filename).extension() == ".glb";
+  if (!binary) {
+    // the fast path declines files with extensions; anything it rejects gets
+    // a second, authoritative pass through tinygltf
+    if (GltfJsonParser::parse(reinterpret_cast<const char *>(data), size,
+                              baseDir, model, nullptr, loadImages)) {
+      return true;
+    }
+    *model = tinygltf::Model();
+  }
+  // tinygltf takes the length as unsigned int
+  if (size > std::numeric_limits<unsigned int>::max()) {
+    if (err) {
+      (*err) += "File too large for tinygltf (" + std::to_string(size) +
+                " bytes) : " + filename + "\n";
+    }
+    return false;
+  }
+  bool loaded =
+      binary ? loader.LoadBinaryFromMemory(model, err, warn, data,
+                                           static_cast<unsigned int>(size),
+                                           baseDir)
+             : loader.LoadASCIIFromString(
+                   model, err, warn, reinterpret_cast<const char *>(data),
+                   static_cast<unsigned int>(size), baseDir);
+  return loaded;
+}
+
+void releaseData(tinygltf::Model &model) {
+  for (auto &buffer : model.buffers) {
+    std::vector<unsigned char>().swap(buffer.data);
+  }
+  for (auto &image : model.images) {
+    std::vector<unsigned char>().swap(image.image);
+  }
+}
+
+} // namespace GltfFileSystem
+} // namespace hiddenpiggy
@@ -0,0 +1,1058 @@
+#include "GltfJsonParser.hpp"
+#include "AssetReader.hpp"
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hiddenpiggy {
+namespace GltfJsonParser {
+
+namespace {
+
+// Forward only cursor over the json text. Whitespace skipping and string
+// scanning look at 16 bytes at a time with sse2, everything else is a plain
+// recursive descent that hands values to the caller as they are reached.
+class JsonCursor {
+public:
+  JsonCursor(const char *data, size_t size)
+      : m_p(data), m_begin(data), m_end(data + size) {}
+
+  [[noreturn]] void fail(const std::string &what) const {
+    throw std::runtime_error("json: " + what + " at offset " +
+                             std::to_string(m_p - m_begin));
+  }
+
+  void skipWhitespace() {
+    // most runs are a single separator, stay scalar for those
+    if (m_p < m_end && !isWhitespace(*m_p)) {
+      return;
+    }
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    while (m_p + 16 <= m_end) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(m_p));
+      __m128i ws = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                       _mm_cmpeq_epi8(chunk, newline)),
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, carriage),
+                       _mm_cmpeq_epi8(chunk, tab)));
+      unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(ws)) & 0xFFFFu;
+      if (mask != 0) {
+        m_p += __builtin_ctz(mask);
+        return;
+      }
+      m_p += 16;
+    }
+#endif
+    while (m_p < m_end && isWhitespace(*m_p)) {
+      ++m_p;
+    }
+  }
+
+  char peek() {
+    skipWhitespace();
+    if (m_p >= m_end) {
+      fail("unexpected end of input");
+    }
+    return *m_p;
+  }
+
+  bool consume(char c) {
+    if (peek() == c) {
+      ++m_p;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!consume(c)) {
+      fail(std::string("expected '") + c + "'");
+    }
+  }
+
+  // contents between the quotes, escapes are left in place
+  std::string_view rawString(bool &escaped) {
+    expect('"');
+    const char *start = m_p;
+    escaped = false;
+    for (;;) {
+      const char *q = findQuoteOrBackslash(m_p);
+      if (q >= m_end) {
+        fail("unterminated string");
+      }
+      if (*q == '"') {
+        m_p = q + 1;
+        return {start, static_cast<size_t>(q - start)};
+      }
+      escaped = true;
+      m_p = q + 2;
+    }
+  }
+
+  std::string stringValue() {
+    bool escaped;
+    std::string_view raw = rawString(escaped);
+    return escaped ? unescape(raw) : std::string(raw);
+  }
+
+  double numberValue() {
+    skipWhitespace();
+    double value = 0.0;
+    auto [ptr, ec] = std::from_chars(m_p, m_end, value);
+    if (ec != std::errc()) {
+      fail("expected a number");
+    }
+    m_p = ptr;
+    return value;
+  }
+
+  int intValue() {
+    skipWhitespace();
+    int64_t value = 0;
+    auto [ptr, ec] = std::from_chars(m_p, m_end, value);
+    if (ec != std::errc()) {
+      fail("expected an integer");
+    }
+    // written as 1.0 or 1e3; still integral, take the slow path
+    if (ptr < m_end && (*ptr == '.' || *ptr == 'e' || *ptr == 'E')) {
+      return static_cast<int>(numberValue());
+    }
+    m_p = ptr;
+    return static_cast<int>(value);
+  }
+
+  size_t sizeValue() {
+    skipWhitespace();
+    uint64_t value = 0;
+    auto [ptr, ec] = std::from_chars(m_p, m_end, value);
+    if (ec != std::errc()) {
+      fail("expected an unsigned integer");
+    }
+    m_p = ptr;
+    return static_cast<size_t>(value);
+  }
+
+  bool boolValue() {
+    if (matchLiteral("true")) {
+      return true;
+    }
+    if (matchLiteral("false")) {
+      return false;
+    }
+    fail("expected a boolean");
+  }
+
+  template <typename F> void object(F &&onMember) {
+    expect('{');
+    if (consume('}')) {
+      return;
+    }
+    do {
+      bool escaped;
+      std::string_view key = rawString(escaped);
+      expect(':');
+      onMember(key);
+    } while (consume(','));
+    expect('}');
+  }
+
+  template <typename F> void array(F &&onElement) {
+    expect('[');
+    if (consume(']')) {
+      return;
+    }
+    size_t index = 0;
+    do {
+      onElement(index++);
+    } while (consume(','));
+    expect(']');
+  }
+
+  std::vector<double> numberArray() {
+    std::vector<double> values;
+    array([&](size_t) { values.push_back(numberValue()); });
+    return values;
+  }
+
+  std::vector<int> intArray() {
+    std::vector<int> values;
+    array([&](size_t) { values.push_back(intValue()); });
+    return values;
+  }
+
+  std::vector<std::string> stringArray() {
+    std::vector<std::string> values;
+    array([&](size_t) { values.push_back(stringValue()); });
+    return values;
+  }
+
+  void skipValue() {
+    char c = peek();
+    if (c == '"') {
+      bool escaped;
+      rawString(escaped);
+    } else if (c == '{' || c == '[') {
+      skipContainer();
+    } else if (c == 't' || c == 'f') {
+      boolValue();
+    } else if (matchLiteral("null")) {
+    } else {
+      numberValue();
+    }
+  }
+
+  bool atEnd() {
+    skipWhitespace();
+    return m_p >= m_end;
+  }
+
+private:
+  static bool isWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  const char *findQuoteOrBackslash(const char *p) const {
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    while (p + 16 <= m_end) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                       _mm_cmpeq_epi8(chunk, backslash))));
+      if (mask != 0) {
+        return p + __builtin_ctz(mask);
+      }
+      p += 16;
+    }
+#endif
+    while (p < m_end && *p != '"' && *p != '\\') {
+      ++p;
+    }
+    return p;
+  }
+
+  bool matchLiteral(const char *literal) {
+    skipWhitespace();
+    size_t length = strlen(literal);
+    if (static_cast<size_t>(m_end - m_p) >= length &&
+        memcmp(m_p, literal, length) == 0) {
+      m_p += length;
+      return true;
+    }
+    return false;
+  }
+
+  // skips a whole object or array by bracket depth, strings are jumped over
+  // so brackets inside them do not count
+  void skipContainer() {
+    int depth = 0;
+    while (m_p < m_end) {
+      char c = *m_p;
+      if (c == '"') {
+        bool escaped;
+        rawString(escaped);
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        ++depth;
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0) {
+          ++m_p;
+          return;
+        }
+      }
+      ++m_p;
+    }
+    fail("unterminated container");
+  }
+
+  static void appendUtf8(std::string &out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+      out += static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+      out += static_cast<char>(0xC0 | (codepoint >> 6));
+      out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+      out += static_cast<char>(0xE0 | (codepoint >> 12));
+      out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | (codepoint >> 18));
+      out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+      out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+  }
+
+  uint32_t hex4(std::string_view raw, size_t i) const {
+    if (i + 4 > raw.size()) {
+      fail("truncated unicode escape");
+    }
+    uint32_t value = 0;
+    auto [ptr, ec] =
+        std::from_chars(raw.data() + i, raw.data() + i + 4, value, 16);
+    if (ec != std::errc() || ptr != raw.data() + i + 4) {
+      fail("bad unicode escape");
+    }
+    return value;
+  }
+
+  std::string unescape(std::string_view raw) const {
+    std::string out;
+    out.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+      if (raw[i] != '\\') {
+        out += raw[i];
+        continue;
+      }
+      char c = raw[++i];
+      switch (c) {
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        uint32_t codepoint = hex4(raw, i + 1);
+        i += 4;
+        // surrogate pair
+        if (codepoint >= 0xD800 && codepoint < 0xDC00 && i + 6 < raw.size() &&
+            raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+          uint32_t low = hex4(raw, i + 3);
+          codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+          i += 6;
+        }
+        appendUtf8(out, codepoint);
+        break;
+      }
+      default:
+        // \" \\ \/
+        out += c;
+        break;
+      }
+    }
+    return out;
+  }
+
+  const char *m_p;
+  const char *m_begin;
+  const char *m_end;
+};
+
+int parseAccessorType(const std::string &type) {
+  if (type == "SCALAR") {
+    return TINYGLTF_TYPE_SCALAR;
+  } else if (type == "VEC2") {
+    return TINYGLTF_TYPE_VEC2;
+  } else if (type == "VEC3") {
+    return TINYGLTF_TYPE_VEC3;
+  } else if (type == "VEC4") {
+    return TINYGLTF_TYPE_VEC4;
+  } else if (type == "MAT2") {
+    return TINYGLTF_TYPE_MAT2;
+  } else if (type == "MAT3") {
+    return TINYGLTF_TYPE_MAT3;
+  } else if (type == "MAT4") {
+    return TINYGLTF_TYPE_MAT4;
+  }
+  throw std::runtime_error("json: unknown accessor type " + type);
+}
+
+template <typename T, typename F>
+void parseArray(JsonCursor &cursor, std::vector<T> &out, F &&parseOne) {
+  cursor.array([&](size_t) {
+    out.emplace_back();
+    parseOne(cursor, out.back());
+  });
+}
+
+void parseAsset(JsonCursor &cursor, tinygltf::Asset &asset) {
+  cursor.object([&](std::string_view key) {
+    if (key == "version") {
+      asset.version = cursor.stringValue();
+    } else if (key == "generator") {
+      asset.generator = cursor.stringValue();
+    } else if (key == "minVersion") {
+      asset.minVersion = cursor.stringValue();
+    } else if (key == "copyright") {
+      asset.copyright = cursor.stringValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseScene(JsonCursor &cursor, tinygltf::Scene &scene) {
+  cursor.object([&](std::string_view key) {
+    if (key == "name") {
+      scene.name = cursor.stringValue();
+    } else if (key == "nodes") {
+      scene.nodes = cursor.intArray();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseNode(JsonCursor &cursor, tinygltf::Node &node) {
+  cursor.object([&](std::string_view key) {
+    if (key == "name") {
+      node.name = cursor.stringValue();
+    } else if (key == "children") {
+      node.children = cursor.intArray();
+    } else if (key == "mesh") {
+      node.mesh = cursor.intValue();
+    } else if (key == "skin") {
+      node.skin = cursor.intValue();
+    } else if (key == "camera") {
+      node.camera = cursor.intValue();
+    } else if (key == "matrix") {
+      node.matrix = cursor.numberArray();
+    } else if (key == "translation") {
+      node.translation = cursor.numberArray();
+    } else if (key == "rotation") {
+      node.rotation = cursor.numberArray();
+    } else if (key == "scale") {
+      node.scale = cursor.numberArray();
+    } else if (key == "weights") {
+      node.weights = cursor.numberArray();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parsePrimitive(JsonCursor &cursor, tinygltf::Primitive &primitive) {
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  cursor.object([&](std::string_view key) {
+    if (key == "attributes") {
+      cursor.object([&](std::string_view attribute) {
+        primitive.attributes.emplace(std::string(attribute),
+                                     cursor.intValue());
+      });
+    } else if (key == "indices") {
+      primitive.indices = cursor.intValue();
+    } else if (key == "material") {
+      primitive.material = cursor.intValue();
+    } else if (key == "mode") {
+      primitive.mode = cursor.intValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseMesh(JsonCursor &cursor, tinygltf::Mesh &mesh) {
+  cursor.object([&](std::string_view key) {
+    if (key == "name") {
+      mesh.name = cursor.stringValue();
+    } else if (key == "primitives") {
+      parseArray(cursor, mesh.primitives, parsePrimitive);
+    } else if (key == "weights") {
+      mesh.weights = cursor.numberArray();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseSparse(JsonCursor &cursor, tinygltf::Accessor &accessor) {
+  auto &sparse = accessor.sparse;
+  sparse.isSparse = true;
+  cursor.object([&](std::string_view key) {
+    if (key == "count") {
+      sparse.count = cursor.intValue();
+    } else if (key == "indices") {
+      cursor.object([&](std::string_view member) {
+        if (member == "bufferView") {
+          sparse.indices.bufferView = cursor.intValue();
+        } else if (member == "byteOffset") {
+          sparse.indices.byteOffset = cursor.intValue();
+        } else if (member == "componentType") {
+          sparse.indices.componentType = cursor.intValue();
+        } else {
+          cursor.skipValue();
+        }
+      });
+    } else if (key == "values") {
+      cursor.object([&](std::string_view member) {
+        if (member == "bufferView") {
+          sparse.values.bufferView = cursor.intValue();
+        } else if (member == "byteOffset") {
+          sparse.values.byteOffset = cursor.intValue();
+        } else {
+          cursor.skipValue();
+        }
+      });
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseAccessor(JsonCursor &cursor, tinygltf::Accessor &accessor) {
+  cursor.object([&](std::string_view key) {
+    if (key == "bufferView") {
+      accessor.bufferView = cursor.intValue();
+    } else if (key == "byteOffset") {
+      accessor.byteOffset = cursor.sizeValue();
+    } else if (key == "normalized") {
+      accessor.normalized = cursor.boolValue();
+    } else if (key == "componentType") {
+      accessor.componentType = cursor.intValue();
+    } else if (key == "count") {
+      accessor.count = cursor.sizeValue();
+    } else if (key == "type") {
+      accessor.type = parseAccessorType(cursor.stringValue());
+    } else if (key == "min") {
+      accessor.minValues = cursor.numberArray();
+    } else if (key == "max") {
+      accessor.maxValues = cursor.numberArray();
+    } else if (key == "sparse") {
+      parseSparse(cursor, accessor);
+    } else if (key == "name") {
+      accessor.name = cursor.stringValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseBufferView(JsonCursor &cursor, tinygltf::BufferView &view) {
+  cursor.object([&](std::string_view key) {
+    if (key == "buffer") {
+      view.buffer = cursor.intValue();
+    } else if (key == "byteOffset") {
+      view.byteOffset = cursor.sizeValue();
+    } else if (key == "byteLength") {
+      view.byteLength = cursor.sizeValue();
+    } else if (key == "byteStride") {
+      view.byteStride = cursor.sizeValue();
+    } else if (key == "target") {
+      view.target = cursor.intValue();
+    } else if (key == "name") {
+      view.name = cursor.stringValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseBuffer(JsonCursor &cursor, tinygltf::Buffer &buffer,
+                 size_t &byteLength) {
+  cursor.object([&](std::string_view key) {
+    if (key == "uri") {
+      buffer.uri = cursor.stringValue();
+    } else if (key == "byteLength") {
+      byteLength = cursor.sizeValue();
+    } else if (key == "name") {
+      buffer.name = cursor.stringValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+// legacy untyped material value, still read by the vkglTF loader
+void parseParameter(JsonCursor &cursor, tinygltf::Parameter &parameter) {
+  char c = cursor.peek();
+  if (c == '"') {
+    parameter.string_value = cursor.stringValue();
+  } else if (c == '[') {
+    parameter.number_array = cursor.numberArray();
+  } else if (c == '{') {
+    cursor.object([&](std::string_view key) {
+      char v = cursor.peek();
+      if (v == '-' || (v >= '0' && v <= '9')) {
+        parameter.json_double_value[std::string(key)] = cursor.numberValue();
+      } else {
+        cursor.skipValue();
+      }
+    });
+  } else if (c == 't' || c == 'f') {
+    parameter.bool_value = cursor.boolValue();
+  } else {
+    parameter.number_value = cursor.numberValue();
+    parameter.has_number_value = true;
+  }
+}
+
+template <typename TextureInfo>
+void readTextureInfo(const tinygltf::ParameterMap &values, const char *name,
+                     TextureInfo &info) {
+  auto it = values.find(name);
+  if (it != values.end()) {
+    info.index = it->second.TextureIndex();
+    info.texCoord = it->second.TextureTexCoord();
+  }
+}
+
+double readNumber(const tinygltf::ParameterMap &values, const char *name,
+                  double fallback) {
+  auto it = values.find(name);
+  return it != values.end() && it->second.has_number_value
+             ? it->second.number_value
+             : fallback;
+}
+
+double readInfoNumber(const tinygltf::ParameterMap &values, const char *name,
+                      const char *member, double fallback) {
+  auto it = values.find(name);
+  if (it == values.end()) {
+    return fallback;
+  }
+  auto m = it->second.json_double_value.find(member);
+  return m != it->second.json_double_value.end() ? m->second : fallback;
+}
+
+// collects the values the same way tinygltf fills values/additionalValues,
+// then derives the typed fields from them
+void parseMaterial(JsonCursor &cursor, tinygltf::Material &material) {
+  cursor.object([&](std::string_view key) {
+    if (key == "name") {
+      material.name = cursor.stringValue();
+    } else if (key == "extensions" || key == "extras") {
+      cursor.skipValue();
+    } else if (key == "pbrMetallicRoughness") {
+      cursor.object([&](std::string_view member) {
+        tinygltf::Parameter parameter;
+        parseParameter(cursor, parameter);
+        material.values.emplace(std::string(member), std::move(parameter));
+      });
+    } else {
+      tinygltf::Parameter parameter;
+      parseParameter(cursor, parameter);
+      material.additionalValues.emplace(std::string(key),
+                                        std::move(parameter));
+    }
+  });
+
+  const auto &values = material.values;
+  const auto &additional = material.additionalValues;
+  auto &pbr = material.pbrMetallicRoughness;
+  auto baseColor = values.find("baseColorFactor");
+  if (baseColor != values.end() && baseColor->second.number_array.size() == 4) {
+    pbr.baseColorFactor = baseColor->second.number_array;
+  }
+  pbr.metallicFactor = readNumber(values, "metallicFactor", 1.0);
+  pbr.roughnessFactor = readNumber(values, "roughnessFactor", 1.0);
+  readTextureInfo(values, "baseColorTexture", pbr.baseColorTexture);
+  readTextureInfo(values, "metallicRoughnessTexture",
+                  pbr.metallicRoughnessTexture);
+
+  readTextureInfo(additional, "normalTexture", material.normalTexture);
+  material.normalTexture.scale =
+      readInfoNumber(additional, "normalTexture", "scale", 1.0);
+  readTextureInfo(additional, "occlusionTexture", material.occlusionTexture);
+  material.occlusionTexture.strength =
+      readInfoNumber(additional, "occlusionTexture", "strength", 1.0);
+  readTextureInfo(additional, "emissiveTexture", material.emissiveTexture);
+
+  auto emissive = additional.find("emissiveFactor");
+  material.emissiveFactor = emissive != additional.end() &&
+                                    emissive->second.number_array.size() == 3
+                                ? emissive->second.number_array
+                                : std::vector<double>{0.0, 0.0, 0.0};
+  auto alphaMode = additional.find("alphaMode");
+  if (alphaMode != additional.end()) {
+    material.alphaMode = alphaMode->second.string_value;
+  }
+  material.alphaCutoff = readNumber(additional, "alphaCutoff", 0.5);
+  auto doubleSided = additional.find("doubleSided");
+  material.doubleSided =
+      doubleSided != additional.end() && doubleSided->second.bool_value;
+}
+
+void parseTexture(JsonCursor &cursor, tinygltf::Texture &texture) {
+  cursor.object([&](std::string_view key) {
+    if (key == "sampler") {
+      texture.sampler = cursor.intValue();
+    } else if (key == "source") {
+      texture.source = cursor.intValue();
+    } else if (key == "name") {
+      texture.name = cursor.stringValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseImage(JsonCursor &cursor, tinygltf::Image &image) {
+  cursor.object([&](std::string_view key) {
+    if (key == "uri") {
+      image.uri = cursor.stringValue();
+    } else if (key == "bufferView") {
+      image.bufferView = cursor.intValue();
+    } else if (key == "mimeType") {
+      image.mimeType = cursor.stringValue();
+    } else if (key == "name") {
+      image.name = cursor.stringValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseSampler(JsonCursor &cursor, tinygltf::Sampler &sampler) {
+  cursor.object([&](std::string_view key) {
+    if (key == "minFilter") {
+      sampler.minFilter = cursor.intValue();
+    } else if (key == "magFilter") {
+      sampler.magFilter = cursor.intValue();
+    } else if (key == "wrapS") {
+      sampler.wrapS = cursor.intValue();
+    } else if (key == "wrapT") {
+      sampler.wrapT = cursor.intValue();
+    } else if (key == "name") {
+      sampler.name = cursor.stringValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseSkin(JsonCursor &cursor, tinygltf::Skin &skin) {
+  cursor.object([&](std::string_view key) {
+    if (key == "name") {
+      skin.name = cursor.stringValue();
+    } else if (key == "skeleton") {
+      skin.skeleton = cursor.intValue();
+    } else if (key == "joints") {
+      skin.joints = cursor.intArray();
+    } else if (key == "inverseBindMatrices") {
+      skin.inverseBindMatrices = cursor.intValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseAnimationChannel(JsonCursor &cursor,
+                           tinygltf::AnimationChannel &channel) {
+  cursor.object([&](std::string_view key) {
+    if (key == "sampler") {
+      channel.sampler = cursor.intValue();
+    } else if (key == "target") {
+      cursor.object([&](std::string_view member) {
+        if (member == "node") {
+          channel.target_node = cursor.intValue();
+        } else if (member == "path") {
+          channel.target_path = cursor.stringValue();
+        } else {
+          cursor.skipValue();
+        }
+      });
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseAnimationSampler(JsonCursor &cursor,
+                           tinygltf::AnimationSampler &sampler) {
+  cursor.object([&](std::string_view key) {
+    if (key == "input") {
+      sampler.input = cursor.intValue();
+    } else if (key == "output") {
+      sampler.output = cursor.intValue();
+    } else if (key == "interpolation") {
+      sampler.interpolation = cursor.stringValue();
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseAnimation(JsonCursor &cursor, tinygltf::Animation &animation) {
+  cursor.object([&](std::string_view key) {
+    if (key == "name") {
+      animation.name = cursor.stringValue();
+    } else if (key == "channels") {
+      parseArray(cursor, animation.channels, parseAnimationChannel);
+    } else if (key == "samplers") {
+      parseArray(cursor, animation.samplers, parseAnimationSampler);
+    } else {
+      cursor.skipValue();
+    }
+  });
+}
+
+void parseRoot(JsonCursor &cursor, tinygltf::Model &model,
+               std::vector<size_t> &bufferLengths) {
+  cursor.object([&](std::string_view key) {
+    if (key == "asset") {
+      parseAsset(cursor, model.asset);
+    } else if (key == "scene") {
+      model.defaultScene = cursor.intValue();
+    } else if (key == "scenes") {
+      parseArray(cursor, model.scenes, parseScene);
+    } else if (key == "nodes") {
+      parseArray(cursor, model.nodes, parseNode);
+    } else if (key == "meshes") {
+      parseArray(cursor, model.meshes, parseMesh);
+    } else if (key == "accessors") {
+      parseArray(cursor, model.accessors, parseAccessor);
+    } else if (key == "bufferViews") {
+      parseArray(cursor, model.bufferViews, parseBufferView);
+    } else if (key == "buffers") {
+      cursor.array([&](size_t) {
+        model.buffers.emplace_back();
+        bufferLengths.push_back(0);
+        parseBuffer(cursor, model.buffers.back(), bufferLengths.back());
+      });
+    } else if (key == "materials") {
+      parseArray(cursor, model.materials, parseMaterial);
+    } else if (key == "textures") {
+      parseArray(cursor, model.textures, parseTexture);
+    } else if (key == "images") {
+      parseArray(cursor, model.images, parseImage);
+    } else if (key == "samplers") {
+      parseArray(cursor, model.samplers, parseSampler);
+    } else if (key == "skins") {
+      parseArray(cursor, model.skins, parseSkin);
+    } else if (key == "animations") {
+      parseArray(cursor, model.animations, parseAnimation);
+    } else if (key == "extensionsUsed") {
+      model.extensionsUsed = cursor.stringArray();
+    } else if (key == "extensionsRequired") {
+      model.extensionsRequired = cursor.stringArray();
+    } else {
+      cursor.skipValue();
+    }
+  });
+  if (!cursor.atEnd()) {
+    cursor.fail("trailing characters");
+  }
+}
+
+// tinygltf infers the missing bufferView targets from how meshes use them
+void inferTargets(tinygltf::Model &model) {
+  auto setTarget = [&](int accessor, int target) {
+    if (accessor < 0 || accessor >= static_cast<int>(model.accessors.size())) {
+      return;
+    }
+    int view = model.accessors[accessor].bufferView;
+    if (view >= 0 && view < static_cast<int>(model.bufferViews.size()) &&
+        model.bufferViews[view].target == 0) {
+      model.bufferViews[view].target = target;
+    }
+  };
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      setTarget(primitive.indices, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+      for (const auto &attribute : primitive.attributes) {
+        setTarget(attribute.second, TINYGLTF_TARGET_ARRAY_BUFFER);
+      }
+    }
+  }
+}
+
+bool base64Decode(std::string_view in, std::vector<unsigned char> &out) {
+  static const auto table = [] {
+    std::array<int8_t, 256> t{};
+    t.fill(-1);
+    const char *alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 64; ++i) {
+      t[static_cast<unsigned char>(alphabet[i])] = static_cast<int8_t>(i);
+    }
+    return t;
+  }();
+  out.clear();
+  out.reserve(in.size() / 4 * 3);
+  uint32_t accumulator = 0;
+  int bits = 0;
+  for (char c : in) {
+    if (c == '=') {
+      break;
+    }
+    int8_t value = table[static_cast<unsigned char>(c)];
+    if (value < 0) {
+      return false;
+    }
+    accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<unsigned char>(accumulator >> bits));
+    }
+  }
+  return true;
+}
+
+std::string percentDecode(const std::string &uri) {
+  std::string out;
+  out.reserve(uri.size());
+  for (size_t i = 0; i < uri.size(); ++i) {
+    unsigned value = 0;
+    if (uri[i] == '%' && i + 2 < uri.size() &&
+        std::from_chars(uri.data() + i + 1, uri.data() + i + 3, value, 16)
+                .ptr == uri.data() + i + 3) {
+      out += static_cast<char>(value);
+      i += 2;
+    } else {
+      out += uri[i];
+    }
+  }
+  return out;
+}
+
+bool isDataUri(const std::string &uri) { return uri.rfind("data:", 0) == 0; }
+
+void decodeDataUri(const std::string &uri, std::vector<unsigned char> &out) {
+  size_t comma = uri.find(',');
+  if (comma == std::string::npos || comma < 7 ||
+      uri.compare(comma - 7, 7, ";base64") != 0 ||
+      !base64Decode(std::string_view(uri).substr(comma + 1), out)) {
+    throw std::runtime_error("unsupported data uri");
+  }
+}
+
+// every external buffer and image goes out as one batch, so the reads overlap
+// instead of each file waiting for the one before it
+void loadExternalData(tinygltf::Model &model, const std::string &baseDir,
+                      bool loadImages) {
+  AssetReader reader;
+  // indexed by ticket, which the reader hands out in order
+  std::vector<std::vector<unsigned char> *> targets;
+  auto request = [&](const std::string &uri, std::vector<unsigned char> &out) {
+    if (isDataUri(uri)) {
+      decodeDataUri(uri, out);
+      return;
+    }
+    if (targets.empty()) {
+      reader.OnCreate();
+    }
+    std::string path = baseDir.empty() ? percentDecode(uri)
+                                       : baseDir + "/" + percentDecode(uri);
+    reader.submit(path);
+    targets.push_back(&out);
+  };
+
+  for (auto &buffer : model.buffers) {
+    if (buffer.uri.empty()) {
+      throw std::runtime_error("buffer without uri outside of a glb");
+    }
+    request(buffer.uri, buffer.data);
+  }
+  if (loadImages) {
+    for (auto &image : model.images) {
+      if (image.bufferView < 0) {
+        request(image.uri, image.image);
+      }
+    }
+  }
+
+  AssetReader::Completion completion;
+  while (reader.wait(completion)) {
+    if (!completion.error.empty()) {
+      throw std::runtime_error(completion.error);
+    }
+    *targets[completion.ticket] = std::move(completion.data);
+  }
+}
+
+void checkBufferLengths(tinygltf::Model &model,
+                        const std::vector<size_t> &bufferLengths) {
+  for (size_t i = 0; i < model.buffers.size(); ++i) {
+    tinygltf::Buffer &buffer = model.buffers[i];
+    if (buffer.data.size() < bufferLengths[i]) {
+      throw std::runtime_error("buffer " + buffer.uri + " is too short");
+    }
+    buffer.data.resize(bufferLengths[i]);
+  }
+}
+
+// the loaders index straight into these arrays, so reject anything that would
+// read out of bounds here instead of trusting the file
+void validateReferences(const tinygltf::Model &model) {
+  for (const auto &view : model.bufferViews) {
+    if (view.buffer < 0 ||
+        view.buffer >= static_cast<int>(model.buffers.size()) ||
+        view.byteOffset + view.byteLength >
+            model.buffers[view.buffer].data.size()) {
+      throw std::runtime_error("buffer view out of range");
+    }
+  }
+  auto checkView = [&](int view) {
+    if (view >= static_cast<int>(model.bufferViews.size())) {
+      throw std::runtime_error("buffer view index out of range");
+    }
+  };
+  for (const auto &accessor : model.accessors) {
+    checkView(accessor.bufferView);
+    if (accessor.sparse.isSparse) {
+      checkView(accessor.sparse.indices.bufferView);
+      checkView(accessor.sparse.values.bufferView);
+    }
+  }
+  for (const auto &image : model.images) {
+    checkView(image.bufferView);
+  }
+}
+
+// images stay encoded, decoding is up to the loader. External files were
+// read together with the buffers, only the embedded ones are copied here
+void loadImageData(tinygltf::Model &model) {
+  for (auto &image : model.images) {
+    if (image.bufferView >= 0) {
+      const tinygltf::BufferView &view = model.bufferViews[image.bufferView];
+      const auto &data = model.buffers[view.buffer].data;
+      image.image.assign(data.begin() + view.byteOffset,
+                         data.begin() + view.byteOffset + view.byteLength);
+    }
+    image.as_is = true;
+  }
+}
+} // namespace
+
+bool parse(const char *json, size_t size, const std::string &baseDir,
+           tinygltf::Model *model, std::string *err, bool loadImages) {
+  try {
+    JsonCursor cursor(json, size);
+    std::vector<size_t> bufferLengths;
+    parseRoot(cursor, *model, bufferLengths);
+    if (!model->extensionsUsed.empty()) {
+      if (err) {
+        (*err) += "extensions are not handled by the fast parser\n";
+      }
+      return false;
+    }
+    inferTargets(*model);
+    loadExternalData(*model, baseDir, loadImages);
+    checkBufferLengths(*model, bufferLengths);
+    validateReferences(*model);
+    if (loadImages) {
+      loadImageData(*model);
+    }
+  } catch (const std::exception &e) {
+    if (err) {
+      (*err) += std::string(e.what()) + "\n";
+    }
+    return false;
+  }
+  return true;
+}
+
+} // namespace GltfJsonParser
+} // namespace hiddenpiggy
@@ -0,0 +1,195 @@
+#include "GpuCodec.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace hiddenpiggy {
+namespace GpuCodec {
+
+namespace {
+uint32_t bitWidth(uint32_t value) {
+  return static_cast<uint32_t>(32 - std::countl_zero(value));
+}
+
+uint32_t packedWords(uint32_t count, uint32_t bits) {
+  return static_cast<uint32_t>((uint64_t(count) * bits + 31) / 32);
+}
+
+void pack(const std::vector<uint32_t> &residuals, uint32_t bits,
+          std::vector<uint32_t> &out) {
+  size_t start = out.size();
+  out.resize(
+      start + packedWords(static_cast<uint32_t>(residuals.size()), bits), 0);
+  if (bits == 0) {
+    return;
+  }
+  for (size_t i = 0; i < residuals.size(); ++i) {
+    uint64_t bitPosition = uint64_t(i) * bits;
+    size_t word = start + bitPosition / 32;
+    uint32_t shift = bitPosition % 32;
+    out[word] |= residuals[i] << shift;
+    if (shift + bits > 32) {
+      out[word + 1] |= residuals[i] >> (32 - shift);
+    }
+  }
+}
+
+uint32_t unpack(const uint32_t *packed, uint32_t index, uint32_t bits) {
+  if (bits == 0) {
+    return 0;
+  }
+  uint64_t bitPosition = uint64_t(index) * bits;
+  const uint32_t *word = packed + bitPosition / 32;
+  uint32_t shift = bitPosition % 32;
+  uint32_t value = word[0] >> shift;
+  if (shift + bits > 32) {
+    value |= word[1] << (32 - shift);
+  }
+  return bits == 32 ? value : value & ((1u << bits) - 1);
+}
+
+uint32_t blockWordCount(const StreamInfo &info, uint32_t block) {
+  return std::min(kBlockWords, info.wordCount - block * kBlockWords);
+}
+
+uint32_t anchorCount(const StreamInfo &info, uint32_t count) {
+  return std::min(info.stride, count);
+}
+
+// encoded size of a block from its header, the decoder's view of the layout
+uint32_t blockSize(const StreamInfo &info, uint32_t count, uint32_t header) {
+  uint32_t mode = header & 0xff;
+  uint32_t bits = header >> 8;
+  if (mode == kModeOffset) {
+    return 2 + packedWords(count, bits);
+  }
+  uint32_t anchors = anchorCount(info, count);
+  return 1 + anchors + packedWords(count - anchors, bits);
+}
+
+void encodeBlock(const uint32_t *words, uint32_t count, uint32_t stride,
+                 std::vector<uint32_t> &out) {
+  auto [minIt, maxIt] = std::minmax_element(words, words + count);
+  uint32_t offsetBits = bitWidth(*maxIt - *minIt);
+  uint32_t offsetSize = 2 + packedWords(count, offsetBits);
+
+  uint32_t anchors = std::min(stride, count);
+  uint32_t anchorBits = 0;
+  for (uint32_t i = anchors; i < count; ++i) {
+    anchorBits = std::max(anchorBits, bitWidth(words[i] ^ words[i % stride]));
+  }
+  uint32_t anchorSize = 1 + anchors + packedWords(count - anchors, anchorBits);
+
+  std::vector<uint32_t> residuals;
+  if (stride > 1 && anchorSize < offsetSize) {
+    out.push_back(kModeAnchor | (anchorBits << 8));
+    out.insert(out.end(), words, words + anchors);
+    for (uint32_t i = anchors; i < count; ++i) {
+      residuals.push_back(words[i] ^ words[i % stride]);
+    }
+    pack(residuals, anchorBits, out);
+  } else {
+    out.push_back(kModeOffset | (offsetBits << 8));
+    out.push_back(*minIt);
+    for (uint32_t i = 0; i < count; ++i) {
+      residuals.push_back(words[i] - *minIt);
+    }
+    pack(residuals, offsetBits, out);
+  }
+}
+} // namespace
+
+std::vector<uint32_t> encode(const uint32_t *words, size_t wordCount,
+                             uint32_t stride) {
+  uint32_t count = static_cast<uint32_t>(wordCount);
+  uint32_t blockCount = (count + kBlockWords - 1) / kBlockWords;
+  std::vector<uint32_t> out{count, std::max(1u, stride), blockCount};
+  size_t tableStart = out.size();
+  out.resize(tableStart + blockCount + 1);
+  size_t blocksStart = out.size();
+  for (uint32_t block = 0; block < blockCount; ++block) {
+    out[tableStart + block] = static_cast<uint32_t>(out.size() - blocksStart);
+    encodeBlock(words + size_t(block) * kBlockWords,
+                std::min(kBlockWords, count - block * kBlockWords),
+                std::max(1u, stride), out);
+  }
+  out[tableStart + blockCount] = static_cast<uint32_t>(out.size() - blocksStart);
+  return out;
+}
+
+bool readInfo(std::span<const uint32_t> stream, StreamInfo &info) {
+  if (stream.size() < kHeaderWords) {
+    return false;
+  }
+  info = {stream[0], stream[1], stream[2]};
+  return info.stride > 0 &&
+         info.blockCount == (uint64_t(info.wordCount) + kBlockWords - 1) /
+                                kBlockWords &&
+         stream.size() - kHeaderWords >= uint64_t(info.blockCount) + 1;
+}
+
+std::span<const uint32_t> getBlockTable(std::span<const uint32_t> stream) {
+  return stream.subspan(kHeaderWords, stream[2] + 1);
+}
+
+bool validate(std::span<const uint32_t> stream) {
+  StreamInfo info{};
+  if (!readInfo(stream, info)) {
+    return false;
+  }
+  auto table = getBlockTable(stream);
+  auto blocks = stream.subspan(kHeaderWords + table.size());
+  if (table[0] != 0 || table[info.blockCount] != blocks.size()) {
+    return false;
+  }
+  for (uint32_t block = 0; block < info.blockCount; ++block) {
+    if (table[block] >= table[block + 1] ||
+        table[block + 1] > blocks.size()) {
+      return false;
+    }
+    uint32_t header = blocks[table[block]];
+    if ((header & 0xff) > kModeAnchor || (header >> 8) > 32 ||
+        blockSize(info, blockWordCount(info, block), header) !=
+            table[block + 1] - table[block]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool decodeRange(std::span<const uint32_t> stream, uint32_t firstWord,
+                 uint32_t endWord, uint32_t *dst) {
+  StreamInfo info{};
+  if (!readInfo(stream, info) || firstWord > endWord ||
+      endWord > info.wordCount) {
+    return false;
+  }
+  auto table = getBlockTable(stream);
+  const uint32_t *blocks = stream.data() + kHeaderWords + table.size();
+  for (uint32_t word = firstWord; word < endWord;) {
+    uint32_t block = word / kBlockWords;
+    uint32_t count = blockWordCount(info, block);
+    const uint32_t *data = blocks + table[block];
+    uint32_t mode = data[0] & 0xff;
+    uint32_t bits = data[0] >> 8;
+    uint32_t blockEnd = std::min(endWord, block * kBlockWords + count);
+    for (; word < blockEnd; ++word) {
+      uint32_t lane = word - block * kBlockWords;
+      if (mode == kModeOffset) {
+        dst[word - firstWord] = data[1] + unpack(data + 2, lane, bits);
+        continue;
+      }
+      uint32_t anchors = anchorCount(info, count);
+      if (lane < anchors) {
+        dst[word - firstWord] = data[1 + lane];
+      } else {
+        dst[word - firstWord] =
+            data[1 + lane % info.stride] ^
+            unpack(data + 1 + anchors, lane - anchors, bits);
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace GpuCodec
+} // namespace hiddenpiggy
@@ -0,0 +1,392 @@
+#include "GpuDecompressor.hpp"
+#include "VkShaderModuleFactory.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace hiddenpiggy {
+
+namespace {
+// the spec guarantees at least this many groups per dimension
+constexpr uint32_t kMaxGroupCount = 65535;
+// dispatches per submit before a batch is flushed early
+constexpr uint32_t kMaxBatchDispatches = 64;
+} // namespace
+
+void GpuDecompressor::OnCreate(bool allowGpu) {
+  if (!allowGpu) {
+    return;
+  }
+  if (!createPipeline()) {
+    std::cerr << "Warning: gpu decompression unavailable, decoding on the cpu"
+              << std::endl;
+    return;
+  }
+  if (!selfTest()) {
+    std::cerr << "Warning: gpu decompression does not match the reference "
+                 "decoder, decoding on the cpu"
+              << std::endl;
+    destroyPipeline();
+  }
+}
+
+void GpuDecompressor::OnDestroy() {
+  destroyPipeline();
+  if (m_stagingSize > 0) {
+    m_pBufferPool->freeBuffer(m_staging);
+    m_stagingSize = 0;
+  }
+}
+
+bool GpuDecompressor::createPipeline() {
+  vk::Device device = m_pContext->getDevice();
+  m_storageAlignment = std::max<vk::DeviceSize>(
+      4, m_pContext->getPhysicalDevice()
+             .getProperties()
+             .limits.minStorageBufferOffsetAlignment);
+
+  // compressed input and decoded output
+  std::array<vk::DescriptorSetLayoutBinding, 2> bindings{
+      vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eCompute},
+      vk::DescriptorSetLayoutBinding{1, vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eCompute}};
+  m_descriptorSetLayout = device.createDescriptorSetLayout(
+      vk::DescriptorSetLayoutCreateInfo{{}, bindings});
+
+  vk::DescriptorPoolSize poolSize{vk::DescriptorType::eStorageBuffer,
+                                  2 * kMaxBatchDispatches};
+  m_descriptorPool = device.createDescriptorPool(
+      vk::DescriptorPoolCreateInfo{{}, kMaxBatchDispatches, poolSize});
+  std::vector<vk::DescriptorSetLayout> setLayouts(kMaxBatchDispatches,
+                                                  m_descriptorSetLayout);
+  m_descriptorSets = device.allocateDescriptorSets(
+      vk::DescriptorSetAllocateInfo{m_descriptorPool, setLayouts});
+
+  vk::PushConstantRange pushConstantRange{vk::ShaderStageFlagBits::eCompute, 0,
+                                          sizeof(DecodeConstants)};
+  m_pipelineLayout = device.createPipelineLayout(
+      vk::PipelineLayoutCreateInfo{{}, m_descriptorSetLayout, pushConstantRange});
+
+  m_pipeline = buildPipeline();
+  if (!m_pipeline) {
+    destroyPipeline();
+    return false;
+  }
+
+  // batches are waited on at endBatch like the other uploads, one command
+  // buffer does
+  m_commandPool = device.createCommandPool(vk::CommandPoolCreateInfo{
+      vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+      m_pContext->getQueueFamilyIndices().graphicsFamilyIndex.value()});
+  m_commandBuffer = device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+      m_commandPool, vk::CommandBufferLevel::ePrimary, 1})[0];
+  m_fence = device.createFence(vk::FenceCreateInfo{});
+  return true;
+}
+
+vk::Pipeline GpuDecompressor::buildPipeline() {
+  vk::Device device = m_pContext->getDevice();
+  vk::ShaderModule shaderModule;
+  try {
+    shaderModule = VkShaderModuleFactory::CreateShaderModule(
+        device,
+        (std::string{SHADERS_PATH} + std::string{"decompress.spv"}).c_str());
+  } catch (const std::exception &) {
+    return nullptr;
+  }
+
+  vk::ComputePipelineCreateInfo pipelineCreateInfo{
+      {},
+      vk::PipelineShaderStageCreateInfo{
+          {}, vk::ShaderStageFlagBits::eCompute, shaderModule, "main"},
+      m_pipelineLayout};
+  auto result = device.createComputePipeline(nullptr, pipelineCreateInfo);
+  device.destroyShaderModule(shaderModule);
+  if (result.result != vk::Result::eSuccess) {
+    return nullptr;
+  }
+  return result.value;
+}
+
+bool GpuDecompressor::reloadShaders() {
+  if (!m_pipeline) {
+    return false;
+  }
+  vk::Pipeline pipeline = buildPipeline();
+  if (!pipeline) {
+    return false;
+  }
+  // batches wait for their fence, so nothing still uses the old pipeline
+  vk::Device device = m_pContext->getDevice();
+  vk::Pipeline oldPipeline = m_pipeline;
+  m_pipeline = pipeline;
+  if (!selfTest()) {
+    m_pipeline = oldPipeline;
+    device.destroyPipeline(pipeline);
+    return false;
+  }
+  device.destroyPipeline(oldPipeline);
+  return true;
+}
+
+void GpuDecompressor::destroyPipeline() {
+  vk::Device device = m_pContext->getDevice();
+  if (m_fence) {
+    device.destroyFence(m_fence);
+    m_fence = nullptr;
+  }
+  if (m_commandPool) {
+    device.destroyCommandPool(m_commandPool);
+    m_commandPool = nullptr;
+    m_commandBuffer = nullptr;
+  }
+  if (m_pipeline) {
+    device.destroyPipeline(m_pipeline);
+    m_pipeline = nullptr;
+  }
+  if (m_pipelineLayout) {
+    device.destroyPipelineLayout(m_pipelineLayout);
+    m_pipelineLayout = nullptr;
+  }
+  if (m_descriptorPool) {
+    device.destroyDescriptorPool(m_descriptorPool);
+    m_descriptorPool = nullptr;
+    m_descriptorSets.clear();
+  }
+  if (m_descriptorSetLayout) {
+    device.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    m_descriptorSetLayout = nullptr;
+  }
+}
+
+bool GpuDecompressor::selfTest() {
+  // interleaved vertices for the anchor mode and noise for the offset mode,
+  // with a partial last block
+  constexpr uint32_t kStride = 10;
+  constexpr uint32_t kWordCount = 64 * 40 + 17;
+  std::vector<uint32_t> words(kWordCount);
+  uint32_t random = 0x9e3779b9u;
+  for (uint32_t i = 0; i < kWordCount; ++i) {
+    random = random * 1664525u + 1013904223u;
+    float value = static_cast<float>(i / kStride) * 0.25f +
+                  static_cast<float>(i % kStride);
+    memcpy(&words[i], &value, sizeof(value));
+    if (i >= kWordCount / 2) {
+      words[i] = random >> (i % 32);
+    }
+  }
+  std::vector<uint32_t> stream =
+      GpuCodec::encode(words.data(), words.size(), kStride);
+
+  vk::BufferCreateInfo bufferCreateInfo{
+      {}, kWordCount * sizeof(uint32_t),
+      vk::BufferUsageFlagBits::eStorageBuffer};
+  VmaAllocationCreateInfo allocCreateInfo{};
+  allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+  allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                          VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  BufferWrapper output =
+      m_pBufferPool->allocateMemory(bufferCreateInfo, allocCreateInfo);
+  VmaAllocationInfo outputInfo{};
+  vmaGetAllocationInfo(m_pBufferPool->getAllocator(), output.allocation,
+                       &outputInfo);
+  memset(outputInfo.pMappedData, 0, kWordCount * sizeof(uint32_t));
+
+  // two ranges that split blocks, like primitive boundaries do, in one batch
+  beginBatch();
+  decodeOnGpu(stream, 0, 1000, output);
+  decodeOnGpu(stream, 1000, kWordCount, output);
+  endBatch();
+  vmaInvalidateAllocation(m_pBufferPool->getAllocator(), output.allocation, 0,
+                          VK_WHOLE_SIZE);
+
+  std::vector<uint32_t> reference(kWordCount);
+  GpuCodec::decodeRange(stream, 0, kWordCount, reference.data());
+  bool matches = reference == words &&
+                 memcmp(outputInfo.pMappedData, reference.data(),
+                        kWordCount * sizeof(uint32_t)) == 0;
+  m_pBufferPool->freeBuffer(output);
+  return matches;
+}
+
+void GpuDecompressor::decode(std::span<const uint32_t> stream,
+                             uint32_t firstWord, uint32_t endWord,
+                             BufferWrapper &dst) {
+  if (firstWord >= endWord) {
+    return;
+  }
+  if (!isUsingGpu()) {
+    decodeOnCpu(stream, firstWord, endWord, dst);
+    return;
+  }
+  if (m_batchOpen) {
+    decodeOnGpu(stream, firstWord, endWord, dst);
+    return;
+  }
+  beginBatch();
+  decodeOnGpu(stream, firstWord, endWord, dst);
+  endBatch();
+}
+
+void GpuDecompressor::beginBatch() {
+  // a batch left open by an exception goes out first
+  endBatch();
+  m_batchOpen = true;
+}
+
+void GpuDecompressor::endBatch() {
+  submitBatch();
+  m_batchOpen = false;
+}
+
+void GpuDecompressor::decodeOnCpu(std::span<const uint32_t> stream,
+                                  uint32_t firstWord, uint32_t endWord,
+                                  BufferWrapper &dst) {
+  std::vector<uint32_t> words(endWord - firstWord);
+  if (!GpuCodec::decodeRange(stream, firstWord, endWord, words.data())) {
+    throw std::runtime_error("corrupt compressed stream");
+  }
+  m_pResourceUploadHeap->uploadBufferData(
+      words.data(), static_cast<uint32_t>(words.size() * sizeof(uint32_t)),
+      dst.buffer, dst.allocation, firstWord * sizeof(uint32_t));
+}
+
+void GpuDecompressor::reserveStaging(vk::DeviceSize size) {
+  if (size <= m_stagingSize) {
+    return;
+  }
+  if (m_stagingSize > 0) {
+    m_pBufferPool->freeBuffer(m_staging);
+  }
+  m_stagingSize = std::max(size, m_stagingSize * 2);
+  vk::BufferCreateInfo bufferCreateInfo{
+      {}, m_stagingSize, vk::BufferUsageFlagBits::eStorageBuffer};
+  VmaAllocationCreateInfo allocCreateInfo{};
+  allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+  allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                          VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  m_staging = m_pBufferPool->allocateMemory(bufferCreateInfo, allocCreateInfo);
+  vmaGetAllocationInfo(m_pBufferPool->getAllocator(), m_staging.allocation,
+                       &m_staging.allocationInfo);
+}
+
+void GpuDecompressor::decodeOnGpu(std::span<const uint32_t> stream,
+                                  uint32_t firstWord, uint32_t endWord,
+                                  BufferWrapper &dst) {
+  GpuCodec::StreamInfo info{};
+  if (!GpuCodec::readInfo(stream, info) || endWord > info.wordCount) {
+    throw std::runtime_error("corrupt compressed stream");
+  }
+  auto table = GpuCodec::getBlockTable(stream);
+  const uint32_t *blocks = stream.data() + GpuCodec::kHeaderWords + table.size();
+
+  // only the blocks overlapping the range are uploaded, with their slice of
+  // the block table in front
+  uint32_t firstBlock = firstWord / GpuCodec::kBlockWords;
+  uint32_t lastBlock = (endWord - 1) / GpuCodec::kBlockWords;
+  uint32_t blockCount = lastBlock - firstBlock + 1;
+  uint32_t tableWords = blockCount + 1;
+  uint32_t blockWords = table[lastBlock + 1] - table[firstBlock];
+  vk::DeviceSize stagingBytes =
+      (vk::DeviceSize(tableWords) + blockWords) * sizeof(uint32_t);
+  vk::DeviceSize stagingOffset =
+      (m_stagingUsed + m_storageAlignment - 1) / m_storageAlignment *
+      m_storageAlignment;
+  bool fits = stagingOffset + stagingBytes <= m_stagingSize;
+  if (!fits || m_batchDispatches == kMaxBatchDispatches) {
+    // the recorded dispatches still read the staging buffer; grow it so
+    // the next batch of this size goes out at once
+    submitBatch();
+    if (!fits) {
+      reserveStaging(stagingOffset + stagingBytes);
+    }
+    stagingOffset = 0;
+  }
+  m_stagingUsed = stagingOffset + stagingBytes;
+  auto *mapped = reinterpret_cast<uint32_t *>(
+      static_cast<uint8_t *>(m_staging.allocationInfo.pMappedData) +
+      stagingOffset);
+  memcpy(mapped, table.data() + firstBlock, tableWords * sizeof(uint32_t));
+  memcpy(mapped + tableWords, blocks + table[firstBlock],
+         blockWords * sizeof(uint32_t));
+
+  // storage buffer bindings need an aligned offset and a bounded range, so
+  // bind the output from just below firstWord
+  vk::DeviceSize outputOffset =
+      (vk::DeviceSize(firstWord) * sizeof(uint32_t)) / m_storageAlignment *
+      m_storageAlignment;
+  vk::DeviceSize outputRange =
+      vk::DeviceSize(endWord) * sizeof(uint32_t) - outputOffset;
+
+  vk::DescriptorSet descriptorSet = m_descriptorSets[m_batchDispatches];
+  vk::DescriptorBufferInfo inputInfo{m_staging.buffer, stagingOffset,
+                                     stagingBytes};
+  vk::DescriptorBufferInfo outputInfo{dst.buffer, outputOffset, outputRange};
+  std::array<vk::WriteDescriptorSet, 2> writes{
+      vk::WriteDescriptorSet{descriptorSet, 0, 0,
+                             vk::DescriptorType::eStorageBuffer, nullptr,
+                             inputInfo},
+      vk::WriteDescriptorSet{descriptorSet, 1, 0,
+                             vk::DescriptorType::eStorageBuffer, nullptr,
+                             outputInfo}};
+  // the batch that last used the set has been waited on
+  m_pContext->getDevice().updateDescriptorSets(writes, nullptr);
+
+  DecodeConstants constants{
+      firstBlock,     blockCount,  firstWord,
+      endWord,        info.wordCount, info.stride,
+      static_cast<uint32_t>(outputOffset / sizeof(uint32_t))};
+
+  if (m_batchDispatches == 0) {
+    m_commandBuffer.begin(vk::CommandBufferBeginInfo{
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    m_commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+  }
+  m_commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     m_pipelineLayout, 0, descriptorSet,
+                                     nullptr);
+  m_commandBuffer.pushConstants(m_pipelineLayout,
+                                vk::ShaderStageFlagBits::eCompute, 0,
+                                sizeof(constants), &constants);
+  // ranges never overlap, the dispatches need no barrier between them
+  m_commandBuffer.dispatch(std::min(blockCount, kMaxGroupCount), 1, 1);
+  ++m_batchDispatches;
+}
+
+void GpuDecompressor::submitBatch() {
+  if (m_batchDispatches == 0) {
+    return;
+  }
+  vmaFlushAllocation(m_pBufferPool->getAllocator(), m_staging.allocation, 0,
+                     m_stagingUsed);
+
+  // everything submitted later reads the decoded words as vertices, indices
+  // or, for the self test, from the host
+  vk::MemoryBarrier barrier{
+      vk::AccessFlagBits::eShaderWrite,
+      vk::AccessFlagBits::eVertexAttributeRead |
+          vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead |
+          vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eHostRead};
+  m_commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eVertexInput |
+          vk::PipelineStageFlagBits::eVertexShader |
+          vk::PipelineStageFlagBits::eComputeShader |
+          vk::PipelineStageFlagBits::eTransfer |
+          vk::PipelineStageFlagBits::eHost,
+      {}, barrier, nullptr, nullptr);
+  m_commandBuffer.end();
+
+  vk::SubmitInfo submitInfo({}, {}, m_commandBuffer);
+  m_pContext->getGraphicsQueue().submit(submitInfo, m_fence);
+  vk::Device device = m_pContext->getDevice();
+  (void)device.waitForFences(m_fence, VK_TRUE, UINT64_MAX);
+  device.resetFences(m_fence);
+  m_commandBuffer.reset();
+  m_batchDispatches = 0;
+  m_stagingUsed = 0;
+}
+} // namespace hiddenpiggy
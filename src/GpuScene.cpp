@@ -0,0 +1,332 @@
+#include "GpuScene.hpp"
+#include "SimdMath.hpp"
+#include "VkShaderModuleFactory.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace hiddenpiggy {
+
+namespace {
+// local_size_x of scene_cull.comp
+constexpr uint32_t kGroupSize = 64;
+// index types the commands are split by, see GpuInstance::indexType
+constexpr uint32_t kIndexTypeCount = 2;
+
+enum Binding : uint32_t {
+  kConstants = 0,
+  kInstances,
+  kTransforms,
+  kCommands,
+  kDrawCounts,
+  kHiddenTransforms,
+  kSelectedLods,
+  kBindingCount
+};
+} // namespace
+
+void GpuScene::OnCreate() {
+  if (!m_pContext->isMultiDrawIndirectSupported()) {
+    std::cerr << "Warning: no multi draw indirect, gpu driven drawing off"
+              << std::endl;
+    return;
+  }
+  m_drawIndirectCount = m_pContext->isDrawIndirectCountSupported();
+  vk::Device device = m_pContext->getDevice();
+
+  std::array<vk::DescriptorSetLayoutBinding, kBindingCount> bindings;
+  for (uint32_t i = 0; i < kBindingCount; ++i) {
+    bindings[i] = vk::DescriptorSetLayoutBinding{
+        i,
+        i == kConstants ? vk::DescriptorType::eUniformBuffer
+                        : vk::DescriptorType::eStorageBuffer,
+        1, vk::ShaderStageFlagBits::eCompute};
+  }
+  m_descriptorSetLayout = device.createDescriptorSetLayout(
+      vk::DescriptorSetLayoutCreateInfo{{}, bindings});
+
+  if (!createCullPipeline()) {
+    std::cerr << "Warning: scene culling shader unavailable, gpu driven "
+                 "drawing off"
+              << std::endl;
+    return;
+  }
+  m_enabled = true;
+}
+
+void GpuScene::OnDestroy() {
+  vk::Device device = m_pContext->getDevice();
+  for (auto &slot : m_slots) {
+    m_pBufferPool->freeBuffer(slot.constants);
+    m_pBufferPool->freeBuffer(slot.drawCounts);
+    if (slot.instanceCapacity > 0) {
+      m_pBufferPool->freeBuffer(slot.commands);
+    }
+    if (slot.transformCapacity > 0) {
+      m_pBufferPool->freeBuffer(slot.hiddenTransforms);
+    }
+    device.destroyDescriptorPool(slot.descriptorPool);
+  }
+  m_slots.clear();
+  if (m_cullPipeline) {
+    device.destroyPipeline(m_cullPipeline);
+    m_cullPipeline = nullptr;
+  }
+  if (m_cullLayout) {
+    device.destroyPipelineLayout(m_cullLayout);
+    m_cullLayout = nullptr;
+  }
+  if (m_descriptorSetLayout) {
+    device.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    m_descriptorSetLayout = nullptr;
+  }
+  m_enabled = false;
+}
+
+bool GpuScene::createCullPipeline() {
+  vk::Device device = m_pContext->getDevice();
+  vk::ShaderModule shaderModule;
+  try {
+    shaderModule = VkShaderModuleFactory::CreateShaderModule(
+        device,
+        (std::string{SHADERS_PATH} + std::string{"scene_cull.spv"}).c_str());
+  } catch (const std::exception &) {
+    return false;
+  }
+
+  m_cullLayout = device.createPipelineLayout(
+      vk::PipelineLayoutCreateInfo{{}, m_descriptorSetLayout});
+  vk::ComputePipelineCreateInfo pipelineCreateInfo{
+      {},
+      vk::PipelineShaderStageCreateInfo{
+          {}, vk::ShaderStageFlagBits::eCompute, shaderModule, "main"},
+      m_cullLayout};
+  auto result = device.createComputePipeline(nullptr, pipelineCreateInfo);
+  device.destroyShaderModule(shaderModule);
+  if (result.result != vk::Result::eSuccess) {
+    device.destroyPipelineLayout(m_cullLayout);
+    m_cullLayout = nullptr;
+    return false;
+  }
+  m_cullPipeline = result.value;
+  return true;
+}
+
+bool GpuScene::reloadShaders(DeletionQueue &deletionQueue) {
+  if (!m_cullPipeline) {
+    return false;
+  }
+  vk::PipelineLayout oldLayout = m_cullLayout;
+  vk::Pipeline oldPipeline = m_cullPipeline;
+  if (!createCullPipeline()) {
+    m_cullLayout = oldLayout;
+    m_cullPipeline = oldPipeline;
+    return false;
+  }
+  vk::Device device = m_pContext->getDevice();
+  deletionQueue.push([device, oldLayout, oldPipeline] {
+    device.destroyPipeline(oldPipeline);
+    device.destroyPipelineLayout(oldLayout);
+  });
+  return true;
+}
+
+GpuScene::Slot &GpuScene::acquireSlot() {
+  if (m_usedSlots < m_slots.size()) {
+    return m_slots[m_usedSlots++];
+  }
+  Slot slot{};
+  vk::Device device = m_pContext->getDevice();
+  std::array<vk::DescriptorPoolSize, 2> poolSizes{
+      vk::DescriptorPoolSize{vk::DescriptorType::eUniformBuffer, 1},
+      vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer,
+                             kBindingCount - 1}};
+  slot.descriptorPool = device.createDescriptorPool(
+      vk::DescriptorPoolCreateInfo{{}, 1, poolSizes});
+  slot.descriptorSet = device.allocateDescriptorSets(
+      vk::DescriptorSetAllocateInfo{slot.descriptorPool,
+                                    m_descriptorSetLayout})[0];
+
+  // rewritten every frame, the frame before has been waited on
+  vk::BufferCreateInfo constantsCreateInfo{
+      {}, sizeof(CullConstants), vk::BufferUsageFlagBits::eUniformBuffer};
+  VmaAllocationCreateInfo hostCreateInfo{};
+  hostCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+  hostCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                         VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  slot.constants =
+      m_pBufferPool->allocateMemory(constantsCreateInfo, hostCreateInfo);
+  vmaGetAllocationInfo(m_pBufferPool->getAllocator(), slot.constants.allocation,
+                       &slot.constants.allocationInfo);
+
+  vk::BufferCreateInfo countsCreateInfo{
+      {}, kIndexTypeCount * sizeof(uint32_t),
+      vk::BufferUsageFlagBits::eStorageBuffer |
+          vk::BufferUsageFlagBits::eIndirectBuffer |
+          vk::BufferUsageFlagBits::eTransferDst};
+  VmaAllocationCreateInfo deviceCreateInfo{};
+  deviceCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  slot.drawCounts =
+      m_pBufferPool->allocateMemory(countsCreateInfo, deviceCreateInfo);
+
+  m_slots.push_back(slot);
+  return m_slots[m_usedSlots++];
+}
+
+void GpuScene::prepareSlot(Slot &slot, const glTFModel &scene) {
+  uint32_t instanceCount = scene.getInstanceCount();
+  if (instanceCount > slot.instanceCapacity) {
+    if (slot.instanceCapacity > 0) {
+      m_pBufferPool->freeBuffer(slot.commands);
+    }
+    slot.instanceCapacity = std::max(instanceCount, slot.instanceCapacity * 2);
+    vk::BufferCreateInfo commandsCreateInfo{
+        {},
+        vk::DeviceSize(kIndexTypeCount) * slot.instanceCapacity *
+            sizeof(vk::DrawIndexedIndirectCommand),
+        vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferDst};
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    slot.commands =
+        m_pBufferPool->allocateMemory(commandsCreateInfo, allocCreateInfo);
+  }
+
+  // which transforms an impostor stands in for, rewritten every frame
+  const std::vector<uint32_t> &hidden = scene.getHiddenTransforms();
+  uint32_t transformCount =
+      std::max<uint32_t>(static_cast<uint32_t>(hidden.size()), 1);
+  if (transformCount > slot.transformCapacity) {
+    if (slot.transformCapacity > 0) {
+      m_pBufferPool->freeBuffer(slot.hiddenTransforms);
+    }
+    slot.transformCapacity =
+        std::max(transformCount, slot.transformCapacity * 2);
+    vk::BufferCreateInfo hiddenCreateInfo{
+        {}, vk::DeviceSize(slot.transformCapacity) * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer};
+    VmaAllocationCreateInfo hostCreateInfo{};
+    hostCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    hostCreateInfo.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+        VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    slot.hiddenTransforms =
+        m_pBufferPool->allocateMemory(hiddenCreateInfo, hostCreateInfo);
+    vmaGetAllocationInfo(m_pBufferPool->getAllocator(),
+                         slot.hiddenTransforms.allocation,
+                         &slot.hiddenTransforms.allocationInfo);
+  }
+  if (!hidden.empty()) {
+    memcpy(slot.hiddenTransforms.allocationInfo.pMappedData, hidden.data(),
+           hidden.size() * sizeof(uint32_t));
+    vmaFlushAllocation(m_pBufferPool->getAllocator(),
+                       slot.hiddenTransforms.allocation, 0,
+                       hidden.size() * sizeof(uint32_t));
+  }
+
+  std::array<vk::DescriptorBufferInfo, kBindingCount> infos{
+      vk::DescriptorBufferInfo{slot.constants.buffer, 0, sizeof(CullConstants)},
+      vk::DescriptorBufferInfo{scene.getInstanceBuffer().buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{scene.getTransformBuffer().buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{slot.commands.buffer, 0, VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{slot.drawCounts.buffer, 0, VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{slot.hiddenTransforms.buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{scene.getSelectedLodBuffer().buffer, 0,
+                               VK_WHOLE_SIZE}};
+  std::array<vk::WriteDescriptorSet, kBindingCount> writes;
+  for (uint32_t i = 0; i < kBindingCount; ++i) {
+    writes[i] = vk::WriteDescriptorSet{
+        slot.descriptorSet, i, 0,
+        i == kConstants ? vk::DescriptorType::eUniformBuffer
+                        : vk::DescriptorType::eStorageBuffer,
+        nullptr, infos[i]};
+  }
+  m_pContext->getDevice().updateDescriptorSets(writes, nullptr);
+}
+
+int GpuScene::cull(vk::CommandBuffer cmdBuf, const glTFModel &scene,
+                   bool skipClustered, const glm::mat4 &model,
+                   const glm::mat4 &view,
+                   const glm::mat4 &projection, float viewportHeight,
+                   float errorPixels) {
+  if (!m_enabled || !scene.isUploaded() || scene.getInstanceCount() == 0) {
+    return -1;
+  }
+  int ticket = static_cast<int>(m_usedSlots);
+  Slot &slot = acquireSlot();
+  prepareSlot(slot, scene);
+
+  CullConstants constants{};
+  constants.model = model;
+  constants.view = view;
+  SimdMath::extractFrustumPlanes(projection * view, constants.frustumPlanes);
+  // same rule as glTFModel::selectLods
+  constants.lodScale =
+      std::fabs(projection[1][1]) * 0.5f * viewportHeight / errorPixels;
+  constants.lodHysteresis = glTFModel::kLodHysteresis;
+  constants.instanceCount = scene.getInstanceCount();
+  constants.commandCapacity = slot.instanceCapacity;
+  constants.skipClustered = skipClustered ? 1 : 0;
+  memcpy(slot.constants.allocationInfo.pMappedData, &constants,
+         sizeof(constants));
+  vmaFlushAllocation(m_pBufferPool->getAllocator(), slot.constants.allocation,
+                     0, sizeof(constants));
+
+  // counts start at zero; without the count draw the unused commands have
+  // to be empty as well
+  cmdBuf.fillBuffer(slot.drawCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+  if (!m_drawIndirectCount) {
+    cmdBuf.fillBuffer(slot.commands.buffer, 0, VK_WHOLE_SIZE, 0);
+  }
+  vk::MemoryBarrier resetBarrier{vk::AccessFlagBits::eTransferWrite,
+                                 vk::AccessFlagBits::eShaderRead |
+                                     vk::AccessFlagBits::eShaderWrite};
+  cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                         vk::PipelineStageFlagBits::eComputeShader, {},
+                         resetBarrier, nullptr, nullptr);
+
+  cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_cullPipeline);
+  cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_cullLayout, 0,
+                            slot.descriptorSet, nullptr);
+  cmdBuf.dispatch((constants.instanceCount + kGroupSize - 1) / kGroupSize, 1,
+                  1);
+
+  vk::MemoryBarrier cullBarrier{vk::AccessFlagBits::eShaderWrite,
+                                vk::AccessFlagBits::eIndirectCommandRead};
+  cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                         vk::PipelineStageFlagBits::eDrawIndirect, {},
+                         cullBarrier, nullptr, nullptr);
+  return ticket;
+}
+
+void GpuScene::draw(vk::CommandBuffer cmdBuf, const glTFModel &scene,
+                    int ticket) {
+  if (ticket < 0) {
+    return;
+  }
+  const Slot &slot = m_slots[ticket];
+  scene.bindVertexStreams(cmdBuf);
+  constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+  const vk::IndexType indexTypes[kIndexTypeCount] = {vk::IndexType::eUint32,
+                                                     vk::IndexType::eUint16};
+  for (uint32_t type = 0; type < kIndexTypeCount; ++type) {
+    cmdBuf.bindIndexBuffer(scene.getIndexBuffer().buffer, 0, indexTypes[type]);
+    vk::DeviceSize offset = vk::DeviceSize(type) * slot.instanceCapacity * stride;
+    if (m_drawIndirectCount) {
+      cmdBuf.drawIndexedIndirectCount(slot.commands.buffer, offset,
+                                      slot.drawCounts.buffer,
+                                      type * sizeof(uint32_t),
+                                      scene.getInstanceCount(), stride);
+    } else {
+      cmdBuf.drawIndexedIndirect(slot.commands.buffer, offset,
+                                 scene.getInstanceCount(), stride);
+    }
+  }
+}
+} // namespace hiddenpiggy
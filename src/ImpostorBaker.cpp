@@ -0,0 +1,312 @@
+#include "ImpostorBaker.hpp"
+#include "AccessorDecoder.hpp"
+#include "StaticBatcher.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace hiddenpiggy {
+namespace ImpostorBaker {
+
+namespace {
+// a group's triangles in world space, three corners after another
+struct GroupGeometry {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+};
+
+glm::vec2 encodeOctahedral(const glm::vec3 &value) {
+  float length = std::fabs(value.x) + std::fabs(value.y) + std::fabs(value.z);
+  glm::vec2 e = length > 0.0f ? glm::vec2(value) / length : glm::vec2(0.0f);
+  if (value.z < 0.0f) {
+    e = glm::vec2((1.0f - std::fabs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+                  (1.0f - std::fabs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+  }
+  return e;
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2 &e) {
+  glm::vec3 n(e, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+  float t = std::max(-n.z, 0.0f);
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  return glm::normalize(n);
+}
+
+bool isPlainTriangleList(const tinygltf::Primitive &primitive) {
+  return primitive.mode == TINYGLTF_MODE_TRIANGLES &&
+         primitive.targets.empty() &&
+         primitive.attributes.count("POSITION") != 0;
+}
+
+std::vector<glm::vec3> decodeVec3(const tinygltf::Model &model,
+                                  const tinygltf::Primitive &primitive,
+                                  const char *name, size_t count) {
+  std::vector<glm::vec3> values;
+  auto attribute = primitive.attributes.find(name);
+  if (attribute == primitive.attributes.end()) {
+    return values;
+  }
+  const tinygltf::Accessor &accessor = model.accessors[attribute->second];
+  if (accessor.count != count) {
+    throw std::runtime_error("attribute count mismatch");
+  }
+  values.assign(count, glm::vec3(0.0f));
+  AccessorDecoder::decodeFloats(model, accessor, 3, values.data(),
+                                sizeof(glm::vec3));
+  return values;
+}
+
+// appends the node's triangles, in world space, to geometry
+void appendNode(const tinygltf::Model &model, const tinygltf::Mesh &mesh,
+                const glm::mat4 &world, GroupGeometry &geometry) {
+  glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+  for (const auto &primitive : mesh.primitives) {
+    size_t count = model.accessors[primitive.attributes.at("POSITION")].count;
+    std::vector<glm::vec3> positions =
+        decodeVec3(model, primitive, "POSITION", count);
+    std::vector<glm::vec3> normals =
+        decodeVec3(model, primitive, "NORMAL", count);
+    std::vector<uint32_t> indices;
+    if (primitive.indices >= 0) {
+      const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
+      indices.resize(accessor.count);
+      AccessorDecoder::decodeIndices(model, accessor, indices.data());
+    } else {
+      indices.resize(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        indices[i] = i;
+      }
+    }
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      glm::vec3 corners[3];
+      for (int k = 0; k < 3; ++k) {
+        if (indices[i + k] >= count) {
+          throw std::runtime_error("primitive index out of range");
+        }
+        corners[k] = glm::vec3(world * glm::vec4(positions[indices[i + k]], 1.0f));
+      }
+      // without normals the triangles shade flat
+      glm::vec3 face =
+          glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+      float faceLength = glm::length(face);
+      if (faceLength == 0.0f) {
+        continue;
+      }
+      for (int k = 0; k < 3; ++k) {
+        glm::vec3 normal = normals.empty()
+                               ? face / faceLength
+                               : normalMatrix * normals[indices[i + k]];
+        float length = glm::length(normal);
+        geometry.positions.push_back(corners[k]);
+        geometry.normals.push_back(length > 0.0f ? normal / length
+                                                 : face / faceLength);
+      }
+    }
+  }
+}
+
+// orthographic view of the group's sphere from frame's direction, depth
+// tested per texel
+void rasterize(const GroupGeometry &geometry, const Group &group,
+               uint32_t frame, uint32_t *texels) {
+  glm::vec3 direction = frameDirection(frame);
+  glm::vec3 right, up;
+  frameBasis(direction, right, up);
+  glm::vec3 center = glm::make_vec3(group.center);
+  float radius = std::max(group.radius, std::numeric_limits<float>::min());
+  float scale = float(kFrameSize) / (2.0f * radius);
+  std::vector<float> depths(kFrameSize * kFrameSize,
+                            std::numeric_limits<float>::max());
+
+  for (size_t i = 0; i + 2 < geometry.positions.size(); i += 3) {
+    glm::vec2 screen[3];
+    float depth[3];
+    for (int k = 0; k < 3; ++k) {
+      glm::vec3 offset = geometry.positions[i + k] - center;
+      screen[k] = glm::vec2(glm::dot(offset, right) + radius,
+                            glm::dot(offset, up) + radius) *
+                  scale;
+      depth[k] = (radius - glm::dot(offset, direction)) / (2.0f * radius);
+    }
+    auto edge = [](const glm::vec2 &a, const glm::vec2 &b,
+                   const glm::vec2 &p) {
+      return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+    };
+    float area = edge(screen[0], screen[1], screen[2]);
+    if (std::fabs(area) < 1e-12f) {
+      continue;
+    }
+    // both windings, the views see the group from every side
+    glm::vec2 lower = glm::min(glm::min(screen[0], screen[1]), screen[2]);
+    glm::vec2 upper = glm::max(glm::max(screen[0], screen[1]), screen[2]);
+    int x0 = std::max(0, int(std::floor(lower.x)));
+    int y0 = std::max(0, int(std::floor(lower.y)));
+    int x1 = std::min(int(kFrameSize) - 1, int(std::ceil(upper.x)));
+    int y1 = std::min(int(kFrameSize) - 1, int(std::ceil(upper.y)));
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        glm::vec2 p(float(x) + 0.5f, float(y) + 0.5f);
+        float w0 = edge(screen[1], screen[2], p) / area;
+        float w1 = edge(screen[2], screen[0], p) / area;
+        float w2 = 1.0f - w0 - w1;
+        if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+          continue;
+        }
+        float z = w0 * depth[0] + w1 * depth[1] + w2 * depth[2];
+        uint32_t texel = uint32_t(y) * kFrameSize + uint32_t(x);
+        if (z >= depths[texel]) {
+          continue;
+        }
+        depths[texel] = z;
+        glm::vec3 normal = w0 * geometry.normals[i] +
+                           w1 * geometry.normals[i + 1] +
+                           w2 * geometry.normals[i + 2];
+        float length = glm::length(normal);
+        texels[texel] = packTexel(
+            length > 0.0f ? normal / length : geometry.normals[i],
+            glm::clamp(z, 0.0f, 1.0f));
+      }
+    }
+  }
+}
+} // namespace
+
+uint32_t packTexel(const glm::vec3 &normal, float depth) {
+  glm::vec2 e = encodeOctahedral(normal) * 0.5f + 0.5f;
+  uint32_t x = uint32_t(std::lround(glm::clamp(e.x, 0.0f, 1.0f) * 255.0f));
+  uint32_t y = uint32_t(std::lround(glm::clamp(e.y, 0.0f, 1.0f) * 255.0f));
+  // 0 is reserved for empty texels
+  uint32_t z = 1 + uint32_t(std::lround(depth * 65534.0f));
+  return x | (y << 8) | (z << 16);
+}
+
+glm::vec3 frameDirection(uint32_t frame) {
+  glm::vec2 cell(float(frame % kViewGrid) + 0.5f,
+                 float(frame / kViewGrid) + 0.5f);
+  return decodeOctahedral(cell / float(kViewGrid) * 2.0f - 1.0f);
+}
+
+uint32_t nearestFrame(const glm::vec3 &direction) {
+  glm::vec2 e = encodeOctahedral(direction) * 0.5f + 0.5f;
+  uint32_t x = std::min(uint32_t(std::max(e.x, 0.0f) * kViewGrid),
+                        kViewGrid - 1);
+  uint32_t y = std::min(uint32_t(std::max(e.y, 0.0f) * kViewGrid),
+                        kViewGrid - 1);
+  return y * kViewGrid + x;
+}
+
+void frameBasis(const glm::vec3 &direction, glm::vec3 &right, glm::vec3 &up) {
+  glm::vec3 worldUp = std::fabs(direction.y) < 0.99f ? glm::vec3(0, 1, 0)
+                                                     : glm::vec3(0, 0, 1);
+  right = glm::normalize(glm::cross(worldUp, direction));
+  up = glm::cross(direction, right);
+}
+
+Result bake(const tinygltf::Model &model) {
+  Result result{};
+  result.nodeGroups.assign(model.nodes.size(), -1);
+  StaticBatcher::SceneGraph graph = StaticBatcher::resolveSceneGraph(model);
+
+  // bounds of every node that can turn into an impostor
+  std::vector<uint32_t> candidates;
+  std::vector<glm::vec3> nodeLower, nodeUpper;
+  for (size_t i = 0; i < model.nodes.size(); ++i) {
+    const tinygltf::Node &node = model.nodes[i];
+    if (node.mesh < 0 || static_cast<size_t>(node.mesh) >= model.meshes.size() ||
+        node.skin >= 0 || graph.moving[i] ||
+        node.extensions.count("EXT_mesh_gpu_instancing") != 0) {
+      continue;
+    }
+    const tinygltf::Mesh &mesh = model.meshes[node.mesh];
+    if (mesh.primitives.empty() ||
+        !std::all_of(mesh.primitives.begin(), mesh.primitives.end(),
+                     isPlainTriangleList)) {
+      continue;
+    }
+    glm::vec3 lower{std::numeric_limits<float>::max()};
+    glm::vec3 upper{std::numeric_limits<float>::lowest()};
+    for (const auto &primitive : mesh.primitives) {
+      size_t count =
+          model.accessors[primitive.attributes.at("POSITION")].count;
+      for (const auto &position :
+           decodeVec3(model, primitive, "POSITION", count)) {
+        glm::vec3 world =
+            glm::vec3(graph.world[i] * glm::vec4(position, 1.0f));
+        lower = glm::min(lower, world);
+        upper = glm::max(upper, world);
+      }
+    }
+    if (lower.x > upper.x) {
+      continue;
+    }
+    candidates.push_back(static_cast<uint32_t>(i));
+    nodeLower.push_back(lower);
+    nodeUpper.push_back(upper);
+  }
+  if (candidates.empty()) {
+    return result;
+  }
+
+  // uniform grid over the candidates, cubic cells
+  glm::vec3 lower{std::numeric_limits<float>::max()};
+  glm::vec3 upper{std::numeric_limits<float>::lowest()};
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    lower = glm::min(lower, nodeLower[i]);
+    upper = glm::max(upper, nodeUpper[i]);
+  }
+  glm::vec3 extent = upper - lower;
+  float cellSize =
+      std::max(std::max(extent.x, extent.y), extent.z) / float(kCellsPerAxis);
+  std::map<uint32_t, std::vector<size_t>> cells;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    uint32_t cellIndex = 0;
+    if (cellSize > 0.0f) {
+      glm::vec3 center = 0.5f * (nodeLower[i] + nodeUpper[i]);
+      glm::uvec3 cell = glm::min(glm::uvec3((center - lower) / cellSize),
+                                 glm::uvec3(kCellsPerAxis - 1));
+      cellIndex = (cell.z * kCellsPerAxis + cell.y) * kCellsPerAxis + cell.x;
+    }
+    cells[cellIndex].push_back(i);
+  }
+
+  for (const auto &[cellIndex, members] : cells) {
+    glm::vec3 groupLower{std::numeric_limits<float>::max()};
+    glm::vec3 groupUpper{std::numeric_limits<float>::lowest()};
+    GroupGeometry geometry;
+    for (size_t member : members) {
+      groupLower = glm::min(groupLower, nodeLower[member]);
+      groupUpper = glm::max(groupUpper, nodeUpper[member]);
+      uint32_t node = candidates[member];
+      appendNode(model, model.meshes[model.nodes[node].mesh], graph.world[node],
+                 geometry);
+    }
+    if (geometry.positions.empty()) {
+      continue;
+    }
+    Group group{};
+    glm::vec3 center = 0.5f * (groupLower + groupUpper);
+    std::copy_n(glm::value_ptr(center), 3, group.center);
+    group.radius = 0.5f * glm::length(groupUpper - groupLower);
+
+    int32_t groupIndex = static_cast<int32_t>(result.groups.size());
+    for (size_t member : members) {
+      result.nodeGroups[candidates[member]] = groupIndex;
+    }
+    result.groups.push_back(group);
+    size_t first = result.texels.size();
+    result.texels.resize(first + kGroupTexels, 0);
+    for (uint32_t frame = 0; frame < kViewCount; ++frame) {
+      rasterize(geometry, group, frame,
+                result.texels.data() + first +
+                    frame * kFrameSize * kFrameSize);
+    }
+  }
+  return result;
+}
+
+} // namespace ImpostorBaker
+} // namespace hiddenpiggy
@@ -0,0 +1,277 @@
+#include "ImpostorRenderer.hpp"
+#include "SimdMath.hpp"
+#include "VkShaderModuleFactory.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+
+namespace hiddenpiggy {
+
+namespace {
+enum Binding : uint32_t { kTexels = 0, kDraws, kBindingCount };
+} // namespace
+
+void ImpostorRenderer::OnCreate(vk::DescriptorSetLayout sceneSetLayout,
+                                vk::RenderPass renderPass) {
+  vk::Device device = m_pContext->getDevice();
+  std::array<vk::DescriptorSetLayoutBinding, kBindingCount> bindings{
+      vk::DescriptorSetLayoutBinding{kTexels,
+                                     vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eFragment},
+      vk::DescriptorSetLayoutBinding{kDraws, vk::DescriptorType::eStorageBuffer,
+                                     1, vk::ShaderStageFlagBits::eVertex}};
+  m_descriptorSetLayout = device.createDescriptorSetLayout(
+      vk::DescriptorSetLayoutCreateInfo{{}, bindings});
+  m_sceneSetLayout = sceneSetLayout;
+  m_renderPass = renderPass;
+
+  if (!createPipeline(sceneSetLayout, renderPass)) {
+    std::cerr << "Warning: impostor shaders unavailable, distant groups draw "
+                 "their meshes"
+              << std::endl;
+    m_enabled = false;
+  }
+}
+
+void ImpostorRenderer::OnDestroy() {
+  vk::Device device = m_pContext->getDevice();
+  for (auto &slot : m_slots) {
+    if (slot.drawCapacity > 0) {
+      m_pBufferPool->freeBuffer(slot.draws);
+    }
+    device.destroyDescriptorPool(slot.descriptorPool);
+  }
+  m_slots.clear();
+  if (m_pipeline) {
+    device.destroyPipeline(m_pipeline);
+    m_pipeline = nullptr;
+  }
+  if (m_pipelineLayout) {
+    device.destroyPipelineLayout(m_pipelineLayout);
+    m_pipelineLayout = nullptr;
+  }
+  if (m_descriptorSetLayout) {
+    device.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    m_descriptorSetLayout = nullptr;
+  }
+}
+
+bool ImpostorRenderer::createPipeline(vk::DescriptorSetLayout sceneSetLayout,
+                                      vk::RenderPass renderPass) {
+  vk::Device device = m_pContext->getDevice();
+  std::array<vk::ShaderModule, 2> modules{};
+  try {
+    modules[0] = VkShaderModuleFactory::CreateShaderModule(
+        device,
+        (std::string{SHADERS_PATH} + std::string{"impostor_vert.spv"}).c_str());
+    modules[1] = VkShaderModuleFactory::CreateShaderModule(
+        device,
+        (std::string{SHADERS_PATH} + std::string{"impostor_frag.spv"}).c_str());
+  } catch (const std::exception &) {
+    for (auto module : modules) {
+      if (module) {
+        device.destroyShaderModule(module);
+      }
+    }
+    return false;
+  }
+  std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages{
+      vk::PipelineShaderStageCreateInfo{
+          {}, vk::ShaderStageFlagBits::eVertex, modules[0], "main"},
+      vk::PipelineShaderStageCreateInfo{
+          {}, vk::ShaderStageFlagBits::eFragment, modules[1], "main"}};
+
+  std::array<vk::DescriptorSetLayout, 2> setLayouts{sceneSetLayout,
+                                                    m_descriptorSetLayout};
+  m_pipelineLayout =
+      device.createPipelineLayout(vk::PipelineLayoutCreateInfo{{}, setLayouts});
+
+  // the quads are expanded from gl_VertexIndex
+  vk::PipelineVertexInputStateCreateInfo vertexInputState{};
+  vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState{
+      {}, vk::PrimitiveTopology::eTriangleList};
+  vk::PipelineViewportStateCreateInfo viewportState{{}, 1, nullptr, 1, nullptr};
+  vk::PipelineRasterizationStateCreateInfo rasterizationState{};
+  rasterizationState.polygonMode = vk::PolygonMode::eFill;
+  // the quads always face the camera, whichever way proj flips them
+  rasterizationState.cullMode = vk::CullModeFlagBits::eNone;
+  rasterizationState.frontFace = vk::FrontFace::eCounterClockwise;
+  rasterizationState.lineWidth = 1.0f;
+  vk::PipelineMultisampleStateCreateInfo multisampleState{};
+  multisampleState.rasterizationSamples = vk::SampleCountFlagBits::e1;
+  vk::PipelineDepthStencilStateCreateInfo depthStencilState{};
+  vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask =
+      vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+      vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+  vk::PipelineColorBlendStateCreateInfo colorBlendState{};
+  colorBlendState.attachmentCount = 1;
+  colorBlendState.pAttachments = &colorBlendAttachment;
+  std::array<vk::DynamicState, 2> dynamicStates{vk::DynamicState::eViewport,
+                                                vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamicState{{}, dynamicStates};
+
+  vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+  pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+  pipelineCreateInfo.pStages = shaderStages.data();
+  pipelineCreateInfo.pVertexInputState = &vertexInputState;
+  pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+  pipelineCreateInfo.pViewportState = &viewportState;
+  pipelineCreateInfo.pRasterizationState = &rasterizationState;
+  pipelineCreateInfo.pMultisampleState = &multisampleState;
+  pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+  pipelineCreateInfo.pColorBlendState = &colorBlendState;
+  pipelineCreateInfo.pDynamicState = &dynamicState;
+  pipelineCreateInfo.layout = m_pipelineLayout;
+  pipelineCreateInfo.renderPass = renderPass;
+  pipelineCreateInfo.subpass = 0;
+  auto result = device.createGraphicsPipeline(nullptr, pipelineCreateInfo);
+  for (auto module : modules) {
+    device.destroyShaderModule(module);
+  }
+  if (result.result != vk::Result::eSuccess) {
+    device.destroyPipelineLayout(m_pipelineLayout);
+    m_pipelineLayout = nullptr;
+    return false;
+  }
+  m_pipeline = result.value;
+  return true;
+}
+
+bool ImpostorRenderer::reloadShaders(DeletionQueue &deletionQueue) {
+  if (!m_pipeline) {
+    return false;
+  }
+  vk::PipelineLayout oldLayout = m_pipelineLayout;
+  vk::Pipeline oldPipeline = m_pipeline;
+  if (!createPipeline(m_sceneSetLayout, m_renderPass)) {
+    m_pipelineLayout = oldLayout;
+    m_pipeline = oldPipeline;
+    return false;
+  }
+  vk::Device device = m_pContext->getDevice();
+  deletionQueue.push([device, oldLayout, oldPipeline] {
+    device.destroyPipeline(oldPipeline);
+    device.destroyPipelineLayout(oldLayout);
+  });
+  return true;
+}
+
+ImpostorRenderer::Slot &ImpostorRenderer::acquireSlot() {
+  if (m_usedSlots < m_slots.size()) {
+    return m_slots[m_usedSlots++];
+  }
+  Slot slot{};
+  vk::Device device = m_pContext->getDevice();
+  vk::DescriptorPoolSize poolSize{vk::DescriptorType::eStorageBuffer,
+                                  kBindingCount};
+  slot.descriptorPool = device.createDescriptorPool(
+      vk::DescriptorPoolCreateInfo{{}, 1, poolSize});
+  slot.descriptorSet = device.allocateDescriptorSets(
+      vk::DescriptorSetAllocateInfo{slot.descriptorPool,
+                                    m_descriptorSetLayout})[0];
+  m_slots.push_back(slot);
+  return m_slots[m_usedSlots++];
+}
+
+uint32_t ImpostorRenderer::draw(vk::CommandBuffer cmdBuf,
+                                const glTFModel &scene,
+                                vk::DescriptorSet sceneSet,
+                                const glm::mat4 &modelViewProj,
+                                const glm::vec3 &cameraPosition) {
+  const std::vector<uint32_t> &active = scene.getActiveImpostors();
+  if (!m_enabled || active.empty()) {
+    return 0;
+  }
+
+  const std::vector<CookedImpostorGroup> &groups = scene.getImpostorGroups();
+  m_sphereX.resize(active.size());
+  m_sphereY.resize(active.size());
+  m_sphereZ.resize(active.size());
+  m_sphereRadius.resize(active.size());
+  m_visible.resize(active.size());
+  for (size_t i = 0; i < active.size(); ++i) {
+    const CookedImpostorGroup &group = groups[active[i]];
+    m_sphereX[i] = group.center[0];
+    m_sphereY[i] = group.center[1];
+    m_sphereZ[i] = group.center[2];
+    m_sphereRadius[i] = group.radius;
+  }
+  glm::vec4 planes[6];
+  SimdMath::extractFrustumPlanes(modelViewProj, planes);
+  SimdMath::cullSpheres(planes,
+                        SimdMath::SpheresSoA{m_sphereX.data(), m_sphereY.data(),
+                                             m_sphereZ.data(),
+                                             m_sphereRadius.data()},
+                        m_visible.data(), active.size());
+  size_t visibleCount = 0;
+  for (uint8_t visible : m_visible) {
+    visibleCount += visible;
+  }
+  if (visibleCount == 0) {
+    return 0;
+  }
+  Slot &slot = acquireSlot();
+
+  // rewritten every frame, the frame before has been waited on
+  vk::DeviceSize drawBytes = visibleCount * sizeof(ImpostorDraw);
+  if (drawBytes > slot.drawCapacity) {
+    if (slot.drawCapacity > 0) {
+      m_pBufferPool->freeBuffer(slot.draws);
+    }
+    slot.drawCapacity = std::max(drawBytes, slot.drawCapacity * 2);
+    vk::BufferCreateInfo drawsCreateInfo{
+        {}, slot.drawCapacity, vk::BufferUsageFlagBits::eStorageBuffer};
+    VmaAllocationCreateInfo hostCreateInfo{};
+    hostCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    hostCreateInfo.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+        VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    slot.draws = m_pBufferPool->allocateMemory(drawsCreateInfo, hostCreateInfo);
+    vmaGetAllocationInfo(m_pBufferPool->getAllocator(), slot.draws.allocation,
+                         &slot.draws.allocationInfo);
+  }
+
+  // each group shows the view baked closest to the direction it is seen from
+  auto *draws =
+      static_cast<ImpostorDraw *>(slot.draws.allocationInfo.pMappedData);
+  size_t drawCount = 0;
+  for (size_t i = 0; i < active.size(); ++i) {
+    if (!m_visible[i]) {
+      continue;
+    }
+    const CookedImpostorGroup &group = groups[active[i]];
+    glm::vec3 center(group.center[0], group.center[1], group.center[2]);
+    glm::vec3 toCamera = cameraPosition - center;
+    float distance = glm::length(toCamera);
+    ImpostorDraw impostor{};
+    impostor.sphere = glm::vec4(center, group.radius);
+    impostor.group = active[i];
+    impostor.frame = ImpostorBaker::nearestFrame(
+        distance > 0.0f ? toCamera / distance : glm::vec3(0.0f, 0.0f, 1.0f));
+    draws[drawCount++] = impostor;
+  }
+  vmaFlushAllocation(m_pBufferPool->getAllocator(), slot.draws.allocation, 0,
+                     drawBytes);
+
+  std::array<vk::DescriptorBufferInfo, kBindingCount> infos{
+      vk::DescriptorBufferInfo{scene.getImpostorTexelBuffer().buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{slot.draws.buffer, 0, drawBytes}};
+  std::array<vk::WriteDescriptorSet, kBindingCount> writes;
+  for (uint32_t i = 0; i < kBindingCount; ++i) {
+    writes[i] = vk::WriteDescriptorSet{slot.descriptorSet, i, 0,
+                                       vk::DescriptorType::eStorageBuffer,
+                                       nullptr, infos[i]};
+  }
+  m_pContext->getDevice().updateDescriptorSets(writes, nullptr);
+
+  std::array<vk::DescriptorSet, 2> sets{sceneSet, slot.descriptorSet};
+  cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline);
+  cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout,
+                            0, sets, nullptr);
+  cmdBuf.draw(6, static_cast<uint32_t>(drawCount), 0, 0);
+  return 1;
+}
+} // namespace hiddenpiggy
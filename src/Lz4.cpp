@@ -0,0 +1,193 @@
+#include "Lz4.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace hiddenpiggy {
+namespace Lz4 {
+
+namespace {
+constexpr size_t kMinMatch = 4;
+// the format ends every block with at least this many literals, and the last
+// match has to start this far before the end
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMatchSearchLimit = 12;
+constexpr size_t kMaxOffset = 65535;
+constexpr uint32_t kHashLog = 16;
+
+uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t hashSequence(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashLog);
+}
+
+// lengths of 15 and above continue in extra bytes, 255 each until the rest
+void writeLength(uint8_t *&op, size_t length) {
+  for (; length >= 255; length -= 255) {
+    *op++ = 255;
+  }
+  *op++ = static_cast<uint8_t>(length);
+}
+
+// a match length of 0 marks the final, literals only sequence
+bool writeSequence(uint8_t *&op, const uint8_t *opEnd, const uint8_t *literals,
+                   size_t literalLength, size_t offset, size_t matchLength) {
+  size_t worstCase = 1 + literalLength + literalLength / 255 + 1 + 2 +
+                     matchLength / 255 + 1;
+  if (static_cast<size_t>(opEnd - op) < worstCase) {
+    return false;
+  }
+  uint8_t *token = op++;
+  *token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+  if (literalLength >= 15) {
+    writeLength(op, literalLength - 15);
+  }
+  if (literalLength > 0) {
+    memcpy(op, literals, literalLength);
+  }
+  op += literalLength;
+  if (matchLength == 0) {
+    return true;
+  }
+
+  *op++ = static_cast<uint8_t>(offset);
+  *op++ = static_cast<uint8_t>(offset >> 8);
+  size_t length = matchLength - kMinMatch;
+  *token |= static_cast<uint8_t>(std::min<size_t>(length, 15));
+  if (length >= 15) {
+    writeLength(op, length - 15);
+  }
+  return true;
+}
+
+bool readLength(const uint8_t *&ip, const uint8_t *ipEnd, size_t &length) {
+  uint8_t byte;
+  do {
+    if (ip >= ipEnd) {
+      return false;
+    }
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+} // namespace
+
+size_t compress(const uint8_t *src, size_t srcSize, uint8_t *dst,
+                size_t dstCapacity) {
+  uint8_t *op = dst;
+  const uint8_t *opEnd = dst + dstCapacity;
+  size_t anchor = 0;
+
+  if (srcSize > kMatchSearchLimit) {
+    std::vector<uint32_t> table(size_t(1) << kHashLog, 0);
+    size_t searchEnd = srcSize - kMatchSearchLimit;
+    size_t matchEnd = srcSize - kLastLiterals;
+    size_t position = 0;
+    while (position < searchEnd) {
+      uint32_t sequence = read32(src + position);
+      uint32_t &slot = table[hashSequence(sequence)];
+      size_t candidate = slot;
+      slot = static_cast<uint32_t>(position);
+
+      if (candidate >= position || position - candidate > kMaxOffset ||
+          read32(src + candidate) != sequence) {
+        // step faster through data that keeps missing
+        position += 1 + ((position - anchor) >> 6);
+        continue;
+      }
+
+      // grow the match backwards over literals that also match
+      while (position > anchor && candidate > 0 &&
+             src[position - 1] == src[candidate - 1]) {
+        position--;
+        candidate--;
+      }
+      size_t length = kMinMatch;
+      while (position + length < matchEnd &&
+             src[position + length] == src[candidate + length]) {
+        length++;
+      }
+
+      if (!writeSequence(op, opEnd, src + anchor, position - anchor,
+                         position - candidate, length)) {
+        return 0;
+      }
+      position += length;
+      anchor = position;
+      // keep the table warm across the match
+      if (position - 2 < searchEnd) {
+        table[hashSequence(read32(src + position - 2))] =
+            static_cast<uint32_t>(position - 2);
+      }
+    }
+  }
+
+  if (!writeSequence(op, opEnd, src + anchor, srcSize - anchor, 0, 0)) {
+    return 0;
+  }
+  return static_cast<size_t>(op - dst);
+}
+
+bool decompress(const uint8_t *src, size_t srcSize, uint8_t *dst,
+                size_t dstSize) {
+  const uint8_t *ip = src;
+  const uint8_t *ipEnd = src + srcSize;
+  uint8_t *op = dst;
+  uint8_t *opEnd = dst + dstSize;
+
+  while (ip < ipEnd) {
+    uint8_t token = *ip++;
+    size_t literalLength = token >> 4;
+    if (literalLength == 15 && !readLength(ip, ipEnd, literalLength)) {
+      return false;
+    }
+    if (literalLength > static_cast<size_t>(ipEnd - ip) ||
+        literalLength > static_cast<size_t>(opEnd - op)) {
+      return false;
+    }
+    if (literalLength > 0) {
+      memcpy(op, ip, literalLength);
+    }
+    ip += literalLength;
+    op += literalLength;
+    if (ip == ipEnd) {
+      // the final sequence has no match
+      break;
+    }
+
+    if (ipEnd - ip < 2) {
+      return false;
+    }
+    size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    size_t matchLength = token & 15;
+    if (matchLength == 15 && !readLength(ip, ipEnd, matchLength)) {
+      return false;
+    }
+    matchLength += kMinMatch;
+    if (offset == 0 || offset > static_cast<size_t>(op - dst) ||
+        matchLength > static_cast<size_t>(opEnd - op)) {
+      return false;
+    }
+
+    const uint8_t *match = op - offset;
+    if (offset >= matchLength) {
+      memcpy(op, match, matchLength);
+      op += matchLength;
+    } else {
+      // overlapping copy repeats the last offset bytes
+      for (size_t i = 0; i < matchLength; ++i) {
+        *op++ = *match++;
+      }
+    }
+  }
+  return op == opEnd;
+}
+
+} // namespace Lz4
+} // namespace hiddenpiggy
@@ -0,0 +1,917 @@
+#include "MeshOptimizer.hpp"
+#include "Hash.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace hiddenpiggy {
+namespace MeshOptimizer {
+
+namespace {
+constexpr uint32_t kInvalid = UINT32_MAX;
+
+// Forsyth's scoring; the cache modelled here is larger than the one the
+// stats use, which is what the paper recommends
+constexpr uint32_t kScoringCacheSize = 32;
+constexpr uint32_t kMaxScoredValence = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriangleScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+struct ScoreTables {
+  std::array<float, kScoringCacheSize> cache{};
+  std::array<float, kMaxScoredValence + 1> valence{};
+
+  ScoreTables() {
+    for (uint32_t i = 0; i < kScoringCacheSize; ++i) {
+      if (i < 3) {
+        // the last triangle's vertices get a fixed score so the next
+        // triangle does not simply reuse the same edge
+        cache[i] = kLastTriangleScore;
+      } else {
+        float scale = 1.0f / float(kScoringCacheSize - 3);
+        cache[i] = std::pow(1.0f - float(i - 3) * scale, kCacheDecayPower);
+      }
+    }
+    for (uint32_t i = 1; i <= kMaxScoredValence; ++i) {
+      valence[i] = kValenceBoostScale * std::pow(float(i), -kValenceBoostPower);
+    }
+  }
+};
+
+float vertexScore(const ScoreTables &tables, uint32_t cachePosition,
+                  uint32_t liveTriangles) {
+  if (liveTriangles == 0) {
+    // nothing left to draw with this vertex
+    return -1.0f;
+  }
+  float score = cachePosition < kScoringCacheSize
+                    ? tables.cache[cachePosition]
+                    : 0.0f;
+  return score + tables.valence[std::min(liveTriangles, kMaxScoredValence)];
+}
+
+struct Float3 {
+  float x, y, z;
+};
+
+Float3 readPosition(const float *positions, uint32_t index) {
+  const float *p = positions + size_t(index) * 3;
+  return {p[0], p[1], p[2]};
+}
+
+// per triangle misses of a fifo cache over the current order
+void simulateFifo(std::span<const uint32_t> indices, size_t vertexCount,
+                  uint32_t cacheSize, std::vector<uint32_t> &misses) {
+  std::vector<uint32_t> timestamps(vertexCount, 0);
+  uint32_t time = cacheSize + 1;
+  misses.assign(indices.size() / 3, 0);
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    for (size_t corner = 0; corner < 3; ++corner) {
+      uint32_t vertex = indices[i + corner];
+      if (time - timestamps[vertex] > cacheSize) {
+        timestamps[vertex] = time++;
+        misses[i / 3]++;
+      }
+    }
+  }
+}
+
+Float3 operator-(const Float3 &a, const Float3 &b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+Float3 cross(const Float3 &a, const Float3 &b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+float dot(const Float3 &a, const Float3 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Garland and Heckbert's plane quadric, error(p) = p'Ap + 2b.p + c. Planes
+// are weighted by area and the error divided by the total weight, so it
+// stays a mean squared distance however many quadrics were merged.
+struct Quadric {
+  double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+  double b0 = 0, b1 = 0, b2 = 0, c = 0;
+  double weight = 0;
+
+  void addPlane(const Float3 &n, float d, double w) {
+    a00 += w * n.x * n.x;
+    a01 += w * n.x * n.y;
+    a02 += w * n.x * n.z;
+    a11 += w * n.y * n.y;
+    a12 += w * n.y * n.z;
+    a22 += w * n.z * n.z;
+    b0 += w * n.x * d;
+    b1 += w * n.y * d;
+    b2 += w * n.z * d;
+    c += w * d * d;
+    weight += w;
+  }
+
+  Quadric &operator+=(const Quadric &other) {
+    a00 += other.a00;
+    a01 += other.a01;
+    a02 += other.a02;
+    a11 += other.a11;
+    a12 += other.a12;
+    a22 += other.a22;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+    return *this;
+  }
+
+  double evaluate(const Float3 &p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double error = a00 * x * x + a11 * y * y + a22 * z * z +
+                   2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                   2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+  }
+};
+
+// open borders get a plane through the edge, perpendicular to the surface,
+// weighted this much more than the surface itself
+constexpr double kBorderWeight = 10.0;
+
+enum VertexKind : uint8_t {
+  kManifold, // moves anywhere
+  kBorder,   // moves along open borders only
+  kLocked,   // attribute seams and non manifold edges never move
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+  return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+} // namespace
+
+CacheStats analyzeVertexCache(std::span<const uint32_t> indices,
+                              size_t vertexCount, uint32_t cacheSize) {
+  CacheStats stats{};
+  std::vector<uint32_t> misses;
+  simulateFifo(indices, vertexCount, cacheSize, misses);
+  for (uint32_t count : misses) {
+    stats.transformed += count;
+  }
+  stats.triangles = indices.size() / 3;
+  stats.vertices = vertexCount;
+  return stats;
+}
+
+size_t generateVertexRemap(const void *vertices, size_t vertexCount,
+                           size_t stride, std::vector<uint32_t> &remap) {
+  return generateVertexRemap(vertices, vertexCount, stride, stride, remap);
+}
+
+size_t generateVertexRemap(const void *vertices, size_t vertexCount,
+                           size_t stride, size_t size,
+                           std::vector<uint32_t> &remap) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(vertices);
+  // open addressing, at most about 80% full
+  size_t tableSize = 1;
+  while (tableSize < vertexCount + vertexCount / 4 + 1) {
+    tableSize *= 2;
+  }
+  std::vector<uint32_t> table(tableSize, kInvalid);
+  remap.assign(vertexCount, kInvalid);
+
+  uint32_t unique = 0;
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    const uint8_t *data = bytes + vertex * stride;
+    size_t slot = Hash64::hash(data, size) & (tableSize - 1);
+    while (true) {
+      uint32_t entry = table[slot];
+      if (entry == kInvalid) {
+        table[slot] = static_cast<uint32_t>(vertex);
+        remap[vertex] = unique++;
+        break;
+      }
+      if (memcmp(bytes + size_t(entry) * stride, data, size) == 0) {
+        remap[vertex] = remap[entry];
+        break;
+      }
+      slot = (slot + 1) & (tableSize - 1);
+    }
+  }
+  return unique;
+}
+
+void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount < 2) {
+    return;
+  }
+  static const ScoreTables tables;
+
+  // triangles using each vertex, the live ones first
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    liveTriangles[indices[i]]++;
+  }
+  std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    adjacencyOffset[vertex + 1] = adjacencyOffset[vertex] + liveTriangles[vertex];
+  }
+  std::vector<uint32_t> adjacency(triangleCount * 3);
+  {
+    std::vector<uint32_t> fill(adjacencyOffset.begin(),
+                               adjacencyOffset.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  std::vector<uint32_t> cachePosition(vertexCount, kInvalid);
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    vertexScores[vertex] =
+        vertexScore(tables, kInvalid, liveTriangles[vertex]);
+  }
+
+  std::vector<uint8_t> emitted(triangleCount, 0);
+  std::vector<uint32_t> output;
+  output.reserve(triangleCount * 3);
+  std::array<uint32_t, kScoringCacheSize + 3> cache{};
+  std::array<uint32_t, kScoringCacheSize + 3> nextCache{};
+  uint32_t cacheCount = 0;
+  size_t cursor = 0;
+  uint32_t best = kInvalid;
+
+  while (output.size() < triangleCount * 3) {
+    if (best == kInvalid) {
+      // nothing in the cache has triangles left, restart from the first
+      // triangle not drawn yet
+      while (emitted[cursor]) {
+        ++cursor;
+      }
+      best = static_cast<uint32_t>(cursor);
+    }
+    const uint32_t *triangle = indices.data() + size_t(best) * 3;
+    emitted[best] = 1;
+    output.insert(output.end(), triangle, triangle + 3);
+
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      uint32_t vertex = triangle[corner];
+      uint32_t *begin = adjacency.data() + adjacencyOffset[vertex];
+      uint32_t *end = begin + liveTriangles[vertex];
+      uint32_t *found = std::find(begin, end, best);
+      std::swap(*found, *(end - 1));
+      liveTriangles[vertex]--;
+    }
+
+    // the triangle's vertices move to the front, the rest shift back
+    uint32_t nextCount = 0;
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      uint32_t vertex = triangle[corner];
+      if (std::find(nextCache.begin(), nextCache.begin() + nextCount,
+                    vertex) == nextCache.begin() + nextCount) {
+        nextCache[nextCount++] = vertex;
+      }
+    }
+    for (uint32_t i = 0; i < cacheCount; ++i) {
+      uint32_t vertex = cache[i];
+      if (vertex != triangle[0] && vertex != triangle[1] &&
+          vertex != triangle[2]) {
+        nextCache[nextCount++] = vertex;
+      }
+    }
+    for (uint32_t i = 0; i < nextCount; ++i) {
+      uint32_t vertex = nextCache[i];
+      // the ones pushed past the end are evicted
+      cachePosition[vertex] = i < kScoringCacheSize ? i : kInvalid;
+      vertexScores[vertex] =
+          vertexScore(tables, cachePosition[vertex], liveTriangles[vertex]);
+    }
+
+    // only triangles touching the cache changed score, the best of them
+    // is drawn next
+    best = kInvalid;
+    float bestScore = -1.0f;
+    for (uint32_t i = 0; i < nextCount; ++i) {
+      uint32_t vertex = nextCache[i];
+      const uint32_t *live = adjacency.data() + adjacencyOffset[vertex];
+      for (uint32_t j = 0; j < liveTriangles[vertex]; ++j) {
+        uint32_t candidate = live[j];
+        const uint32_t *corners = indices.data() + size_t(candidate) * 3;
+        float score = vertexScores[corners[0]] + vertexScores[corners[1]] +
+                      vertexScores[corners[2]];
+        if (score > bestScore) {
+          bestScore = score;
+          best = candidate;
+        }
+      }
+    }
+
+    cacheCount = std::min(nextCount, kScoringCacheSize);
+    std::copy(nextCache.begin(), nextCache.begin() + cacheCount,
+              cache.begin());
+  }
+
+  std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void optimizeOverdraw(std::span<uint32_t> indices, const float *positions,
+                      size_t vertexCount, float threshold) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount < 2) {
+    return;
+  }
+
+  // hard boundaries where the cache order already flushed, every vertex of
+  // the triangle missed
+  std::vector<uint32_t> misses;
+  simulateFifo(indices, vertexCount, kCacheSize, misses);
+  std::vector<uint32_t> hardStarts;
+  for (size_t triangle = 0; triangle < triangleCount; ++triangle) {
+    if (triangle == 0 || misses[triangle] == 3) {
+      hardStarts.push_back(static_cast<uint32_t>(triangle));
+    }
+  }
+  hardStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+  // soft boundaries split a hard cluster as soon as the piece, drawn with a
+  // cold cache, is within threshold of the cluster's own miss ratio, so
+  // drawing the pieces in any order costs little vertex reuse
+  std::vector<uint32_t> clusterStarts;
+  std::vector<uint32_t> timestamps(vertexCount, 0);
+  uint32_t time = kCacheSize + 1;
+  for (size_t h = 0; h + 1 < hardStarts.size(); ++h) {
+    uint32_t start = hardStarts[h];
+    uint32_t end = hardStarts[h + 1];
+    uint32_t clusterMisses = 0;
+    for (uint32_t triangle = start; triangle < end; ++triangle) {
+      clusterMisses += misses[triangle];
+    }
+    float limit = threshold * float(clusterMisses) / float(end - start);
+
+    clusterStarts.push_back(start);
+    uint32_t pieceStart = start;
+    uint32_t pieceMisses = 0;
+    for (uint32_t triangle = start; triangle < end; ++triangle) {
+      for (uint32_t corner = 0; corner < 3; ++corner) {
+        uint32_t vertex = indices[size_t(triangle) * 3 + corner];
+        if (time - timestamps[vertex] > kCacheSize) {
+          timestamps[vertex] = time++;
+          pieceMisses++;
+        }
+      }
+      uint32_t pieceTriangles = triangle - pieceStart + 1;
+      if (triangle + 1 < end &&
+          float(pieceMisses) <= limit * float(pieceTriangles)) {
+        clusterStarts.push_back(triangle + 1);
+        pieceStart = triangle + 1;
+        pieceMisses = 0;
+        // the next piece starts cold
+        time += kCacheSize + 1;
+      }
+    }
+  }
+  clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+  // area weighted centroid and normal of every cluster
+  size_t clusterCount = clusterStarts.size() - 1;
+  std::vector<Float3> centroids(clusterCount);
+  std::vector<Float3> normals(clusterCount);
+  Float3 meshCentroid{0.0f, 0.0f, 0.0f};
+  float meshArea = 0.0f;
+  for (size_t cluster = 0; cluster < clusterCount; ++cluster) {
+    Float3 centroid{0.0f, 0.0f, 0.0f};
+    Float3 normal{0.0f, 0.0f, 0.0f};
+    float area = 0.0f;
+    for (uint32_t triangle = clusterStarts[cluster];
+         triangle < clusterStarts[cluster + 1]; ++triangle) {
+      const uint32_t *corners = indices.data() + size_t(triangle) * 3;
+      Float3 p0 = readPosition(positions, corners[0]);
+      Float3 p1 = readPosition(positions, corners[1]);
+      Float3 p2 = readPosition(positions, corners[2]);
+      Float3 e1{p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
+      Float3 e2{p2.x - p0.x, p2.y - p0.y, p2.z - p0.z};
+      Float3 n{e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z,
+               e1.x * e2.y - e1.y * e2.x};
+      float weight = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+      centroid.x += (p0.x + p1.x + p2.x) * weight;
+      centroid.y += (p0.y + p1.y + p2.y) * weight;
+      centroid.z += (p0.z + p1.z + p2.z) * weight;
+      normal.x += n.x;
+      normal.y += n.y;
+      normal.z += n.z;
+      area += weight;
+    }
+    meshCentroid.x += centroid.x;
+    meshCentroid.y += centroid.y;
+    meshCentroid.z += centroid.z;
+    meshArea += area;
+    float inverse = area > 0.0f ? 1.0f / (3.0f * area) : 0.0f;
+    centroids[cluster] = {centroid.x * inverse, centroid.y * inverse,
+                          centroid.z * inverse};
+    float length = std::sqrt(normal.x * normal.x + normal.y * normal.y +
+                             normal.z * normal.z);
+    float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+    normals[cluster] = {normal.x * inverseLength, normal.y * inverseLength,
+                        normal.z * inverseLength};
+  }
+  float inverseArea = meshArea > 0.0f ? 1.0f / (3.0f * meshArea) : 0.0f;
+  meshCentroid = {meshCentroid.x * inverseArea, meshCentroid.y * inverseArea,
+                  meshCentroid.z * inverseArea};
+
+  // clusters facing away from the centre are likely to occlude the rest,
+  // draw them first
+  std::vector<float> sortKeys(clusterCount);
+  std::vector<uint32_t> order(clusterCount);
+  for (size_t cluster = 0; cluster < clusterCount; ++cluster) {
+    const Float3 &c = centroids[cluster];
+    const Float3 &n = normals[cluster];
+    sortKeys[cluster] = (c.x - meshCentroid.x) * n.x +
+                        (c.y - meshCentroid.y) * n.y +
+                        (c.z - meshCentroid.z) * n.z;
+    order[cluster] = static_cast<uint32_t>(cluster);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return sortKeys[a] > sortKeys[b];
+  });
+
+  std::vector<uint32_t> source(indices.begin(),
+                               indices.begin() + triangleCount * 3);
+  size_t out = 0;
+  for (uint32_t cluster : order) {
+    size_t begin = size_t(clusterStarts[cluster]) * 3;
+    size_t end = size_t(clusterStarts[cluster + 1]) * 3;
+    std::copy(source.begin() + begin, source.begin() + end,
+              indices.begin() + out);
+    out += end - begin;
+  }
+}
+
+size_t optimizeVertexFetch(void *vertices, size_t vertexCount, size_t stride,
+                           std::span<uint32_t> indices) {
+  uint8_t *bytes = static_cast<uint8_t *>(vertices);
+  std::vector<uint32_t> remap(vertexCount, kInvalid);
+  uint32_t next = 0;
+  for (uint32_t &index : indices) {
+    if (remap[index] == kInvalid) {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+
+  std::vector<uint8_t> source(bytes, bytes + vertexCount * stride);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    if (remap[vertex] != kInvalid) {
+      memcpy(bytes + size_t(remap[vertex]) * stride,
+             source.data() + vertex * stride, stride);
+    }
+  }
+  return next;
+}
+
+void generatePositionIndices(std::span<const uint32_t> indices,
+                             const void *vertices, size_t vertexCount,
+                             size_t stride, size_t positionSize,
+                             std::vector<uint32_t> &positionIndices) {
+  std::vector<uint32_t> remap;
+  size_t unique = generateVertexRemap(vertices, vertexCount, stride,
+                                      positionSize, remap);
+  // the first vertex of every position stands in for the others
+  std::vector<uint32_t> first(unique, kInvalid);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    if (first[remap[vertex]] == kInvalid) {
+      first[remap[vertex]] = static_cast<uint32_t>(vertex);
+    }
+  }
+
+  positionIndices.clear();
+  positionIndices.reserve(indices.size());
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    uint32_t a = first[remap[indices[i]]];
+    uint32_t b = first[remap[indices[i + 1]]];
+    uint32_t c = first[remap[indices[i + 2]]];
+    if (a != b && b != c && c != a) {
+      positionIndices.insert(positionIndices.end(), {a, b, c});
+    }
+  }
+  optimizeVertexCache(positionIndices, vertexCount);
+}
+
+std::vector<uint32_t> simplify(std::span<const uint32_t> indices,
+                               const float *positions, size_t positionStride,
+                               size_t vertexCount, size_t targetIndexCount,
+                               float targetError, float *resultError) {
+  const uint8_t *positionBytes = reinterpret_cast<const uint8_t *>(positions);
+  std::vector<Float3> points(vertexCount);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    memcpy(&points[vertex], positionBytes + vertex * positionStride,
+           sizeof(Float3));
+  }
+
+  // vertices sharing a position are one point of the surface; the topology
+  // is judged on these groups, so a uv or normal seam is not a border
+  std::vector<uint32_t> group;
+  size_t groupCount = generateVertexRemap(points.data(), vertexCount,
+                                          sizeof(Float3), group);
+  std::vector<uint32_t> groupSize(groupCount, 0);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    groupSize[group[vertex]]++;
+  }
+
+  std::vector<uint32_t> result(indices.begin(),
+                               indices.end() - indices.size() % 3);
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i < result.size(); i += 3) {
+    const Float3 &p0 = points[result[i]];
+    Float3 normal = cross(points[result[i + 1]] - p0, points[result[i + 2]] - p0);
+    float length = std::sqrt(dot(normal, normal));
+    if (length == 0.0f) {
+      continue;
+    }
+    normal = {normal.x / length, normal.y / length, normal.z / length};
+    for (size_t corner = 0; corner < 3; ++corner) {
+      quadrics[result[i + corner]].addPlane(normal, -dot(normal, p0),
+                                            0.5 * length);
+    }
+  }
+
+  std::unordered_map<uint64_t, uint32_t> edgeUses;
+  std::vector<uint8_t> kind(vertexCount);
+  std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+  std::vector<uint32_t> adjacency;
+  std::vector<uint32_t> collapse(vertexCount);
+  std::vector<uint8_t> touched(vertexCount);
+  struct Candidate {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+  };
+  std::vector<Candidate> candidates;
+  double maxCost = double(targetError) * double(targetError);
+  double worstCost = 0.0;
+  bool firstPass = true;
+
+  while (result.size() > targetIndexCount) {
+    edgeUses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        edgeUses[edgeKey(group[result[i + corner]],
+                         group[result[i + (corner + 1) % 3]])]++;
+      }
+    }
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+      kind[vertex] = groupSize[group[vertex]] > 1 ? kLocked : kManifold;
+    }
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        uint32_t a = result[i + corner];
+        uint32_t b = result[i + (corner + 1) % 3];
+        uint32_t uses = edgeUses[edgeKey(group[a], group[b])];
+        for (uint32_t vertex : {a, b}) {
+          if (uses > 2) {
+            kind[vertex] = kLocked;
+          } else if (uses == 1 && kind[vertex] == kManifold) {
+            kind[vertex] = kBorder;
+          }
+        }
+        if (uses == 1 && firstPass) {
+          // the border plane keeps the outline in place
+          Float3 edge = points[b] - points[a];
+          Float3 normal = cross(edge, points[result[i + (corner + 2) % 3]] -
+                                          points[a]);
+          Float3 plane = cross(edge, normal);
+          float length = std::sqrt(dot(plane, plane));
+          if (length > 0.0f) {
+            plane = {plane.x / length, plane.y / length, plane.z / length};
+            double weight = kBorderWeight * dot(edge, edge);
+            quadrics[a].addPlane(plane, -dot(plane, points[a]), weight);
+            quadrics[b].addPlane(plane, -dot(plane, points[a]), weight);
+          }
+        }
+      }
+    }
+    firstPass = false;
+
+    // triangles around every vertex
+    std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+    for (uint32_t index : result) {
+      adjacencyOffsets[index + 1]++;
+    }
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+      adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+    }
+    adjacency.resize(result.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(),
+                               adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < result.size(); ++i) {
+      adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    // both directions of every edge, the cheaper allowed one is kept;
+    // vertices only collapse onto vertices alone at their position, so the
+    // attributes they end up with are never ambiguous
+    auto allowed = [&](uint32_t from, uint32_t to) {
+      if (kind[from] == kLocked || groupSize[group[to]] > 1) {
+        return false;
+      }
+      return kind[from] != kBorder ||
+             edgeUses[edgeKey(group[from], group[to])] == 1;
+    };
+    auto cost = [&](uint32_t from, uint32_t to) {
+      Quadric merged = quadrics[from];
+      merged += quadrics[to];
+      return merged.evaluate(points[to]);
+    };
+    candidates.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        uint32_t a = result[i + corner];
+        uint32_t b = result[i + (corner + 1) % 3];
+        bool forward = allowed(a, b);
+        bool backward = allowed(b, a);
+        double forwardCost = forward ? cost(a, b) : 0.0;
+        double backwardCost = backward ? cost(b, a) : 0.0;
+        if (forward && (!backward || forwardCost <= backwardCost)) {
+          candidates.push_back({a, b, forwardCost});
+        } else if (backward) {
+          candidates.push_back({b, a, backwardCost});
+        }
+      }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) {
+                return a.cost < b.cost;
+              });
+
+    // greedy in cost order; a collapse locks everything around it for the
+    // rest of the pass so the flip test never sees stale triangles
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+      collapse[vertex] = static_cast<uint32_t>(vertex);
+    }
+    std::fill(touched.begin(), touched.end(), 0);
+    size_t triangleCount = result.size() / 3;
+    size_t targetTriangles = targetIndexCount / 3;
+    size_t collapsed = 0;
+    for (const Candidate &candidate : candidates) {
+      if (candidate.cost > maxCost || triangleCount <= targetTriangles) {
+        break;
+      }
+      if (touched[candidate.from] || touched[candidate.to]) {
+        continue;
+      }
+      bool flips = false;
+      size_t removed = 0;
+      for (uint32_t k = adjacencyOffsets[candidate.from];
+           k < adjacencyOffsets[candidate.from + 1] && !flips; ++k) {
+        const uint32_t *triangle = &result[size_t(adjacency[k]) * 3];
+        Float3 before[3];
+        Float3 after[3];
+        bool degenerate = false;
+        for (size_t corner = 0; corner < 3; ++corner) {
+          before[corner] = points[triangle[corner]];
+          after[corner] = triangle[corner] == candidate.from
+                              ? points[candidate.to]
+                              : before[corner];
+          degenerate |= triangle[corner] == candidate.to;
+        }
+        if (degenerate) {
+          removed++;
+          continue;
+        }
+        Float3 normalBefore =
+            cross(before[1] - before[0], before[2] - before[0]);
+        Float3 normalAfter = cross(after[1] - after[0], after[2] - after[0]);
+        flips = dot(normalBefore, normalAfter) <= 0.0f;
+      }
+      if (flips) {
+        continue;
+      }
+
+      collapse[candidate.from] = candidate.to;
+      quadrics[candidate.to] += quadrics[candidate.from];
+      worstCost = std::max(worstCost, candidate.cost);
+      for (uint32_t k = adjacencyOffsets[candidate.from];
+           k < adjacencyOffsets[candidate.from + 1]; ++k) {
+        const uint32_t *triangle = &result[size_t(adjacency[k]) * 3];
+        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+      }
+      touched[candidate.to] = 1;
+      triangleCount -= removed;
+      collapsed++;
+    }
+    if (collapsed == 0) {
+      break;
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      uint32_t a = collapse[result[i]];
+      uint32_t b = collapse[result[i + 1]];
+      uint32_t c = collapse[result[i + 2]];
+      if (a != b && b != c && c != a) {
+        result[written++] = a;
+        result[written++] = b;
+        result[written++] = c;
+      }
+    }
+    result.resize(written);
+  }
+
+  if (resultError) {
+    *resultError = float(std::sqrt(worstCost));
+  }
+  return result;
+}
+
+void buildMeshlets(std::span<const uint32_t> indices, size_t vertexCount,
+                   std::vector<Meshlet> &meshlets,
+                   std::vector<uint32_t> &meshletVertices,
+                   std::vector<uint8_t> &meshletTriangles,
+                   uint32_t maxVertices, uint32_t maxTriangles) {
+  // local index of every vertex in the open meshlet
+  std::vector<uint8_t> local(vertexCount, 0xff);
+  Meshlet current{static_cast<uint32_t>(meshletVertices.size()),
+                  static_cast<uint32_t>(meshletTriangles.size()), 0, 0};
+
+  auto flush = [&]() {
+    if (current.triangleCount == 0) {
+      return;
+    }
+    for (uint32_t i = 0; i < current.vertexCount; ++i) {
+      local[meshletVertices[current.vertexOffset + i]] = 0xff;
+    }
+    meshletTriangles.resize((meshletTriangles.size() + 3) & ~size_t(3), 0);
+    meshlets.push_back(current);
+    current = {static_cast<uint32_t>(meshletVertices.size()),
+               static_cast<uint32_t>(meshletTriangles.size()), 0, 0};
+  };
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    uint32_t added = 0;
+    for (size_t corner = 0; corner < 3; ++corner) {
+      added += local[indices[i + corner]] == 0xff;
+    }
+    if (current.vertexCount + added > maxVertices ||
+        current.triangleCount + 1 > maxTriangles) {
+      flush();
+    }
+    for (size_t corner = 0; corner < 3; ++corner) {
+      uint32_t vertex = indices[i + corner];
+      if (local[vertex] == 0xff) {
+        local[vertex] = static_cast<uint8_t>(current.vertexCount++);
+        meshletVertices.push_back(vertex);
+      }
+      meshletTriangles.push_back(local[vertex]);
+    }
+    current.triangleCount++;
+  }
+  flush();
+}
+
+MeshletBounds computeMeshletBounds(const Meshlet &meshlet,
+                                   std::span<const uint32_t> meshletVertices,
+                                   std::span<const uint8_t> meshletTriangles,
+                                   const float *positions,
+                                   size_t positionStride) {
+  const uint8_t *positionBytes = reinterpret_cast<const uint8_t *>(positions);
+  auto point = [&](uint32_t localIndex) {
+    Float3 p;
+    memcpy(&p,
+           positionBytes +
+               size_t(meshletVertices[meshlet.vertexOffset + localIndex]) *
+                   positionStride,
+           sizeof(p));
+    return p;
+  };
+
+  MeshletBounds bounds{};
+  if (meshlet.vertexCount == 0) {
+    bounds.coneCutoff = 1.0f;
+    return bounds;
+  }
+
+  // sphere around the box, loose but cheap
+  Float3 lower = point(0);
+  Float3 upper = lower;
+  for (uint32_t i = 1; i < meshlet.vertexCount; ++i) {
+    Float3 p = point(i);
+    lower = {std::min(lower.x, p.x), std::min(lower.y, p.y),
+             std::min(lower.z, p.z)};
+    upper = {std::max(upper.x, p.x), std::max(upper.y, p.y),
+             std::max(upper.z, p.z)};
+  }
+  Float3 center = {(lower.x + upper.x) * 0.5f, (lower.y + upper.y) * 0.5f,
+                   (lower.z + upper.z) * 0.5f};
+  float radius = 0.0f;
+  for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+    Float3 d = point(i) - center;
+    radius = std::max(radius, std::sqrt(dot(d, d)));
+  }
+  memcpy(bounds.center, &center, sizeof(bounds.center));
+  bounds.radius = radius;
+
+  // the cone axis is the average normal; its cutoff the widest angle to any
+  // triangle's normal, turned into the test against the view direction
+  std::vector<Float3> normals;
+  normals.reserve(meshlet.triangleCount);
+  Float3 axis{0.0f, 0.0f, 0.0f};
+  for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+    const uint8_t *triangle =
+        meshletTriangles.data() + meshlet.triangleOffset + t * 3;
+    Float3 p0 = point(triangle[0]);
+    Float3 normal = cross(point(triangle[1]) - p0, point(triangle[2]) - p0);
+    float length = std::sqrt(dot(normal, normal));
+    if (length == 0.0f) {
+      continue;
+    }
+    normal = {normal.x / length, normal.y / length, normal.z / length};
+    normals.push_back(normal);
+    axis = {axis.x + normal.x, axis.y + normal.y, axis.z + normal.z};
+  }
+  float axisLength = std::sqrt(dot(axis, axis));
+  bounds.coneCutoff = 1.0f;
+  memcpy(bounds.coneApex, &center, sizeof(bounds.coneApex));
+  if (normals.empty() || axisLength == 0.0f) {
+    return bounds;
+  }
+  axis = {axis.x / axisLength, axis.y / axisLength, axis.z / axisLength};
+  memcpy(bounds.coneAxis, &axis, sizeof(bounds.coneAxis));
+
+  float minDot = 1.0f;
+  for (const Float3 &normal : normals) {
+    minDot = std::min(minDot, dot(axis, normal));
+  }
+  // wider than about 84 degrees the cone never culls anything useful
+  if (minDot <= 0.1f) {
+    return bounds;
+  }
+
+  // the apex sits behind every triangle plane along the axis, so the test
+  // holds for any point of the meshlet
+  float apexDistance = 0.0f;
+  uint32_t normalIndex = 0;
+  for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+    const uint8_t *triangle =
+        meshletTriangles.data() + meshlet.triangleOffset + t * 3;
+    Float3 p0 = point(triangle[0]);
+    Float3 normal = cross(point(triangle[1]) - p0, point(triangle[2]) - p0);
+    if (dot(normal, normal) == 0.0f) {
+      continue;
+    }
+    const Float3 &unit = normals[normalIndex++];
+    float distance = dot(center - p0, unit) / dot(axis, unit);
+    apexDistance = std::max(apexDistance, distance);
+  }
+  Float3 apex = {center.x - axis.x * apexDistance,
+                 center.y - axis.y * apexDistance,
+                 center.z - axis.z * apexDistance};
+  memcpy(bounds.coneApex, &apex, sizeof(bounds.coneApex));
+  bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  return bounds;
+}
+
+size_t optimizeMesh(void *vertices, size_t vertexCount, size_t stride,
+                    const float *positions, size_t positionStride,
+                    std::span<uint32_t> indices, CacheStats *before,
+                    CacheStats *after) {
+  if (before) {
+    *before = analyzeVertexCache(indices, vertexCount);
+  }
+
+  // weld; the remap is in first occurrence order, so every unique vertex
+  // moves towards the front and the compaction can run in place
+  std::vector<uint32_t> remap;
+  size_t unique = generateVertexRemap(vertices, vertexCount, stride, remap);
+  uint8_t *bytes = static_cast<uint8_t *>(vertices);
+  const uint8_t *positionBytes = reinterpret_cast<const uint8_t *>(positions);
+  std::vector<float> weldedPositions(unique * 3);
+  size_t written = 0;
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    if (remap[vertex] == written) {
+      if (written != vertex) {
+        memcpy(bytes + written * stride, bytes + vertex * stride, stride);
+      }
+      memcpy(weldedPositions.data() + written * 3,
+             positionBytes + vertex * positionStride, 3 * sizeof(float));
+      ++written;
+    }
+  }
+  for (uint32_t &index : indices) {
+    index = remap[index];
+  }
+
+  optimizeVertexCache(indices, unique);
+  optimizeOverdraw(indices, weldedPositions.data(), unique);
+  size_t count = optimizeVertexFetch(vertices, unique, stride, indices);
+
+  if (after) {
+    *after = analyzeVertexCache(indices, count);
+  }
+  return count;
+}
+
+} // namespace MeshOptimizer
+} // namespace hiddenpiggy
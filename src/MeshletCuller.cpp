@@ -0,0 +1,516 @@
+#include "MeshletCuller.hpp"
+#include "SimdMath.hpp"
+#include "VkShaderModuleFactory.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+
+namespace hiddenpiggy {
+
+namespace {
+// the spec guarantees at least this many groups per dimension
+constexpr uint32_t kMaxGroupCount = 65535;
+// meshlets per task shader workgroup, local_size_x of meshlet_task.task
+constexpr uint32_t kTaskGroupSize = 32;
+
+enum Binding : uint32_t {
+  kConstants = 0,
+  kMeshlets,
+  kMeshletVertices,
+  kMeshletTriangles,
+  kIndices,
+  kDrawArgs,
+  kVertices,
+  kPlacements,
+  kWorkItems,
+  kBindingCount
+};
+
+// updateBuffer takes at most 65536 bytes
+constexpr uint32_t kMaxUpdateDraws =
+    65536 / sizeof(vk::DrawIndexedIndirectCommand);
+// the minimum maxDrawIndirectCount of devices with multiDrawIndirect
+constexpr uint32_t kMaxMultiDrawCount = 65535;
+} // namespace
+
+void MeshletCuller::OnCreate(
+    vk::DescriptorSetLayout sceneSetLayout,
+    std::span<const vk::PushConstantRange> scenePushConstants,
+    vk::RenderPass renderPass) {
+  vk::Device device = m_pContext->getDevice();
+  vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eCompute;
+  if (m_pContext->isMeshShaderSupported()) {
+    stages |= vk::ShaderStageFlagBits::eTaskEXT |
+              vk::ShaderStageFlagBits::eMeshEXT;
+  }
+  std::array<vk::DescriptorSetLayoutBinding, kBindingCount> bindings;
+  for (uint32_t i = 0; i < kBindingCount; ++i) {
+    bindings[i] = vk::DescriptorSetLayoutBinding{
+        i,
+        i == kConstants ? vk::DescriptorType::eUniformBuffer
+                        : vk::DescriptorType::eStorageBuffer,
+        1, stages};
+  }
+  m_descriptorSetLayout = device.createDescriptorSetLayout(
+      vk::DescriptorSetLayoutCreateInfo{{}, bindings});
+  m_sceneSetLayout = sceneSetLayout;
+  m_scenePushConstants.assign(scenePushConstants.begin(),
+                              scenePushConstants.end());
+  m_renderPass = renderPass;
+
+  if (m_pContext->isMeshShaderSupported() &&
+      createMeshPipeline(sceneSetLayout, scenePushConstants, renderPass)) {
+    return;
+  }
+  if (!createComputePipeline()) {
+    std::cerr << "Warning: meshlet culling unavailable, drawing whole meshes"
+              << std::endl;
+    m_enabled = false;
+  }
+}
+
+void MeshletCuller::OnDestroy() {
+  vk::Device device = m_pContext->getDevice();
+  for (auto &slot : m_slots) {
+    m_pBufferPool->freeBuffer(slot.constants);
+    for (GrowingBuffer *buffer : {&slot.placements, &slot.workItems,
+                                  &slot.indices, &slot.drawArgs}) {
+      if (buffer->capacity > 0) {
+        m_pBufferPool->freeBuffer(buffer->buffer);
+      }
+    }
+    device.destroyDescriptorPool(slot.descriptorPool);
+  }
+  m_slots.clear();
+  if (m_computePipeline) {
+    device.destroyPipeline(m_computePipeline);
+    m_computePipeline = nullptr;
+  }
+  if (m_computeLayout) {
+    device.destroyPipelineLayout(m_computeLayout);
+    m_computeLayout = nullptr;
+  }
+  if (m_meshPipeline) {
+    device.destroyPipeline(m_meshPipeline);
+    m_meshPipeline = nullptr;
+  }
+  if (m_meshLayout) {
+    device.destroyPipelineLayout(m_meshLayout);
+    m_meshLayout = nullptr;
+  }
+  if (m_descriptorSetLayout) {
+    device.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    m_descriptorSetLayout = nullptr;
+  }
+}
+
+bool MeshletCuller::createComputePipeline() {
+  vk::Device device = m_pContext->getDevice();
+  vk::ShaderModule shaderModule;
+  try {
+    shaderModule = VkShaderModuleFactory::CreateShaderModule(
+        device,
+        (std::string{SHADERS_PATH} + std::string{"meshlet_cull.spv"}).c_str());
+  } catch (const std::exception &) {
+    return false;
+  }
+
+  m_computeLayout = device.createPipelineLayout(
+      vk::PipelineLayoutCreateInfo{{}, m_descriptorSetLayout});
+  vk::ComputePipelineCreateInfo pipelineCreateInfo{
+      {},
+      vk::PipelineShaderStageCreateInfo{
+          {}, vk::ShaderStageFlagBits::eCompute, shaderModule, "main"},
+      m_computeLayout};
+  auto result = device.createComputePipeline(nullptr, pipelineCreateInfo);
+  device.destroyShaderModule(shaderModule);
+  if (result.result != vk::Result::eSuccess) {
+    device.destroyPipelineLayout(m_computeLayout);
+    m_computeLayout = nullptr;
+    return false;
+  }
+  m_computePipeline = result.value;
+  return true;
+}
+
+bool MeshletCuller::createMeshPipeline(
+    vk::DescriptorSetLayout sceneSetLayout,
+    std::span<const vk::PushConstantRange> scenePushConstants,
+    vk::RenderPass renderPass) {
+  vk::Device device = m_pContext->getDevice();
+  m_vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(
+      device.getProcAddr("vkCmdDrawMeshTasksEXT"));
+  if (!m_vkCmdDrawMeshTasksEXT) {
+    return false;
+  }
+
+  std::array<vk::ShaderModule, 3> modules{};
+  try {
+    modules[0] = VkShaderModuleFactory::CreateShaderModule(
+        device,
+        (std::string{SHADERS_PATH} + std::string{"meshlet_task.spv"}).c_str());
+    modules[1] = VkShaderModuleFactory::CreateShaderModule(
+        device,
+        (std::string{SHADERS_PATH} + std::string{"meshlet_mesh.spv"}).c_str());
+    modules[2] = VkShaderModuleFactory::CreateShaderModule(
+        device,
+        (std::string{SHADERS_PATH} + std::string{"swapchain_frag.spv"})
+            .c_str());
+  } catch (const std::exception &) {
+    for (auto module : modules) {
+      if (module) {
+        device.destroyShaderModule(module);
+      }
+    }
+    return false;
+  }
+  std::array<vk::PipelineShaderStageCreateInfo, 3> shaderStages{
+      vk::PipelineShaderStageCreateInfo{
+          {}, vk::ShaderStageFlagBits::eTaskEXT, modules[0], "main"},
+      vk::PipelineShaderStageCreateInfo{
+          {}, vk::ShaderStageFlagBits::eMeshEXT, modules[1], "main"},
+      vk::PipelineShaderStageCreateInfo{
+          {}, vk::ShaderStageFlagBits::eFragment, modules[2], "main"}};
+
+  // same set 0 and push constants as the scene pipeline, so what the
+  // renderer bound for it stays valid
+  std::array<vk::DescriptorSetLayout, 2> setLayouts{sceneSetLayout,
+                                                    m_descriptorSetLayout};
+  m_meshLayout = device.createPipelineLayout(
+      vk::PipelineLayoutCreateInfo{{}, setLayouts, scenePushConstants});
+
+  vk::PipelineViewportStateCreateInfo viewportState{{}, 1, nullptr, 1, nullptr};
+  vk::PipelineRasterizationStateCreateInfo rasterizationState{};
+  rasterizationState.polygonMode = vk::PolygonMode::eFill;
+  rasterizationState.cullMode = vk::CullModeFlagBits::eBack;
+  rasterizationState.frontFace = vk::FrontFace::eCounterClockwise;
+  rasterizationState.lineWidth = 1.0f;
+  vk::PipelineMultisampleStateCreateInfo multisampleState{};
+  multisampleState.rasterizationSamples = vk::SampleCountFlagBits::e1;
+  vk::PipelineDepthStencilStateCreateInfo depthStencilState{};
+  vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask =
+      vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+      vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+  vk::PipelineColorBlendStateCreateInfo colorBlendState{};
+  colorBlendState.attachmentCount = 1;
+  colorBlendState.pAttachments = &colorBlendAttachment;
+  std::array<vk::DynamicState, 2> dynamicStates{vk::DynamicState::eViewport,
+                                                vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamicState{{}, dynamicStates};
+
+  // mesh pipelines have neither vertex input nor input assembly
+  vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+  pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+  pipelineCreateInfo.pStages = shaderStages.data();
+  pipelineCreateInfo.pViewportState = &viewportState;
+  pipelineCreateInfo.pRasterizationState = &rasterizationState;
+  pipelineCreateInfo.pMultisampleState = &multisampleState;
+  pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+  pipelineCreateInfo.pColorBlendState = &colorBlendState;
+  pipelineCreateInfo.pDynamicState = &dynamicState;
+  pipelineCreateInfo.layout = m_meshLayout;
+  pipelineCreateInfo.renderPass = renderPass;
+  pipelineCreateInfo.subpass = 0;
+  auto result = device.createGraphicsPipeline(nullptr, pipelineCreateInfo);
+  for (auto module : modules) {
+    device.destroyShaderModule(module);
+  }
+  if (result.result != vk::Result::eSuccess) {
+    device.destroyPipelineLayout(m_meshLayout);
+    m_meshLayout = nullptr;
+    return false;
+  }
+  m_meshPipeline = result.value;
+  return true;
+}
+
+bool MeshletCuller::reloadShaders(DeletionQueue &deletionQueue) {
+  bool mesh = static_cast<bool>(m_meshPipeline);
+  vk::PipelineLayout &layout = mesh ? m_meshLayout : m_computeLayout;
+  vk::Pipeline &pipeline = mesh ? m_meshPipeline : m_computePipeline;
+  if (!pipeline) {
+    return false;
+  }
+  vk::PipelineLayout oldLayout = layout;
+  vk::Pipeline oldPipeline = pipeline;
+  bool built = mesh ? createMeshPipeline(m_sceneSetLayout,
+                                         m_scenePushConstants, m_renderPass)
+                    : createComputePipeline();
+  if (!built) {
+    layout = oldLayout;
+    pipeline = oldPipeline;
+    return false;
+  }
+  vk::Device device = m_pContext->getDevice();
+  deletionQueue.push([device, oldLayout, oldPipeline] {
+    device.destroyPipeline(oldPipeline);
+    device.destroyPipelineLayout(oldLayout);
+  });
+  return true;
+}
+
+MeshletCuller::Slot &MeshletCuller::acquireSlot() {
+  if (m_usedSlots < m_slots.size()) {
+    return m_slots[m_usedSlots++];
+  }
+  Slot slot{};
+  vk::Device device = m_pContext->getDevice();
+  std::array<vk::DescriptorPoolSize, 2> poolSizes{
+      vk::DescriptorPoolSize{vk::DescriptorType::eUniformBuffer, 1},
+      vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer,
+                             kBindingCount - 1}};
+  slot.descriptorPool = device.createDescriptorPool(
+      vk::DescriptorPoolCreateInfo{{}, 1, poolSizes});
+  slot.descriptorSet = device.allocateDescriptorSets(
+      vk::DescriptorSetAllocateInfo{slot.descriptorPool,
+                                    m_descriptorSetLayout})[0];
+
+  // rewritten every frame, the frame before has been waited on
+  vk::BufferCreateInfo constantsCreateInfo{
+      {}, sizeof(CullConstants), vk::BufferUsageFlagBits::eUniformBuffer};
+  VmaAllocationCreateInfo hostCreateInfo{};
+  hostCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+  hostCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                         VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  slot.constants =
+      m_pBufferPool->allocateMemory(constantsCreateInfo, hostCreateInfo);
+  vmaGetAllocationInfo(m_pBufferPool->getAllocator(), slot.constants.allocation,
+                       &slot.constants.allocationInfo);
+
+  m_slots.push_back(slot);
+  return m_slots[m_usedSlots++];
+}
+
+void MeshletCuller::reserve(GrowingBuffer &buffer, vk::DeviceSize size,
+                            vk::BufferUsageFlags usage, bool hostVisible) {
+  if (size <= buffer.capacity) {
+    return;
+  }
+  if (buffer.capacity > 0) {
+    m_pBufferPool->freeBuffer(buffer.buffer);
+  }
+  buffer.capacity = std::max(size, buffer.capacity * 2);
+  vk::BufferCreateInfo bufferCreateInfo{{}, buffer.capacity, usage};
+  VmaAllocationCreateInfo allocCreateInfo{};
+  if (hostVisible) {
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocCreateInfo.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+        VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  } else {
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  }
+  buffer.buffer =
+      m_pBufferPool->allocateMemory(bufferCreateInfo, allocCreateInfo);
+  if (hostVisible) {
+    vmaGetAllocationInfo(m_pBufferPool->getAllocator(),
+                         buffer.buffer.allocation,
+                         &buffer.buffer.allocationInfo);
+  }
+}
+
+void MeshletCuller::writeDescriptors(Slot &slot, const glTFModel &scene) {
+  // the mesh shader path writes no indices, bind the args in their place
+  const BufferWrapper &indices =
+      m_meshPipeline ? slot.drawArgs.buffer : slot.indices.buffer;
+
+  std::array<vk::DescriptorBufferInfo, kBindingCount> infos{
+      vk::DescriptorBufferInfo{slot.constants.buffer, 0, sizeof(CullConstants)},
+      vk::DescriptorBufferInfo{scene.getMeshletBuffer().buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{scene.getMeshletVertexBuffer().buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{scene.getMeshletTriangleBuffer().buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{indices.buffer, 0, VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{slot.drawArgs.buffer.buffer, 0, VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{scene.getVertexBuffer().buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{slot.placements.buffer.buffer, 0,
+                               VK_WHOLE_SIZE},
+      vk::DescriptorBufferInfo{slot.workItems.buffer.buffer, 0,
+                               VK_WHOLE_SIZE}};
+  std::array<vk::WriteDescriptorSet, kBindingCount> writes;
+  for (uint32_t i = 0; i < kBindingCount; ++i) {
+    writes[i] = vk::WriteDescriptorSet{
+        slot.descriptorSet, i, 0,
+        i == kConstants ? vk::DescriptorType::eUniformBuffer
+                        : vk::DescriptorType::eStorageBuffer,
+        nullptr, infos[i]};
+  }
+  m_pContext->getDevice().updateDescriptorSets(writes, nullptr);
+}
+
+int MeshletCuller::cull(vk::CommandBuffer cmdBuf, const glTFModel &scene,
+                        const glm::mat4 &model, const glm::mat4 &viewProj,
+                        const glm::vec3 &cameraPosition) {
+  if (!m_enabled || !scene.isUploaded() || scene.getMeshletCount() == 0) {
+    return -1;
+  }
+
+  // every transform of a mesh with meshlets that no impostor stands in for
+  // is a placement, with a work item per meshlet of the mesh. The compute
+  // path compacts each placement's survivors into its own index range.
+  m_placements.clear();
+  m_workItems.clear();
+  m_draws.clear();
+  uint32_t indexCount = 0;
+  const auto &hidden = scene.getHiddenTransforms();
+  for (const auto &range : scene.getMeshletRanges()) {
+    for (uint32_t i = 0; i < range.transformCount; ++i) {
+      uint32_t transform = range.firstTransform + i;
+      if (hidden[transform]) {
+        continue;
+      }
+      // meshlet bounds are in model space, so is the culling
+      glm::mat4 placed = model * scene.getTransforms()[transform];
+      Placement placement{};
+      placement.modelViewProj = viewProj * placed;
+      SimdMath::extractFrustumPlanes(placement.modelViewProj,
+                                     placement.frustumPlanes);
+      placement.cameraPosition =
+          glm::inverse(placed) * glm::vec4(cameraPosition, 1.0f);
+      placement.quantization = scene.getQuantizations()[transform];
+      uint32_t placementIndex = static_cast<uint32_t>(m_placements.size());
+      m_placements.push_back(placement);
+      for (uint32_t m = 0; m < range.meshletCount; ++m) {
+        m_workItems.push_back({range.firstMeshlet + m, placementIndex});
+      }
+      // the shader appends to indexCount; the indices are absolute, and
+      // firstInstance picks the transform for the scene's vertex shader
+      m_draws.push_back(
+          vk::DrawIndexedIndirectCommand{0, 1, indexCount, 0, transform});
+      indexCount += range.indexCount;
+    }
+  }
+  if (m_placements.empty()) {
+    return -1;
+  }
+  // indirect draws only start past instance 0 with drawIndirectFirstInstance,
+  // which comes with multi draw; the scene path draws the rest
+  if (!m_meshPipeline && !m_pContext->isMultiDrawIndirectSupported() &&
+      (m_draws.size() > 1 || m_draws[0].firstInstance != 0)) {
+    return -1;
+  }
+
+  if (m_usedSlots == 0) {
+    m_submittedMeshlets = 0;
+  }
+  int ticket = static_cast<int>(m_usedSlots);
+  Slot &slot = acquireSlot();
+  slot.itemCount = static_cast<uint32_t>(m_workItems.size());
+  slot.placementCount = static_cast<uint32_t>(m_placements.size());
+
+  vk::DeviceSize placementBytes = m_placements.size() * sizeof(Placement);
+  vk::DeviceSize itemBytes = m_workItems.size() * sizeof(WorkItem);
+  vk::DeviceSize drawBytes =
+      m_draws.size() * sizeof(vk::DrawIndexedIndirectCommand);
+  reserve(slot.placements, placementBytes,
+          vk::BufferUsageFlagBits::eStorageBuffer, true);
+  reserve(slot.workItems, itemBytes, vk::BufferUsageFlagBits::eStorageBuffer,
+          true);
+  reserve(slot.drawArgs, drawBytes,
+          vk::BufferUsageFlagBits::eStorageBuffer |
+              vk::BufferUsageFlagBits::eIndirectBuffer |
+              vk::BufferUsageFlagBits::eTransferDst,
+          false);
+  if (!m_meshPipeline) {
+    reserve(slot.indices,
+            std::max<vk::DeviceSize>(vk::DeviceSize(indexCount) *
+                                         sizeof(uint32_t),
+                                     sizeof(uint32_t)),
+            vk::BufferUsageFlagBits::eStorageBuffer |
+                vk::BufferUsageFlagBits::eIndexBuffer,
+            false);
+  }
+  writeDescriptors(slot, scene);
+
+  CullConstants constants{};
+  constants.itemCount = slot.itemCount;
+  constants.placementCount = slot.placementCount;
+  constants.attributeOffset =
+      static_cast<uint32_t>(scene.getAttributeStreamOffset() / sizeof(uint32_t));
+  constants.coneCulling = m_coneCulling ? 1 : 0;
+  memcpy(slot.constants.allocationInfo.pMappedData, &constants,
+         sizeof(constants));
+  memcpy(slot.placements.buffer.allocationInfo.pMappedData,
+         m_placements.data(), placementBytes);
+  memcpy(slot.workItems.buffer.allocationInfo.pMappedData, m_workItems.data(),
+         itemBytes);
+  VmaAllocator allocator = m_pBufferPool->getAllocator();
+  vmaFlushAllocation(allocator, slot.constants.allocation, 0,
+                     sizeof(constants));
+  vmaFlushAllocation(allocator, slot.placements.buffer.allocation, 0,
+                     placementBytes);
+  vmaFlushAllocation(allocator, slot.workItems.buffer.allocation, 0,
+                     itemBytes);
+  m_submittedMeshlets += slot.itemCount;
+
+  // the task shader culls as part of the draw
+  if (m_meshPipeline) {
+    return ticket;
+  }
+
+  for (uint32_t first = 0; first < slot.placementCount;
+       first += kMaxUpdateDraws) {
+    uint32_t count = std::min(slot.placementCount - first, kMaxUpdateDraws);
+    cmdBuf.updateBuffer(slot.drawArgs.buffer.buffer,
+                        first * sizeof(vk::DrawIndexedIndirectCommand),
+                        count * sizeof(vk::DrawIndexedIndirectCommand),
+                        m_draws.data() + first);
+  }
+  vk::MemoryBarrier resetBarrier{vk::AccessFlagBits::eTransferWrite,
+                                 vk::AccessFlagBits::eShaderRead |
+                                     vk::AccessFlagBits::eShaderWrite};
+  cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                         vk::PipelineStageFlagBits::eComputeShader, {},
+                         resetBarrier, nullptr, nullptr);
+
+  cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_computePipeline);
+  cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_computeLayout, 0,
+                            slot.descriptorSet, nullptr);
+  cmdBuf.dispatch(std::min(slot.itemCount, kMaxGroupCount), 1, 1);
+
+  vk::MemoryBarrier cullBarrier{vk::AccessFlagBits::eShaderWrite,
+                                vk::AccessFlagBits::eIndirectCommandRead |
+                                    vk::AccessFlagBits::eIndexRead};
+  cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                         vk::PipelineStageFlagBits::eDrawIndirect |
+                             vk::PipelineStageFlagBits::eVertexInput,
+                         {}, cullBarrier, nullptr, nullptr);
+  return ticket;
+}
+
+void MeshletCuller::draw(vk::CommandBuffer cmdBuf, const glTFModel &scene,
+                         int ticket) {
+  if (ticket < 0) {
+    return;
+  }
+  const Slot &slot = m_slots[ticket];
+  if (m_meshPipeline) {
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eGraphics, m_meshPipeline);
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_meshLayout,
+                              1, slot.descriptorSet, nullptr);
+    // more groups than a dimension can have go on in y
+    uint32_t groups = (slot.itemCount + kTaskGroupSize - 1) / kTaskGroupSize;
+    uint32_t rows = (groups + kMaxGroupCount - 1) / kMaxGroupCount;
+    m_vkCmdDrawMeshTasksEXT(cmdBuf, std::min(groups, kMaxGroupCount), rows,
+                            1);
+    return;
+  }
+  // the culled indices are absolute, the vertex offset is baked in
+  scene.bindVertexStreams(cmdBuf);
+  cmdBuf.bindIndexBuffer(slot.indices.buffer.buffer, 0,
+                         vk::IndexType::eUint32);
+  for (uint32_t first = 0; first < slot.placementCount;
+       first += kMaxMultiDrawCount) {
+    cmdBuf.drawIndexedIndirect(
+        slot.drawArgs.buffer.buffer,
+        first * sizeof(vk::DrawIndexedIndirectCommand),
+        std::min(slot.placementCount - first, kMaxMultiDrawCount),
+        sizeof(vk::DrawIndexedIndirectCommand));
+  }
+}
+} // namespace hiddenpiggy
@@ -1,4 +1,5 @@
 #include "Renderer.hpp"
+#include "AssetPack.hpp"
 #include "GLFW/glfw3.h"
 #include "ResourceUploadHeap.hpp"
 #include "UniformBuffers.hpp"
@@ -19,6 +20,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "glTFScene.hpp"
 #include "App.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
 
 namespace hiddenpiggy {
 void Renderer::OnCreate(const std::string AppName, uint32_t width,
@@ -41,13 +46,42 @@ void Renderer::OnCreate(const std::string AppName, uint32_t width,
   m_pResourceUploadHeap = new ResourceUploadHeap(m_Context, m_pBufferPool);
   m_pResourceUploadHeap->OnCreate();
 
-  // loading textures
-  m_textures.resize(1);
-  m_textures[0] =
-      new VulkanTexture(m_Context, m_pBufferPool, m_pResourceUploadHeap);
+  // cooked geometry is decoded on the gpu, or on the cpu if the decoder
+  // fails its self test
+  m_pDecompressor =
+      new GpuDecompressor(m_Context, m_pBufferPool, m_pResourceUploadHeap);
+  m_pDecompressor->OnCreate();
+
+  // setup command buffers
+  vk::Device device = m_Context->getDevice();
+  m_pCommandBuffers = new VkCommandBuffers(
+      device, m_Context->getGraphicsQueue(),
+      m_Context->getQueueFamilyIndices().graphicsFamilyIndex.value());
+  m_pCommandBuffers->OnCreate(1);
+
+  // shipped builds replace the loose asset directories with packs
+  bool scenesPacked =
+      AssetPack::mount(AssetPack::packPathFor(SCENES_PATH), SCENES_PATH);
+  bool texturesPacked =
+      AssetPack::mount(AssetPack::packPathFor(TEXTURES_PATH), TEXTURES_PATH);
+
+  // loading textures, only the mip tail is resident until the feedback pass
+  // asks for more
+  bool textureFeedback = m_Context->isFragmentStoresAndAtomicsSupported();
+  if (!textureFeedback) {
+    std::cerr << "Warning: no fragmentStoresAndAtomics, texture streaming "
+                 "runs without feedback"
+              << std::endl;
+  }
+  m_pTextureStreamer = new TextureStreamer(m_Context, m_pBufferPool,
+                                           m_pResourceUploadHeap);
+  m_pTextureStreamer->OnCreate(m_swapchain.getImageCount(),
+                               256ull * 1024 * 1024, textureFeedback);
+  // the scene's own images are registered by the SceneLoader; the pipeline
+  // has a single texture binding, which samples this one
   std::string texturePath{TEXTURES_PATH};
   texturePath += "texture.jpg";
-  m_textures[0]->OnCreate(texturePath);
+  m_sceneTexture = m_pTextureStreamer->registerTexture(texturePath);
 
   // create swapchain renderpass
   assert(m_pSwapchainRenderPass == nullptr);
@@ -55,7 +89,6 @@ void Renderer::OnCreate(const std::string AppName, uint32_t width,
   m_pSwapchainRenderPass->OnCreate();
 
   // create swapchain framebuffers
-  vk::Device device = m_Context->getDevice();
   m_pFramebuffers =
       new VkSwapchainFramebuffers(device, &m_swapchain, m_pSwapchainRenderPass);
   m_pFramebuffers->OnCreate();
@@ -68,11 +101,14 @@ void Renderer::OnCreate(const std::string AppName, uint32_t width,
   // setup swapchain resource binding
   // create descriptor pool
   vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
-  std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+  std::array<vk::DescriptorPoolSize, 3> poolSizes = {
       vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer,
                              m_swapchain.getImageCount()),
 
       vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler,
+                             m_swapchain.getImageCount()),
+
+      vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer,
                              m_swapchain.getImageCount())};
 
   descriptorPoolCreateInfo.setPoolSizeCount(
@@ -90,6 +126,10 @@ void Renderer::OnCreate(const std::string AppName, uint32_t width,
   layoutBindings[1] = vk::DescriptorSetLayoutBinding{
       1, vk::DescriptorType::eCombinedImageSampler, 1,
       vk::ShaderStageFlagBits::eFragment};
+  // texture streaming feedback, written by the fragment shader
+  layoutBindings[2] = vk::DescriptorSetLayoutBinding{
+      2, vk::DescriptorType::eStorageBuffer, 1,
+      vk::ShaderStageFlagBits::eFragment};
 
   vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo(
       vk::DescriptorSetLayoutCreateFlags(),         // Flags
@@ -130,10 +170,15 @@ void Renderer::OnCreate(const std::string AppName, uint32_t width,
 
     vk::DescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    imageInfo.imageView = m_textures[0]->getImageView();
-    imageInfo.sampler = m_textures[0]->getSampler();
+    imageInfo.imageView = m_pTextureStreamer->getImageView(m_sceneTexture);
+    imageInfo.sampler = m_pTextureStreamer->getSampler(m_sceneTexture);
 
-    std::array<vk::WriteDescriptorSet, 2> descriptorWrites{};
+    vk::DescriptorBufferInfo feedbackInfo{};
+    feedbackInfo.buffer = m_pTextureStreamer->getFeedbackBuffer(i).buffer;
+    feedbackInfo.offset = 0;
+    feedbackInfo.range = m_pTextureStreamer->getFeedbackBufferSize();
+
+    std::array<vk::WriteDescriptorSet, 3> descriptorWrites{};
     descriptorWrites[0].dstSet = m_swapchainResourceBinding.m_descriptorSets[i];
     descriptorWrites[0].dstBinding = 0;
     descriptorWrites[0].dstArrayElement = 0;
@@ -151,19 +196,43 @@ void Renderer::OnCreate(const std::string AppName, uint32_t width,
     descriptorWrites[1].descriptorCount = 1;
     descriptorWrites[1].pImageInfo = &imageInfo;
 
+    descriptorWrites[2].dstSet = m_swapchainResourceBinding.m_descriptorSets[i];
+    descriptorWrites[2].dstBinding = 2;
+    descriptorWrites[2].dstArrayElement = 0;
+    descriptorWrites[2].descriptorType = vk::DescriptorType::eStorageBuffer;
+    descriptorWrites[2].descriptorCount = 1;
+    descriptorWrites[2].pBufferInfo = &feedbackInfo;
+
     device.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()),
                                 descriptorWrites.data(), 0, nullptr);
   }
 
-  // setup pipelinelayout of swapchain
+  // per scene transforms and the dequantization of their meshes, see
+  // glTFModel::getTransformBuffer and getQuantizationBuffer
+  std::array<vk::DescriptorSetLayoutBinding, 2> instanceBindings{
+      vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eVertex},
+      vk::DescriptorSetLayoutBinding{1, vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eVertex}};
+  m_instanceSetLayout = device.createDescriptorSetLayout(
+      vk::DescriptorSetLayoutCreateInfo{{}, instanceBindings});
+
+  // setup pipelinelayout of swapchain; texture feedback for the fragment
+  // stage
+  std::array<vk::PushConstantRange, 1> pushConstantRanges{
+      vk::PushConstantRange{vk::ShaderStageFlagBits::eFragment, 0,
+                            sizeof(TextureFeedbackPushConstants)}};
+  // the per image set layouts are all alike, the first stands for them
+  std::array<vk::DescriptorSetLayout, 2> pipelineSetLayouts{
+      m_swapchainResourceBinding.m_descriptorSetLayouts[0],
+      m_instanceSetLayout};
   vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{
       {}, // flags
-      static_cast<uint32_t>(m_swapchainResourceBinding.m_descriptorSetLayouts
-                                .size()), // setlayoutCount
-      m_swapchainResourceBinding.m_descriptorSetLayouts.data(), // pSetLayouts
-      0U,      // push constant range count
-      nullptr, // pPushConstantRanges
-      nullptr  // pNext
+      static_cast<uint32_t>(pipelineSetLayouts.size()), // setlayoutCount
+      pipelineSetLayouts.data(), // pSetLayouts
+      static_cast<uint32_t>(pushConstantRanges.size()), // push constant range count
+      pushConstantRanges.data(), // pPushConstantRanges
+      nullptr                      // pNext
   };
 
   m_swapchainResourceBinding.m_pipelineLayout =
@@ -172,15 +241,27 @@ void Renderer::OnCreate(const std::string AppName, uint32_t width,
   // setup graphics pipeline
   m_swapchainPipeline = new VkSwapchainGraphicsPipeline(
       device, m_swapchainResourceBinding.m_pipelineLayout,
-      m_pSwapchainRenderPass->getRenderPass(), &m_swapchain);
+      m_pSwapchainRenderPass->getRenderPass(), &m_swapchain,
+      m_Context->isFragmentStoresAndAtomicsSupported());
 
   m_swapchainPipeline->OnCreate();
 
-  // setup command buffers
-  m_pCommandBuffers = new VkCommandBuffers(
-      device, m_Context->getGraphicsQueue(),
-      m_Context->getQueueFamilyIndices().graphicsFamilyIndex.value());
-  m_pCommandBuffers->OnCreate(1);
+  // resident scenes are culled and drawn from the gpu
+  m_pGpuScene = new GpuScene(m_Context, m_pBufferPool);
+  m_pGpuScene->OnCreate();
+
+  // meshlets are culled in task shaders where the device has mesh shaders,
+  // in a compute pass otherwise
+  m_pMeshletCuller = new MeshletCuller(m_Context, m_pBufferPool);
+  m_pMeshletCuller->OnCreate(
+      m_swapchainResourceBinding.m_descriptorSetLayouts[0], pushConstantRanges,
+      m_pSwapchainRenderPass->getRenderPass());
+
+  // distant static groups of scenes baked with impostors draw as one quad
+  m_pImpostorRenderer = new ImpostorRenderer(m_Context, m_pBufferPool);
+  m_pImpostorRenderer->OnCreate(
+      m_swapchainResourceBinding.m_descriptorSetLayouts[0],
+      m_pSwapchainRenderPass->getRenderPass());
 
   //setup camera
   m_cameras.push_back(
@@ -190,24 +271,101 @@ void Renderer::OnCreate(const std::string AppName, uint32_t width,
   m_cameras[0].setPerspectiveParameters(45.0f, 0.1f, 10.0f, (float)m_swapchain.getExtent().width /
                                   (float)m_swapchain.getExtent().height);
 
-  //glTF model
-  glTFModel model{};
+  //glTF model, loads in the background so the first frame is not held up
+  m_pSceneLoader = new SceneLoader(
+      m_pBufferPool, m_pResourceUploadHeap, m_pDecompressor, m_pTextureStreamer,
+      m_Context->getQueueFamilyIndices().graphicsFamilyIndex.value());
+  m_pSceneLoader->OnCreate(16ull * 1024 * 1024, &m_deletionQueue);
   std::string ScenePath {SCENES_PATH};
   ScenePath += "Box/Box.gltf";
-  model.loadModel(ScenePath.c_str());
-  model.AllocateBuffersAndUpload(m_pBufferPool, m_pResourceUploadHeap, m_Context->getQueueFamilyIndices().graphicsFamilyIndex.value());
-
-  m_models.push_back(model);
+  m_scene = m_pSceneLoader->loadAsync(ScenePath);
 
   //setup UI
   m_ui = new UI();
   m_ui->OnCreate(m_Context,  m_pWindow, m_pSwapchainRenderPass->getRenderPass(), m_pCommandBuffers);
+  m_ui->setSceneLoader(m_pSceneLoader);
+
+  //watch the asset directories for edits, packed ones are read only
+  m_assetWatcher.OnCreate();
+  if (!scenesPacked) {
+    m_assetWatcher.watchDirectory(SCENES_PATH);
+  }
+  if (!texturesPacked) {
+    m_assetWatcher.watchDirectory(TEXTURES_PATH);
+  }
+  m_assetWatcher.watchDirectory(SHADERS_PATH);
 
   //start time counting
   m_timer.start();
 }
 
-void Renderer::OnUpdate() {}
+void Renderer::OnUpdate() {
+  // the previous frame has finished, so uploads and releases are safe here
+  m_deletionQueue.OnUpdate();
+  for (const auto &path : m_assetWatcher.poll()) {
+    reloadAsset(path);
+  }
+  m_pSceneLoader->OnUpdate();
+}
+
+void Renderer::reloadAsset(const std::string &path) {
+  std::string extension = std::filesystem::path(path).extension().string();
+  // written by the scene cooker itself
+  if (extension == ".cooked" || extension == ".tmp") {
+    return;
+  }
+  if (extension == ".spv") {
+    reloadShader(std::filesystem::path(path).stem().string());
+    return;
+  }
+  if (m_pTextureStreamer->reloadTexture(path)) {
+    return;
+  }
+  m_pSceneLoader->reloadChanged(path);
+}
+
+void Renderer::reloadShader(const std::string &name) {
+  bool reloaded = true;
+  if (name.starts_with("swapchain_")) {
+    reloadPipeline();
+    // the mesh shader pipeline shades with the scene's fragment shader
+    if (name == "swapchain_frag" && m_pMeshletCuller->isUsingMeshShaders()) {
+      reloaded = m_pMeshletCuller->reloadShaders(m_deletionQueue);
+    }
+  } else if (name == "scene_cull") {
+    reloaded = m_pGpuScene->reloadShaders(m_deletionQueue);
+  } else if (name.starts_with("meshlet_")) {
+    reloaded = m_pMeshletCuller->reloadShaders(m_deletionQueue);
+  } else if (name.starts_with("impostor_")) {
+    reloaded = m_pImpostorRenderer->reloadShaders(m_deletionQueue);
+  } else if (name == "decompress") {
+    reloaded = m_pDecompressor->reloadShaders();
+  }
+  if (!reloaded) {
+    std::cerr << "Warning: shader reload failed: " << name << std::endl;
+  }
+}
+
+void Renderer::reloadPipeline() {
+  // build the new pipeline first, a broken shader keeps the old one running
+  auto *pipeline = new VkSwapchainGraphicsPipeline(
+      m_Context->getDevice(), m_swapchainResourceBinding.m_pipelineLayout,
+      m_pSwapchainRenderPass->getRenderPass(), &m_swapchain,
+      m_Context->isFragmentStoresAndAtomicsSupported());
+  try {
+    pipeline->OnCreate();
+  } catch (const std::exception &e) {
+    std::cerr << "Warning: shader reload failed: " << e.what() << std::endl;
+    delete pipeline;
+    return;
+  }
+  VkSwapchainGraphicsPipeline *oldPipeline = m_swapchainPipeline;
+  m_swapchainPipeline = pipeline;
+  m_deletionQueue.push([oldPipeline] {
+    oldPipeline->OnDestroy();
+    delete oldPipeline;
+  });
+}
 
 void Renderer::OnDraw() {
   auto frameStartTime = m_timer.getCurrentTime();
@@ -235,8 +393,8 @@ void Renderer::OnDraw() {
   // update uniform buffers
   UniformBufferObject obj{};
 
-  //m_models[0].rotate(m_deltaTime * 20, glm::vec3(0.0f, 0.0f, 1.0f));
-  obj.model = m_models[0].getModelMatrix();
+  glTFModel *model = m_pSceneLoader->getModel(m_scene);
+  obj.model = model ? model->getModelMatrix() : glm::mat4(1.0f);
   obj.view = m_cameras[0].getViewMatrix();
   m_cameras[0].setPerspectiveParameters(45.0f, 0.1f, 10.0f, (float)m_swapchain.getExtent().width /
                                   (float)m_swapchain.getExtent().height);
@@ -264,9 +422,56 @@ void Renderer::OnDraw() {
     vk::CommandBufferBeginInfo beginInfo({}, nullptr);
     commandBuffer.begin(beginInfo);
 
+    // stream in the mips the frame that last used this slot asked for; the
+    // uploads are recorded ahead of the render pass, and the previous
+    // submission has been waited on, so descriptors can be rewritten
+    m_pTextureStreamer->OnUpdate(imageIndex, commandBuffer);
+    if (!m_pTextureStreamer->getChangedTextures().empty()) {
+      vk::DescriptorImageInfo imageInfo{};
+      imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+      imageInfo.imageView = m_pTextureStreamer->getImageView(m_sceneTexture);
+      imageInfo.sampler = m_pTextureStreamer->getSampler(m_sceneTexture);
+      for (auto &descriptorSet : m_swapchainResourceBinding.m_descriptorSets) {
+        vk::WriteDescriptorSet descriptorWrite{};
+        descriptorWrite.dstSet = descriptorSet;
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.descriptorType =
+            vk::DescriptorType::eCombinedImageSampler;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+        device.updateDescriptorSets(descriptorWrite, nullptr);
+      }
+    }
+
+    // culling runs ahead of the render pass; scenes still uploading get no
+    // ticket and draw from the cpu
+    vk::Extent2D extent = m_swapchain.getExtent();
+    std::vector<int> sceneTickets(m_pSceneLoader->getSceneCount(), -1);
+    std::vector<int> meshletTickets(m_pSceneLoader->getSceneCount(), -1);
+    m_pGpuScene->beginFrame();
+    m_pMeshletCuller->beginFrame();
+    m_pImpostorRenderer->beginFrame();
+    glm::vec3 cameraPosition = glm::inverse(obj.view)[3];
+    for (uint32_t i = 0; i < m_pSceneLoader->getSceneCount(); ++i) {
+      if (glTFModel *scene = m_pSceneLoader->getModel(i)) {
+        // impostors hide the transforms they stand in for, before any cull
+        if (m_pImpostorRenderer->isEnabled()) {
+          scene->selectImpostors(obj.view * obj.model, obj.proj,
+                                 static_cast<float>(extent.height));
+        }
+        // the clustered primitives go to the meshlet path whenever it
+        // takes the scene, the rest to the gpu or the cpu driven draw
+        meshletTickets[i] = m_pMeshletCuller->cull(
+            commandBuffer, *scene, obj.model, obj.proj * obj.view,
+            cameraPosition);
+        sceneTickets[i] = m_pGpuScene->cull(
+            commandBuffer, *scene, meshletTickets[i] >= 0, obj.model,
+            obj.view, obj.proj, static_cast<float>(extent.height));
+      }
+    }
+
     // begin render pass
     vk::RenderPass renderPass = m_pSwapchainRenderPass->getRenderPass();
-    vk::Extent2D extent = m_swapchain.getExtent();
 
     vk::ClearValue clearValue;
     clearValue.color = {0.0f, 0.0f, 0.0f, 0.0f};
@@ -290,11 +495,76 @@ void Renderer::OnDraw() {
     commandBuffer.setScissor(0, 1, &scissor);
     vk::DescriptorSet descriptorSets[] = { m_swapchainResourceBinding.m_descriptorSets[imageIndex] };
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_swapchainResourceBinding.m_pipelineLayout, 0, descriptorSets, nullptr);
-
-
-    for(auto &model : m_models) {
-        model.draw(commandBuffer);
+    TextureFeedbackPushConstants feedbackConstants =
+        m_pTextureStreamer->getPushConstants(m_sceneTexture);
+    commandBuffer.pushConstants(m_swapchainResourceBinding.m_pipelineLayout,
+                                vk::ShaderStageFlagBits::eFragment, 0,
+                                sizeof(feedbackConstants), &feedbackConstants);
+
+
+    // scenes still uploading draw whatever is resident so far, each
+    // primitive at the LOD its projected error allows; resident scenes pick
+    // their LODs on the gpu. The cpu drawn scenes are timed for the debug
+    // window.
+    bool multiDraw =
+        m_Context->isMultiDrawIndirectSupported() && m_ui->isMultiDrawEnabled();
+    uint32_t drawCalls = 0;
+    auto recordStart = std::chrono::high_resolution_clock::now();
+    std::vector<vk::DescriptorSet> instanceSets =
+        acquireInstanceSets(m_pSceneLoader->getSceneCount());
+    for (uint32_t i = 0; i < m_pSceneLoader->getSceneCount(); ++i) {
+      if (glTFModel *scene = m_pSceneLoader->getModel(i)) {
+        if (scene->getTransformCount() == 0) {
+          continue;
+        }
+        vk::DescriptorBufferInfo transformInfo{
+            scene->getTransformBuffer().buffer, 0, VK_WHOLE_SIZE};
+        vk::DescriptorBufferInfo quantizationInfo{
+            scene->getQuantizationBuffer().buffer, 0, VK_WHOLE_SIZE};
+        std::array<vk::WriteDescriptorSet, 2> instanceWrites{
+            vk::WriteDescriptorSet{instanceSets[i], 0, 0,
+                                   vk::DescriptorType::eStorageBuffer, nullptr,
+                                   transformInfo},
+            vk::WriteDescriptorSet{instanceSets[i], 1, 0,
+                                   vk::DescriptorType::eStorageBuffer, nullptr,
+                                   quantizationInfo}};
+        m_Context->getDevice().updateDescriptorSets(instanceWrites, nullptr);
+        commandBuffer.bindDescriptorSets(
+            vk::PipelineBindPoint::eGraphics,
+            m_swapchainResourceBinding.m_pipelineLayout, 1, instanceSets[i],
+            nullptr);
+        bool clustered = meshletTickets[i] >= 0;
+        if (sceneTickets[i] >= 0) {
+          m_pGpuScene->draw(commandBuffer, *scene, sceneTickets[i]);
+        } else {
+          scene->selectLods(obj.view * obj.model, obj.proj,
+                            static_cast<float>(extent.height));
+          scene->draw(commandBuffer, clustered, multiDraw);
+          drawCalls += scene->getDrawCallCount();
+        }
+        if (!clustered) {
+          continue;
+        }
+        // meshlets are built from the full mesh, so the clustered
+        // primitives draw at full detail and LOD selection only applies to
+        // the rest
+        m_pMeshletCuller->draw(commandBuffer, *scene, meshletTickets[i]);
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+      }
     }
+    // impostors last, they bring their own pipeline
+    glm::vec3 sceneCamera =
+        glm::vec3(glm::inverse(obj.model) * glm::vec4(cameraPosition, 1.0f));
+    for (uint32_t i = 0; i < m_pSceneLoader->getSceneCount(); ++i) {
+      if (glTFModel *scene = m_pSceneLoader->getModel(i)) {
+        drawCalls += m_pImpostorRenderer->draw(
+            commandBuffer, *scene, descriptorSets[0],
+            obj.proj * obj.view * obj.model, sceneCamera);
+      }
+    }
+    std::chrono::duration<float, std::milli> recordTime =
+        std::chrono::high_resolution_clock::now() - recordStart;
+    m_ui->setDrawStats(drawCalls, recordTime.count());
 
     m_ui->OnDraw(commandBuffer);
     commandBuffer.endRenderPass();
@@ -362,6 +632,30 @@ void Renderer::OnResize() {
   m_pFramebuffers->OnCreate();
 }
 
+std::vector<vk::DescriptorSet> Renderer::acquireInstanceSets(uint32_t count) {
+  vk::Device device = m_Context->getDevice();
+  if (count > m_instanceSetCapacity) {
+    if (m_instanceDescriptorPool) {
+      device.destroyDescriptorPool(m_instanceDescriptorPool);
+    }
+    m_instanceSetCapacity = std::max(count, m_instanceSetCapacity * 2);
+    // transforms and quantizations
+    vk::DescriptorPoolSize poolSize{vk::DescriptorType::eStorageBuffer,
+                                    m_instanceSetCapacity * 2};
+    m_instanceDescriptorPool = device.createDescriptorPool(
+        vk::DescriptorPoolCreateInfo{{}, m_instanceSetCapacity, poolSize});
+  } else if (m_instanceDescriptorPool) {
+    // the frame that used them has been waited on
+    device.resetDescriptorPool(m_instanceDescriptorPool);
+  }
+  if (count == 0) {
+    return {};
+  }
+  std::vector<vk::DescriptorSetLayout> layouts(count, m_instanceSetLayout);
+  return device.allocateDescriptorSets(
+      vk::DescriptorSetAllocateInfo{m_instanceDescriptorPool, layouts});
+}
+
 void Renderer::OnDestroy() {
   // get device handle
   vk::Device device = m_Context->getDevice();
@@ -371,14 +665,19 @@ void Renderer::OnDestroy() {
   m_ui = nullptr;
 
 
+  m_assetWatcher.OnDestroy();
+
   // destroy models
-  for (auto &model : m_models) {
-    model.destroy();
-  }
+  m_pSceneLoader->OnDestroy();
+  delete m_pSceneLoader;
+  m_pSceneLoader = nullptr;
 
-  for (auto &texture : m_textures) {
-    texture->OnDestroy();
-  }
+  // everything retired by hot reload, including old pipelines
+  m_deletionQueue.flush();
+
+  m_pTextureStreamer->OnDestroy();
+  delete m_pTextureStreamer;
+  m_pTextureStreamer = nullptr;
 
   // destroy command buffer
   m_pCommandBuffers->OnDestroy();
@@ -398,12 +697,32 @@ void Renderer::OnDestroy() {
         m_swapchainResourceBinding.m_descriptorSetLayouts[i]);
   }
   device.destroyDescriptorPool(m_swapchainResourceBinding.m_descriptorPool);
+  if (m_instanceDescriptorPool) {
+    device.destroyDescriptorPool(m_instanceDescriptorPool);
+  }
+  device.destroyDescriptorSetLayout(m_instanceSetLayout);
 
   // destroy uniform buffers
   m_pUniformBuffers->OnDestroy();
   delete m_pUniformBuffers;
   m_pUniformBuffers = nullptr;
 
+  m_pImpostorRenderer->OnDestroy();
+  delete m_pImpostorRenderer;
+  m_pImpostorRenderer = nullptr;
+
+  m_pMeshletCuller->OnDestroy();
+  delete m_pMeshletCuller;
+  m_pMeshletCuller = nullptr;
+
+  m_pGpuScene->OnDestroy();
+  delete m_pGpuScene;
+  m_pGpuScene = nullptr;
+
+  m_pDecompressor->OnDestroy();
+  delete m_pDecompressor;
+  m_pDecompressor = nullptr;
+
   // destroy upload heaps
   m_pResourceUploadHeap->OnDestroy();
   delete m_pResourceUploadHeap;
@@ -425,6 +744,8 @@ void Renderer::OnDestroy() {
 
   m_swapchain.OnDestroy();
 
+  AssetPack::unmountAll();
+
   if (m_Context != nullptr) {
     m_Context->OnDestroy();
     delete m_Context;
@@ -0,0 +1,231 @@
+#include "SceneLoader.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace hiddenpiggy {
+
+void SceneLoader::OnCreate(vk::DeviceSize uploadBudgetPerFrame,
+                           DeletionQueue *pDeletionQueue) {
+  m_uploadBudget = uploadBudgetPerFrame;
+  m_pDeletionQueue = pDeletionQueue;
+  m_pWorker = std::make_unique<ThreadPool>(1);
+}
+
+uint32_t SceneLoader::loadAsync(const std::string &path) {
+  auto scene = std::make_unique<Scene>();
+  scene->path = path;
+  scene->cancelled = std::make_shared<std::atomic<bool>>(false);
+  scene->pending = parseAsync(path, scene->cancelled);
+  m_scenes.push_back(std::move(scene));
+  return static_cast<uint32_t>(m_scenes.size() - 1);
+}
+
+// the job only touches its own model and the flag, never the scene record
+std::future<std::unique_ptr<glTFModel>>
+SceneLoader::parseAsync(const std::string &path,
+                        std::shared_ptr<std::atomic<bool>> cancelled) {
+  return m_pWorker->submit(
+      [path, cancelled, optimizeMeshes = m_optimizeMeshes,
+       staticBatching = m_staticBatching,
+       impostors = m_impostors]() -> std::unique_ptr<glTFModel> {
+        if (cancelled->load()) {
+          return nullptr;
+        }
+        auto model = std::make_unique<glTFModel>();
+        model->loadModel(path.c_str(), optimizeMeshes, staticBatching,
+                         impostors);
+        return model;
+      });
+}
+
+bool SceneLoader::reloadChanged(const std::string &changedPath) {
+  std::filesystem::path changed(changedPath);
+  bool affected = false;
+  for (auto &pScene : m_scenes) {
+    Scene &scene = *pScene;
+    std::filesystem::path source(scene.path);
+    std::error_code ec;
+    // the gltf itself or anything next to it (buffers, images)
+    bool dependsOn = std::filesystem::equivalent(source, changed, ec) ||
+                     source.parent_path() == changed.parent_path();
+    if (!dependsOn || scene.state != State::Ready) {
+      continue;
+    }
+    affected = true;
+    // a reload that is already running reads the file again anyway
+    if (!scene.pendingReload.valid() && !scene.replacement) {
+      scene.pendingReload = parseAsync(scene.path, scene.cancelled);
+    }
+  }
+  return affected;
+}
+
+void SceneLoader::updateReload(Scene &scene, vk::DeviceSize &budget) {
+  if (scene.pendingReload.valid() &&
+      scene.pendingReload.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    std::unique_ptr<glTFModel> model;
+    try {
+      model = scene.pendingReload.get();
+    } catch (const std::exception &e) {
+      // keep showing the last good version
+      scene.error = e.what();
+      return;
+    }
+    if (!model) {
+      return;
+    }
+    scene.error.clear();
+    registerTextures(*model);
+    if (model->adoptBuffers(*scene.model, m_pResourceUploadHeap,
+                            m_pDecompressor)) {
+      // the old model no longer owns any gpu memory
+      retireModel(std::move(scene.model));
+      scene.model = std::move(model);
+      return;
+    }
+    model->beginUpload(m_pBufferPool, m_pDecompressor, m_queueFamilyIndex);
+    scene.replacement = std::move(model);
+  }
+
+  if (scene.replacement && budget > 0) {
+    budget -= std::min(budget, scene.replacement->uploadSome(
+                                   m_pResourceUploadHeap, budget));
+    if (scene.replacement->isUploaded()) {
+      retireModel(std::move(scene.model));
+      scene.model = std::move(scene.replacement);
+    }
+  }
+}
+
+// already registered images keep their ids, so a reload only adds new ones
+void SceneLoader::registerTextures(glTFModel &model) {
+  std::vector<uint32_t> textureIds;
+  for (const auto &path : model.getTexturePaths()) {
+    uint32_t textureId = glTFModel::kNoTexture;
+    if (!path.empty()) {
+      try {
+        textureId = m_pTextureStreamer->registerTexture(path);
+      } catch (const std::exception &e) {
+        std::cerr << "Warning: " << e.what() << std::endl;
+      }
+    }
+    textureIds.push_back(textureId);
+  }
+  model.setTextureIds(std::move(textureIds));
+}
+
+void SceneLoader::retireModel(std::unique_ptr<glTFModel> model) {
+  if (!model) {
+    return;
+  }
+  // the last recorded frames may still read its buffers
+  std::shared_ptr<glTFModel> retired(std::move(model));
+  m_pDeletionQueue->push([retired] { retired->destroy(); });
+}
+
+void SceneLoader::cancel(uint32_t handle) {
+  Scene &scene = *m_scenes[handle];
+  if (scene.state == State::Loading || scene.state == State::Uploading) {
+    scene.cancelled->store(true);
+  }
+}
+
+void SceneLoader::OnUpdate() {
+  vk::DeviceSize budget = m_uploadBudget;
+  for (auto &pScene : m_scenes) {
+    Scene &scene = *pScene;
+
+    if (scene.state == State::Loading &&
+        scene.pending.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::ready) {
+      try {
+        scene.model = scene.pending.get();
+      } catch (const std::exception &e) {
+        scene.error = e.what();
+        scene.state = State::Failed;
+        continue;
+      }
+      if (scene.model && !scene.cancelled->load()) {
+        registerTextures(*scene.model);
+        scene.model->beginUpload(m_pBufferPool, m_pDecompressor,
+                                 m_queueFamilyIndex);
+        scene.state = State::Uploading;
+      }
+    }
+
+    if (scene.cancelled->load() && scene.state != State::Cancelled &&
+        (scene.state != State::Loading || !scene.pending.valid())) {
+      releaseScene(scene);
+      scene.state = State::Cancelled;
+      continue;
+    }
+
+    if (scene.state == State::Ready) {
+      updateReload(scene, budget);
+    }
+
+    if (scene.state == State::Uploading && budget > 0) {
+      budget -= std::min(budget, scene.model->uploadSome(
+                                     m_pResourceUploadHeap, budget));
+      if (scene.model->isUploaded()) {
+        scene.state = State::Ready;
+      }
+    }
+  }
+}
+
+float SceneLoader::getProgress(uint32_t handle) const {
+  const Scene &scene = *m_scenes[handle];
+  if (scene.state == State::Ready) {
+    return 1.0f;
+  }
+  if (scene.state != State::Uploading || scene.model->getUploadSize() == 0) {
+    return 0.0f;
+  }
+  return static_cast<float>(scene.model->getUploadedSize()) /
+         static_cast<float>(scene.model->getUploadSize());
+}
+
+bool SceneLoader::isBusy() const {
+  for (const auto &scene : m_scenes) {
+    if (scene->state == State::Loading || scene->state == State::Uploading) {
+      return true;
+    }
+  }
+  return false;
+}
+
+glTFModel *SceneLoader::getModel(uint32_t handle) {
+  Scene &scene = *m_scenes[handle];
+  if (scene.state != State::Uploading && scene.state != State::Ready) {
+    return nullptr;
+  }
+  return scene.model.get();
+}
+
+void SceneLoader::releaseScene(Scene &scene) {
+  // the frame that drew it has been waited on before OnUpdate runs
+  if (scene.model) {
+    scene.model->destroy();
+    scene.model.reset();
+  }
+  if (scene.replacement) {
+    scene.replacement->destroy();
+    scene.replacement.reset();
+  }
+}
+
+void SceneLoader::OnDestroy() {
+  for (auto &scene : m_scenes) {
+    scene->cancelled->store(true);
+  }
+  // joins the worker after it finishes the parse it is on
+  m_pWorker.reset();
+  for (auto &scene : m_scenes) {
+    releaseScene(*scene);
+  }
+  m_scenes.clear();
+}
+} // namespace hiddenpiggy
@@ -0,0 +1,533 @@
+#include "SimdMath.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define SIMD_MATH_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_MATH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace hiddenpiggy {
+namespace SimdMath {
+
+namespace {
+// The lane types the composition, culling and decoding kernels are written
+// against: loads and stores of kWidth consecutive floats, loads of 16-bit
+// words, arithmetic, and a bit mask of the lanes where a >= b.
+struct ScalarLanes {
+  static constexpr size_t kWidth = 1;
+  float v;
+  static ScalarLanes load(const float *p) { return {*p}; }
+  static ScalarLanes splat(float f) { return {f}; }
+  // kWidth 16-bit words shifted right by Shift, as floats
+  template <int Shift> static ScalarLanes loadWords(const uint16_t *p) {
+    return {float(*p >> Shift)};
+  }
+  void store(float *p) const { *p = v; }
+};
+inline ScalarLanes operator+(ScalarLanes a, ScalarLanes b) {
+  return {a.v + b.v};
+}
+inline ScalarLanes operator-(ScalarLanes a, ScalarLanes b) {
+  return {a.v - b.v};
+}
+inline ScalarLanes operator*(ScalarLanes a, ScalarLanes b) {
+  return {a.v * b.v};
+}
+inline ScalarLanes multiplyAdd(ScalarLanes a, ScalarLanes b, ScalarLanes c) {
+  return {a.v * b.v + c.v};
+}
+inline uint32_t greaterEqual(ScalarLanes a, ScalarLanes b) {
+  return a.v >= b.v ? 1u : 0u;
+}
+inline ScalarLanes maximum(ScalarLanes a, ScalarLanes b) {
+  return {a.v > b.v ? a.v : b.v};
+}
+inline ScalarLanes squareRoot(ScalarLanes a) { return {std::sqrt(a.v)}; }
+
+#if defined(SIMD_MATH_AVX2)
+struct WideLanes {
+  static constexpr size_t kWidth = 8;
+  __m256 v;
+  static WideLanes load(const float *p) { return {_mm256_loadu_ps(p)}; }
+  static WideLanes splat(float f) { return {_mm256_set1_ps(f)}; }
+  template <int Shift> static WideLanes loadWords(const uint16_t *p) {
+    __m256i words = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+    return {_mm256_cvtepi32_ps(_mm256_srli_epi32(words, Shift))};
+  }
+  void store(float *p) const { _mm256_storeu_ps(p, v); }
+};
+inline WideLanes operator+(WideLanes a, WideLanes b) {
+  return {_mm256_add_ps(a.v, b.v)};
+}
+inline WideLanes operator-(WideLanes a, WideLanes b) {
+  return {_mm256_sub_ps(a.v, b.v)};
+}
+inline WideLanes operator*(WideLanes a, WideLanes b) {
+  return {_mm256_mul_ps(a.v, b.v)};
+}
+inline WideLanes multiplyAdd(WideLanes a, WideLanes b, WideLanes c) {
+  return {_mm256_fmadd_ps(a.v, b.v, c.v)};
+}
+inline uint32_t greaterEqual(WideLanes a, WideLanes b) {
+  return static_cast<uint32_t>(
+      _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)));
+}
+inline WideLanes maximum(WideLanes a, WideLanes b) {
+  return {_mm256_max_ps(a.v, b.v)};
+}
+inline WideLanes squareRoot(WideLanes a) { return {_mm256_sqrt_ps(a.v)}; }
+#elif defined(SIMD_MATH_SSE2)
+struct WideLanes {
+  static constexpr size_t kWidth = 4;
+  __m128 v;
+  static WideLanes load(const float *p) { return {_mm_loadu_ps(p)}; }
+  static WideLanes splat(float f) { return {_mm_set1_ps(f)}; }
+  template <int Shift> static WideLanes loadWords(const uint16_t *p) {
+    __m128i words = _mm_unpacklo_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)),
+        _mm_setzero_si128());
+    return {_mm_cvtepi32_ps(_mm_srli_epi32(words, Shift))};
+  }
+  void store(float *p) const { _mm_storeu_ps(p, v); }
+};
+inline WideLanes operator+(WideLanes a, WideLanes b) {
+  return {_mm_add_ps(a.v, b.v)};
+}
+inline WideLanes operator-(WideLanes a, WideLanes b) {
+  return {_mm_sub_ps(a.v, b.v)};
+}
+inline WideLanes operator*(WideLanes a, WideLanes b) {
+  return {_mm_mul_ps(a.v, b.v)};
+}
+inline WideLanes multiplyAdd(WideLanes a, WideLanes b, WideLanes c) {
+  return {_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)};
+}
+inline uint32_t greaterEqual(WideLanes a, WideLanes b) {
+  return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(a.v, b.v)));
+}
+inline WideLanes maximum(WideLanes a, WideLanes b) {
+  return {_mm_max_ps(a.v, b.v)};
+}
+inline WideLanes squareRoot(WideLanes a) { return {_mm_sqrt_ps(a.v)}; }
+#else
+using WideLanes = ScalarLanes;
+#endif
+
+// composes count - count % kWidth matrices, returns how many
+template <typename L>
+size_t composeTrsLanes(const glm::vec3 *translations,
+                       const glm::quat *rotations, const glm::vec3 *scales,
+                       glm::mat4 *out, size_t count) {
+  constexpr size_t W = L::kWidth;
+  alignas(32) float in[7][W];
+  alignas(32) float columns[9][W];
+  size_t i = 0;
+  for (; i + W <= count; i += W) {
+    // the inputs are arrays of glm structs, gathered lane by lane
+    for (size_t k = 0; k < W; ++k) {
+      const glm::quat &q = rotations[i + k];
+      in[0][k] = q.x;
+      in[1][k] = q.y;
+      in[2][k] = q.z;
+      in[3][k] = q.w;
+      in[4][k] = scales[i + k].x;
+      in[5][k] = scales[i + k].y;
+      in[6][k] = scales[i + k].z;
+    }
+    L x = L::load(in[0]), y = L::load(in[1]), z = L::load(in[2]),
+      w = L::load(in[3]);
+    L sx = L::load(in[4]), sy = L::load(in[5]), sz = L::load(in[6]);
+    L two = L::splat(2.0f), one = L::splat(1.0f);
+    L xx = x * x, yy = y * y, zz = z * z;
+    L xy = x * y, xz = x * z, yz = y * z;
+    L wx = w * x, wy = w * y, wz = w * z;
+    // glm::mat3_cast, each column scaled by its scale
+    (sx * (one - two * (yy + zz))).store(columns[0]);
+    (sx * (two * (xy + wz))).store(columns[1]);
+    (sx * (two * (xz - wy))).store(columns[2]);
+    (sy * (two * (xy - wz))).store(columns[3]);
+    (sy * (one - two * (xx + zz))).store(columns[4]);
+    (sy * (two * (yz + wx))).store(columns[5]);
+    (sz * (two * (xz + wy))).store(columns[6]);
+    (sz * (two * (yz - wx))).store(columns[7]);
+    (sz * (one - two * (xx + yy))).store(columns[8]);
+    for (size_t k = 0; k < W; ++k) {
+      glm::mat4 &m = out[i + k];
+      m[0] = glm::vec4(columns[0][k], columns[1][k], columns[2][k], 0.0f);
+      m[1] = glm::vec4(columns[3][k], columns[4][k], columns[5][k], 0.0f);
+      m[2] = glm::vec4(columns[6][k], columns[7][k], columns[8][k], 0.0f);
+      m[3] = glm::vec4(translations[i + k], 1.0f);
+    }
+  }
+  return i;
+}
+
+template <typename L>
+size_t cullSpheresLanes(const glm::vec4 planes[6], const SpheresSoA &spheres,
+                        uint8_t *visible, size_t count) {
+  constexpr size_t W = L::kWidth;
+  constexpr uint32_t kAllLanes = (1u << W) - 1;
+  size_t i = 0;
+  for (; i + W <= count; i += W) {
+    L x = L::load(spheres.x + i), y = L::load(spheres.y + i),
+      z = L::load(spheres.z + i);
+    L negativeRadius = L::splat(0.0f) - L::load(spheres.radius + i);
+    uint32_t mask = kAllLanes;
+    for (int p = 0; p < 6; ++p) {
+      L distance = multiplyAdd(
+          L::splat(planes[p].x), x,
+          multiplyAdd(L::splat(planes[p].y), y,
+                      multiplyAdd(L::splat(planes[p].z), z,
+                                  L::splat(planes[p].w))));
+      mask &= greaterEqual(distance, negativeRadius);
+    }
+    for (size_t k = 0; k < W; ++k) {
+      visible[i + k] = static_cast<uint8_t>((mask >> k) & 1u);
+    }
+  }
+  return i;
+}
+
+template <typename L>
+size_t cullBoxesLanes(const glm::vec4 planes[6], const BoxesSoA &boxes,
+                      uint8_t *visible, size_t count) {
+  constexpr size_t W = L::kWidth;
+  constexpr uint32_t kAllLanes = (1u << W) - 1;
+  size_t i = 0;
+  for (; i + W <= count; i += W) {
+    uint32_t mask = kAllLanes;
+    for (int p = 0; p < 6; ++p) {
+      // the corner furthest along the plane normal
+      const glm::vec4 &plane = planes[p];
+      L x = L::load((plane.x >= 0.0f ? boxes.maxX : boxes.minX) + i);
+      L y = L::load((plane.y >= 0.0f ? boxes.maxY : boxes.minY) + i);
+      L z = L::load((plane.z >= 0.0f ? boxes.maxZ : boxes.minZ) + i);
+      L distance = multiplyAdd(
+          L::splat(plane.x), x,
+          multiplyAdd(L::splat(plane.y), y,
+                      multiplyAdd(L::splat(plane.z), z, L::splat(plane.w))));
+      mask &= greaterEqual(distance, L::splat(0.0f));
+    }
+    for (size_t k = 0; k < W; ++k) {
+      visible[i + k] = static_cast<uint8_t>((mask >> k) & 1u);
+    }
+  }
+  return i;
+}
+
+// the smallest three components span [-kSmallestMax, kSmallestMax]
+constexpr float kSmallestMax = 0.70710678f;
+constexpr float kSmallestSteps = 32767.0f;
+
+// where each of x, y, z, w comes from per index of the largest component:
+// the decoded smallest three in order, or 3 for the largest
+constexpr uint8_t kSmallestSources[4][4] = {
+    {3, 0, 1, 2}, {0, 3, 1, 2}, {0, 1, 3, 2}, {0, 1, 2, 3}};
+
+template <typename L>
+size_t decodeSmallestThreeLanes(const uint16_t *a, const uint16_t *b,
+                                const uint16_t *c, glm::quat *out,
+                                size_t count) {
+  constexpr size_t W = L::kWidth;
+  alignas(32) float components[4][W];
+  size_t i = 0;
+  for (; i + W <= count; i += W) {
+    L step = L::splat(2.0f * kSmallestMax / kSmallestSteps);
+    L offset = L::splat(-kSmallestMax);
+    L x = multiplyAdd(L::template loadWords<1>(a + i), step, offset);
+    L y = multiplyAdd(L::template loadWords<1>(b + i), step, offset);
+    L z = multiplyAdd(L::template loadWords<1>(c + i), step, offset);
+    // unit length gives the largest back, rounding may push it below zero
+    L rest = L::splat(1.0f) - multiplyAdd(x, x, multiplyAdd(y, y, z * z));
+    x.store(components[0]);
+    y.store(components[1]);
+    z.store(components[2]);
+    squareRoot(maximum(rest, L::splat(0.0f))).store(components[3]);
+    for (size_t k = 0; k < W; ++k) {
+      const uint8_t *source =
+          kSmallestSources[(a[i + k] & 1u) | (b[i + k] & 1u) << 1];
+      out[i + k] =
+          glm::quat(components[source[3]][k], components[source[0]][k],
+                    components[source[1]][k], components[source[2]][k]);
+    }
+  }
+  return i;
+}
+
+template <typename L>
+size_t dequantizeLanes(const uint16_t *quantized, const float *origins,
+                       const float *extents, float *out, size_t count) {
+  constexpr size_t W = L::kWidth;
+  size_t i = 0;
+  for (; i + W <= count; i += W) {
+    L steps = L::template loadWords<0>(quantized + i);
+    multiplyAdd(L::load(extents + i), steps * L::splat(1.0f / 65535.0f),
+                L::load(origins + i))
+        .store(out + i);
+  }
+  return i;
+}
+
+SpheresSoA offsetSpheres(const SpheresSoA &spheres, size_t offset) {
+  return {spheres.x + offset, spheres.y + offset, spheres.z + offset,
+          spheres.radius + offset};
+}
+
+BoxesSoA offsetBoxes(const BoxesSoA &boxes, size_t offset) {
+  return {boxes.minX + offset, boxes.minY + offset, boxes.minZ + offset,
+          boxes.maxX + offset, boxes.maxY + offset, boxes.maxZ + offset};
+}
+} // namespace
+
+const char *getInstructionSet() {
+#if defined(SIMD_MATH_AVX2)
+  return "avx2";
+#elif defined(SIMD_MATH_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+uint32_t getLaneCount() { return static_cast<uint32_t>(WideLanes::kWidth); }
+
+void composeTrs(const glm::vec3 *translations, const glm::quat *rotations,
+                const glm::vec3 *scales, glm::mat4 *out, size_t count) {
+  size_t done =
+      composeTrsLanes<WideLanes>(translations, rotations, scales, out, count);
+  composeTrsLanes<ScalarLanes>(translations + done, rotations + done,
+                               scales + done, out + done, count - done);
+}
+
+void multiply(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out,
+              size_t count) {
+#if defined(SIMD_MATH_AVX2)
+  // two result columns per register: both halves of aj hold column j of a,
+  // and every lane of b's columns is broadcast within its half
+  for (size_t i = 0; i < count; ++i) {
+    const float *pa = &a[i][0][0];
+    const float *pb = &b[i][0][0];
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(pa));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(pa + 4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(pa + 8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(pa + 12));
+    __m256 b01 = _mm256_loadu_ps(pb);
+    __m256 b23 = _mm256_loadu_ps(pb + 8);
+    __m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+    r01 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b01, 0x55), r01);
+    r01 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b01, 0xaa), r01);
+    r01 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b01, 0xff), r01);
+    __m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00));
+    r23 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b23, 0x55), r23);
+    r23 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b23, 0xaa), r23);
+    r23 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b23, 0xff), r23);
+    float *po = &out[i][0][0];
+    _mm256_storeu_ps(po, r01);
+    _mm256_storeu_ps(po + 8, r23);
+  }
+#elif defined(SIMD_MATH_SSE2)
+  for (size_t i = 0; i < count; ++i) {
+    const float *pa = &a[i][0][0];
+    const float *pb = &b[i][0][0];
+    __m128 columns[4] = {_mm_loadu_ps(pa), _mm_loadu_ps(pa + 4),
+                         _mm_loadu_ps(pa + 8), _mm_loadu_ps(pa + 12)};
+    __m128 bColumns[4] = {_mm_loadu_ps(pb), _mm_loadu_ps(pb + 4),
+                          _mm_loadu_ps(pb + 8), _mm_loadu_ps(pb + 12)};
+    float *po = &out[i][0][0];
+    for (int j = 0; j < 4; ++j) {
+      __m128 bj = bColumns[j];
+      __m128 r = _mm_mul_ps(columns[0],
+                            _mm_shuffle_ps(bj, bj, _MM_SHUFFLE(0, 0, 0, 0)));
+      r = _mm_add_ps(r, _mm_mul_ps(columns[1], _mm_shuffle_ps(
+                                                   bj, bj,
+                                                   _MM_SHUFFLE(1, 1, 1, 1))));
+      r = _mm_add_ps(r, _mm_mul_ps(columns[2], _mm_shuffle_ps(
+                                                   bj, bj,
+                                                   _MM_SHUFFLE(2, 2, 2, 2))));
+      r = _mm_add_ps(r, _mm_mul_ps(columns[3], _mm_shuffle_ps(
+                                                   bj, bj,
+                                                   _MM_SHUFFLE(3, 3, 3, 3))));
+      _mm_storeu_ps(po + 4 * j, r);
+    }
+  }
+#else
+  Scalar::multiply(a, b, out, count);
+#endif
+}
+
+void transformAabbs(const glm::mat4 *matrices, const glm::vec3 *mins,
+                    const glm::vec3 *maxs, glm::vec3 *outMins,
+                    glm::vec3 *outMaxs, size_t count) {
+#if defined(SIMD_MATH_AVX2) || defined(SIMD_MATH_SSE2)
+  // center and extent: the center moves with the matrix, the extent with
+  // its absolute value
+  const __m128 signMask = _mm_set1_ps(-0.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (size_t i = 0; i < count; ++i) {
+    const float *m = &matrices[i][0][0];
+    __m128 lo = _mm_setr_ps(mins[i].x, mins[i].y, mins[i].z, 0.0f);
+    __m128 hi = _mm_setr_ps(maxs[i].x, maxs[i].y, maxs[i].z, 0.0f);
+    alignas(16) float center[4];
+    alignas(16) float extent[4];
+    _mm_store_ps(center, _mm_mul_ps(_mm_add_ps(lo, hi), half));
+    _mm_store_ps(extent, _mm_mul_ps(_mm_sub_ps(hi, lo), half));
+    __m128 newCenter = _mm_loadu_ps(m + 12);
+    __m128 newExtent = _mm_setzero_ps();
+    for (int c = 0; c < 3; ++c) {
+      __m128 column = _mm_loadu_ps(m + 4 * c);
+      newCenter =
+          _mm_add_ps(newCenter, _mm_mul_ps(column, _mm_set1_ps(center[c])));
+      newExtent = _mm_add_ps(newExtent,
+                             _mm_mul_ps(_mm_andnot_ps(signMask, column),
+                                        _mm_set1_ps(extent[c])));
+    }
+    alignas(16) float result[2][4];
+    _mm_store_ps(result[0], _mm_sub_ps(newCenter, newExtent));
+    _mm_store_ps(result[1], _mm_add_ps(newCenter, newExtent));
+    outMins[i] = glm::vec3(result[0][0], result[0][1], result[0][2]);
+    outMaxs[i] = glm::vec3(result[1][0], result[1][1], result[1][2]);
+  }
+#else
+  Scalar::transformAabbs(matrices, mins, maxs, outMins, outMaxs, count);
+#endif
+}
+
+void extractFrustumPlanes(const glm::mat4 &clip, glm::vec4 planes[6]) {
+  glm::vec4 row0{clip[0][0], clip[1][0], clip[2][0], clip[3][0]};
+  glm::vec4 row1{clip[0][1], clip[1][1], clip[2][1], clip[3][1]};
+  glm::vec4 row2{clip[0][2], clip[1][2], clip[2][2], clip[3][2]};
+  glm::vec4 row3{clip[0][3], clip[1][3], clip[2][3], clip[3][3]};
+  planes[0] = row3 + row0; // left
+  planes[1] = row3 - row0; // right
+  planes[2] = row3 + row1; // top or bottom, proj flips y
+  planes[3] = row3 - row1;
+  // near as for a [-1, 1] depth range, loose but safe for [0, 1] as well
+  planes[4] = row3 + row2;
+  planes[5] = row3 - row2; // far
+  for (int i = 0; i < 6; ++i) {
+    planes[i] /= glm::length(glm::vec3(planes[i]));
+  }
+}
+
+void cullSpheres(const glm::vec4 planes[6], const SpheresSoA &spheres,
+                 uint8_t *visible, size_t count) {
+  size_t done = cullSpheresLanes<WideLanes>(planes, spheres, visible, count);
+  cullSpheresLanes<ScalarLanes>(planes, offsetSpheres(spheres, done),
+                                visible + done, count - done);
+}
+
+void cullBoxes(const glm::vec4 planes[6], const BoxesSoA &boxes,
+               uint8_t *visible, size_t count) {
+  size_t done = cullBoxesLanes<WideLanes>(planes, boxes, visible, count);
+  cullBoxesLanes<ScalarLanes>(planes, offsetBoxes(boxes, done), visible + done,
+                              count - done);
+}
+
+void encodeSmallestThree(const glm::quat &rotation, uint16_t words[3]) {
+  float q[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+  uint32_t largest = 0;
+  for (uint32_t j = 1; j < 4; ++j) {
+    largest = std::fabs(q[j]) > std::fabs(q[largest]) ? j : largest;
+  }
+  float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] +
+                           q[3] * q[3]);
+  float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+  uint32_t smallest = 0;
+  for (uint32_t j = 0; j < 4; ++j) {
+    if (j == largest) {
+      continue;
+    }
+    float unit = (sign * q[j] / length + kSmallestMax) / (2.0f * kSmallestMax);
+    unit = std::min(std::max(unit, 0.0f), 1.0f);
+    words[smallest++] =
+        static_cast<uint16_t>(std::lround(unit * kSmallestSteps) << 1);
+  }
+  words[0] |= static_cast<uint16_t>(largest & 1u);
+  words[1] |= static_cast<uint16_t>(largest >> 1);
+}
+
+void decodeSmallestThree(const uint16_t *a, const uint16_t *b,
+                         const uint16_t *c, glm::quat *out, size_t count) {
+  size_t done = decodeSmallestThreeLanes<WideLanes>(a, b, c, out, count);
+  decodeSmallestThreeLanes<ScalarLanes>(a + done, b + done, c + done,
+                                        out + done, count - done);
+}
+
+void dequantize(const uint16_t *quantized, const float *origins,
+                const float *extents, float *out, size_t count) {
+  size_t done =
+      dequantizeLanes<WideLanes>(quantized, origins, extents, out, count);
+  dequantizeLanes<ScalarLanes>(quantized + done, origins + done,
+                               extents + done, out + done, count - done);
+}
+
+namespace Scalar {
+void composeTrs(const glm::vec3 *translations, const glm::quat *rotations,
+                const glm::vec3 *scales, glm::mat4 *out, size_t count) {
+  composeTrsLanes<ScalarLanes>(translations, rotations, scales, out, count);
+}
+
+void multiply(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out,
+              size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    float result[4][4];
+    for (int column = 0; column < 4; ++column) {
+      for (int row = 0; row < 4; ++row) {
+        result[column][row] = a[i][0][row] * b[i][column][0] +
+                              a[i][1][row] * b[i][column][1] +
+                              a[i][2][row] * b[i][column][2] +
+                              a[i][3][row] * b[i][column][3];
+      }
+    }
+    memcpy(&out[i][0][0], result, sizeof(result));
+  }
+}
+
+void transformAabbs(const glm::mat4 *matrices, const glm::vec3 *mins,
+                    const glm::vec3 *maxs, glm::vec3 *outMins,
+                    glm::vec3 *outMaxs, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    const glm::mat4 &m = matrices[i];
+    glm::vec3 center = (mins[i] + maxs[i]) * 0.5f;
+    glm::vec3 extent = (maxs[i] - mins[i]) * 0.5f;
+    glm::vec3 newCenter(m[3]);
+    glm::vec3 newExtent(0.0f);
+    for (int c = 0; c < 3; ++c) {
+      newCenter += glm::vec3(m[c]) * center[c];
+      newExtent += glm::abs(glm::vec3(m[c])) * extent[c];
+    }
+    outMins[i] = newCenter - newExtent;
+    outMaxs[i] = newCenter + newExtent;
+  }
+}
+
+void cullSpheres(const glm::vec4 planes[6], const SpheresSoA &spheres,
+                 uint8_t *visible, size_t count) {
+  cullSpheresLanes<ScalarLanes>(planes, spheres, visible, count);
+}
+
+void cullBoxes(const glm::vec4 planes[6], const BoxesSoA &boxes,
+               uint8_t *visible, size_t count) {
+  cullBoxesLanes<ScalarLanes>(planes, boxes, visible, count);
+}
+
+void decodeSmallestThree(const uint16_t *a, const uint16_t *b,
+                         const uint16_t *c, glm::quat *out, size_t count) {
+  decodeSmallestThreeLanes<ScalarLanes>(a, b, c, out, count);
+}
+
+void dequantize(const uint16_t *quantized, const float *origins,
+                const float *extents, float *out, size_t count) {
+  dequantizeLanes<ScalarLanes>(quantized, origins, extents, out, count);
+}
+} // namespace Scalar
+
+} // namespace SimdMath
+} // namespace hiddenpiggy
@@ -0,0 +1,441 @@
+#include "StaticBatcher.hpp"
+#include "AccessorDecoder.hpp"
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+
+namespace hiddenpiggy {
+namespace StaticBatcher {
+
+namespace {
+// attributes a piece brings besides its positions; pieces only merge with
+// pieces of the same layout
+constexpr uint32_t kNormals = 1;
+constexpr uint32_t kUv0 = 2;
+constexpr uint32_t kUv1 = 4;
+
+// one primitive of one static node, in world space
+struct Piece {
+  uint32_t node = 0;
+  int32_t material = -1;
+  uint32_t layout = 0;
+  std::vector<float> positions; // 3 floats per vertex
+  std::vector<float> normals;
+  std::vector<float> uv0; // 2 floats per vertex
+  std::vector<float> uv1;
+  std::vector<uint32_t> indices;
+  glm::vec3 boundsMin{std::numeric_limits<float>::max()};
+  glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+};
+
+struct Batch {
+  int32_t material = -1;
+  uint32_t layout = 0;
+  std::vector<size_t> pieces;
+  size_t vertexCount = 0;
+};
+
+glm::mat4 localMatrix(const tinygltf::Node &node) {
+  glm::mat4 matrix = glm::identity<glm::mat4>();
+  if (node.matrix.size() == 16) {
+    for (int k = 0; k < 16; ++k) {
+      glm::value_ptr(matrix)[k] = static_cast<float>(node.matrix[k]);
+    }
+    return matrix;
+  }
+  glm::mat4 translation = glm::identity<glm::mat4>();
+  glm::mat4 rotation = glm::identity<glm::mat4>();
+  glm::mat4 scale = glm::identity<glm::mat4>();
+  if (node.translation.size() == 3) {
+    translation = glm::translate(
+        translation, glm::vec3(glm::make_vec3(node.translation.data())));
+  }
+  if (node.rotation.size() == 4) {
+    glm::quat q = glm::make_quat(node.rotation.data());
+    rotation = glm::mat4(q);
+  }
+  if (node.scale.size() == 3) {
+    scale = glm::scale(scale, glm::vec3(glm::make_vec3(node.scale.data())));
+  }
+  return translation * rotation * scale;
+}
+
+bool isPlainTriangleList(const tinygltf::Primitive &primitive) {
+  return primitive.mode == TINYGLTF_MODE_TRIANGLES &&
+         primitive.targets.empty() &&
+         primitive.attributes.count("POSITION") != 0;
+}
+
+std::vector<float> decodeAttribute(const tinygltf::Model &model,
+                                   const tinygltf::Primitive &primitive,
+                                   const char *name, uint32_t components,
+                                   size_t count) {
+  std::vector<float> values;
+  auto attribute = primitive.attributes.find(name);
+  if (attribute == primitive.attributes.end()) {
+    return values;
+  }
+  const tinygltf::Accessor &accessor = model.accessors[attribute->second];
+  if (accessor.count != count) {
+    throw std::runtime_error("attribute count mismatch");
+  }
+  values.assign(count * components, 0.0f);
+  AccessorDecoder::decodeFloats(model, accessor, components, values.data(),
+                                components * sizeof(float));
+  return values;
+}
+
+Piece makePiece(const tinygltf::Model &model,
+                const tinygltf::Primitive &primitive, uint32_t node,
+                const glm::mat4 &world) {
+  Piece piece{};
+  piece.node = node;
+  piece.material = primitive.material;
+  size_t count =
+      model.accessors[primitive.attributes.at("POSITION")].count;
+  piece.positions = decodeAttribute(model, primitive, "POSITION", 3, count);
+  piece.normals = decodeAttribute(model, primitive, "NORMAL", 3, count);
+  piece.uv0 = decodeAttribute(model, primitive, "TEXCOORD_0", 2, count);
+  piece.uv1 = decodeAttribute(model, primitive, "TEXCOORD_1", 2, count);
+  piece.layout = (piece.normals.empty() ? 0 : kNormals) |
+                 (piece.uv0.empty() ? 0 : kUv0) |
+                 (piece.uv1.empty() ? 0 : kUv1);
+
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec3 position = glm::vec3(
+        world * glm::vec4(glm::make_vec3(&piece.positions[3 * i]), 1.0f));
+    std::copy_n(glm::value_ptr(position), 3, &piece.positions[3 * i]);
+    piece.boundsMin = glm::min(piece.boundsMin, position);
+    piece.boundsMax = glm::max(piece.boundsMax, position);
+  }
+  glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+  for (size_t i = 0; i < piece.normals.size(); i += 3) {
+    glm::vec3 normal = normalMatrix * glm::make_vec3(&piece.normals[i]);
+    float length = glm::length(normal);
+    if (length > 0.0f) {
+      normal /= length;
+    }
+    std::copy_n(glm::value_ptr(normal), 3, &piece.normals[i]);
+  }
+
+  if (primitive.indices >= 0) {
+    const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
+    piece.indices.resize(accessor.count);
+    AccessorDecoder::decodeIndices(model, accessor, piece.indices.data());
+    if (std::any_of(piece.indices.begin(), piece.indices.end(),
+                    [count](uint32_t index) { return index >= count; })) {
+      throw std::runtime_error("primitive index out of range");
+    }
+  } else {
+    piece.indices.resize(count);
+    std::iota(piece.indices.begin(), piece.indices.end(), 0u);
+  }
+  piece.indices.resize(piece.indices.size() - piece.indices.size() % 3);
+  // a mirroring transform turns the triangles inside out
+  if (glm::determinant(glm::mat3(world)) < 0.0f) {
+    for (size_t i = 0; i < piece.indices.size(); i += 3) {
+      std::swap(piece.indices[i + 1], piece.indices[i + 2]);
+    }
+  }
+  return piece;
+}
+
+// placed primitives, one draw each for a renderer without instancing
+uint32_t countDraws(const tinygltf::Model &model) {
+  uint32_t draws = 0;
+  for (const auto &node : model.nodes) {
+    if (node.mesh >= 0 && static_cast<size_t>(node.mesh) < model.meshes.size()) {
+      draws += static_cast<uint32_t>(model.meshes[node.mesh].primitives.size());
+    }
+  }
+  return draws;
+}
+
+int appendView(tinygltf::Model &model, int buffer, const void *data,
+               size_t size, int target) {
+  auto &bytes = model.buffers[buffer].data;
+  tinygltf::BufferView view;
+  view.buffer = buffer;
+  view.byteOffset = bytes.size();
+  view.byteLength = size;
+  view.target = target;
+  const auto *first = static_cast<const unsigned char *>(data);
+  bytes.insert(bytes.end(), first, first + size);
+  model.bufferViews.push_back(view);
+  return static_cast<int>(model.bufferViews.size() - 1);
+}
+
+int appendFloats(tinygltf::Model &model, int buffer,
+                 const std::vector<float> &values, uint32_t components) {
+  tinygltf::Accessor accessor;
+  accessor.bufferView =
+      appendView(model, buffer, values.data(), values.size() * sizeof(float),
+                 TINYGLTF_TARGET_ARRAY_BUFFER);
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.count = values.size() / components;
+  accessor.type = components == 3 ? TINYGLTF_TYPE_VEC3 : TINYGLTF_TYPE_VEC2;
+  model.accessors.push_back(accessor);
+  return static_cast<int>(model.accessors.size() - 1);
+}
+} // namespace
+
+SceneGraph resolveSceneGraph(const tinygltf::Model &model) {
+  size_t nodeCount = model.nodes.size();
+  std::vector<int32_t> parents(nodeCount, -1);
+  for (size_t i = 0; i < nodeCount; ++i) {
+    for (int child : model.nodes[i].children) {
+      if (child >= 0 && static_cast<size_t>(child) < nodeCount) {
+        parents[child] = static_cast<int32_t>(i);
+      }
+    }
+  }
+  std::vector<bool> animated(nodeCount, false);
+  for (const auto &animation : model.animations) {
+    for (const auto &channel : animation.channels) {
+      if (channel.target_node >= 0 &&
+          static_cast<size_t>(channel.target_node) < nodeCount) {
+        animated[channel.target_node] = true;
+      }
+    }
+  }
+
+  SceneGraph graph{std::vector<glm::mat4>(nodeCount),
+                   std::vector<bool>(nodeCount, false)};
+  std::vector<bool> resolved(nodeCount, false);
+  std::function<void(size_t)> resolve = [&](size_t node) {
+    if (resolved[node]) {
+      return;
+    }
+    resolved[node] = true; // also breaks cycles in broken files
+    graph.world[node] = localMatrix(model.nodes[node]);
+    graph.moving[node] = animated[node];
+    if (int32_t parent = parents[node]; parent >= 0) {
+      resolve(parent);
+      graph.world[node] = graph.world[parent] * graph.world[node];
+      graph.moving[node] = graph.moving[node] || graph.moving[parent];
+    }
+  };
+  for (size_t i = 0; i < nodeCount; ++i) {
+    resolve(i);
+  }
+  return graph;
+}
+
+std::vector<Member> batch(tinygltf::Model &model, Stats *stats) {
+  size_t nodeCount = model.nodes.size();
+  std::vector<uint32_t> placements(model.meshes.size(), 0);
+  for (const auto &node : model.nodes) {
+    if (node.mesh >= 0 && static_cast<size_t>(node.mesh) < model.meshes.size()) {
+      placements[node.mesh]++;
+    }
+  }
+  SceneGraph graph = resolveSceneGraph(model);
+
+  std::vector<Piece> pieces;
+  std::vector<bool> absorbed(model.meshes.size(), false);
+  uint32_t staticNodes = 0;
+  for (size_t i = 0; i < nodeCount; ++i) {
+    const tinygltf::Node &node = model.nodes[i];
+    if (node.mesh < 0 || static_cast<size_t>(node.mesh) >= model.meshes.size() ||
+        placements[node.mesh] != 1 || node.skin >= 0 ||
+        node.extensions.count("EXT_mesh_gpu_instancing") != 0) {
+      continue;
+    }
+    const tinygltf::Mesh &mesh = model.meshes[node.mesh];
+    if (!std::all_of(mesh.primitives.begin(), mesh.primitives.end(),
+                     isPlainTriangleList)) {
+      continue;
+    }
+    if (graph.moving[i]) {
+      continue;
+    }
+    for (const auto &primitive : mesh.primitives) {
+      Piece piece = makePiece(model, primitive, static_cast<uint32_t>(i),
+                              graph.world[i]);
+      if (!piece.indices.empty()) {
+        pieces.push_back(std::move(piece));
+      }
+    }
+    absorbed[node.mesh] = true;
+    staticNodes++;
+  }
+  if (stats) {
+    *stats = Stats{};
+    stats->drawsBefore = countDraws(model);
+    stats->drawsAfter = stats->drawsBefore;
+  }
+  if (staticNodes == 0) {
+    return {};
+  }
+
+  // uniform grid over everything static, cubic cells
+  glm::vec3 lower{std::numeric_limits<float>::max()};
+  glm::vec3 upper{std::numeric_limits<float>::lowest()};
+  for (const auto &piece : pieces) {
+    lower = glm::min(lower, piece.boundsMin);
+    upper = glm::max(upper, piece.boundsMax);
+  }
+  glm::vec3 extent = glm::max(upper - lower, glm::vec3(0.0f));
+  float cellSize =
+      std::max(std::max(extent.x, extent.y), extent.z) / float(kCellsPerAxis);
+  auto cellOf = [&](const Piece &piece) {
+    if (cellSize <= 0.0f) {
+      return 0u;
+    }
+    glm::vec3 center = 0.5f * (piece.boundsMin + piece.boundsMax);
+    glm::uvec3 cell = glm::min(glm::uvec3((center - lower) / cellSize),
+                               glm::uvec3(kCellsPerAxis - 1));
+    return (cell.z * kCellsPerAxis + cell.y) * kCellsPerAxis + cell.x;
+  };
+
+  // ordered, so the same source always cooks to the same batches
+  std::map<std::tuple<int32_t, uint32_t, uint32_t>, std::vector<size_t>>
+      groups;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    groups[{pieces[i].material, pieces[i].layout, cellOf(pieces[i])}]
+        .push_back(i);
+  }
+  std::vector<Batch> batches;
+  for (const auto &[key, members] : groups) {
+    Batch current{};
+    for (size_t index : members) {
+      size_t vertexCount = pieces[index].positions.size() / 3;
+      if (!current.pieces.empty() &&
+          current.vertexCount + vertexCount > kMaxBatchVertices) {
+        batches.push_back(std::move(current));
+        current = Batch{};
+      }
+      current.material = std::get<0>(key);
+      current.layout = std::get<1>(key);
+      current.pieces.push_back(index);
+      current.vertexCount += vertexCount;
+    }
+    batches.push_back(std::move(current));
+  }
+
+  // drop the absorbed meshes; the static nodes stay without one
+  std::vector<int> meshRemap(model.meshes.size(), -1);
+  std::vector<tinygltf::Mesh> meshes;
+  for (size_t i = 0; i < model.meshes.size(); ++i) {
+    if (!absorbed[i]) {
+      meshRemap[i] = static_cast<int>(meshes.size());
+      meshes.push_back(std::move(model.meshes[i]));
+    }
+  }
+  model.meshes = std::move(meshes);
+  for (auto &node : model.nodes) {
+    if (node.mesh >= 0 && static_cast<size_t>(node.mesh) < meshRemap.size()) {
+      node.mesh = meshRemap[node.mesh];
+    }
+  }
+
+  model.buffers.emplace_back();
+  int buffer = static_cast<int>(model.buffers.size() - 1);
+  int scene = model.defaultScene >= 0 ? model.defaultScene : 0;
+  std::map<std::pair<uint32_t, uint32_t>, Member> members;
+  for (const Batch &merged : batches) {
+    std::vector<float> positions, normals, uv0, uv1;
+    std::vector<uint32_t> indices;
+    uint32_t meshIndex = static_cast<uint32_t>(model.meshes.size());
+    for (size_t index : merged.pieces) {
+      const Piece &piece = pieces[index];
+      uint32_t base = static_cast<uint32_t>(positions.size() / 3);
+      positions.insert(positions.end(), piece.positions.begin(),
+                       piece.positions.end());
+      normals.insert(normals.end(), piece.normals.begin(), piece.normals.end());
+      uv0.insert(uv0.end(), piece.uv0.begin(), piece.uv0.end());
+      uv1.insert(uv1.end(), piece.uv1.begin(), piece.uv1.end());
+      for (uint32_t vertex : piece.indices) {
+        indices.push_back(base + vertex);
+      }
+
+      auto [member, inserted] =
+          members.try_emplace({piece.node, meshIndex}, Member{});
+      if (inserted) {
+        member->second.node = piece.node;
+        member->second.mesh = meshIndex;
+        std::copy_n(glm::value_ptr(piece.boundsMin), 3,
+                    member->second.boundsMin);
+        std::copy_n(glm::value_ptr(piece.boundsMax), 3,
+                    member->second.boundsMax);
+      } else {
+        for (int k = 0; k < 3; ++k) {
+          member->second.boundsMin[k] =
+              std::min(member->second.boundsMin[k], piece.boundsMin[k]);
+          member->second.boundsMax[k] =
+              std::max(member->second.boundsMax[k], piece.boundsMax[k]);
+        }
+      }
+    }
+
+    tinygltf::Primitive primitive;
+    primitive.mode = TINYGLTF_MODE_TRIANGLES;
+    primitive.material = merged.material;
+    primitive.attributes["POSITION"] = appendFloats(model, buffer, positions, 3);
+    tinygltf::Accessor &position = model.accessors.back();
+    glm::vec3 batchMin{std::numeric_limits<float>::max()};
+    glm::vec3 batchMax{std::numeric_limits<float>::lowest()};
+    for (size_t k = 0; k < positions.size(); k += 3) {
+      batchMin = glm::min(batchMin, glm::make_vec3(&positions[k]));
+      batchMax = glm::max(batchMax, glm::make_vec3(&positions[k]));
+    }
+    position.minValues = {batchMin.x, batchMin.y, batchMin.z};
+    position.maxValues = {batchMax.x, batchMax.y, batchMax.z};
+    if (merged.layout & kNormals) {
+      primitive.attributes["NORMAL"] = appendFloats(model, buffer, normals, 3);
+    }
+    if (merged.layout & kUv0) {
+      primitive.attributes["TEXCOORD_0"] = appendFloats(model, buffer, uv0, 2);
+    }
+    if (merged.layout & kUv1) {
+      primitive.attributes["TEXCOORD_1"] = appendFloats(model, buffer, uv1, 2);
+    }
+    tinygltf::Accessor indexAccessor;
+    indexAccessor.bufferView =
+        appendView(model, buffer, indices.data(),
+                   indices.size() * sizeof(uint32_t),
+                   TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+    indexAccessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+    indexAccessor.count = indices.size();
+    indexAccessor.type = TINYGLTF_TYPE_SCALAR;
+    model.accessors.push_back(indexAccessor);
+    primitive.indices = static_cast<int>(model.accessors.size() - 1);
+
+    tinygltf::Mesh mesh;
+    mesh.name = "static batch";
+    mesh.primitives.push_back(std::move(primitive));
+    model.meshes.push_back(std::move(mesh));
+
+    // the geometry is in world space already, so an identity root places it
+    tinygltf::Node node;
+    node.name = "static batch";
+    node.mesh = static_cast<int>(meshIndex);
+    model.nodes.push_back(std::move(node));
+    if (static_cast<size_t>(scene) < model.scenes.size()) {
+      model.scenes[scene].nodes.push_back(
+          static_cast<int>(model.nodes.size() - 1));
+    }
+  }
+
+  if (stats) {
+    stats->drawsAfter = countDraws(model);
+    stats->staticNodes = staticNodes;
+  }
+  std::vector<Member> result;
+  result.reserve(members.size());
+  for (const auto &[key, member] : members) {
+    result.push_back(member);
+  }
+  return result;
+}
+
+} // namespace StaticBatcher
+} // namespace hiddenpiggy
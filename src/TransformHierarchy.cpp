@@ -0,0 +1,166 @@
+#include "TransformHierarchy.hpp"
+#include "SimdMath.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace hiddenpiggy {
+
+void TransformHierarchy::build(const std::vector<int32_t> &parents) {
+  const uint32_t count = static_cast<uint32_t>(parents.size());
+  std::vector<std::vector<uint32_t>> children(count);
+  std::vector<uint32_t> roots;
+  for (uint32_t node = 0; node < count; ++node) {
+    int32_t parent = parents[node];
+    if (parent < 0) {
+      roots.push_back(node);
+    } else if (static_cast<uint32_t>(parent) < count) {
+      children[parent].push_back(node);
+    } else {
+      throw std::runtime_error("node parent out of range");
+    }
+  }
+
+  // depth first preorder, so subtrees are contiguous; children are pushed
+  // in reverse to keep them in source order
+  m_slots.assign(count, UINT32_MAX);
+  m_parents.assign(count, -1);
+  std::vector<uint32_t> order;
+  order.reserve(count);
+  std::vector<uint32_t> stack(roots.rbegin(), roots.rend());
+  while (!stack.empty()) {
+    uint32_t node = stack.back();
+    stack.pop_back();
+    m_slots[node] = static_cast<uint32_t>(order.size());
+    order.push_back(node);
+    stack.insert(stack.end(), children[node].rbegin(), children[node].rend());
+  }
+  // nodes on a cycle are never reached from a root
+  if (order.size() != count) {
+    throw std::runtime_error("node hierarchy is not a tree");
+  }
+  for (uint32_t slot = 0; slot < count; ++slot) {
+    int32_t parent = parents[order[slot]];
+    m_parents[slot] = parent < 0 ? -1 : static_cast<int32_t>(m_slots[parent]);
+  }
+  m_subtreeEnds.resize(count);
+  for (uint32_t slot = count; slot-- > 0;) {
+    uint32_t end = slot + 1;
+    for (uint32_t child : children[order[slot]]) {
+      end = std::max(end, m_subtreeEnds[m_slots[child]]);
+    }
+    m_subtreeEnds[slot] = end;
+  }
+
+  m_translations.assign(count, glm::vec3(0.0f));
+  m_rotations.assign(count, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+  m_scales.assign(count, glm::vec3(1.0f));
+  m_matrices.assign(count, glm::mat4(1.0f));
+  m_hasMatrix.assign(count, 0);
+  m_locals.resize(count);
+  m_world.assign(count, glm::mat4(1.0f));
+  m_dirty.assign(count, 1);
+  m_changed.assign(count, 0);
+  m_changedCount = 0;
+  m_anyDirty = count > 0;
+}
+
+void TransformHierarchy::clear() {
+  m_translations.clear();
+  m_rotations.clear();
+  m_scales.clear();
+  m_matrices.clear();
+  m_hasMatrix.clear();
+  m_parents.clear();
+  m_subtreeEnds.clear();
+  m_locals.clear();
+  m_world.clear();
+  m_dirty.clear();
+  m_changed.clear();
+  m_slots.clear();
+  m_changedCount = 0;
+  m_anyDirty = false;
+}
+
+void TransformHierarchy::setTranslation(uint32_t node,
+                                        const glm::vec3 &translation) {
+  uint32_t slot = m_slots[node];
+  m_translations[slot] = translation;
+  markDirty(slot);
+}
+
+void TransformHierarchy::setRotation(uint32_t node, const glm::quat &rotation) {
+  uint32_t slot = m_slots[node];
+  m_rotations[slot] = rotation;
+  markDirty(slot);
+}
+
+void TransformHierarchy::setScale(uint32_t node, const glm::vec3 &scale) {
+  uint32_t slot = m_slots[node];
+  m_scales[slot] = scale;
+  markDirty(slot);
+}
+
+void TransformHierarchy::setMatrix(uint32_t node, const glm::mat4 &matrix) {
+  uint32_t slot = m_slots[node];
+  m_matrices[slot] = matrix;
+  m_hasMatrix[slot] = matrix != glm::mat4(1.0f) ? 1 : 0;
+  markDirty(slot);
+}
+
+void TransformHierarchy::markAllDirty() {
+  std::fill(m_dirty.begin(), m_dirty.end(), uint8_t{1});
+  m_anyDirty = !m_dirty.empty();
+}
+
+uint32_t TransformHierarchy::update() {
+  if (!m_anyDirty) {
+    if (m_changedCount > 0) {
+      std::fill(m_changed.begin(), m_changed.end(), uint8_t{0});
+      m_changedCount = 0;
+    }
+    return 0;
+  }
+  // parents precede children, so a parent's change is known by the time
+  // its children are visited
+  uint32_t recomputed = 0;
+  const uint32_t count = static_cast<uint32_t>(m_world.size());
+  for (uint32_t slot = 0; slot < count; ++slot) {
+    int32_t parent = m_parents[slot];
+    bool changed = m_dirty[slot] || (parent >= 0 && m_changed[parent]);
+    m_changed[slot] = changed ? 1 : 0;
+    recomputed += changed ? 1 : 0;
+  }
+  // the locals of a run of changed slots are composed in one batch, then
+  // chained onto their parents in order
+  for (uint32_t begin = 0; begin < count;) {
+    if (!m_changed[begin]) {
+      ++begin;
+      continue;
+    }
+    uint32_t end = begin + 1;
+    while (end < count && m_changed[end]) {
+      ++end;
+    }
+    SimdMath::composeTrs(&m_translations[begin], &m_rotations[begin],
+                         &m_scales[begin], &m_locals[begin], end - begin);
+    for (uint32_t slot = begin; slot < end; ++slot) {
+      if (m_hasMatrix[slot]) {
+        SimdMath::multiply(&m_locals[slot], &m_matrices[slot],
+                           &m_locals[slot], 1);
+      }
+      int32_t parent = m_parents[slot];
+      if (parent >= 0) {
+        SimdMath::multiply(&m_world[parent], &m_locals[slot], &m_world[slot],
+                           1);
+      } else {
+        m_world[slot] = m_locals[slot];
+      }
+      m_dirty[slot] = 0;
+    }
+    begin = end;
+  }
+  m_changedCount = recomputed;
+  m_anyDirty = false;
+  return recomputed;
+}
+} // namespace hiddenpiggy
@@ -318,6 +318,36 @@ void VkContext::OnCreate(const std::string AppName) {
     m_EnabledDeviceExtensions.push_back(extension.c_str());
   }
 
+  // meshlets are drawn with mesh shaders where there are any, the compute
+  // culling path covers the rest
+  auto deviceExtensions = m_PhysicalDevice.enumerateDeviceExtensionProperties();
+  if (std::any_of(deviceExtensions.begin(), deviceExtensions.end(),
+                  [](const vk::ExtensionProperties &extension) {
+                    return std::string{extension.extensionName.data()} ==
+                           VK_EXT_MESH_SHADER_EXTENSION_NAME;
+                  })) {
+    auto supportedFeatures = m_PhysicalDevice.getFeatures2<
+        vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    const auto &meshShaderFeatures =
+        supportedFeatures.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    m_meshShaderSupported =
+        meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+  }
+  if (m_meshShaderSupported) {
+    m_EnabledDeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+  }
+
+  // gpu driven drawing
+  auto coreFeatures = m_PhysicalDevice.getFeatures2<
+      vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+  const auto &features10 =
+      coreFeatures.get<vk::PhysicalDeviceFeatures2>().features;
+  m_multiDrawIndirectSupported =
+      features10.multiDrawIndirect && features10.drawIndirectFirstInstance;
+  m_drawIndirectCountSupported =
+      coreFeatures.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+  m_fragmentStoresAndAtomicsSupported = features10.fragmentStoresAndAtomics;
+
   // prepare for queue family
   FindQueueFamilyIndex(m_PhysicalDevice, m_queueFamilyIndices);
 
@@ -361,6 +391,11 @@ void VkContext::OnCreate(const std::string AppName) {
   vk::PhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
   deviceFeatures.geometryShader = VK_TRUE;
+  // texture streaming feedback is written from the fragment shader
+  deviceFeatures.fragmentStoresAndAtomics =
+      m_fragmentStoresAndAtomicsSupported;
+  deviceFeatures.multiDrawIndirect = m_multiDrawIndirectSupported;
+  deviceFeatures.drawIndirectFirstInstance = m_multiDrawIndirectSupported;
   deviceFeatures2.features = deviceFeatures;
 
   vk::PhysicalDeviceAccelerationStructureFeaturesKHR accelFeature = {};
@@ -372,6 +407,17 @@ void VkContext::OnCreate(const std::string AppName) {
   rtpipelineFeature.pNext = nullptr;
   accelFeature.pNext = &rtpipelineFeature;
 
+  vk::PhysicalDeviceVulkan12Features vulkan12Features = {};
+  vulkan12Features.drawIndirectCount = m_drawIndirectCountSupported;
+  rtpipelineFeature.pNext = &vulkan12Features;
+
+  vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeature = {};
+  if (m_meshShaderSupported) {
+    meshShaderFeature.taskShader = VK_TRUE;
+    meshShaderFeature.meshShader = VK_TRUE;
+    vulkan12Features.pNext = &meshShaderFeature;
+  }
+
   vk::DeviceCreateInfo deviceCreateInfo{
       {},
       static_cast<uint32_t>(queueCreateInfos.size()),
@@ -0,0 +1,101 @@
+#include "VkDepthOnlyPipeline.hpp"
+#include "VkShaderModuleFactory.hpp"
+#include "glTFScene.hpp"
+
+namespace hiddenpiggy {
+void VkDepthOnlyPipeline::createShaderStages() {
+  m_vertexModule = VkShaderModuleFactory::CreateShaderModule(
+      m_device,
+      (std::string{SHADERS_PATH} + std::string{"depth_vert.spv"}).c_str());
+
+  vk::PipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
+  vertShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eVertex;
+  vertShaderStageCreateInfo.module = m_vertexModule;
+  vertShaderStageCreateInfo.pName = "main";
+
+  m_shaderStages.push_back(vertShaderStageCreateInfo);
+}
+
+void VkDepthOnlyPipeline::OnCreate() {
+  createShaderStages();
+
+  // positions only, the attribute stream is never bound
+  auto bindingDescription = gltfVertex::getPositionBindingDescription();
+  auto attributeDescriptions = gltfVertex::getPositionAttributeDescriptions();
+  vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
+  vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+  vertexInputStateCreateInfo.pVertexBindingDescriptions = &bindingDescription;
+  vertexInputStateCreateInfo.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(attributeDescriptions.size());
+  vertexInputStateCreateInfo.pVertexAttributeDescriptions =
+      attributeDescriptions.data();
+
+  vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo;
+  inputAssemblyStateCreateInfo.topology = vk::PrimitiveTopology::eTriangleList;
+  inputAssemblyStateCreateInfo.primitiveRestartEnable = false;
+
+  // set by the pass
+  vk::PipelineViewportStateCreateInfo viewportStateCreateInfo;
+  viewportStateCreateInfo.viewportCount = 1;
+  viewportStateCreateInfo.scissorCount = 1;
+
+  vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
+  rasterizationStateCreateInfo.depthClampEnable = false;
+  rasterizationStateCreateInfo.rasterizerDiscardEnable = false;
+  rasterizationStateCreateInfo.polygonMode = vk::PolygonMode::eFill;
+  rasterizationStateCreateInfo.cullMode = vk::CullModeFlagBits::eBack;
+  rasterizationStateCreateInfo.frontFace = vk::FrontFace::eCounterClockwise;
+  rasterizationStateCreateInfo.depthBiasEnable = m_depthBias;
+  rasterizationStateCreateInfo.lineWidth = 1.0f;
+
+  vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo;
+  multisampleStateCreateInfo.sampleShadingEnable = false;
+  multisampleStateCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+  vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo;
+  depthStencilStateCreateInfo.depthTestEnable = true;
+  depthStencilStateCreateInfo.depthWriteEnable = true;
+  depthStencilStateCreateInfo.depthCompareOp = vk::CompareOp::eLessOrEqual;
+  depthStencilStateCreateInfo.setDepthBoundsTestEnable(false);
+
+  // no color attachments
+  vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo;
+  colorBlendStateCreateInfo.logicOpEnable = false;
+  colorBlendStateCreateInfo.attachmentCount = 0;
+
+  std::vector<vk::DynamicState> dynamicStates{vk::DynamicState::eViewport,
+                                              vk::DynamicState::eScissor};
+  if (m_depthBias) {
+    dynamicStates.push_back(vk::DynamicState::eDepthBias);
+  }
+  vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{
+      {}, static_cast<uint32_t>(dynamicStates.size()), dynamicStates.data(),
+      nullptr};
+
+  vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
+  pipelineCreateInfo.stageCount = static_cast<uint32_t>(m_shaderStages.size());
+  pipelineCreateInfo.pStages = m_shaderStages.data();
+  pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
+  pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
+  pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+  pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
+  pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
+  pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+  pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+  pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
+  pipelineCreateInfo.layout = m_pipelineLayout;
+  pipelineCreateInfo.renderPass = m_RenderPass;
+  pipelineCreateInfo.subpass = 0;
+
+  auto res = m_device.createGraphicsPipeline({}, pipelineCreateInfo);
+  assert(res.result == vk::Result::eSuccess);
+  m_pipeline = res.value;
+
+  m_device.destroyShaderModule(m_vertexModule, nullptr);
+}
+
+void VkDepthOnlyPipeline::OnDestroy() { m_device.destroyPipeline(m_pipeline); }
+
+vk::Pipeline VkDepthOnlyPipeline::getPipeline() { return m_pipeline; }
+
+} // namespace hiddenpiggy
@@ -11,7 +11,10 @@ void VkSwapchainGraphicsPipeline::createShaderStages() {
       (std::string{SHADERS_PATH} + std::string{"swapchain_vert.spv"}).c_str());
   m_fragmentModule = VkShaderModuleFactory::CreateShaderModule(
       m_device,
-      (std::string{SHADERS_PATH} + std::string{"swapchain_frag.spv"}).c_str());
+      (std::string{SHADERS_PATH} +
+       std::string{m_textureFeedback ? "swapchain_frag.spv"
+                                     : "swapchain_frag_nofeedback.spv"})
+          .c_str());
 
   vk::PipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
   vertShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eVertex;
@@ -33,15 +36,19 @@ void VkSwapchainGraphicsPipeline::OnCreate() {
 
   // Vertex input state
   vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
-  vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
   //vertexInputStateCreateInfo.setVertexBindingDescriptionCount(0);
   //vertexInputStateCreateInfo.setVertexAttributeDescriptionCount(0);
-  auto bindingDescription = gltfVertex::getBindingDescription();
-  vertexInputStateCreateInfo.pVertexBindingDescriptions = &bindingDescription;
+  // positions and shading attributes come from separate bindings
+  auto bindingDescriptions = gltfVertex::getBindingDescriptions();
+  auto attributeDescriptions = gltfVertex::getAttributeDescriptions();
+  vertexInputStateCreateInfo.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(bindingDescriptions.size());
+  vertexInputStateCreateInfo.pVertexBindingDescriptions =
+      bindingDescriptions.data();
   vertexInputStateCreateInfo.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(gltfVertex::getAttributeDescriptions().size());
+      static_cast<uint32_t>(attributeDescriptions.size());
   vertexInputStateCreateInfo.pVertexAttributeDescriptions =
-         gltfVertex::getAttributeDescriptions().data();
+      attributeDescriptions.data();
 
   // Input assembly state
   vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo;
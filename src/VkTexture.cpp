@@ -1,4 +1,5 @@
 #include "VkTexture.hpp"
+#include "AssetReader.hpp"
 #include "ResourceUploadHeap.hpp"
 #include "VkBufferPool.hpp"
 #include "stb_image.h"
@@ -13,8 +14,12 @@ namespace hiddenpiggy {
         vk::Device device = m_pContext->getDevice();
 
         // Load texture image data from file
+        std::vector<unsigned char> encoded;
+        if (!AssetReader::readFile(filename, &encoded, nullptr)) {
+            throw std::runtime_error("failed to open texture " + filename);
+        }
         int texWidth, texHeight, texChannels;
-        stbi_uc* pixels = stbi_load(filename.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+        stbi_uc* pixels = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
         VkDeviceSize imageSize = texWidth * texHeight * 4;
 
         // Create Image Object
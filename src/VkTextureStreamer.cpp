@@ -0,0 +1,731 @@
+#include "VkTextureStreamer.hpp"
+#include "AssetReader.hpp"
+#include "stb_image.h"
+#include "vulkan/vulkan_enums.hpp"
+#include "vulkan/vulkan_structs.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace hiddenpiggy {
+
+namespace {
+constexpr vk::Format kStreamingFormat = vk::Format::eR8G8B8A8Srgb;
+
+uint32_t mipExtent(uint32_t size, uint32_t mipLevel) {
+  return std::max(1u, size >> mipLevel);
+}
+
+// 2x2 box filter, the last row/column is repeated for odd sizes
+std::vector<uint8_t> downsample(const std::vector<uint8_t> &src, uint32_t width,
+                                uint32_t height) {
+  uint32_t dstWidth = std::max(1u, width / 2);
+  uint32_t dstHeight = std::max(1u, height / 2);
+  std::vector<uint8_t> dst(static_cast<size_t>(dstWidth) * dstHeight * 4);
+  for (uint32_t y = 0; y < dstHeight; ++y) {
+    uint32_t y0 = std::min(y * 2, height - 1);
+    uint32_t y1 = std::min(y * 2 + 1, height - 1);
+    for (uint32_t x = 0; x < dstWidth; ++x) {
+      uint32_t x0 = std::min(x * 2, width - 1);
+      uint32_t x1 = std::min(x * 2 + 1, width - 1);
+      for (uint32_t c = 0; c < 4; ++c) {
+        uint32_t sum = src[(y0 * width + x0) * 4 + c] +
+                       src[(y0 * width + x1) * 4 + c] +
+                       src[(y1 * width + x0) * 4 + c] +
+                       src[(y1 * width + x1) * 4 + c];
+        dst[(y * dstWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+      }
+    }
+  }
+  return dst;
+}
+
+std::vector<unsigned char> readEncoded(const std::string &filename) {
+  std::vector<unsigned char> encoded;
+  if (!AssetReader::readFile(filename, &encoded, nullptr)) {
+    throw std::runtime_error("failed to open streaming texture " + filename);
+  }
+  return encoded;
+}
+
+// decodes the image and returns mips [firstMip, endMip)
+std::vector<std::vector<uint8_t>>
+decodeEncodedMips(const std::vector<unsigned char> &encoded,
+                  const std::string &filename, uint32_t firstMip,
+                  uint32_t endMip) {
+  int texWidth, texHeight, texChannels;
+  stbi_uc *pixels = stbi_load_from_memory(
+      encoded.data(), static_cast<int>(encoded.size()), &texWidth, &texHeight,
+      &texChannels, STBI_rgb_alpha);
+  if (pixels == nullptr) {
+    throw std::runtime_error("failed to load streaming texture " + filename);
+  }
+
+  uint32_t width = static_cast<uint32_t>(texWidth);
+  uint32_t height = static_cast<uint32_t>(texHeight);
+  std::vector<uint8_t> level(pixels, pixels + static_cast<size_t>(width) *
+                                                  height * 4);
+  stbi_image_free(pixels);
+
+  std::vector<std::vector<uint8_t>> mips;
+  mips.reserve(endMip - firstMip);
+  for (uint32_t mip = 0; mip < endMip; ++mip) {
+    if (mip >= firstMip) {
+      mips.push_back(level);
+    }
+    if (mip + 1 < endMip) {
+      level = downsample(level, mipExtent(width, mip), mipExtent(height, mip));
+    }
+  }
+  return mips;
+}
+
+// the streamed part of the chain, which is decoded whole anyway since every
+// mip is downsampled from the one above it
+std::shared_ptr<const MipChain> decodeStreamedMips(const std::string &filename,
+                                                   uint32_t firstTailMip) {
+  return std::make_shared<const MipChain>(
+      decodeEncodedMips(readEncoded(filename), filename, 0, firstTailMip));
+}
+
+size_t chainBytes(const MipChain &mips) {
+  size_t bytes = 0;
+  for (const auto &mip : mips) {
+    bytes += mip.size();
+  }
+  return bytes;
+}
+
+// sizes the mip chain and decodes the part that is resident from the start
+TextureTail decodeTail(const std::string &filename) {
+  // one read serves both the header query and the decode
+  std::vector<unsigned char> encoded = readEncoded(filename);
+  int texWidth, texHeight, texChannels;
+  if (!stbi_info_from_memory(encoded.data(), static_cast<int>(encoded.size()),
+                             &texWidth, &texHeight, &texChannels)) {
+    throw std::runtime_error("failed to open streaming texture " + filename);
+  }
+  TextureTail tail{};
+  tail.width = static_cast<uint32_t>(texWidth);
+  tail.height = static_cast<uint32_t>(texHeight);
+  tail.mipLevels = static_cast<uint32_t>(
+      std::floor(std::log2(std::max(tail.width, tail.height))) + 1);
+
+  // only the mip tail becomes resident up front
+  tail.firstTailMip = 0;
+  while (tail.firstTailMip + 1 < tail.mipLevels &&
+         std::max(mipExtent(tail.width, tail.firstTailMip),
+                  mipExtent(tail.height, tail.firstTailMip)) >
+             TextureStreamer::kTailSize) {
+    tail.firstTailMip++;
+  }
+  tail.mips = decodeEncodedMips(encoded, filename, tail.firstTailMip,
+                                tail.mipLevels);
+  return tail;
+}
+} // namespace
+
+void TextureStreamer::OnCreate(uint32_t feedbackSlots,
+                               vk::DeviceSize budgetBytes, bool feedback,
+                               uint32_t maxTextures) {
+  assert(m_pContext != nullptr && m_pBufferPool != nullptr);
+  m_budgetBytes = budgetBytes;
+  m_feedback = feedback;
+  m_maxTextures = maxTextures;
+  // leaves a core to the render thread
+  m_pDecodePool = std::make_unique<ThreadPool>(
+      std::max(2u, std::thread::hardware_concurrency()) - 1);
+
+  // the shader writes atomicMin(requestedMip) per texture id, the cpu reads
+  // a slot back the next time the same frame slot comes around, so no copy
+  // or wait is needed to get the data
+  vk::BufferCreateInfo feedbackCreateInfo{
+      {}, getFeedbackBufferSize(), vk::BufferUsageFlagBits::eStorageBuffer};
+  VmaAllocationCreateInfo allocCreateInfo{};
+  allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+  allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                          VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+  m_feedbackBuffers.resize(feedbackSlots);
+  for (auto &feedbackBuffer : m_feedbackBuffers) {
+    feedbackBuffer =
+        m_pBufferPool->allocateMemory(feedbackCreateInfo, allocCreateInfo);
+    memset(feedbackBuffer.allocationInfo.pMappedData, 0xFF,
+           getFeedbackBufferSize());
+    vmaFlushAllocation(m_pBufferPool->getAllocator(), feedbackBuffer.allocation,
+                       0, VK_WHOLE_SIZE);
+  }
+}
+
+uint32_t TextureStreamer::registerTexture(const std::string &filename) {
+  // materials of one scene, or several scenes, often share an image
+  for (uint32_t textureId = 0; textureId < m_textures.size(); ++textureId) {
+    if (m_textures[textureId].filename == filename) {
+      return textureId;
+    }
+  }
+  if (m_textures.size() >= m_maxTextures) {
+    throw std::runtime_error("too many streaming textures");
+  }
+
+  vk::Device device = m_pContext->getDevice();
+  uint32_t textureId = static_cast<uint32_t>(m_textures.size());
+  StreamingTexture &texture = m_textures.emplace_back();
+  texture.filename = filename;
+
+  // a single white texel until the worker is done, finishReloads swaps the
+  // real tail in like it does after a change on disk
+  TextureTail placeholder{};
+  placeholder.width = 1;
+  placeholder.height = 1;
+  placeholder.mipLevels = 1;
+  placeholder.mips.push_back({0xFF, 0xFF, 0xFF, 0xFF});
+  createTailImage(texture, placeholder);
+  texture.reloading = true;
+  texture.pendingReload =
+      m_pDecodePool->submit([filename] { return decodeTail(filename); });
+
+  // the view only exposes resident mips, so the sampler never has to change
+  vk::SamplerCreateInfo samplerInfo{};
+  samplerInfo.magFilter = vk::Filter::eLinear;
+  samplerInfo.minFilter = vk::Filter::eLinear;
+  samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
+  samplerInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
+  samplerInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
+  samplerInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  texture.sampler = device.createSampler(samplerInfo);
+
+  m_residentBytes += residentBytes(texture);
+  return textureId;
+}
+
+void TextureStreamer::createTailImage(StreamingTexture &texture,
+                                      const TextureTail &tail) {
+  vk::Device device = m_pContext->getDevice();
+  texture.width = tail.width;
+  texture.height = tail.height;
+  texture.mipLevels = tail.mipLevels;
+  texture.firstTailMip = tail.firstTailMip;
+  texture.residentMip = texture.firstTailMip;
+
+  uint32_t levelCount = texture.mipLevels - texture.residentMip;
+  vk::ImageCreateInfo imageInfo{
+      {},
+      vk::ImageType::e2D,
+      kStreamingFormat,
+      {mipExtent(texture.width, texture.residentMip),
+       mipExtent(texture.height, texture.residentMip), 1},
+      levelCount,
+      1,
+      vk::SampleCountFlagBits::e1,
+      vk::ImageTiling::eOptimal,
+      vk::ImageUsageFlagBits::eTransferDst |
+          vk::ImageUsageFlagBits::eTransferSrc |
+          vk::ImageUsageFlagBits::eSampled,
+      vk::SharingMode::eExclusive};
+  imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+  VmaAllocationCreateInfo allocCreateInfo{};
+  allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  texture.image = m_pBufferPool->allocateMeomryForImage(imageInfo, allocCreateInfo);
+
+  m_pResourceUploadHeap->transitionImageLayout(
+      texture.image.image, kStreamingFormat, vk::ImageLayout::eUndefined,
+      vk::ImageLayout::eTransferDstOptimal, 0, levelCount);
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    uint32_t mip = texture.residentMip + level;
+    const auto &pixels = tail.mips[level];
+    m_pResourceUploadHeap->uploadImageData(
+        pixels.data(), static_cast<uint32_t>(pixels.size()),
+        mipExtent(texture.width, mip), mipExtent(texture.height, mip),
+        texture.image.image, texture.image.allocation, level);
+  }
+  m_pResourceUploadHeap->transitionImageLayout(
+      texture.image.image, kStreamingFormat,
+      vk::ImageLayout::eTransferDstOptimal,
+      vk::ImageLayout::eShaderReadOnlyOptimal, 0, levelCount);
+
+  vk::ImageViewCreateInfo viewInfo{
+      {},
+      texture.image.image,
+      vk::ImageViewType::e2D,
+      kStreamingFormat,
+      {},
+      {vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1}};
+  texture.view = device.createImageView(viewInfo);
+}
+
+bool TextureStreamer::reloadTexture(const std::string &filename) {
+  bool found = false;
+  for (auto &texture : m_textures) {
+    std::error_code ec;
+    if (std::filesystem::equivalent(texture.filename, filename, ec)) {
+      texture.reloadRequested = true;
+      found = true;
+    }
+  }
+  return found;
+}
+
+TextureFeedbackPushConstants
+TextureStreamer::getPushConstants(uint32_t textureId) const {
+  const StreamingTexture &texture = m_textures[textureId];
+  return TextureFeedbackPushConstants{static_cast<float>(texture.width),
+                                      static_cast<float>(texture.height),
+                                      textureId, 0};
+}
+
+void TextureStreamer::OnUpdate(uint32_t slot, vk::CommandBuffer cmd) {
+  m_frameCounter++;
+  m_changedTextures.clear();
+
+  releaseRetired(false);
+  readFeedback(slot);
+  scheduleReloads();
+  finishReloads();
+  scheduleLoads();
+  finishLoads(cmd);
+}
+
+void TextureStreamer::scheduleReloads() {
+  for (auto &texture : m_textures) {
+    // a mip load of the old file finishes first, then gets replaced
+    if (!texture.reloadRequested || texture.reloading || texture.loading) {
+      continue;
+    }
+    texture.reloadRequested = false;
+    texture.reloading = true;
+    texture.pendingReload = m_pDecodePool->submit(
+        [filename = texture.filename] { return decodeTail(filename); });
+  }
+}
+
+void TextureStreamer::finishReloads() {
+  for (uint32_t textureId = 0; textureId < m_textures.size(); ++textureId) {
+    StreamingTexture &texture = m_textures[textureId];
+    if (!texture.reloading ||
+        texture.pendingReload.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+      continue;
+    }
+    texture.reloading = false;
+    TextureTail tail;
+    try {
+      tail = texture.pendingReload.get();
+    } catch (const std::exception &e) {
+      // a reload most likely caught the file half written, the next write
+      // triggers again; a texture that never loaded keeps its placeholder
+      if (!texture.tailLoaded) {
+        std::cerr << "Warning: " << e.what() << std::endl;
+      }
+      continue;
+    }
+    texture.tailLoaded = true;
+
+    // the old image may still be referenced by a recorded frame
+    m_residentBytes -= residentBytes(texture);
+    m_retired.push_back({texture.image, texture.view, {}, m_frameCounter});
+    for (uint32_t mip = 0; mip < texture.mipLevels; ++mip) {
+      auto it = m_lruLookup.find(makeTexturePageId(textureId, mip));
+      if (it != m_lruLookup.end()) {
+        m_lru.erase(it->second);
+        m_lruLookup.erase(it);
+      }
+    }
+
+    // the cached chain belongs to the old file
+    if (texture.decoded) {
+      m_decodedBytes -= chainBytes(*texture.decoded);
+      texture.decoded.reset();
+    }
+
+    createTailImage(texture, tail);
+    m_residentBytes += residentBytes(texture);
+    m_changedTextures.push_back(textureId);
+  }
+}
+
+void TextureStreamer::readFeedback(uint32_t slot) {
+  BufferWrapper &feedbackBuffer = m_feedbackBuffers[slot];
+  VmaAllocator allocator = m_pBufferPool->getAllocator();
+  vmaInvalidateAllocation(allocator, feedbackBuffer.allocation, 0,
+                          VK_WHOLE_SIZE);
+
+  uint32_t *requests =
+      static_cast<uint32_t *>(feedbackBuffer.allocationInfo.pMappedData);
+  for (uint32_t textureId = 0; textureId < m_textures.size(); ++textureId) {
+    StreamingTexture &texture = m_textures[textureId];
+    if (!m_feedback) {
+      // nothing is written back, so everything asks for full resolution
+      requests[textureId] = 0;
+    }
+    if (requests[textureId] == UINT32_MAX) {
+      // not sampled last frame, its pages age in the cache
+      texture.requestedMip = UINT32_MAX;
+      continue;
+    }
+    texture.requestedMip =
+        std::min(requests[textureId], texture.firstTailMip);
+
+    // every page from the request up to the tail is in use this frame
+    for (uint32_t mip = std::max(texture.requestedMip, texture.residentMip);
+         mip < texture.firstTailMip; ++mip) {
+      touchPage(makeTexturePageId(textureId, mip));
+    }
+  }
+
+  // reset the slot for the frame that is about to be recorded into it
+  memset(requests, 0xFF, getFeedbackBufferSize());
+  vmaFlushAllocation(allocator, feedbackBuffer.allocation, 0, VK_WHOLE_SIZE);
+}
+
+void TextureStreamer::scheduleLoads() {
+  for (auto &texture : m_textures) {
+    if (texture.loading || texture.reloading || texture.reloadRequested ||
+        texture.requestedMip >= texture.residentMip) {
+      continue;
+    }
+    texture.loading = true;
+    texture.pendingMip = texture.requestedMip;
+    if (texture.decoded) {
+      std::promise<std::shared_ptr<const MipChain>> cached;
+      cached.set_value(texture.decoded);
+      texture.pendingMips = cached.get_future();
+    } else {
+      texture.pendingMips = m_pDecodePool->submit(
+          [filename = texture.filename, firstTailMip = texture.firstTailMip] {
+            return decodeStreamedMips(filename, firstTailMip);
+          });
+    }
+  }
+}
+
+void TextureStreamer::finishLoads(vk::CommandBuffer cmd) {
+  uint32_t uploads = 0;
+  for (uint32_t textureId = 0;
+       textureId < m_textures.size() && uploads < kMaxUploadsPerUpdate;
+       ++textureId) {
+    StreamingTexture &texture = m_textures[textureId];
+    if (!texture.loading ||
+        texture.pendingMips.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+      continue;
+    }
+    texture.loading = false;
+    std::shared_ptr<const MipChain> mips = texture.pendingMips.get();
+    if (texture.decoded != mips) {
+      if (texture.decoded) {
+        m_decodedBytes -= chainBytes(*texture.decoded);
+      }
+      texture.decoded = mips;
+      m_decodedBytes += chainBytes(*mips);
+    }
+    texture.decodedFrame = m_frameCounter;
+    trimDecodedCache(textureId);
+
+    // the texture may have been evicted further while the mips were decoded
+    if (texture.pendingMip >= texture.residentMip) {
+      continue;
+    }
+    uint32_t uploadedEnd = std::min(
+        texture.residentMip, static_cast<uint32_t>(mips->size()));
+    std::span<const std::vector<uint8_t>> newMips(
+        mips->data() + texture.pendingMip, uploadedEnd - texture.pendingMip);
+
+    vk::DeviceSize incomingBytes = 0;
+    for (uint32_t mip = texture.pendingMip; mip < uploadedEnd; ++mip) {
+      incomingBytes += mipBytes(texture, mip);
+    }
+    evictToBudget(cmd, incomingBytes, textureId);
+    setResidentMip(cmd, textureId, texture.pendingMip, newMips);
+    for (uint32_t mip = texture.residentMip; mip < texture.firstTailMip; ++mip) {
+      touchPage(makeTexturePageId(textureId, mip));
+    }
+    uploads++;
+  }
+}
+
+void TextureStreamer::trimDecodedCache(uint32_t protectedTexture) {
+  while (m_decodedBytes > kDecodedCacheBytes) {
+    StreamingTexture *oldest = nullptr;
+    for (uint32_t textureId = 0; textureId < m_textures.size(); ++textureId) {
+      StreamingTexture &texture = m_textures[textureId];
+      if (textureId != protectedTexture && texture.decoded &&
+          (oldest == nullptr || texture.decodedFrame < oldest->decodedFrame)) {
+        oldest = &texture;
+      }
+    }
+    if (oldest == nullptr) {
+      return;
+    }
+    m_decodedBytes -= chainBytes(*oldest->decoded);
+    oldest->decoded.reset();
+  }
+}
+
+void TextureStreamer::evictToBudget(vk::CommandBuffer cmd,
+                                    vk::DeviceSize incomingBytes,
+                                    uint32_t protectedTexture) {
+  size_t inspected = 0;
+  while (m_residentBytes + incomingBytes > m_budgetBytes && !m_lru.empty() &&
+         inspected < m_lru.size()) {
+    TexturePageId page = m_lru.front();
+    uint32_t textureId = page >> 8;
+    uint32_t mip = page & 0xFF;
+    if (textureId == protectedTexture) {
+      m_lru.splice(m_lru.end(), m_lru, m_lru.begin());
+      inspected++;
+      continue;
+    }
+
+    // dropping a page also drops every higher resolution page of that texture
+    setResidentMip(cmd, textureId, mip + 1, {});
+    inspected = 0;
+  }
+}
+
+// The copies are recorded into the frame's command buffer ahead of its
+// render pass, so a residency change costs no submit or wait of its own; the
+// replaced image and the staging buffer are released once that frame can no
+// longer be in flight.
+void TextureStreamer::setResidentMip(
+    vk::CommandBuffer cmd, uint32_t textureId, uint32_t newResidentMip,
+    std::span<const std::vector<uint8_t>> newMips) {
+  StreamingTexture &texture = m_textures[textureId];
+  if (newResidentMip == texture.residentMip) {
+    return;
+  }
+
+  vk::Device device = m_pContext->getDevice();
+  uint32_t oldResidentMip = texture.residentMip;
+  uint32_t levelCount = texture.mipLevels - newResidentMip;
+  vk::DeviceSize oldBytes = residentBytes(texture);
+
+  vk::ImageCreateInfo imageInfo{
+      {},
+      vk::ImageType::e2D,
+      kStreamingFormat,
+      {mipExtent(texture.width, newResidentMip),
+       mipExtent(texture.height, newResidentMip), 1},
+      levelCount,
+      1,
+      vk::SampleCountFlagBits::e1,
+      vk::ImageTiling::eOptimal,
+      vk::ImageUsageFlagBits::eTransferDst |
+          vk::ImageUsageFlagBits::eTransferSrc |
+          vk::ImageUsageFlagBits::eSampled,
+      vk::SharingMode::eExclusive};
+  imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+  VmaAllocationCreateInfo allocCreateInfo{};
+  allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  ImageWrapper newImage =
+      m_pBufferPool->allocateMeomryForImage(imageInfo, allocCreateInfo);
+
+  // stage the freshly decoded mips in one buffer
+  BufferWrapper stagingBuffer{};
+  if (!newMips.empty()) {
+    vk::DeviceSize stagingSize = 0;
+    for (const auto &mip : newMips) {
+      stagingSize += mip.size();
+    }
+    vk::BufferCreateInfo stagingCreateInfo{
+        {}, stagingSize, vk::BufferUsageFlagBits::eTransferSrc};
+    VmaAllocationCreateInfo stagingAllocCreateInfo{};
+    stagingAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    stagingAllocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    stagingBuffer =
+        m_pBufferPool->allocateMemory(stagingCreateInfo, stagingAllocCreateInfo);
+    uint8_t *mapped =
+        static_cast<uint8_t *>(stagingBuffer.allocationInfo.pMappedData);
+    for (const auto &mip : newMips) {
+      memcpy(mapped, mip.data(), mip.size());
+      mapped += mip.size();
+    }
+  }
+
+  {
+    std::array<vk::ImageMemoryBarrier, 2> barriers{};
+    barriers[0].srcAccessMask = {};
+    barriers[0].dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barriers[0].oldLayout = vk::ImageLayout::eUndefined;
+    barriers[0].newLayout = vk::ImageLayout::eTransferDstOptimal;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = newImage.image;
+    barriers[0].subresourceRange = {vk::ImageAspectFlagBits::eColor, 0,
+                                    levelCount, 0, 1};
+
+    // the old image may itself have been written earlier in this command
+    // buffer, when an eviction and a load hit the same texture
+    barriers[1].srcAccessMask =
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferWrite;
+    barriers[1].dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    barriers[1].oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    barriers[1].newLayout = vk::ImageLayout::eTransferSrcOptimal;
+    barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].image = texture.image.image;
+    barriers[1].subresourceRange = {vk::ImageAspectFlagBits::eColor, 0,
+                                    texture.mipLevels - oldResidentMip, 0, 1};
+
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader |
+                            vk::PipelineStageFlagBits::eTransfer |
+                            vk::PipelineStageFlagBits::eTopOfPipe,
+                        vk::PipelineStageFlagBits::eTransfer, {}, nullptr,
+                        nullptr, barriers);
+  }
+
+  // keep every mip both images have in common
+  std::vector<vk::ImageCopy> copies;
+  for (uint32_t mip = std::max(newResidentMip, oldResidentMip);
+       mip < texture.mipLevels; ++mip) {
+    vk::ImageCopy copy{};
+    copy.srcSubresource = {vk::ImageAspectFlagBits::eColor,
+                           mip - oldResidentMip, 0, 1};
+    copy.dstSubresource = {vk::ImageAspectFlagBits::eColor,
+                           mip - newResidentMip, 0, 1};
+    copy.extent = vk::Extent3D{mipExtent(texture.width, mip),
+                               mipExtent(texture.height, mip), 1};
+    copies.push_back(copy);
+  }
+  cmd.copyImage(texture.image.image, vk::ImageLayout::eTransferSrcOptimal,
+                newImage.image, vk::ImageLayout::eTransferDstOptimal, copies);
+
+  if (!newMips.empty()) {
+    std::vector<vk::BufferImageCopy> regions;
+    vk::DeviceSize bufferOffset = 0;
+    for (uint32_t i = 0; i < newMips.size(); ++i) {
+      uint32_t mip = newResidentMip + i;
+      vk::BufferImageCopy region{};
+      region.bufferOffset = bufferOffset;
+      region.imageSubresource = {vk::ImageAspectFlagBits::eColor,
+                                 mip - newResidentMip, 0, 1};
+      region.imageExtent = vk::Extent3D{mipExtent(texture.width, mip),
+                                        mipExtent(texture.height, mip), 1};
+      regions.push_back(region);
+      bufferOffset += newMips[i].size();
+    }
+    cmd.copyBufferToImage(stagingBuffer.buffer, newImage.image,
+                          vk::ImageLayout::eTransferDstOptimal, regions);
+  }
+
+  {
+    vk::ImageMemoryBarrier barrier{};
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = newImage.image;
+    barrier.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, levelCount,
+                                0, 1};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr,
+                        nullptr, barrier);
+  }
+
+  // the old image may still be referenced by a recorded frame, and both it
+  // and the staging buffer are read by this one
+  m_retired.push_back(
+      {texture.image, texture.view, stagingBuffer, m_frameCounter});
+
+  texture.image = newImage;
+  texture.residentMip = newResidentMip;
+  vk::ImageViewCreateInfo viewInfo{
+      {},
+      texture.image.image,
+      vk::ImageViewType::e2D,
+      kStreamingFormat,
+      {},
+      {vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1}};
+  texture.view = device.createImageView(viewInfo);
+
+  m_residentBytes = m_residentBytes - oldBytes + residentBytes(texture);
+  m_changedTextures.push_back(textureId);
+
+  // pages above the new resident mip are gone
+  for (uint32_t mip = oldResidentMip; mip < newResidentMip; ++mip) {
+    auto it = m_lruLookup.find(makeTexturePageId(textureId, mip));
+    if (it != m_lruLookup.end()) {
+      m_lru.erase(it->second);
+      m_lruLookup.erase(it);
+    }
+  }
+}
+
+void TextureStreamer::touchPage(TexturePageId page) {
+  auto it = m_lruLookup.find(page);
+  if (it != m_lruLookup.end()) {
+    m_lru.splice(m_lru.end(), m_lru, it->second);
+    return;
+  }
+  m_lru.push_back(page);
+  m_lruLookup[page] = std::prev(m_lru.end());
+}
+
+void TextureStreamer::releaseRetired(bool all) {
+  vk::Device device = m_pContext->getDevice();
+  auto it = m_retired.begin();
+  while (it != m_retired.end()) {
+    if (all || m_frameCounter - it->retiredFrame >= m_feedbackBuffers.size()) {
+      device.destroyImageView(it->view);
+      m_pBufferPool->freeImage(it->image);
+      if (it->staging.buffer) {
+        m_pBufferPool->freeBuffer(it->staging);
+      }
+      it = m_retired.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+vk::DeviceSize TextureStreamer::mipBytes(const StreamingTexture &texture,
+                                         uint32_t mipLevel) const {
+  return static_cast<vk::DeviceSize>(mipExtent(texture.width, mipLevel)) *
+         mipExtent(texture.height, mipLevel) * 4;
+}
+
+vk::DeviceSize
+TextureStreamer::residentBytes(const StreamingTexture &texture) const {
+  vk::DeviceSize bytes = 0;
+  for (uint32_t mip = texture.residentMip; mip < texture.mipLevels; ++mip) {
+    bytes += mipBytes(texture, mip);
+  }
+  return bytes;
+}
+
+void TextureStreamer::OnDestroy() {
+  vk::Device device = m_pContext->getDevice();
+  for (auto &texture : m_textures) {
+    if (texture.loading) {
+      texture.pendingMips.wait();
+    }
+    if (texture.reloading) {
+      texture.pendingReload.wait();
+    }
+    device.destroyImageView(texture.view);
+    device.destroySampler(texture.sampler);
+    m_pBufferPool->freeImage(texture.image);
+  }
+  m_textures.clear();
+  m_pDecodePool.reset();
+  m_decodedBytes = 0;
+  releaseRetired(true);
+
+  for (const auto &feedbackBuffer : m_feedbackBuffers) {
+    m_pBufferPool->freeBuffer(feedbackBuffer);
+  }
+  m_feedbackBuffers.clear();
+  m_lru.clear();
+  m_lruLookup.clear();
+}
+} // namespace hiddenpiggy
@@ -5,36 +5,24 @@
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_handles.hpp"
 #include "vulkan/vulkan_structs.hpp"
+#include "AccessorDecoder.hpp"
+#include "AnimationCompressor.hpp"
+#include "GltfFileSystem.hpp"
+#include "SimdMath.hpp"
+#include "ThreadPool.hpp"
+#include "stb_image.h"
 #include <iostream>
+#include <stdexcept>
 namespace hiddenpiggy {
+namespace vkglTF {
 
 BoundingBox::BoundingBox() {}
 BoundingBox::BoundingBox(glm::vec3 min, glm::vec3 max) : min(min), max(max){};
 
 BoundingBox BoundingBox::getAABB(glm::mat4 m) {
-  glm::vec3 min = glm::vec3(m[3]);
-  glm::vec3 max = min;
-  glm::vec3 v0, v1;
-
-  glm::vec3 right = glm::vec3(m[0]);
-  v0 = right * this->min.x;
-  v1 = right * this->max.x;
-  min += glm::min(v0, v1);
-  max += glm::max(v0, v1);
-
-  glm::vec3 up = glm::vec3(m[1]);
-  v0 = up * this->min.y;
-  v1 = up * this->max.y;
-  min += glm::min(v0, v1);
-  max += glm::max(v0, v1);
-
-  glm::vec3 back = glm::vec3(m[2]);
-  v0 = back * this->min.z;
-  v1 = back * this->max.z;
-  min += glm::min(v0, v1);
-  max += glm::max(v0, v1);
-
-  return BoundingBox(min, max);
+  glm::vec3 outMin, outMax;
+  SimdMath::transformAabbs(&m, &min, &max, &outMin, &outMax, 1);
+  return BoundingBox(outMin, outMax);
 }
 
 // Texture
@@ -420,48 +408,33 @@ void glTFMesh::setBoundingBox(glm::vec3 min, glm::vec3 max) {
 }
 
 // Node
-glm::mat4 Node::localMatrix() {
-  return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) *
-         glm::scale(glm::mat4(1.0f), scale) * matrix;
-}
-
-glm::mat4 Node::getMatrix() {
-  glm::mat4 m = localMatrix();
-  Node *p = parent;
-  while (p) {
-    m = p->localMatrix() * m;
-    p = p->parent;
-  }
-  return m;
+const glm::mat4 &Node::getMatrix() const {
+  return transforms->getWorldMatrix(index);
 }
 
 void Node::update() {
-  if (mesh) {
-    glm::mat4 m = getMatrix();
-    if (skin) {
-      mesh->uniformBlock.matrix = m;
-
-      // Update join matrices
-      glm::mat4 inverseTransform = glm::inverse(m);
-      size_t numJoints =
-          std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
-      for (size_t i = 0; i < numJoints; ++i) {
-        Node *jointNode = skin->joints[i];
-        glm::mat4 jointMat =
-            jointNode->getMatrix() * skin->inverseBindMatrices[i];
-        jointMat = inverseTransform * jointMat;
-        mesh->uniformBlock.jointMatrix[i] = jointMat;
-      }
-      mesh->uniformBlock.jointcount = (float)numJoints;
-      memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock,
-             sizeof(mesh->uniformBlock));
-    } else {
-      memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
-    }
+  if (!mesh) {
+    return;
   }
-
-  for (auto &child : children) {
-    child->update();
+  const glm::mat4 &m = getMatrix();
+  if (skin) {
+    mesh->uniformBlock.matrix = m;
+
+    // Update join matrices
+    glm::mat4 inverseTransform = glm::inverse(m);
+    size_t numJoints = std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
+    for (size_t i = 0; i < numJoints; ++i) {
+      Node *jointNode = skin->joints[i];
+      glm::mat4 jointMat =
+          jointNode->getMatrix() * skin->inverseBindMatrices[i];
+      jointMat = inverseTransform * jointMat;
+      mesh->uniformBlock.jointMatrix[i] = jointMat;
+    }
+    mesh->uniformBlock.jointcount = (float)numJoints;
+    memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock,
+           sizeof(mesh->uniformBlock));
+  } else {
+    memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
   }
 }
 
@@ -499,9 +472,12 @@ void glTFModel::destroy(vk::Device device) {
     delete node;
   }
   materials.resize(0);
-  animations.resize(0);
+  animationLibrary.clear();
+  animationPlayer = AnimationPlayer{};
   nodes.resize(0);
   linearNodes.resize(0);
+  nodeTable.resize(0);
+  transforms.clear();
   extensions.resize(0);
   for (auto skin : skins) {
     delete skin;
@@ -517,27 +493,8 @@ void glTFModel::loadNode(Node *parent, const tinygltf::Node &node,
   newNode->parent = parent;
   newNode->name = node.name;
   newNode->skinIndex = node.skin;
-  newNode->matrix = glm::mat4(1.0f);
-
-  // Generate local node matrix
-  glm::vec3 translation = glm::vec3(0.0f);
-  if (node.translation.size() == 3) {
-    translation = glm::make_vec3(node.translation.data());
-    newNode->translation = translation;
-  }
-  glm::mat4 rotation = glm::mat4(1.0f);
-  if (node.rotation.size() == 4) {
-    glm::quat q = glm::make_quat(node.rotation.data());
-    newNode->rotation = glm::mat4(q);
-  }
-  glm::vec3 scale = glm::vec3(1.0f);
-  if (node.scale.size() == 3) {
-    scale = glm::make_vec3(node.scale.data());
-    newNode->scale = scale;
-  }
-  if (node.matrix.size() == 16) {
-    newNode->matrix = glm::make_mat4x4(node.matrix.data());
-  };
+  newNode->transforms = &transforms;
+  nodeTable[nodeIndex] = newNode;
 
   // Node with children
   if (node.children.size() > 0) {
@@ -547,261 +504,20 @@ void glTFModel::loadNode(Node *parent, const tinygltf::Node &node,
     }
   }
 
-  // Node contains mesh data
+  // Node contains mesh data, already decoded by the parallel pass
   if (node.mesh > -1) {
-    const tinygltf::Mesh mesh = model.meshes[node.mesh];
-    glTFMesh *newMesh = new glTFMesh(context, bufferPool, newNode->matrix);
+    const tinygltf::Mesh &mesh = model.meshes[node.mesh];
+    glTFMesh *newMesh = new glTFMesh(context, bufferPool, glm::mat4(1.0f));
     for (size_t j = 0; j < mesh.primitives.size(); j++) {
       const tinygltf::Primitive &primitive = mesh.primitives[j];
-      uint32_t vertexStart = static_cast<uint32_t>(loaderInfo.vertexPos);
-      uint32_t indexStart = static_cast<uint32_t>(loaderInfo.indexPos);
-      uint32_t indexCount = 0;
-      uint32_t vertexCount = 0;
-      glm::vec3 posMin{};
-      glm::vec3 posMax{};
-      bool hasSkin = false;
-      bool hasIndices = primitive.indices > -1;
-      // Vertices
-      {
-        const float *bufferPos = nullptr;
-        const float *bufferNormals = nullptr;
-        const float *bufferTexCoordSet0 = nullptr;
-        const float *bufferTexCoordSet1 = nullptr;
-        const float *bufferColorSet0 = nullptr;
-        const void *bufferJoints = nullptr;
-        const float *bufferWeights = nullptr;
-
-        int posByteStride;
-        int normByteStride;
-        int uv0ByteStride;
-        int uv1ByteStride;
-        int color0ByteStride;
-        int jointByteStride;
-        int weightByteStride;
-
-        int jointComponentType;
-
-        // Position attribute is required
-        assert(primitive.attributes.find("POSITION") !=
-               primitive.attributes.end());
-
-        const tinygltf::Accessor &posAccessor =
-            model.accessors[primitive.attributes.find("POSITION")->second];
-        const tinygltf::BufferView &posView =
-            model.bufferViews[posAccessor.bufferView];
-        bufferPos = reinterpret_cast<const float *>(
-            &(model.buffers[posView.buffer]
-                  .data[posAccessor.byteOffset + posView.byteOffset]));
-        posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1],
-                           posAccessor.minValues[2]);
-        posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1],
-                           posAccessor.maxValues[2]);
-        vertexCount = static_cast<uint32_t>(posAccessor.count);
-        posByteStride =
-            posAccessor.ByteStride(posView)
-                ? (posAccessor.ByteStride(posView) / sizeof(float))
-                : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
-
-        if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-          const tinygltf::Accessor &normAccessor =
-              model.accessors[primitive.attributes.find("NORMAL")->second];
-          const tinygltf::BufferView &normView =
-              model.bufferViews[normAccessor.bufferView];
-          bufferNormals = reinterpret_cast<const float *>(
-              &(model.buffers[normView.buffer]
-                    .data[normAccessor.byteOffset + normView.byteOffset]));
-          normByteStride =
-              normAccessor.ByteStride(normView)
-                  ? (normAccessor.ByteStride(normView) / sizeof(float))
-                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
-        }
-
-        // UVs
-        if (primitive.attributes.find("TEXCOORD_0") !=
-            primitive.attributes.end()) {
-          const tinygltf::Accessor &uvAccessor =
-              model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-          const tinygltf::BufferView &uvView =
-              model.bufferViews[uvAccessor.bufferView];
-          bufferTexCoordSet0 = reinterpret_cast<const float *>(
-              &(model.buffers[uvView.buffer]
-                    .data[uvAccessor.byteOffset + uvView.byteOffset]));
-          uv0ByteStride =
-              uvAccessor.ByteStride(uvView)
-                  ? (uvAccessor.ByteStride(uvView) / sizeof(float))
-                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC2);
-        }
-        if (primitive.attributes.find("TEXCOORD_1") !=
-            primitive.attributes.end()) {
-          const tinygltf::Accessor &uvAccessor =
-              model.accessors[primitive.attributes.find("TEXCOORD_1")->second];
-          const tinygltf::BufferView &uvView =
-              model.bufferViews[uvAccessor.bufferView];
-          bufferTexCoordSet1 = reinterpret_cast<const float *>(
-              &(model.buffers[uvView.buffer]
-                    .data[uvAccessor.byteOffset + uvView.byteOffset]));
-          uv1ByteStride =
-              uvAccessor.ByteStride(uvView)
-                  ? (uvAccessor.ByteStride(uvView) / sizeof(float))
-                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC2);
-        }
-
-        // Vertex colors
-        if (primitive.attributes.find("COLOR_0") !=
-            primitive.attributes.end()) {
-          const tinygltf::Accessor &accessor =
-              model.accessors[primitive.attributes.find("COLOR_0")->second];
-          const tinygltf::BufferView &view =
-              model.bufferViews[accessor.bufferView];
-          bufferColorSet0 = reinterpret_cast<const float *>(
-              &(model.buffers[view.buffer]
-                    .data[accessor.byteOffset + view.byteOffset]));
-          color0ByteStride =
-              accessor.ByteStride(view)
-                  ? (accessor.ByteStride(view) / sizeof(float))
-                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
-        }
-
-        // Skinning
-        // Joints
-        if (primitive.attributes.find("JOINTS_0") !=
-            primitive.attributes.end()) {
-          const tinygltf::Accessor &jointAccessor =
-              model.accessors[primitive.attributes.find("JOINTS_0")->second];
-          const tinygltf::BufferView &jointView =
-              model.bufferViews[jointAccessor.bufferView];
-          bufferJoints =
-              &(model.buffers[jointView.buffer]
-                    .data[jointAccessor.byteOffset + jointView.byteOffset]);
-          jointComponentType = jointAccessor.componentType;
-          jointByteStride =
-              jointAccessor.ByteStride(jointView)
-                  ? (jointAccessor.ByteStride(jointView) /
-                     tinygltf::GetComponentSizeInBytes(jointComponentType))
-                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4);
-        }
-
-        if (primitive.attributes.find("WEIGHTS_0") !=
-            primitive.attributes.end()) {
-          const tinygltf::Accessor &weightAccessor =
-              model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-          const tinygltf::BufferView &weightView =
-              model.bufferViews[weightAccessor.bufferView];
-          bufferWeights = reinterpret_cast<const float *>(
-              &(model.buffers[weightView.buffer]
-                    .data[weightAccessor.byteOffset + weightView.byteOffset]));
-          weightByteStride =
-              weightAccessor.ByteStride(weightView)
-                  ? (weightAccessor.ByteStride(weightView) / sizeof(float))
-                  : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC4);
-        }
-
-        hasSkin = (bufferJoints && bufferWeights);
-
-        for (size_t v = 0; v < posAccessor.count; v++) {
-          Vertex &vert = loaderInfo.vertexBuffer[loaderInfo.vertexPos];
-          vert.pos =
-              glm::vec4(glm::make_vec3(&bufferPos[v * posByteStride]), 1.0f);
-          vert.normal = glm::normalize(glm::vec3(
-              bufferNormals ? glm::make_vec3(&bufferNormals[v * normByteStride])
-                            : glm::vec3(0.0f)));
-          vert.uv0 =
-              bufferTexCoordSet0
-                  ? glm::make_vec2(&bufferTexCoordSet0[v * uv0ByteStride])
-                  : glm::vec3(0.0f);
-          vert.uv1 =
-              bufferTexCoordSet1
-                  ? glm::make_vec2(&bufferTexCoordSet1[v * uv1ByteStride])
-                  : glm::vec3(0.0f);
-          vert.color =
-              bufferColorSet0
-                  ? glm::make_vec4(&bufferColorSet0[v * color0ByteStride])
-                  : glm::vec4(1.0f);
-
-          if (hasSkin) {
-            switch (jointComponentType) {
-            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
-              const uint16_t *buf = static_cast<const uint16_t *>(bufferJoints);
-              vert.joint0 =
-                  glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
-              break;
-            }
-            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
-              const uint8_t *buf = static_cast<const uint8_t *>(bufferJoints);
-              vert.joint0 =
-                  glm::vec4(glm::make_vec4(&buf[v * jointByteStride]));
-              break;
-            }
-            default:
-              // Not supported by spec
-              std::cerr << "Joint component type " << jointComponentType
-                        << " not supported!" << std::endl;
-              break;
-            }
-          } else {
-            vert.joint0 = glm::vec4(0.0f);
-          }
-          vert.weight0 =
-              hasSkin ? glm::make_vec4(&bufferWeights[v * weightByteStride])
-                      : glm::vec4(0.0f);
-          // Fix for all zero weights
-          if (glm::length(vert.weight0) == 0.0f) {
-            vert.weight0 = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
-          }
-          loaderInfo.vertexPos++;
-        }
-      }
-      // Indices
-      if (hasIndices) {
-        const tinygltf::Accessor &accessor =
-            model.accessors[primitive.indices > -1 ? primitive.indices : 0];
-        const tinygltf::BufferView &bufferView =
-            model.bufferViews[accessor.bufferView];
-        const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
-
-        indexCount = static_cast<uint32_t>(accessor.count);
-        const void *dataPtr =
-            &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
-
-        switch (accessor.componentType) {
-        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-          const uint32_t *buf = static_cast<const uint32_t *>(dataPtr);
-          for (size_t index = 0; index < accessor.count; index++) {
-            loaderInfo.indexBuffer[loaderInfo.indexPos] =
-                buf[index] + vertexStart;
-            loaderInfo.indexPos++;
-          }
-          break;
-        }
-        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-          const uint16_t *buf = static_cast<const uint16_t *>(dataPtr);
-          for (size_t index = 0; index < accessor.count; index++) {
-            loaderInfo.indexBuffer[loaderInfo.indexPos] =
-                buf[index] + vertexStart;
-            loaderInfo.indexPos++;
-          }
-          break;
-        }
-        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-          const uint8_t *buf = static_cast<const uint8_t *>(dataPtr);
-          for (size_t index = 0; index < accessor.count; index++) {
-            loaderInfo.indexBuffer[loaderInfo.indexPos] =
-                buf[index] + vertexStart;
-            loaderInfo.indexPos++;
-          }
-          break;
-        }
-        default:
-          std::cerr << "Index component type " << accessor.componentType
-                    << " not supported!" << std::endl;
-          return;
-        }
-      }
+      const PrimitiveRange &range =
+          loaderInfo.primitives[loaderInfo.primitivePos++];
+      assert(range.primitive == &primitive);
       Primitive *newPrimitive =
-          new Primitive(indexStart, indexCount, vertexCount,
+          new Primitive(range.indexStart, range.indexCount, range.vertexCount,
                         primitive.material > -1 ? materials[primitive.material]
                                                 : materials.back());
-      newPrimitive->setBoundingBox(posMin, posMax);
+      newPrimitive->setBoundingBox(range.min, range.max);
       newMesh->primitives.push_back(newPrimitive);
     }
     // Mesh BB from BBs of primitives
@@ -824,23 +540,164 @@ void glTFModel::loadNode(Node *parent, const tinygltf::Node &node,
 }
 
 void glTFModel::getNodeProps(const tinygltf::Node &node,
-                             const tinygltf::Model &model, size_t &vertexCount,
-                             size_t &indexCount) {
+                             const tinygltf::Model &model,
+                             LoaderInfo &loaderInfo) {
   if (node.children.size() > 0) {
     for (size_t i = 0; i < node.children.size(); i++) {
-      getNodeProps(model.nodes[node.children[i]], model, vertexCount,
-                   indexCount);
+      getNodeProps(model.nodes[node.children[i]], model, loaderInfo);
     }
   }
   if (node.mesh > -1) {
-    const tinygltf::Mesh mesh = model.meshes[node.mesh];
+    const tinygltf::Mesh &mesh = model.meshes[node.mesh];
     for (size_t i = 0; i < mesh.primitives.size(); i++) {
-      auto primitive = mesh.primitives[i];
-      vertexCount +=
-          model.accessors[primitive.attributes.find("POSITION")->second].count;
-      if (primitive.indices > -1) {
-        indexCount += model.accessors[primitive.indices].count;
+      const tinygltf::Primitive &primitive = mesh.primitives[i];
+      // Position attribute is required
+      assert(primitive.attributes.find("POSITION") !=
+             primitive.attributes.end());
+
+      // hand out the next free ranges of the shared arrays
+      PrimitiveRange range{};
+      range.primitive = &primitive;
+      range.vertexCount = static_cast<uint32_t>(
+          model.accessors[primitive.attributes.find("POSITION")->second]
+              .count);
+      range.indexCount =
+          primitive.indices > -1
+              ? static_cast<uint32_t>(model.accessors[primitive.indices].count)
+              : 0;
+      if (!loaderInfo.primitives.empty()) {
+        const PrimitiveRange &last = loaderInfo.primitives.back();
+        range.vertexStart = last.vertexStart + last.vertexCount;
+        range.indexStart = last.indexStart + last.indexCount;
       }
+      loaderInfo.primitives.push_back(range);
+    }
+  }
+}
+
+// Runs on a worker thread. Only touches the primitive's own range of the
+// shared vertex and index arrays.
+void glTFModel::loadPrimitive(const tinygltf::Model &model,
+                              PrimitiveRange &range, LoaderInfo &loaderInfo) {
+  const tinygltf::Primitive &primitive = *range.primitive;
+  Vertex *vertices = loaderInfo.vertexBuffer + range.vertexStart;
+
+  for (uint32_t v = 0; v < range.vertexCount; v++) {
+    vertices[v] = Vertex{glm::vec3(0.0f), glm::vec3(0.0f), glm::vec2(0.0f),
+                         glm::vec2(0.0f), glm::vec4(0.0f), glm::vec4(0.0f),
+                         glm::vec4(1.0f)};
+  }
+
+  auto decode = [&](const char *name, uint32_t components, void *dst) {
+    auto it = primitive.attributes.find(name);
+    if (it == primitive.attributes.end()) {
+      return false;
+    }
+    const tinygltf::Accessor &accessor = model.accessors[it->second];
+    if (accessor.count < range.vertexCount) {
+      throw std::runtime_error(std::string("attribute too short: ") + name);
+    }
+    AccessorDecoder::decodeFloats(model, accessor, components, dst,
+                                  sizeof(Vertex));
+    return true;
+  };
+
+  decode("POSITION", 3, &vertices->pos);
+  bool hasNormals = decode("NORMAL", 3, &vertices->normal);
+  decode("TEXCOORD_0", 2, &vertices->uv0);
+  decode("TEXCOORD_1", 2, &vertices->uv1);
+  decode("COLOR_0", 4, &vertices->color);
+  bool hasSkin = primitive.attributes.count("JOINTS_0") > 0 &&
+                 primitive.attributes.count("WEIGHTS_0") > 0;
+  if (hasSkin) {
+    decode("JOINTS_0", 4, &vertices->joint0);
+    decode("WEIGHTS_0", 4, &vertices->weight0);
+  }
+
+  for (uint32_t v = 0; v < range.vertexCount; v++) {
+    Vertex &vert = vertices[v];
+    if (hasNormals) {
+      vert.normal = glm::normalize(vert.normal);
+    }
+    // Fix for all zero weights
+    if (glm::length(vert.weight0) == 0.0f) {
+      vert.weight0 = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+    }
+    range.min = glm::min(range.min, vert.pos);
+    range.max = glm::max(range.max, vert.pos);
+  }
+
+  // Indices
+  if (range.indexCount > 0) {
+    AccessorDecoder::decodeIndices(model, model.accessors[primitive.indices],
+                                   loaderInfo.indexBuffer + range.indexStart,
+                                   range.vertexStart);
+  }
+}
+
+// keep the encoded bytes, decoding is done later on the loader's workers
+static bool deferImageLoad(tinygltf::Image *image, const int imageIndex,
+                           std::string *err, std::string *warn, int reqWidth,
+                           int reqHeight, const unsigned char *bytes, int size,
+                           void *userData) {
+  image->image.assign(bytes, bytes + size);
+  image->as_is = true;
+  return true;
+}
+
+// Runs on a worker thread. Always expands to rgba8, which is what
+// fromglTFImage uploads.
+void glTFModel::decodeImage(tinygltf::Image &image) {
+  if (!image.as_is) {
+    return;
+  }
+  int width = 0;
+  int height = 0;
+  int component = 0;
+  stbi_uc *pixels = stbi_load_from_memory(
+      image.image.data(), static_cast<int>(image.image.size()), &width,
+      &height, &component, STBI_rgb_alpha);
+  if (pixels == nullptr) {
+    throw std::runtime_error("failed to decode image " + image.uri + ": " +
+                             stbi_failure_reason());
+  }
+  image.image.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+  stbi_image_free(pixels);
+  image.width = width;
+  image.height = height;
+  image.component = 4;
+  image.bits = 8;
+  image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  image.as_is = false;
+}
+
+void glTFModel::loadTransforms(const tinygltf::Model &model) {
+  std::vector<int32_t> parents(model.nodes.size(), -1);
+  for (size_t i = 0; i < model.nodes.size(); ++i) {
+    for (int child : model.nodes[i].children) {
+      if (child < 0 || static_cast<size_t>(child) >= model.nodes.size()) {
+        throw std::runtime_error("node child out of range");
+      }
+      parents[child] = static_cast<int32_t>(i);
+    }
+  }
+  transforms.build(parents);
+
+  for (size_t i = 0; i < model.nodes.size(); ++i) {
+    const tinygltf::Node &node = model.nodes[i];
+    uint32_t index = static_cast<uint32_t>(i);
+    if (node.translation.size() == 3) {
+      transforms.setTranslation(index,
+                                glm::make_vec3(node.translation.data()));
+    }
+    if (node.rotation.size() == 4) {
+      transforms.setRotation(index, glm::make_quat(node.rotation.data()));
+    }
+    if (node.scale.size() == 3) {
+      transforms.setScale(index, glm::make_vec3(node.scale.data()));
+    }
+    if (node.matrix.size() == 16) {
+      transforms.setMatrix(index, glm::make_mat4x4(node.matrix.data()));
     }
   }
 }
@@ -888,7 +745,7 @@ void glTFModel::loadTextures(tinygltf::Model &gltfModel, VkContext *context,
   vk::Device device = context->getDevice();
 
   for (tinygltf::Texture &tex : gltfModel.textures) {
-    tinygltf::Image image = gltfModel.images[tex.source];
+    tinygltf::Image &image = gltfModel.images[tex.source];
     TextureSampler textureSampler;
     if (tex.sampler == -1) {
       // No sampler specified, use a default one
@@ -1071,118 +928,79 @@ void glTFModel::loadMaterials(tinygltf::Model &gltfModel) {
 }
 
 void glTFModel::loadAnimations(tinygltf::Model &gltfModel) {
+  // keys as the file has them, compressed into animationLibrary below
+  AnimationLibrary loaded;
   for (tinygltf::Animation &anim : gltfModel.animations) {
-    Animation animation{};
-    animation.name = anim.name;
-    if (anim.name.empty()) {
-      animation.name = std::to_string(animations.size());
-    }
+    loaded.beginClip(anim.name.empty()
+                         ? std::to_string(loaded.getClips().size())
+                         : anim.name);
 
-    // Samplers
-    for (auto &samp : anim.samplers) {
-      AnimationSampler sampler{};
-
-      if (samp.interpolation == "LINEAR") {
-        sampler.interpolation = AnimationSampler::InterpolationType::LINEAR;
-      }
-      if (samp.interpolation == "STEP") {
-        sampler.interpolation = AnimationSampler::InterpolationType::STEP;
-      }
-      if (samp.interpolation == "CUBICSPLINE") {
-        sampler.interpolation =
-            AnimationSampler::InterpolationType::CUBICSPLINE;
-      }
-
-      // Read sampler input time values
-      {
-        const tinygltf::Accessor &accessor = gltfModel.accessors[samp.input];
-        const tinygltf::BufferView &bufferView =
-            gltfModel.bufferViews[accessor.bufferView];
-        const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-        assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-        const void *dataPtr =
-            &buffer.data[accessor.byteOffset + bufferView.byteOffset];
-        const float *buf = static_cast<const float *>(dataPtr);
-        for (size_t index = 0; index < accessor.count; index++) {
-          sampler.inputs.push_back(buf[index]);
-        }
-
-        for (auto input : sampler.inputs) {
-          if (input < animation.start) {
-            animation.start = input;
-          };
-          if (input > animation.end) {
-            animation.end = input;
-          }
-        }
-      }
-
-      // Read sampler output T/R/S values
-      {
-        const tinygltf::Accessor &accessor = gltfModel.accessors[samp.output];
-        const tinygltf::BufferView &bufferView =
-            gltfModel.bufferViews[accessor.bufferView];
-        const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-        assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-        const void *dataPtr =
-            &buffer.data[accessor.byteOffset + bufferView.byteOffset];
-
-        switch (accessor.type) {
-        case TINYGLTF_TYPE_VEC3: {
-          const glm::vec3 *buf = static_cast<const glm::vec3 *>(dataPtr);
-          for (size_t index = 0; index < accessor.count; index++) {
-            sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
-          }
-          break;
-        }
-        case TINYGLTF_TYPE_VEC4: {
-          const glm::vec4 *buf = static_cast<const glm::vec4 *>(dataPtr);
-          for (size_t index = 0; index < accessor.count; index++) {
-            sampler.outputsVec4.push_back(buf[index]);
-          }
-          break;
-        }
-        default: {
-          std::cout << "unknown type" << std::endl;
-          break;
-        }
-        }
-      }
-
-      animation.samplers.push_back(sampler);
-    }
-
-    // Channels
+    // samplers are stored once, the first time a channel uses them
+    std::vector<uint32_t> samplers(anim.samplers.size(), UINT32_MAX);
     for (auto &source : anim.channels) {
-      AnimationChannel channel{};
-
+      AnimationPath path;
       if (source.target_path == "rotation") {
-        channel.path = AnimationChannel::PathType::ROTATION;
-      }
-      if (source.target_path == "translation") {
-        channel.path = AnimationChannel::PathType::TRANSLATION;
-      }
-      if (source.target_path == "scale") {
-        channel.path = AnimationChannel::PathType::SCALE;
-      }
-      if (source.target_path == "weights") {
-        std::cout << "weights not yet supported, skipping channel" << std::endl;
+        path = AnimationPath::Rotation;
+      } else if (source.target_path == "translation") {
+        path = AnimationPath::Translation;
+      } else if (source.target_path == "scale") {
+        path = AnimationPath::Scale;
+      } else {
+        std::cout << source.target_path
+                  << " not yet supported, skipping channel" << std::endl;
         continue;
       }
-      channel.samplerIndex = source.sampler;
-      channel.node = nodeFromIndex(source.target_node);
-      if (!channel.node) {
+      Node *node = nodeFromIndex(source.target_node);
+      if (!node || source.sampler < 0 ||
+          static_cast<size_t>(source.sampler) >= anim.samplers.size()) {
         continue;
       }
 
-      animation.channels.push_back(channel);
+      uint32_t &sampler = samplers[source.sampler];
+      if (sampler == UINT32_MAX) {
+        const tinygltf::AnimationSampler &samp = anim.samplers[source.sampler];
+        AnimationInterpolation interpolation = AnimationInterpolation::Linear;
+        if (samp.interpolation == "STEP") {
+          interpolation = AnimationInterpolation::Step;
+        } else if (samp.interpolation == "CUBICSPLINE") {
+          interpolation = AnimationInterpolation::CubicSpline;
+        }
+
+        // key times, then T/R/S values; rotations may be normalized integers
+        const tinygltf::Accessor &input = gltfModel.accessors[samp.input];
+        const tinygltf::Accessor &output = gltfModel.accessors[samp.output];
+        uint32_t components = path == AnimationPath::Rotation ? 4 : 3;
+        size_t valuesPerKey =
+            interpolation == AnimationInterpolation::CubicSpline ? 3 : 1;
+        if (input.count == 0 || output.count != input.count * valuesPerKey) {
+          std::cout << "animation sampler output count mismatch, skipping "
+                       "channel"
+                    << std::endl;
+          continue;
+        }
+        std::vector<float> times(input.count);
+        AccessorDecoder::decodeFloats(gltfModel, input, 1, times.data(),
+                                      sizeof(float));
+        std::vector<float> values(output.count * components);
+        AccessorDecoder::decodeFloats(gltfModel, output, components,
+                                      values.data(),
+                                      components * sizeof(float));
+        sampler = loaded.addSampler(
+            interpolation, times.data(), static_cast<uint32_t>(input.count),
+            values.data(), components);
+      }
+      loaded.addChannel(sampler, node->index, path);
     }
+  }
 
-    animations.push_back(animation);
+  for (const auto &clip :
+       AnimationCompressor::compress(loaded, animationLibrary)) {
+    std::cout << "animation " << clip.name << ": " << clip.keysBefore
+              << " -> " << clip.keysAfter << " keys, " << clip.bytesBefore
+              << " -> " << clip.bytesAfter << " bytes (" << clip.ratio()
+              << "x), max error " << clip.translationError << " / "
+              << clip.rotationError << " rad / " << clip.scaleError
+              << std::endl;
   }
 }
 
@@ -1217,40 +1035,66 @@ void glTFModel::loadFromFile(std::string filename, BufferPool *bufferPool,
 
   this->device = device;
 
-  bool binary = false;
-  size_t extpos = filename.rfind('.', filename.length());
-  if (extpos != std::string::npos) {
-    binary = (filename.substr(extpos + 1, filename.length() - extpos) == "glb");
-  }
+  // images are decoded in parallel below instead of inside the parser
+  gltfContext.SetImageLoader(deferImageLoad, nullptr);
 
-  bool fileLoaded =
-      binary ? gltfContext.LoadBinaryFromFile(&gltfModel, &error, &warning,
-                                              filename.c_str())
-             : gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning,
-                                             filename.c_str());
+  bool fileLoaded = GltfFileSystem::loadModel(gltfContext, &gltfModel, &error,
+                                              &warning, filename);
 
   LoaderInfo loaderInfo{};
   size_t vertexCount = 0;
   size_t indexCount = 0;
 
   if (fileLoaded) {
-    loadTextureSamplers(gltfModel);
-    loadTextures(gltfModel, context, commandBuffers, bufferPool,
-                 resourceUploadHeap, transferQueue);
-    loadMaterials(gltfModel);
+    ThreadPool threadPool;
+
+    // images only depend on the parsed file, start them first
+    std::vector<std::future<void>> imageJobs;
+    for (auto &image : gltfModel.images) {
+      imageJobs.push_back(
+          threadPool.submit([&image] { decodeImage(image); }));
+    }
 
     const tinygltf::Scene &scene =
         gltfModel
             .scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
 
-    // Get vertex and index buffer sizes up-front
+    // serial pass: fix every primitive's output range up-front
     for (size_t i = 0; i < scene.nodes.size(); i++) {
-      getNodeProps(gltfModel.nodes[scene.nodes[i]], gltfModel, vertexCount,
-                   indexCount);
+      getNodeProps(gltfModel.nodes[scene.nodes[i]], gltfModel, loaderInfo);
+    }
+    if (!loaderInfo.primitives.empty()) {
+      const PrimitiveRange &last = loaderInfo.primitives.back();
+      vertexCount = last.vertexStart + last.vertexCount;
+      indexCount = last.indexStart + last.indexCount;
     }
     loaderInfo.vertexBuffer = new Vertex[vertexCount];
     loaderInfo.indexBuffer = new uint32_t[indexCount];
 
+    // parallel pass: decode primitives into their disjoint ranges
+    std::vector<std::future<void>> primitiveJobs;
+    for (auto &range : loaderInfo.primitives) {
+      primitiveJobs.push_back(threadPool.submit([&gltfModel, &range,
+                                                 &loaderInfo] {
+        loadPrimitive(gltfModel, range, loaderInfo);
+      }));
+    }
+
+    // gpu uploads stay on this thread, overlapping the remaining decodes
+    for (auto &job : imageJobs) {
+      job.get();
+    }
+    loadTextureSamplers(gltfModel);
+    loadTextures(gltfModel, context, commandBuffers, bufferPool,
+                 resourceUploadHeap, transferQueue);
+    loadMaterials(gltfModel);
+
+    for (auto &job : primitiveJobs) {
+      job.get();
+    }
+
+    loadTransforms(gltfModel);
+    nodeTable.assign(gltfModel.nodes.size(), nullptr);
     // TODO: scene handling with no default scene
     for (size_t i = 0; i < scene.nodes.size(); i++) {
       const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
@@ -1261,6 +1105,7 @@ void glTFModel::loadFromFile(std::string filename, BufferPool *bufferPool,
     }
     loadSkins(gltfModel);
 
+    transforms.update();
     for (auto node : linearNodes) {
       // Assign skins
       if (node->skinIndex > -1) {
@@ -1271,6 +1116,9 @@ void glTFModel::loadFromFile(std::string filename, BufferPool *bufferPool,
         node->update();
       }
     }
+
+    // everything left in the gltf buffers has been decoded or uploaded
+    GltfFileSystem::releaseData(gltfModel);
   } else {
     // TODO: throw
     std::cerr << "Could not load gltf file: " << error << std::endl;
@@ -1482,91 +1330,48 @@ void glTFModel::getSceneDimensions() {
 }
 
 void glTFModel::updateAnimation(uint32_t index, float time) {
-  if (animations.empty()) {
+  const auto &clips = animationLibrary.getClips();
+  if (clips.empty()) {
     std::cout << ".glTF does not contain animation." << std::endl;
     return;
   }
-  if (index > static_cast<uint32_t>(animations.size()) - 1) {
+  if (index >= clips.size()) {
     std::cout << "No animation with index " << index << std::endl;
     return;
   }
-  Animation &animation = animations[index];
+  if (animationPlayer.getClip() != index) {
+    animationPlayer.setClip(animationLibrary, index);
+  }
+  animationPlayer.evaluate(animationLibrary, time, transforms);
+  updateNodes();
+}
 
-  bool updated = false;
-  for (auto &channel : animation.channels) {
-    AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-    if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+void glTFModel::updateNodes() {
+  if (transforms.update() == 0) {
+    return;
+  }
+  for (auto node : linearNodes) {
+    if (!node->mesh) {
       continue;
     }
-
-    for (size_t i = 0; i < sampler.inputs.size() - 1; i++) {
-      if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-        float u = std::max(0.0f, time - sampler.inputs[i]) /
-                  (sampler.inputs[i + 1] - sampler.inputs[i]);
-        if (u <= 1.0f) {
-          switch (channel.path) {
-          case AnimationChannel::PathType::TRANSLATION: {
-            glm::vec4 trans =
-                glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-            channel.node->translation = glm::vec3(trans);
-            break;
-          }
-          case AnimationChannel::PathType::SCALE: {
-            glm::vec4 trans =
-                glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-            channel.node->scale = glm::vec3(trans);
-            break;
-          }
-          case AnimationChannel::PathType::ROTATION: {
-            glm::quat q1;
-            q1.x = sampler.outputsVec4[i].x;
-            q1.y = sampler.outputsVec4[i].y;
-            q1.z = sampler.outputsVec4[i].z;
-            q1.w = sampler.outputsVec4[i].w;
-            glm::quat q2;
-            q2.x = sampler.outputsVec4[i + 1].x;
-            q2.y = sampler.outputsVec4[i + 1].y;
-            q2.z = sampler.outputsVec4[i + 1].z;
-            q2.w = sampler.outputsVec4[i + 1].w;
-            channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-            break;
-          }
-          }
-          updated = true;
+    bool moved = transforms.isChanged(node->index);
+    if (!moved && node->skin) {
+      for (Node *joint : node->skin->joints) {
+        if (transforms.isChanged(joint->index)) {
+          moved = true;
+          break;
         }
       }
     }
-  }
-  if (updated) {
-    for (auto &node : nodes) {
+    if (moved) {
       node->update();
     }
   }
 }
 
-Node *glTFModel::findNode(Node *parent, uint32_t index) {
-  Node *nodeFound = nullptr;
-  if (parent->index == index) {
-    return parent;
-  }
-  for (auto &child : parent->children) {
-    nodeFound = findNode(child, index);
-    if (nodeFound) {
-      break;
-    }
-  }
-  return nodeFound;
-}
-
 Node *glTFModel::nodeFromIndex(uint32_t index) {
-  Node *nodeFound = nullptr;
-  for (auto &node : nodes) {
-    nodeFound = findNode(node, index);
-    if (nodeFound) {
-      break;
-    }
-  }
-  return nodeFound;
+  return index < nodeTable.size() ? nodeTable[index] : nullptr;
 }
 
-} // namespace hiddenpiggy
\ No newline at end of file
+} // namespace vkglTF
+} // namespace hiddenpiggy
@@ -0,0 +1,346 @@
+#include "AnimationCompressor.hpp"
+#include "AnimationEvaluator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// usage: AnimationBenchmark [instances] [nodes] [keys] [frames]
+// plays one clip with translation, rotation and scale channels on every
+// node of many instances, five ways: the linear key scan
+// vkglTF::glTFModel::updateAnimation did, AnimationPlayer playing forward,
+// AnimationPlayer seeking to random times, AnimationPlayer::evaluateAll on a
+// thread pool and AnimationPlayer playing the clip after
+// AnimationCompressor. Exits with 1 when the players disagree with the scan,
+// the step and cubic spline samplers with their expected values, or the
+// batch decoding of compressed keys with decoding them one at a time.
+// --check plays a small clip for a few frames and skips the random seeks,
+// which nothing checks, for ctest.
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+using namespace hiddenpiggy;
+
+constexpr float kTolerance = 1e-4f;
+// reduction tolerance plus quantization, with room to spare
+constexpr float kCompressedTolerance = 1e-3f;
+
+double millisecondsSince(Clock::time_point start, uint32_t frames) {
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+  return elapsed.count() / frames;
+}
+
+glm::vec4 valueAt(const AnimationLibrary &library, uint32_t index) {
+  return glm::vec4(library.getValues(0)[index], library.getValues(1)[index],
+                   library.getValues(2)[index], library.getValues(3)[index]);
+}
+
+// the search and interpolation updateAnimation had: every channel scans its
+// keys from the start for the interval containing time
+void evaluateByScan(const AnimationLibrary &library, uint32_t clipIndex,
+                    float time, TransformHierarchy &transforms) {
+  const AnimationLibrary::Clip &clip = library.getClips()[clipIndex];
+  for (uint32_t i = 0; i < clip.channelCount; ++i) {
+    const AnimationLibrary::Channel &channel =
+        library.getChannels()[clip.firstChannel + i];
+    const AnimationLibrary::Sampler &sampler =
+        library.getSamplers()[channel.sampler];
+    const float *times = library.getTimes() + sampler.firstKey;
+    for (uint32_t k = 0; k + 1 < sampler.keyCount; ++k) {
+      if (time < times[k] || time > times[k + 1]) {
+        continue;
+      }
+      float u = (time - times[k]) / (times[k + 1] - times[k]);
+      glm::vec4 v0 = valueAt(library, sampler.firstValue + k);
+      glm::vec4 v1 = valueAt(library, sampler.firstValue + k + 1);
+      switch (channel.path) {
+      case AnimationPath::Translation:
+        transforms.setTranslation(channel.node, glm::vec3(glm::mix(v0, v1, u)));
+        break;
+      case AnimationPath::Scale:
+        transforms.setScale(channel.node, glm::vec3(glm::mix(v0, v1, u)));
+        break;
+      case AnimationPath::Rotation:
+        transforms.setRotation(
+            channel.node,
+            glm::normalize(glm::slerp(glm::quat(v0.w, v0.x, v0.y, v0.z),
+                                      glm::quat(v1.w, v1.x, v1.y, v1.z), u)));
+        break;
+      }
+    }
+  }
+}
+
+float maxDifference(const TransformHierarchy &a, const TransformHierarchy &b) {
+  float difference = 0.0f;
+  for (uint32_t n = 0; n < a.getNodeCount(); ++n) {
+    glm::vec3 t = glm::abs(a.getTranslation(n) - b.getTranslation(n));
+    glm::vec3 s = glm::abs(a.getScale(n) - b.getScale(n));
+    // q and -q are the same rotation
+    float q = 1.0f - std::fabs(glm::dot(a.getRotation(n), b.getRotation(n)));
+    difference = std::max({difference, t.x, t.y, t.z, s.x, s.y, s.z, q});
+  }
+  return difference;
+}
+
+// step keys hold, and a cubic spline whose tangents follow a line stays on it
+bool checkStepAndCubic() {
+  AnimationLibrary library;
+  const float times[] = {0.0f, 1.0f, 3.0f};
+  const float stepValues[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+  // in tangent, value, out tangent per key, on x = 2t, y = -t, z = 1
+  std::vector<float> cubicValues;
+  for (float t : times) {
+    const float key[] = {2, -1, 0, 2 * t, -t, 1, 2, -1, 0};
+    cubicValues.insert(cubicValues.end(), key, key + 9);
+  }
+  library.beginClip("check");
+  library.addChannel(library.addSampler(AnimationInterpolation::Step, times, 3,
+                                        stepValues, 3),
+                     0, AnimationPath::Scale);
+  library.addChannel(library.addSampler(AnimationInterpolation::CubicSpline,
+                                        times, 3, cubicValues.data(), 3),
+                     0, AnimationPath::Translation);
+
+  TransformHierarchy transforms;
+  transforms.build({-1});
+  AnimationPlayer player;
+  player.setClip(library, 0);
+  bool agrees = true;
+  for (float time : {-1.0f, 0.0f, 0.5f, 1.0f, 2.25f, 3.0f, 4.0f}) {
+    player.evaluate(library, time, transforms);
+    float clamped = std::clamp(time, 0.0f, 3.0f);
+    glm::vec3 scale = clamped < 1.0f   ? glm::vec3(1, 2, 3)
+                      : clamped < 3.0f ? glm::vec3(4, 5, 6)
+                                       : glm::vec3(7, 8, 9);
+    glm::vec3 translation(2 * clamped, -clamped, 1);
+    float difference =
+        std::max(glm::length(transforms.getScale(0) - scale),
+                 glm::length(transforms.getTranslation(0) - translation));
+    if (difference > kTolerance) {
+      std::cerr << "step or cubic spline sampler off by " << difference
+                << " at " << time << std::endl;
+      agrees = false;
+    }
+  }
+  return agrees;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int first = 1;
+  bool checkOnly = argc > 1 && std::string(argv[1]) == "--check";
+  if (checkOnly) {
+    ++first;
+  }
+  auto argument = [&](int index, uint32_t benchmark, uint32_t check) {
+    return argc > first + index ? std::atoi(argv[first + index])
+                                : (checkOnly ? check : benchmark);
+  };
+  uint32_t instances = argument(0, 256, 16);
+  uint32_t nodes = argument(1, 64, 16);
+  uint32_t keys = argument(2, 120, 60);
+  uint32_t frames = argument(3, 60, 4);
+  if (instances == 0 || nodes == 0 || keys < 2 || frames == 0) {
+    std::cerr << "usage: " << argv[0]
+              << " [--check] [instances] [nodes] [keys] [frames]" << std::endl;
+    return 1;
+  }
+
+  // a chain of nodes, each with its own samplers over irregular key times
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  AnimationLibrary library;
+  library.beginClip("benchmark");
+  std::vector<float> times(keys), values(keys * 4);
+  // the old scan left nodes alone past their last key where the player
+  // clamps, so play only the part every channel covers
+  float duration = 1e30f;
+  for (uint32_t n = 0; n < nodes; ++n) {
+    float time = 0.0f;
+    for (uint32_t k = 0; k < keys; ++k) {
+      times[k] = time;
+      time += 1.0f / 30.0f * (1.0f + 0.5f * unit(random));
+    }
+    duration = std::min(duration, times[keys - 1]);
+    for (AnimationPath path : {AnimationPath::Translation,
+                               AnimationPath::Rotation, AnimationPath::Scale}) {
+      uint32_t components = path == AnimationPath::Rotation ? 4 : 3;
+      // smooth curves, as from motion capture, so keys can be dropped
+      glm::vec4 frequency(unit(random), unit(random), unit(random),
+                          unit(random));
+      glm::vec4 phase(unit(random), unit(random), unit(random), unit(random));
+      for (uint32_t k = 0; k < keys; ++k) {
+        glm::vec4 v;
+        for (uint32_t c = 0; c < 4; ++c) {
+          v[c] = std::sin(2.0f * frequency[c] * times[k] + 3.0f * phase[c]);
+        }
+        if (path == AnimationPath::Rotation) {
+          v = glm::normalize(v);
+        } else if (path == AnimationPath::Scale) {
+          v = glm::vec4(1.0f) + 0.25f * v;
+        }
+        for (uint32_t c = 0; c < components; ++c) {
+          values[k * components + c] = v[c];
+        }
+      }
+      library.addChannel(library.addSampler(AnimationInterpolation::Linear,
+                                            times.data(), keys, values.data(),
+                                            components),
+                         n, path);
+    }
+  }
+  const AnimationLibrary::Clip &clip = library.getClips()[0];
+
+  std::vector<int32_t> parents(nodes);
+  for (uint32_t n = 0; n < nodes; ++n) {
+    parents[n] = static_cast<int32_t>(n) - 1;
+  }
+  std::vector<TransformHierarchy> scanned(instances), played(instances);
+  std::vector<AnimationPlayer> players(instances);
+  for (uint32_t i = 0; i < instances; ++i) {
+    scanned[i].build(parents);
+    played[i].build(parents);
+    players[i].setClip(library, 0);
+  }
+  // instances start at different offsets into the clip
+  std::vector<float> offsets(instances);
+  for (float &offset : offsets) {
+    offset = (unit(random) + 1.0f) * 0.5f * duration;
+  }
+  auto timeAt = [&](uint32_t instance, uint32_t frame) {
+    return std::fmod(offsets[instance] + frame / 60.0f, duration);
+  };
+
+  std::cout << instances << " instances, " << clip.channelCount
+            << " channels of " << keys << " keys each" << std::endl;
+  bool agrees = checkStepAndCubic();
+
+  auto start = Clock::now();
+  for (uint32_t f = 0; f < frames; ++f) {
+    for (uint32_t i = 0; i < instances; ++i) {
+      evaluateByScan(library, 0, timeAt(i, f), scanned[i]);
+      scanned[i].update();
+    }
+  }
+  std::cout << "linear scan: " << millisecondsSince(start, frames)
+            << " ms per frame" << std::endl;
+
+  start = Clock::now();
+  for (uint32_t f = 0; f < frames; ++f) {
+    for (uint32_t i = 0; i < instances; ++i) {
+      players[i].evaluate(library, timeAt(i, f), played[i]);
+      played[i].update();
+    }
+  }
+  std::cout << "cursors, forward: " << millisecondsSince(start, frames)
+            << " ms per frame" << std::endl;
+
+  float difference = 0.0f;
+  for (uint32_t i = 0; i < instances; ++i) {
+    difference = std::max(difference, maxDifference(scanned[i], played[i]));
+  }
+  if (difference > kTolerance) {
+    std::cerr << "cursors differ from the linear scan by " << difference
+              << std::endl;
+    agrees = false;
+  }
+
+  // every evaluation lands away from the cursor, so the search runs
+  if (!checkOnly) {
+    std::vector<float> seeks(size_t(instances) * frames);
+    for (float &seek : seeks) {
+      seek = (unit(random) + 1.0f) * 0.5f * duration;
+    }
+    start = Clock::now();
+    for (uint32_t f = 0; f < frames; ++f) {
+      for (uint32_t i = 0; i < instances; ++i) {
+        players[i].evaluate(library, seeks[size_t(f) * instances + i],
+                            played[i]);
+        played[i].update();
+      }
+    }
+    std::cout << "cursors, random seeks: " << millisecondsSince(start, frames)
+              << " ms per frame" << std::endl;
+  }
+
+  ThreadPool pool;
+  std::vector<AnimationPlayer::Job> jobs(instances);
+  start = Clock::now();
+  for (uint32_t f = 0; f < frames; ++f) {
+    for (uint32_t i = 0; i < instances; ++i) {
+      jobs[i] = AnimationPlayer::Job{&players[i], &played[i], timeAt(i, f)};
+    }
+    AnimationPlayer::evaluateAll(pool, library, jobs);
+  }
+  std::cout << "evaluateAll on " << pool.getThreadCount()
+            << " threads: " << millisecondsSince(start, frames)
+            << " ms per frame" << std::endl;
+
+  AnimationLibrary compressed;
+  AnimationCompressor::ClipStats stats =
+      AnimationCompressor::compress(library, compressed)[0];
+  std::cout << "compressed: " << stats.keysBefore << " -> " << stats.keysAfter
+            << " keys, " << stats.bytesBefore << " -> " << stats.bytesAfter
+            << " bytes (" << stats.ratio() << "x), max error "
+            << stats.translationError << " / " << stats.rotationError
+            << " rad / " << stats.scaleError << std::endl;
+  if (std::max({stats.translationError, stats.rotationError,
+                stats.scaleError}) > kCompressedTolerance) {
+    std::cerr << "compression error above " << kCompressedTolerance
+              << std::endl;
+    agrees = false;
+  }
+
+  for (uint32_t i = 0; i < instances; ++i) {
+    players[i].setClip(compressed, 0);
+  }
+  start = Clock::now();
+  for (uint32_t f = 0; f < frames; ++f) {
+    for (uint32_t i = 0; i < instances; ++i) {
+      players[i].evaluate(compressed, timeAt(i, f), played[i]);
+      played[i].update();
+    }
+  }
+  std::cout << "compressed, forward: " << millisecondsSince(start, frames)
+            << " ms per frame" << std::endl;
+
+  // the batch decode the players ran against the one key at a time one
+  float decodeDifference = 0.0f;
+  const AnimationLibrary::Clip &compressedClip = compressed.getClips()[0];
+  for (uint32_t i = 0; i < instances; ++i) {
+    float time = timeAt(i, frames - 1);
+    for (uint32_t c = 0; c < compressedClip.channelCount; ++c) {
+      const AnimationLibrary::Channel &channel =
+          compressed.getChannels()[compressedClip.firstChannel + c];
+      glm::vec4 expected = compressed.sample(channel.sampler, channel.path,
+                                             time);
+      glm::vec4 actual;
+      if (channel.path == AnimationPath::Rotation) {
+        glm::quat q = played[i].getRotation(channel.node);
+        expected = glm::normalize(expected);
+        float sign = glm::dot(glm::vec4(q.x, q.y, q.z, q.w), expected) < 0.0f
+                         ? -1.0f
+                         : 1.0f;
+        actual = sign * glm::vec4(q.x, q.y, q.z, q.w);
+      } else {
+        actual = glm::vec4(channel.path == AnimationPath::Translation
+                               ? played[i].getTranslation(channel.node)
+                               : played[i].getScale(channel.node),
+                           expected.w);
+      }
+      glm::vec4 d = glm::abs(actual - expected);
+      decodeDifference = std::max({decodeDifference, d.x, d.y, d.z, d.w});
+    }
+  }
+  if (decodeDifference > kTolerance) {
+    std::cerr << "batch decoding differs by " << decodeDifference << std::endl;
+    agrees = false;
+  }
+
+  return agrees ? 0 : 1;
+}
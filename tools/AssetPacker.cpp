@@ -0,0 +1,52 @@
+#include "AssetPack.hpp"
+#include <filesystem>
+#include <iostream>
+
+// usage: AssetPacker <directory> [output.pak]
+// packs every file below directory; the renderer mounts <directory>.pak in
+// place of the directory when it finds one
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <directory> [output.pak]"
+              << std::endl;
+    return 1;
+  }
+  std::filesystem::path directory{argv[1]};
+  std::string packPath =
+      argc > 2 ? argv[2] : hiddenpiggy::AssetPack::packPathFor(argv[1]);
+
+  std::vector<std::pair<std::string, std::string>> files;
+  uint64_t totalSize = 0;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(directory, ec)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    std::string extension = entry.path().extension().string();
+    // caches are rebuilt from the sources and never read from a pack
+    if (extension == ".cooked" || extension == ".tmp" || extension == ".pak") {
+      continue;
+    }
+    files.emplace_back(
+        entry.path().lexically_relative(directory).generic_string(),
+        entry.path().string());
+    totalSize += entry.file_size();
+  }
+  if (ec) {
+    std::cerr << "cannot read " << directory << ": " << ec.message()
+              << std::endl;
+    return 1;
+  }
+
+  hiddenpiggy::ThreadPool pool;
+  std::string err;
+  if (!hiddenpiggy::AssetPack::write(packPath, files, pool, &err)) {
+    std::cerr << err;
+    return 1;
+  }
+  std::cout << "packed " << files.size() << " files, " << totalSize
+            << " bytes -> " << std::filesystem::file_size(packPath, ec)
+            << " bytes in " << packPath << std::endl;
+  return 0;
+}
@@ -0,0 +1,294 @@
+#include "GltfFileSystem.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <tiny_gltf.h>
+
+// usage: DrawBenchmark [iterations] [files...]
+// lays the primitives of .gltf files out the way glTFModel::recordDraws
+// sees them after loadModel with optimizeMeshes, records them with one
+// drawIndexed per primitive and transform run and with multi-draw, and
+// reports the draw calls and the host time of both loops. Without files it
+// takes scenes/Box/Box.gltf and scenes/GI/GI.gltf. Commands go to a
+// recorder that only stores them, so the time is the loop's own cost, not
+// the driver's; the renderer's debug window shows the real record time.
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+namespace fs = std::filesystem;
+
+double microsecondsSince(Clock::time_point start) {
+  std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+  return elapsed.count();
+}
+
+std::string readText(const fs::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+// a copy of the scene's directory with missing buffers filled with zeros;
+// only the accessor counts are read, so zeros do as well as the real data
+fs::path stageScene(const fs::path &source, const fs::path &stagingRoot) {
+  fs::path directory = stagingRoot / source.stem();
+  fs::create_directories(directory);
+  for (const auto &entry : fs::directory_iterator(source.parent_path())) {
+    fs::path target = directory / entry.path().filename();
+    if (!fs::exists(target)) {
+      fs::create_symlink(fs::absolute(entry.path()), target);
+    }
+  }
+  auto json = nlohmann::json::parse(readText(source));
+  for (const auto &buffer : json.value("buffers", nlohmann::json::array())) {
+    std::string uri = buffer.value("uri", "");
+    fs::path target = directory / uri;
+    if (uri.empty() || uri.starts_with("data:") || fs::exists(target)) {
+      continue;
+    }
+    std::cout << source.filename().string() << ": " << uri
+              << " is missing, staged as zeros" << std::endl;
+    std::ofstream bin(target, std::ios::binary);
+    std::vector<char> zeros(buffer.value("byteLength", size_t(0)));
+    bin.write(zeros.data(), zeros.size());
+  }
+  return directory / source.filename();
+}
+
+bool skipImage(tinygltf::Image *, const int, std::string *, std::string *,
+               int, int, const unsigned char *, int, void *) {
+  return true;
+}
+
+// what recordDraws reads of a resident primitive
+struct DrawPrimitive {
+  bool indexed = false;
+  bool index16 = false;
+  uint32_t indexCount = 0;
+  uint32_t firstIndex = 0;
+  int32_t vertexOffset = 0;
+  uint32_t firstTransform = 0;
+  uint32_t transformCount = 0;
+};
+
+// the fields of vk::DrawIndexedIndirectCommand
+struct IndirectCommand {
+  uint32_t indexCount;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+  uint32_t firstInstance;
+};
+
+// stands in for vk::CommandBuffer, keeps what it is given
+struct Recorder {
+  enum class Op { BindIndexBuffer, DrawIndexed, DrawIndexedIndirect };
+  struct Command {
+    Op op;
+    uint32_t arguments[5];
+  };
+  std::vector<Command> commands;
+
+  void bindIndexBuffer(bool index16) {
+    commands.push_back({Op::BindIndexBuffer, {index16, 0, 0, 0, 0}});
+  }
+  void drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+                   uint32_t firstIndex, int32_t vertexOffset,
+                   uint32_t firstInstance) {
+    commands.push_back({Op::DrawIndexed,
+                        {indexCount, instanceCount, firstIndex,
+                         static_cast<uint32_t>(vertexOffset), firstInstance}});
+  }
+  void drawIndexedIndirect(uint32_t offset, uint32_t drawCount) {
+    commands.push_back({Op::DrawIndexedIndirect, {offset, drawCount, 0, 0, 0}});
+  }
+};
+
+// one transform per node placing the mesh, or one per EXT_mesh_gpu_instancing
+// instance, meshes in file order like buildInstances
+std::vector<DrawPrimitive> layOut(const tinygltf::Model &model) {
+  std::vector<uint32_t> placements(model.meshes.size(), 0);
+  for (const auto &node : model.nodes) {
+    if (node.mesh < 0 || static_cast<size_t>(node.mesh) >= placements.size()) {
+      continue;
+    }
+    uint32_t count = 1;
+    auto instancing = node.extensions.find("EXT_mesh_gpu_instancing");
+    if (instancing != node.extensions.end() &&
+        instancing->second.Has("attributes")) {
+      const auto &attributes = instancing->second.Get("attributes");
+      for (const auto &name : attributes.Keys()) {
+        int accessor = attributes.Get(name).GetNumberAsInt();
+        if (accessor >= 0 &&
+            static_cast<size_t>(accessor) < model.accessors.size()) {
+          count = static_cast<uint32_t>(model.accessors[accessor].count);
+          break;
+        }
+      }
+    }
+    placements[node.mesh] += count;
+  }
+
+  std::vector<DrawPrimitive> primitives;
+  uint32_t transform = 0;
+  uint32_t index = 0;
+  int32_t vertex = 0;
+  for (size_t m = 0; m < model.meshes.size(); ++m) {
+    for (const auto &source : model.meshes[m].primitives) {
+      DrawPrimitive primitive;
+      auto position = source.attributes.find("POSITION");
+      uint32_t vertexCount =
+          position == source.attributes.end()
+              ? 0
+              : static_cast<uint32_t>(model.accessors[position->second].count);
+      primitive.indexed = source.indices >= 0;
+      if (primitive.indexed) {
+        primitive.indexCount =
+            static_cast<uint32_t>(model.accessors[source.indices].count);
+      }
+      // optimizePrimitive packs triangle lists below 65536 vertices
+      primitive.index16 = primitive.indexed &&
+                          source.mode == TINYGLTF_MODE_TRIANGLES &&
+                          vertexCount < 65536;
+      primitive.firstIndex = index;
+      primitive.vertexOffset = vertex;
+      primitive.firstTransform = transform;
+      primitive.transformCount = placements[m];
+      index += primitive.indexCount;
+      vertex += static_cast<int32_t>(vertexCount);
+      primitives.push_back(primitive);
+    }
+    transform += placements[m];
+  }
+  return primitives;
+}
+
+constexpr uint32_t kMaxMultiDrawCount = 65535;
+
+// the loop of recordDraws with no transforms hidden and LOD 0 selected;
+// returns the draw calls
+uint32_t record(const std::vector<DrawPrimitive> &primitives, bool multiDraw,
+                Recorder &recorder, std::vector<IndirectCommand> &mapped) {
+  uint32_t drawCalls = 0;
+  uint32_t written = 0;
+  uint32_t batchStart = 0;
+  auto flush = [&]() {
+    if (written == batchStart) {
+      return;
+    }
+    recorder.drawIndexedIndirect(
+        batchStart * static_cast<uint32_t>(sizeof(IndirectCommand)),
+        written - batchStart);
+    ++drawCalls;
+    batchStart = written;
+  };
+
+  bool bound16 = false;
+  recorder.bindIndexBuffer(bound16);
+  for (const auto &primitive : primitives) {
+    if (!primitive.indexed || primitive.transformCount == 0) {
+      continue;
+    }
+    if (primitive.index16 != bound16) {
+      flush();
+      bound16 = primitive.index16;
+      recorder.bindIndexBuffer(bound16);
+    }
+    uint32_t first = primitive.firstTransform;
+    uint32_t count = primitive.transformCount;
+    if (!multiDraw) {
+      recorder.drawIndexed(primitive.indexCount, count, primitive.firstIndex,
+                           primitive.vertexOffset, first);
+      ++drawCalls;
+      continue;
+    }
+    mapped[written++] = IndirectCommand{primitive.indexCount, count,
+                                        primitive.firstIndex,
+                                        primitive.vertexOffset, first};
+    if (written - batchStart == kMaxMultiDrawCount) {
+      flush();
+    }
+  }
+  flush();
+  return drawCalls;
+}
+
+void benchmark(const fs::path &path, uint32_t iterations) {
+  tinygltf::Model model;
+  tinygltf::TinyGLTF loader;
+  loader.SetFsCallbacks(hiddenpiggy::GltfFileSystem::getMappedCallbacks());
+  loader.SetImageLoader(&skipImage, nullptr);
+  std::string error, warning;
+  if (!loader.LoadASCIIFromFile(&model, &error, &warning, path.string())) {
+    std::cout << path.filename().string() << ": tinygltf failed: " << error
+              << std::endl;
+    return;
+  }
+
+  std::vector<DrawPrimitive> primitives = layOut(model);
+  uint32_t transforms = 0;
+  uint32_t index16 = 0;
+  for (const auto &primitive : primitives) {
+    transforms = std::max(transforms, primitive.firstTransform +
+                                          primitive.transformCount);
+    index16 += primitive.index16 ? 1 : 0;
+  }
+  std::cout << path.filename().string() << ": " << model.meshes.size()
+            << " meshes, " << primitives.size() << " primitives ("
+            << index16 << " with 16 bit indices), " << transforms
+            << " transforms" << std::endl;
+
+  std::vector<IndirectCommand> mapped(primitives.size());
+  for (bool multiDraw : {false, true}) {
+    Recorder recorder;
+    recorder.commands.reserve(primitives.size() * 2 + 1);
+    uint32_t drawCalls = 0;
+    double best = 0.0;
+    for (uint32_t it = 0; it < iterations; ++it) {
+      recorder.commands.clear();
+      auto start = Clock::now();
+      drawCalls = record(primitives, multiDraw, recorder, mapped);
+      double time = microsecondsSince(start);
+      best = it == 0 ? time : std::min(best, time);
+    }
+    std::cout << (multiDraw ? "  multi-draw:    " : "  per primitive: ")
+              << drawCalls << " draw calls, " << recorder.commands.size()
+              << " commands, " << best << " us" << std::endl;
+  }
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t iterations = argc > 1 ? std::atoi(argv[1]) : 1000;
+  if (iterations == 0) {
+    std::cerr << "usage: " << argv[0] << " [iterations] [files...]"
+              << std::endl;
+    return 1;
+  }
+
+  fs::path stagingRoot = fs::temp_directory_path() / "DrawBenchmark";
+  fs::remove_all(stagingRoot);
+  fs::create_directories(stagingRoot);
+
+  std::vector<fs::path> files;
+  for (int i = 2; i < argc; ++i) {
+    files.push_back(stageScene(argv[i], stagingRoot));
+  }
+  if (files.empty()) {
+    files.push_back(
+        stageScene(fs::path(SCENES_PATH) / "Box/Box.gltf", stagingRoot));
+    files.push_back(
+        stageScene(fs::path(SCENES_PATH) / "GI/GI.gltf", stagingRoot));
+  }
+  for (const auto &file : files) {
+    benchmark(file, iterations);
+  }
+  fs::remove_all(stagingRoot);
+  return 0;
+}
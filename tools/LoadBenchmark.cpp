@@ -0,0 +1,400 @@
+#include "AccessorDecoder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <tiny_gltf.h>
+
+// usage: LoadBenchmark [meshes] [vertices per mesh] [iterations]
+// writes a synthetic .gltf with an external .bin, loads it with tinygltf and
+// decodes every primitive's positions, normals, uvs and indices two ways:
+// the per element gather from a second read of the .bin that glTFModel did
+// before, and AccessorDecoder straight out of tinygltf's buffers. Half the
+// meshes interleave their attributes in one strided view, half use one
+// packed view per attribute; indices alternate between 16 and 32 bits.
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+// what the importer decodes into before encoding the gpu vertices
+struct SourceVertex {
+  float position[3];
+  float normal[3];
+  float uv0[2];
+};
+
+struct Decoded {
+  std::vector<SourceVertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+double millisecondsSince(Clock::time_point start, uint32_t iterations) {
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+void writeScene(const std::filesystem::path &gltfPath, uint32_t meshes,
+                uint32_t verticesPerMesh) {
+  const uint32_t triangles = verticesPerMesh - 2;
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+  std::vector<uint8_t> bin;
+  auto append = [&bin](const void *data, size_t size) {
+    size_t offset = bin.size();
+    bin.resize(offset + size);
+    memcpy(bin.data() + offset, data, size);
+    // views start 4 byte aligned, as the spec asks
+    bin.resize((bin.size() + 3) & ~size_t(3));
+    return offset;
+  };
+
+  std::string views;
+  std::string accessors;
+  std::string meshesJson;
+  uint32_t viewCount = 0;
+  uint32_t accessorCount = 0;
+  auto addView = [&](size_t offset, size_t length, uint32_t stride) {
+    if (viewCount > 0) {
+      views += ",";
+    }
+    views += "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) +
+             ",\"byteLength\":" + std::to_string(length);
+    if (stride > 0) {
+      views += ",\"byteStride\":" + std::to_string(stride);
+    }
+    views += "}";
+    return viewCount++;
+  };
+  auto addAccessor = [&](uint32_t view, size_t offset, uint32_t componentType,
+                         uint32_t count, const char *type) {
+    if (accessorCount > 0) {
+      accessors += ",";
+    }
+    accessors += "{\"bufferView\":" + std::to_string(view) +
+                 ",\"byteOffset\":" + std::to_string(offset) +
+                 ",\"componentType\":" + std::to_string(componentType) +
+                 ",\"count\":" + std::to_string(count) + ",\"type\":\"" +
+                 type + "\"}";
+    return accessorCount++;
+  };
+
+  for (uint32_t mesh = 0; mesh < meshes; ++mesh) {
+    std::vector<SourceVertex> vertices(verticesPerMesh);
+    for (auto &vertex : vertices) {
+      for (float &v : vertex.position) {
+        v = unit(random);
+      }
+      glm::vec3 normal = glm::normalize(
+          glm::vec3(unit(random), unit(random), unit(random)) + 1e-3f);
+      vertex.normal[0] = normal.x;
+      vertex.normal[1] = normal.y;
+      vertex.normal[2] = normal.z;
+      vertex.uv0[0] = 0.5f + 0.5f * unit(random);
+      vertex.uv0[1] = 0.5f + 0.5f * unit(random);
+    }
+
+    uint32_t position, normal, uv0;
+    if (mesh % 2 == 0) {
+      size_t offset = append(vertices.data(),
+                             vertices.size() * sizeof(SourceVertex));
+      uint32_t view = addView(offset, vertices.size() * sizeof(SourceVertex),
+                              sizeof(SourceVertex));
+      position = addAccessor(view, 0, 5126, verticesPerMesh, "VEC3");
+      normal = addAccessor(view, offsetof(SourceVertex, normal), 5126,
+                           verticesPerMesh, "VEC3");
+      uv0 = addAccessor(view, offsetof(SourceVertex, uv0), 5126,
+                        verticesPerMesh, "VEC2");
+    } else {
+      std::vector<float> positions, normals, uvs;
+      for (const auto &vertex : vertices) {
+        positions.insert(positions.end(), vertex.position,
+                         vertex.position + 3);
+        normals.insert(normals.end(), vertex.normal, vertex.normal + 3);
+        uvs.insert(uvs.end(), vertex.uv0, vertex.uv0 + 2);
+      }
+      size_t bytes = positions.size() * sizeof(float);
+      position = addAccessor(addView(append(positions.data(), bytes), bytes, 0),
+                             0, 5126, verticesPerMesh, "VEC3");
+      normal = addAccessor(addView(append(normals.data(), bytes), bytes, 0), 0,
+                           5126, verticesPerMesh, "VEC3");
+      bytes = uvs.size() * sizeof(float);
+      uv0 = addAccessor(addView(append(uvs.data(), bytes), bytes, 0), 0, 5126,
+                        verticesPerMesh, "VEC2");
+    }
+
+    // a strip's worth of triangles over the mesh's vertices
+    uint32_t indexAccessor;
+    if (mesh % 4 < 2 && verticesPerMesh <= 65536) {
+      std::vector<uint16_t> indices;
+      for (uint32_t t = 0; t < triangles; ++t) {
+        indices.insert(indices.end(), {uint16_t(t), uint16_t(t + 1),
+                                       uint16_t(t + 2)});
+      }
+      size_t bytes = indices.size() * sizeof(uint16_t);
+      indexAccessor = addAccessor(
+          addView(append(indices.data(), bytes), bytes, 0), 0, 5123,
+          static_cast<uint32_t>(indices.size()), "SCALAR");
+    } else {
+      std::vector<uint32_t> indices;
+      for (uint32_t t = 0; t < triangles; ++t) {
+        indices.insert(indices.end(), {t, t + 1, t + 2});
+      }
+      size_t bytes = indices.size() * sizeof(uint32_t);
+      indexAccessor = addAccessor(
+          addView(append(indices.data(), bytes), bytes, 0), 0, 5125,
+          static_cast<uint32_t>(indices.size()), "SCALAR");
+    }
+
+    if (mesh > 0) {
+      meshesJson += ",";
+    }
+    meshesJson += "{\"primitives\":[{\"attributes\":{\"POSITION\":" +
+                  std::to_string(position) +
+                  ",\"NORMAL\":" + std::to_string(normal) +
+                  ",\"TEXCOORD_0\":" + std::to_string(uv0) +
+                  "},\"indices\":" + std::to_string(indexAccessor) + "}]}";
+  }
+
+  std::string nodes;
+  for (uint32_t mesh = 0; mesh < meshes; ++mesh) {
+    nodes += (mesh > 0 ? ",{\"mesh\":" : "{\"mesh\":") +
+             std::to_string(mesh) + "}";
+  }
+
+  std::filesystem::path binPath = gltfPath;
+  binPath.replace_extension(".bin");
+  std::ofstream binFile(binPath, std::ios::binary);
+  binFile.write(reinterpret_cast<const char *>(bin.data()), bin.size());
+
+  std::ofstream gltfFile(gltfPath);
+  gltfFile << "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,"
+           << "\"scenes\":[{\"nodes\":[";
+  for (uint32_t mesh = 0; mesh < meshes; ++mesh) {
+    gltfFile << (mesh > 0 ? "," : "") << mesh;
+  }
+  gltfFile << "]}],\"nodes\":[" << nodes << "],\"meshes\":[" << meshesJson
+           << "],\"accessors\":[" << accessors << "],\"bufferViews\":["
+           << views << "],\"buffers\":[{\"uri\":\""
+           << binPath.filename().string()
+           << "\",\"byteLength\":" << bin.size() << "}]}";
+  if (!binFile || !gltfFile) {
+    throw std::runtime_error("failed to write " + gltfPath.string());
+  }
+}
+
+// the decode glTFModel did before AccessorDecoder: every .bin is read a
+// second time, float attributes are gathered one element at a time into
+// per attribute vectors and then interleaved
+Decoded decodeGather(const tinygltf::Model &model,
+                     const std::filesystem::path &gltfPath) {
+  struct ByteBuffer {
+    uint8_t *pData = nullptr;
+    uint32_t byteLength;
+  };
+  std::vector<ByteBuffer> byteBuffers{};
+  for (const auto &buffer : model.buffers) {
+    std::filesystem::path path{gltfPath};
+    std::ifstream opened_file{path.remove_filename().string() + buffer.uri,
+                              std::ios_base::in | std::ios_base::binary};
+    if (!opened_file.is_open()) {
+      throw std::runtime_error("cannot open the binary file");
+    }
+    opened_file.seekg(0, std::ios::end);
+    std::streamsize fileSize = opened_file.tellg();
+    opened_file.seekg(0, std::ios::beg);
+
+    ByteBuffer byteBuffer{};
+    byteBuffer.byteLength = fileSize;
+    byteBuffer.pData = new uint8_t[fileSize];
+    if (!opened_file.read(reinterpret_cast<char *>(byteBuffer.pData),
+                          fileSize)) {
+      throw std::runtime_error("buffer read failed");
+    }
+    byteBuffers.push_back(byteBuffer);
+  }
+
+  Decoded decoded;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      uint32_t vertexStart = static_cast<uint32_t>(decoded.vertices.size());
+      std::vector<glm::vec3> positions{};
+      std::vector<glm::vec3> normals{};
+      std::vector<glm::vec2> uv0{};
+      for (auto it = primitive.attributes.begin();
+           it != primitive.attributes.end(); it++) {
+        const tinygltf::Accessor &accessor = model.accessors[it->second];
+        auto bufferView = model.bufferViews[accessor.bufferView];
+        auto pointer = byteBuffers[bufferView.buffer].pData +
+                       bufferView.byteOffset + accessor.byteOffset;
+        size_t count = accessor.count;
+        if (it->first == "POSITION" || it->first == "NORMAL") {
+          auto &target = it->first == "POSITION" ? positions : normals;
+          while (count--) {
+            glm::vec3 data = *(reinterpret_cast<glm::vec3 *>(pointer));
+            pointer += bufferView.byteStride > 0 ? bufferView.byteStride
+                                                 : sizeof(glm::vec3);
+            target.push_back(data);
+          }
+        } else if (it->first == "TEXCOORD_0") {
+          while (count--) {
+            glm::vec2 data = *(reinterpret_cast<glm::vec2 *>(pointer));
+            pointer += bufferView.byteStride > 0 ? bufferView.byteStride
+                                                 : sizeof(glm::vec2);
+            uv0.push_back(data);
+          }
+        }
+      }
+      for (size_t i = 0; i < positions.size(); ++i) {
+        glm::vec3 normal = normals.size() > 0 ? normals[i] : glm::vec3(0.0f);
+        glm::vec2 uv = uv0.size() > 0 ? uv0[i] : glm::vec2(0.0f);
+        decoded.vertices.push_back({{positions[i].x, positions[i].y,
+                                     positions[i].z},
+                                    {normal.x, normal.y, normal.z},
+                                    {uv.x, uv.y}});
+      }
+
+      const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
+      auto bufferView = model.bufferViews[accessor.bufferView];
+      auto pointer = byteBuffers[bufferView.buffer].pData +
+                     bufferView.byteOffset + accessor.byteOffset;
+      size_t count = accessor.count;
+      while (count--) {
+        if (accessor.componentType == 5123) {
+          auto data = *(reinterpret_cast<uint16_t *>(pointer));
+          pointer += bufferView.byteStride > 0 ? bufferView.byteStride
+                                               : sizeof(uint16_t);
+          decoded.indices.push_back(data + vertexStart);
+        }
+        if (accessor.componentType == 5125) {
+          auto data = *(reinterpret_cast<uint32_t *>(pointer));
+          pointer += bufferView.byteStride > 0 ? bufferView.byteStride
+                                               : sizeof(uint32_t);
+          decoded.indices.push_back(data + vertexStart);
+        }
+      }
+    }
+  }
+
+  for (auto &byteBuffer : byteBuffers) {
+    delete[] byteBuffer.pData;
+  }
+  return decoded;
+}
+
+// what glTFModel does now: a counting pass sizes the arrays, then every
+// accessor decodes in place out of tinygltf's buffers
+Decoded decodeBulk(const tinygltf::Model &model) {
+  size_t vertexCount = 0;
+  size_t indexCount = 0;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      vertexCount += model.accessors[primitive.attributes.at("POSITION")].count;
+      indexCount += model.accessors[primitive.indices].count;
+    }
+  }
+
+  Decoded decoded;
+  decoded.vertices.resize(vertexCount);
+  decoded.indices.resize(indexCount);
+  size_t firstVertex = 0;
+  size_t firstIndex = 0;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      SourceVertex *vertices = decoded.vertices.data() + firstVertex;
+      size_t count = 0;
+      for (const auto &[attributeName, accessorIndex] :
+           primitive.attributes) {
+        const tinygltf::Accessor &accessor = model.accessors[accessorIndex];
+        count = accessor.count;
+        if (attributeName == "POSITION") {
+          hiddenpiggy::AccessorDecoder::decodeFloats(
+              model, accessor, 3, vertices->position, sizeof(SourceVertex));
+        } else if (attributeName == "NORMAL") {
+          hiddenpiggy::AccessorDecoder::decodeFloats(
+              model, accessor, 3, vertices->normal, sizeof(SourceVertex));
+        } else if (attributeName == "TEXCOORD_0") {
+          hiddenpiggy::AccessorDecoder::decodeFloats(
+              model, accessor, 2, vertices->uv0, sizeof(SourceVertex));
+        }
+      }
+      const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
+      hiddenpiggy::AccessorDecoder::decodeIndices(
+          model, accessor, decoded.indices.data() + firstIndex,
+          static_cast<uint32_t>(firstVertex));
+      firstVertex += count;
+      firstIndex += accessor.count;
+    }
+  }
+  return decoded;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t meshes = argc > 1 ? std::atoi(argv[1]) : 256;
+  uint32_t verticesPerMesh = argc > 2 ? std::atoi(argv[2]) : 8192;
+  uint32_t iterations = argc > 3 ? std::atoi(argv[3]) : 5;
+  if (meshes == 0 || verticesPerMesh < 3 || iterations == 0) {
+    std::cerr << "usage: " << argv[0]
+              << " [meshes] [vertices per mesh] [iterations]" << std::endl;
+    return 1;
+  }
+
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "LoadBenchmark";
+  std::filesystem::create_directories(directory);
+  std::filesystem::path gltfPath = directory / "synthetic.gltf";
+  writeScene(gltfPath, meshes, verticesPerMesh);
+
+  tinygltf::Model model;
+  tinygltf::TinyGLTF loader;
+  std::string error, warning;
+  auto start = Clock::now();
+  if (!loader.LoadASCIIFromFile(&model, &error, &warning,
+                                gltfPath.string())) {
+    std::cerr << "failed to load " << gltfPath << ": " << error << std::endl;
+    return 1;
+  }
+  double parseTime = millisecondsSince(start, 1);
+
+  // the best of the runs, the first one warms the page cache for the gather
+  double gatherTime = 0.0;
+  double bulkTime = 0.0;
+  Decoded gathered, bulk;
+  for (uint32_t it = 0; it < iterations; ++it) {
+    start = Clock::now();
+    gathered = decodeGather(model, gltfPath);
+    double time = millisecondsSince(start, 1);
+    gatherTime = it == 0 ? time : std::min(gatherTime, time);
+
+    start = Clock::now();
+    bulk = decodeBulk(model);
+    time = millisecondsSince(start, 1);
+    bulkTime = it == 0 ? time : std::min(bulkTime, time);
+  }
+
+  bool identical =
+      gathered.vertices.size() == bulk.vertices.size() &&
+      gathered.indices == bulk.indices &&
+      memcmp(gathered.vertices.data(), bulk.vertices.data(),
+             bulk.vertices.size() * sizeof(SourceVertex)) == 0;
+
+  size_t binBytes = model.buffers.empty() ? 0 : model.buffers[0].data.size();
+  std::cout << meshes << " meshes, " << bulk.vertices.size() << " vertices, "
+            << bulk.indices.size() << " indices, " << (binBytes >> 20)
+            << " MiB of buffers" << std::endl;
+  std::cout << "tinygltf load:          " << parseTime << " ms" << std::endl;
+  std::cout << "re-read and gather:     " << gatherTime << " ms" << std::endl;
+  std::cout << "AccessorDecoder:        " << bulkTime << " ms, "
+            << gatherTime / bulkTime << "x" << std::endl;
+  std::cout << "results " << (identical ? "match" : "DIFFER") << std::endl;
+
+  std::filesystem::remove_all(directory);
+  return identical ? 0 : 1;
+}
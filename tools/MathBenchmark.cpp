@@ -0,0 +1,397 @@
+#include "SimdMath.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// usage: MathBenchmark [--check] [count] [iterations]
+// checks the SimdMath kernels against glm one item at a time, and the key
+// decoding ones against the values encoded, then reports the throughput of
+// glm, the scalar kernels and the vector kernels on one core. Exits with 1
+// when a kernel disagrees. --check only runs the checks, for ctest.
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+using namespace hiddenpiggy;
+
+// relative to the magnitude of the inputs, which stay around 1
+constexpr float kTolerance = 1e-4f;
+
+// set by --check, skips the timing loops and their reports
+bool checkOnly = false;
+
+template <typename F> double itemsPerSecond(size_t count, uint32_t iterations,
+                                            F &&kernel) {
+  if (checkOnly) {
+    return 0.0;
+  }
+  auto start = Clock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    kernel();
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  return double(count) * iterations / elapsed.count();
+}
+
+float maxDifference(const glm::mat4 *a, const glm::mat4 *b, size_t count) {
+  float difference = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        difference = std::max(difference, std::fabs(a[i][c][r] - b[i][c][r]));
+      }
+    }
+  }
+  return difference;
+}
+
+float maxDifference(const glm::vec3 *a, const glm::vec3 *b, size_t count) {
+  float difference = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      difference = std::max(difference, std::fabs(a[i][k] - b[i][k]));
+    }
+  }
+  return difference;
+}
+
+size_t countMismatches(const std::vector<uint8_t> &a,
+                       const std::vector<uint8_t> &b) {
+  size_t mismatches = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    mismatches += a[i] != b[i] ? 1 : 0;
+  }
+  return mismatches;
+}
+
+void report(const char *kernel, double reference, double scalar,
+            double simd) {
+  if (checkOnly) {
+    return;
+  }
+  std::cout << kernel << ": glm " << reference / 1e6 << ", scalar "
+            << scalar / 1e6 << ", " << SimdMath::getInstructionSet() << " "
+            << simd / 1e6 << " M/s" << std::endl;
+}
+void report(const char *kernel, double scalar, double simd) {
+  if (checkOnly) {
+    return;
+  }
+  std::cout << kernel << ": scalar " << scalar / 1e6 << ", "
+            << SimdMath::getInstructionSet() << " " << simd / 1e6 << " M/s"
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int first = 1;
+  if (argc > 1 && std::string(argv[1]) == "--check") {
+    checkOnly = true;
+    ++first;
+  }
+  // odd by default, so the scalar tails run too
+  size_t count =
+      argc > first ? std::strtoul(argv[first], nullptr, 10) : 100003;
+  uint32_t iterations = argc > first + 1 ? std::atoi(argv[first + 1]) : 50;
+  if (count == 0 || iterations == 0) {
+    std::cerr << "usage: " << argv[0] << " [--check] [count] [iterations]"
+              << std::endl;
+    return 1;
+  }
+
+  std::mt19937 random(11);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::vector<glm::vec3> translations(count), scales(count);
+  std::vector<glm::quat> rotations(count);
+  std::vector<glm::mat4> a(count), b(count);
+  for (size_t i = 0; i < count; ++i) {
+    translations[i] = glm::vec3(unit(random), unit(random), unit(random));
+    scales[i] = glm::vec3(1.0f) +
+                0.5f * glm::vec3(unit(random), unit(random), unit(random));
+    glm::vec3 axis = glm::normalize(
+        glm::vec3(unit(random), unit(random), unit(random)) + 1e-3f);
+    rotations[i] = glm::angleAxis(3.14159f * unit(random), axis);
+    for (int c = 0; c < 4; ++c) {
+      for (int r = 0; r < 4; ++r) {
+        a[i][c][r] = unit(random);
+        b[i][c][r] = unit(random);
+      }
+    }
+  }
+  bool agrees = true;
+  auto check = [&agrees](const char *kernel, float difference) {
+    if (difference > kTolerance) {
+      std::cerr << kernel << " differs from glm by " << difference
+                << std::endl;
+      agrees = false;
+    }
+  };
+
+  std::cout << count << " items, " << SimdMath::getInstructionSet() << " with "
+            << SimdMath::getLaneCount() << " lanes" << std::endl;
+
+  // TRS composition
+  std::vector<glm::mat4> expected(count), scalarOut(count), simdOut(count);
+  auto composeReference = [&] {
+    for (size_t i = 0; i < count; ++i) {
+      expected[i] = glm::translate(glm::mat4(1.0f), translations[i]) *
+                    glm::mat4_cast(rotations[i]) *
+                    glm::scale(glm::mat4(1.0f), scales[i]);
+    }
+  };
+  auto composeScalar = [&] {
+    SimdMath::Scalar::composeTrs(translations.data(), rotations.data(),
+                                 scales.data(), scalarOut.data(), count);
+  };
+  auto composeSimd = [&] {
+    SimdMath::composeTrs(translations.data(), rotations.data(), scales.data(),
+                         simdOut.data(), count);
+  };
+  composeReference();
+  composeScalar();
+  composeSimd();
+  check("scalar composeTrs",
+        maxDifference(expected.data(), scalarOut.data(), count));
+  check("composeTrs", maxDifference(expected.data(), simdOut.data(), count));
+  report("composeTrs", itemsPerSecond(count, iterations, composeReference),
+         itemsPerSecond(count, iterations, composeScalar),
+         itemsPerSecond(count, iterations, composeSimd));
+
+  // matrix products
+  auto multiplyReference = [&] {
+    for (size_t i = 0; i < count; ++i) {
+      expected[i] = a[i] * b[i];
+    }
+  };
+  auto multiplyScalar = [&] {
+    SimdMath::Scalar::multiply(a.data(), b.data(), scalarOut.data(), count);
+  };
+  auto multiplySimd = [&] {
+    SimdMath::multiply(a.data(), b.data(), simdOut.data(), count);
+  };
+  multiplyReference();
+  multiplyScalar();
+  multiplySimd();
+  check("scalar multiply",
+        maxDifference(expected.data(), scalarOut.data(), count));
+  check("multiply", maxDifference(expected.data(), simdOut.data(), count));
+  report("multiply", itemsPerSecond(count, iterations, multiplyReference),
+         itemsPerSecond(count, iterations, multiplyScalar),
+         itemsPerSecond(count, iterations, multiplySimd));
+
+  // box transforms, reference as vkglTF::BoundingBox::getAABB
+  std::vector<glm::vec3> mins(count), maxs(count);
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec3 corner(unit(random), unit(random), unit(random));
+    mins[i] = corner;
+    maxs[i] = corner + glm::abs(glm::vec3(unit(random), unit(random),
+                                          unit(random)));
+  }
+  std::vector<glm::vec3> expectedMins(count), expectedMaxs(count);
+  std::vector<glm::vec3> outMins(count), outMaxs(count);
+  auto aabbReference = [&] {
+    for (size_t i = 0; i < count; ++i) {
+      glm::vec3 min(a[i][3]), max(a[i][3]);
+      for (int c = 0; c < 3; ++c) {
+        glm::vec3 v0 = glm::vec3(a[i][c]) * mins[i][c];
+        glm::vec3 v1 = glm::vec3(a[i][c]) * maxs[i][c];
+        min += glm::min(v0, v1);
+        max += glm::max(v0, v1);
+      }
+      expectedMins[i] = min;
+      expectedMaxs[i] = max;
+    }
+  };
+  auto aabbScalar = [&] {
+    SimdMath::Scalar::transformAabbs(a.data(), mins.data(), maxs.data(),
+                                     outMins.data(), outMaxs.data(), count);
+  };
+  auto aabbSimd = [&] {
+    SimdMath::transformAabbs(a.data(), mins.data(), maxs.data(),
+                             outMins.data(), outMaxs.data(), count);
+  };
+  aabbReference();
+  aabbScalar();
+  check("scalar transformAabbs",
+        std::max(maxDifference(expectedMins.data(), outMins.data(), count),
+                 maxDifference(expectedMaxs.data(), outMaxs.data(), count)));
+  aabbSimd();
+  check("transformAabbs",
+        std::max(maxDifference(expectedMins.data(), outMins.data(), count),
+                 maxDifference(expectedMaxs.data(), outMaxs.data(), count)));
+  report("transformAabbs", itemsPerSecond(count, iterations, aabbReference),
+         itemsPerSecond(count, iterations, aabbScalar),
+         itemsPerSecond(count, iterations, aabbSimd));
+
+  // culling against a camera looking at the middle of the items
+  glm::mat4 view(1.0f);
+  view[3] = glm::vec4(0.0f, 0.0f, -2.0f, 1.0f);
+  glm::mat4 proj(0.0f);
+  proj[0][0] = 1.5f;
+  proj[1][1] = 1.5f;
+  proj[2][2] = -1.0f;
+  proj[2][3] = -1.0f;
+  proj[3][2] = -0.2f;
+  glm::vec4 planes[6];
+  SimdMath::extractFrustumPlanes(proj * view, planes);
+
+  std::vector<float> x(count), y(count), z(count), radius(count);
+  std::vector<float> maxX(count), maxY(count), maxZ(count);
+  for (size_t i = 0; i < count; ++i) {
+    x[i] = 3.0f * unit(random);
+    y[i] = 3.0f * unit(random);
+    z[i] = 3.0f * unit(random);
+    radius[i] = 0.1f * (unit(random) + 1.0f);
+    maxX[i] = x[i] + radius[i];
+    maxY[i] = y[i] + radius[i];
+    maxZ[i] = z[i] + radius[i];
+  }
+  SimdMath::SpheresSoA spheres{x.data(), y.data(), z.data(), radius.data()};
+  SimdMath::BoxesSoA boxes{x.data(),    y.data(),    z.data(),
+                           maxX.data(), maxY.data(), maxZ.data()};
+  std::vector<uint8_t> expectedVisible(count), scalarVisible(count),
+      simdVisible(count);
+
+  auto spheresReference = [&] {
+    for (size_t i = 0; i < count; ++i) {
+      bool visible = true;
+      for (int p = 0; p < 6; ++p) {
+        visible = visible &&
+                  glm::dot(glm::vec3(planes[p]), glm::vec3(x[i], y[i], z[i])) +
+                          planes[p].w >=
+                      -radius[i];
+      }
+      expectedVisible[i] = visible ? 1 : 0;
+    }
+  };
+  auto spheresScalar = [&] {
+    SimdMath::Scalar::cullSpheres(planes, spheres, scalarVisible.data(),
+                                  count);
+  };
+  auto spheresSimd = [&] {
+    SimdMath::cullSpheres(planes, spheres, simdVisible.data(), count);
+  };
+  spheresReference();
+  spheresScalar();
+  spheresSimd();
+  // a sphere touching a plane may round either way
+  check("scalar cullSpheres",
+        float(countMismatches(expectedVisible, scalarVisible)) / count);
+  check("cullSpheres",
+        float(countMismatches(expectedVisible, simdVisible)) / count);
+  report("cullSpheres", itemsPerSecond(count, iterations, spheresReference),
+         itemsPerSecond(count, iterations, spheresScalar),
+         itemsPerSecond(count, iterations, spheresSimd));
+
+  auto boxesReference = [&] {
+    for (size_t i = 0; i < count; ++i) {
+      bool visible = true;
+      for (int p = 0; p < 6; ++p) {
+        glm::vec3 corner(planes[p].x >= 0.0f ? maxX[i] : x[i],
+                         planes[p].y >= 0.0f ? maxY[i] : y[i],
+                         planes[p].z >= 0.0f ? maxZ[i] : z[i]);
+        visible = visible &&
+                  glm::dot(glm::vec3(planes[p]), corner) + planes[p].w >= 0.0f;
+      }
+      expectedVisible[i] = visible ? 1 : 0;
+    }
+  };
+  auto boxesScalar = [&] {
+    SimdMath::Scalar::cullBoxes(planes, boxes, scalarVisible.data(), count);
+  };
+  auto boxesSimd = [&] {
+    SimdMath::cullBoxes(planes, boxes, simdVisible.data(), count);
+  };
+  boxesReference();
+  boxesScalar();
+  boxesSimd();
+  check("scalar cullBoxes",
+        float(countMismatches(expectedVisible, scalarVisible)) / count);
+  check("cullBoxes",
+        float(countMismatches(expectedVisible, simdVisible)) / count);
+  report("cullBoxes", itemsPerSecond(count, iterations, boxesReference),
+         itemsPerSecond(count, iterations, boxesScalar),
+         itemsPerSecond(count, iterations, boxesSimd));
+
+  // smallest-three rotations, encoded from the random rotations
+  std::vector<uint16_t> wordA(count), wordB(count), wordC(count);
+  for (size_t i = 0; i < count; ++i) {
+    uint16_t words[3];
+    SimdMath::encodeSmallestThree(rotations[i], words);
+    wordA[i] = words[0];
+    wordB[i] = words[1];
+    wordC[i] = words[2];
+  }
+  std::vector<glm::quat> scalarRotations(count), simdRotations(count);
+  auto rotationDifference = [&](const std::vector<glm::quat> &decoded) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+      // the encoder may flip the sign
+      const glm::quat &q = rotations[i];
+      const glm::quat &d = decoded[i];
+      float sign =
+          q.x * d.x + q.y * d.y + q.z * d.z + q.w * d.w < 0.0f ? -1.0f : 1.0f;
+      difference = std::max(
+          {difference, std::fabs(q.x - sign * d.x), std::fabs(q.y - sign * d.y),
+           std::fabs(q.z - sign * d.z), std::fabs(q.w - sign * d.w)});
+    }
+    return difference;
+  };
+  auto rotationsScalar = [&] {
+    SimdMath::Scalar::decodeSmallestThree(wordA.data(), wordB.data(),
+                                          wordC.data(), scalarRotations.data(),
+                                          count);
+  };
+  auto rotationsSimd = [&] {
+    SimdMath::decodeSmallestThree(wordA.data(), wordB.data(), wordC.data(),
+                                  simdRotations.data(), count);
+  };
+  rotationsScalar();
+  rotationsSimd();
+  check("scalar decodeSmallestThree", rotationDifference(scalarRotations));
+  check("decodeSmallestThree", rotationDifference(simdRotations));
+  report("decodeSmallestThree",
+         itemsPerSecond(count, iterations, rotationsScalar),
+         itemsPerSecond(count, iterations, rotationsSimd));
+
+  // 16-bit steps of per item ranges
+  std::uniform_int_distribution<uint32_t> step(0, 65535);
+  std::vector<uint16_t> steps(count);
+  std::vector<float> origins(count), extents(count), expectedValues(count);
+  for (size_t i = 0; i < count; ++i) {
+    steps[i] = static_cast<uint16_t>(step(random));
+    origins[i] = unit(random);
+    extents[i] = unit(random) + 1.0f;
+    expectedValues[i] = origins[i] + extents[i] * (steps[i] / 65535.0f);
+  }
+  std::vector<float> scalarValues(count), simdValues(count);
+  auto valueDifference = [&](const std::vector<float> &values) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+      difference =
+          std::max(difference, std::fabs(values[i] - expectedValues[i]));
+    }
+    return difference;
+  };
+  auto dequantizeScalar = [&] {
+    SimdMath::Scalar::dequantize(steps.data(), origins.data(), extents.data(),
+                                 scalarValues.data(), count);
+  };
+  auto dequantizeSimd = [&] {
+    SimdMath::dequantize(steps.data(), origins.data(), extents.data(),
+                         simdValues.data(), count);
+  };
+  dequantizeScalar();
+  dequantizeSimd();
+  check("scalar dequantize", valueDifference(scalarValues));
+  check("dequantize", valueDifference(simdValues));
+  report("dequantize", itemsPerSecond(count, iterations, dequantizeScalar),
+         itemsPerSecond(count, iterations, dequantizeSimd));
+
+  return agrees ? 0 : 1;
+}
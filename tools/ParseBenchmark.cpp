@@ -0,0 +1,435 @@
+#include "GltfFileSystem.hpp"
+#include "GltfJsonParser.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <tiny_gltf.h>
+
+// usage: ParseBenchmark [nodes] [iterations] [files...]
+// loads .gltf files with tinygltf, set up the way glTFModel does it, and
+// with GltfJsonParser, times both and compares the two tinygltf::Models
+// field by field. Without files it takes scenes/GI/GI.gltf and a synthetic
+// scene of [nodes] nodes. Buffers a scene references but does not ship are
+// stood in for by zeros in a staged copy, so the json is still measured.
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+namespace fs = std::filesystem;
+
+double millisecondsSince(Clock::time_point start) {
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+  return elapsed.count();
+}
+
+// what glTFModel hands tinygltf, images stay encoded
+bool keepEncodedImage(tinygltf::Image *image, const int, std::string *,
+                      std::string *, int, int, const unsigned char *bytes,
+                      int size, void *) {
+  image->image.assign(bytes, bytes + size);
+  image->as_is = true;
+  return true;
+}
+
+std::string readText(const fs::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+// a copy of the scene's directory with missing buffers filled with zeros;
+// everything else is linked, not copied
+fs::path stageScene(const fs::path &source, const fs::path &stagingRoot) {
+  fs::path directory = stagingRoot / source.stem();
+  fs::create_directories(directory);
+  for (const auto &entry : fs::directory_iterator(source.parent_path())) {
+    fs::path target = directory / entry.path().filename();
+    if (!fs::exists(target)) {
+      fs::create_symlink(fs::absolute(entry.path()), target);
+    }
+  }
+  auto json = nlohmann::json::parse(readText(source));
+  for (const auto &buffer : json.value("buffers", nlohmann::json::array())) {
+    std::string uri = buffer.value("uri", "");
+    fs::path target = directory / uri;
+    if (uri.empty() || uri.starts_with("data:") || fs::exists(target)) {
+      continue;
+    }
+    std::cout << source.filename().string() << ": " << uri
+              << " is missing, staged as zeros" << std::endl;
+    std::ofstream bin(target, std::ios::binary);
+    std::vector<char> zeros(buffer.value("byteLength", size_t(0)));
+    bin.write(zeros.data(), zeros.size());
+  }
+  return directory / source.filename();
+}
+
+// a forest of nodes with trs or matrix transforms, a quarter of them
+// placing one of a few meshes that share one buffer
+fs::path writeSynthetic(const fs::path &directory, uint32_t nodeCount) {
+  constexpr uint32_t kMeshes = 16;
+  constexpr uint32_t kVertices = 24;
+  constexpr uint32_t kFanout = 8;
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+  nlohmann::json json;
+  json["asset"] = {{"version", "2.0"}, {"generator", "ParseBenchmark"}};
+  json["scene"] = 0;
+
+  std::vector<float> vertexData;
+  std::vector<uint16_t> indexData;
+  for (uint32_t v = 0; v < kVertices * 2 * 3; ++v) {
+    vertexData.push_back(unit(random));
+  }
+  for (uint32_t i = 0; i < kVertices; ++i) {
+    indexData.push_back(static_cast<uint16_t>(i));
+  }
+  size_t vertexBytes = vertexData.size() * sizeof(float);
+  size_t indexBytes = indexData.size() * sizeof(uint16_t);
+  fs::path binPath = directory / "synthetic.bin";
+  {
+    std::ofstream bin(binPath, std::ios::binary);
+    bin.write(reinterpret_cast<const char *>(vertexData.data()), vertexBytes);
+    bin.write(reinterpret_cast<const char *>(indexData.data()), indexBytes);
+  }
+  json["buffers"] = {{{"uri", "synthetic.bin"},
+                      {"byteLength", vertexBytes + indexBytes}}};
+  json["bufferViews"] = {
+      {{"buffer", 0}, {"byteLength", vertexBytes}, {"byteStride", 24},
+       {"target", 34962}},
+      {{"buffer", 0}, {"byteOffset", vertexBytes}, {"byteLength", indexBytes},
+       {"target", 34963}}};
+  json["accessors"] = {
+      {{"bufferView", 0}, {"componentType", 5126}, {"count", kVertices},
+       {"type", "VEC3"}, {"min", {-1, -1, -1}}, {"max", {1, 1, 1}}},
+      {{"bufferView", 0}, {"byteOffset", 12}, {"componentType", 5126},
+       {"count", kVertices}, {"type", "VEC3"}},
+      {{"bufferView", 1}, {"componentType", 5123}, {"count", kVertices},
+       {"type", "SCALAR"}}};
+
+  json["materials"] = nlohmann::json::array();
+  json["meshes"] = nlohmann::json::array();
+  for (uint32_t m = 0; m < kMeshes; ++m) {
+    json["materials"].push_back(
+        {{"name", "material" + std::to_string(m)},
+         {"pbrMetallicRoughness",
+          {{"baseColorFactor", {0.5f + 0.5f * unit(random), 0.5f, 0.5f, 1.0f}},
+           {"metallicFactor", 0.5f + 0.5f * unit(random)},
+           {"roughnessFactor", 0.5f}}},
+         {"doubleSided", m % 2 == 0}});
+    json["meshes"].push_back(
+        {{"name", "mesh" + std::to_string(m)},
+         {"primitives",
+          {{{"attributes", {{"POSITION", 0}, {"NORMAL", 1}}},
+            {"indices", 2},
+            {"material", m}}}}});
+  }
+
+  nlohmann::json nodes = nlohmann::json::array();
+  for (uint32_t n = 0; n < nodeCount; ++n) {
+    nlohmann::json node = {{"name", "node" + std::to_string(n)}};
+    if (n % 5 == 0) {
+      node["matrix"] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0,
+                        unit(random), unit(random), unit(random), 1};
+    } else {
+      node["translation"] = {unit(random), unit(random), unit(random)};
+      node["rotation"] = {0.0f, 0.0f, 0.0f, 1.0f};
+      node["scale"] = {1.0f, 1.0f + 0.1f * unit(random), 1.0f};
+    }
+    if (n % 4 == 0) {
+      node["mesh"] = n / 4 % kMeshes;
+    }
+    nlohmann::json children = nlohmann::json::array();
+    for (uint32_t c = n * kFanout + 1;
+         c <= n * kFanout + kFanout && c < nodeCount; ++c) {
+      children.push_back(c);
+    }
+    if (!children.empty()) {
+      node["children"] = children;
+    }
+    nodes.push_back(node);
+  }
+  json["nodes"] = nodes;
+  json["scenes"] = {{{"nodes", {0}}}};
+
+  fs::path gltfPath = directory / "synthetic.gltf";
+  std::ofstream(gltfPath) << json.dump(1);
+  return gltfPath;
+}
+
+// the first differences between the models, empty if they agree
+class ModelDiff {
+public:
+  template <typename T>
+  void check(const std::string &field, const T &a, const T &b) {
+    if (!(a == b)) {
+      m_count++;
+      if (m_reported.size() < 10) {
+        m_reported.push_back(field);
+      }
+    }
+  }
+
+  void compare(const tinygltf::Model &a, const tinygltf::Model &b) {
+    check("defaultScene", a.defaultScene, b.defaultScene);
+    check("scenes", a.scenes.size(), b.scenes.size());
+    for (size_t i = 0; i < std::min(a.scenes.size(), b.scenes.size()); ++i) {
+      check(at("scenes", i, "nodes"), a.scenes[i].nodes, b.scenes[i].nodes);
+    }
+
+    check("nodes", a.nodes.size(), b.nodes.size());
+    for (size_t i = 0; i < std::min(a.nodes.size(), b.nodes.size()); ++i) {
+      const auto &x = a.nodes[i];
+      const auto &y = b.nodes[i];
+      check(at("nodes", i, "name"), x.name, y.name);
+      check(at("nodes", i, "mesh"), x.mesh, y.mesh);
+      check(at("nodes", i, "skin"), x.skin, y.skin);
+      check(at("nodes", i, "children"), x.children, y.children);
+      check(at("nodes", i, "matrix"), x.matrix, y.matrix);
+      check(at("nodes", i, "translation"), x.translation, y.translation);
+      check(at("nodes", i, "rotation"), x.rotation, y.rotation);
+      check(at("nodes", i, "scale"), x.scale, y.scale);
+    }
+
+    check("meshes", a.meshes.size(), b.meshes.size());
+    for (size_t i = 0; i < std::min(a.meshes.size(), b.meshes.size()); ++i) {
+      const auto &x = a.meshes[i].primitives;
+      const auto &y = b.meshes[i].primitives;
+      check(at("meshes", i, "primitives"), x.size(), y.size());
+      for (size_t p = 0; p < std::min(x.size(), y.size()); ++p) {
+        check(at("meshes", i, "attributes"), x[p].attributes, y[p].attributes);
+        check(at("meshes", i, "indices"), x[p].indices, y[p].indices);
+        check(at("meshes", i, "material"), x[p].material, y[p].material);
+        check(at("meshes", i, "mode"), x[p].mode, y[p].mode);
+      }
+    }
+
+    check("accessors", a.accessors.size(), b.accessors.size());
+    for (size_t i = 0; i < std::min(a.accessors.size(), b.accessors.size());
+         ++i) {
+      const auto &x = a.accessors[i];
+      const auto &y = b.accessors[i];
+      check(at("accessors", i, "bufferView"), x.bufferView, y.bufferView);
+      check(at("accessors", i, "byteOffset"), x.byteOffset, y.byteOffset);
+      check(at("accessors", i, "componentType"), x.componentType,
+            y.componentType);
+      check(at("accessors", i, "normalized"), x.normalized, y.normalized);
+      check(at("accessors", i, "count"), x.count, y.count);
+      check(at("accessors", i, "type"), x.type, y.type);
+      check(at("accessors", i, "minValues"), x.minValues, y.minValues);
+      check(at("accessors", i, "maxValues"), x.maxValues, y.maxValues);
+      check(at("accessors", i, "sparse"), x.sparse.isSparse,
+            y.sparse.isSparse);
+    }
+
+    check("bufferViews", a.bufferViews.size(), b.bufferViews.size());
+    for (size_t i = 0;
+         i < std::min(a.bufferViews.size(), b.bufferViews.size()); ++i) {
+      const auto &x = a.bufferViews[i];
+      const auto &y = b.bufferViews[i];
+      check(at("bufferViews", i, "buffer"), x.buffer, y.buffer);
+      check(at("bufferViews", i, "byteOffset"), x.byteOffset, y.byteOffset);
+      check(at("bufferViews", i, "byteLength"), x.byteLength, y.byteLength);
+      check(at("bufferViews", i, "byteStride"), x.byteStride, y.byteStride);
+      check(at("bufferViews", i, "target"), x.target, y.target);
+    }
+
+    check("buffers", a.buffers.size(), b.buffers.size());
+    for (size_t i = 0; i < std::min(a.buffers.size(), b.buffers.size()); ++i) {
+      check(at("buffers", i, "data"), a.buffers[i].data, b.buffers[i].data);
+    }
+
+    check("materials", a.materials.size(), b.materials.size());
+    for (size_t i = 0; i < std::min(a.materials.size(), b.materials.size());
+         ++i) {
+      const auto &x = a.materials[i];
+      const auto &y = b.materials[i];
+      const auto &xp = x.pbrMetallicRoughness;
+      const auto &yp = y.pbrMetallicRoughness;
+      check(at("materials", i, "name"), x.name, y.name);
+      check(at("materials", i, "alphaMode"), x.alphaMode, y.alphaMode);
+      check(at("materials", i, "alphaCutoff"), x.alphaCutoff, y.alphaCutoff);
+      check(at("materials", i, "doubleSided"), x.doubleSided, y.doubleSided);
+      check(at("materials", i, "emissiveFactor"), x.emissiveFactor,
+            y.emissiveFactor);
+      check(at("materials", i, "baseColorFactor"), xp.baseColorFactor,
+            yp.baseColorFactor);
+      check(at("materials", i, "metallicFactor"), xp.metallicFactor,
+            yp.metallicFactor);
+      check(at("materials", i, "roughnessFactor"), xp.roughnessFactor,
+            yp.roughnessFactor);
+      check(at("materials", i, "baseColorTexture"), xp.baseColorTexture.index,
+            yp.baseColorTexture.index);
+      check(at("materials", i, "metallicRoughnessTexture"),
+            xp.metallicRoughnessTexture.index,
+            yp.metallicRoughnessTexture.index);
+      check(at("materials", i, "normalTexture"), x.normalTexture.index,
+            y.normalTexture.index);
+      check(at("materials", i, "occlusionTexture"), x.occlusionTexture.index,
+            y.occlusionTexture.index);
+      check(at("materials", i, "emissiveTexture"), x.emissiveTexture.index,
+            y.emissiveTexture.index);
+    }
+
+    check("textures", a.textures.size(), b.textures.size());
+    for (size_t i = 0; i < std::min(a.textures.size(), b.textures.size());
+         ++i) {
+      check(at("textures", i, "source"), a.textures[i].source,
+            b.textures[i].source);
+      check(at("textures", i, "sampler"), a.textures[i].sampler,
+            b.textures[i].sampler);
+    }
+
+    check("images", a.images.size(), b.images.size());
+    for (size_t i = 0; i < std::min(a.images.size(), b.images.size()); ++i) {
+      check(at("images", i, "uri"), a.images[i].uri, b.images[i].uri);
+      check(at("images", i, "mimeType"), a.images[i].mimeType,
+            b.images[i].mimeType);
+      check(at("images", i, "image"), a.images[i].image, b.images[i].image);
+    }
+
+    check("samplers", a.samplers.size(), b.samplers.size());
+    for (size_t i = 0; i < std::min(a.samplers.size(), b.samplers.size());
+         ++i) {
+      const auto &x = a.samplers[i];
+      const auto &y = b.samplers[i];
+      check(at("samplers", i, "minFilter"), x.minFilter, y.minFilter);
+      check(at("samplers", i, "magFilter"), x.magFilter, y.magFilter);
+      check(at("samplers", i, "wrapS"), x.wrapS, y.wrapS);
+      check(at("samplers", i, "wrapT"), x.wrapT, y.wrapT);
+    }
+
+    check("skins", a.skins.size(), b.skins.size());
+    check("animations", a.animations.size(), b.animations.size());
+    for (size_t i = 0; i < std::min(a.animations.size(), b.animations.size());
+         ++i) {
+      check(at("animations", i, "channels"), a.animations[i].channels.size(),
+            b.animations[i].channels.size());
+      check(at("animations", i, "samplers"), a.animations[i].samplers.size(),
+            b.animations[i].samplers.size());
+    }
+  }
+
+  size_t getCount() const { return m_count; }
+  const std::vector<std::string> &getReported() const { return m_reported; }
+
+private:
+  static std::string at(const char *table, size_t index, const char *field) {
+    return std::string(table) + "[" + std::to_string(index) + "]." + field;
+  }
+
+  size_t m_count = 0;
+  std::vector<std::string> m_reported;
+};
+
+void benchmark(const fs::path &path, uint32_t iterations) {
+  std::string json = readText(path);
+  std::string baseDir = path.parent_path().string() + "/";
+
+  tinygltf::Model reference;
+  double tinygltfTime = 0.0;
+  for (uint32_t it = 0; it < iterations; ++it) {
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    loader.SetFsCallbacks(hiddenpiggy::GltfFileSystem::getMappedCallbacks());
+    loader.SetImageLoader(&keepEncodedImage, nullptr);
+    std::string error, warning;
+    auto start = Clock::now();
+    bool loaded = loader.LoadASCIIFromString(
+        &model, &error, &warning, json.data(),
+        static_cast<unsigned int>(json.size()), baseDir);
+    double time = millisecondsSince(start);
+    if (!loaded) {
+      std::cout << path.filename().string()
+                << ": tinygltf failed: " << error << std::endl;
+      return;
+    }
+    tinygltfTime = it == 0 ? time : std::min(tinygltfTime, time);
+    reference = std::move(model);
+  }
+
+  tinygltf::Model parsed;
+  double parserTime = 0.0;
+  std::string parserError;
+  for (uint32_t it = 0; it < iterations; ++it) {
+    tinygltf::Model model;
+    std::string error;
+    auto start = Clock::now();
+    bool loaded = hiddenpiggy::GltfJsonParser::parse(
+        json.data(), json.size(), baseDir, &model, &error, true);
+    double time = millisecondsSince(start);
+    parserTime = it == 0 ? time : std::min(parserTime, time);
+    if (!loaded) {
+      parserError = error;
+    }
+    parsed = std::move(model);
+  }
+
+  std::cout << path.filename().string() << ": " << (json.size() >> 10)
+            << " KiB of json, " << reference.nodes.size() << " nodes, "
+            << reference.meshes.size() << " meshes, "
+            << reference.accessors.size() << " accessors, "
+            << reference.materials.size() << " materials, "
+            << reference.images.size() << " images" << std::endl;
+  std::cout << "  tinygltf:       " << tinygltfTime << " ms" << std::endl;
+  if (!parserError.empty()) {
+    // the loader falls back to tinygltf, so this is added to its time
+    std::cout << "  GltfJsonParser: declined after " << parserTime
+              << " ms, " << parserError;
+    return;
+  }
+  std::cout << "  GltfJsonParser: " << parserTime << " ms, "
+            << tinygltfTime / parserTime << "x" << std::endl;
+
+  ModelDiff diff;
+  diff.compare(reference, parsed);
+  if (diff.getCount() == 0) {
+    std::cout << "  models match" << std::endl;
+    return;
+  }
+  std::cout << "  models differ in " << diff.getCount() << " fields:";
+  for (const auto &field : diff.getReported()) {
+    std::cout << " " << field;
+  }
+  std::cout << std::endl;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t nodes = argc > 1 ? std::atoi(argv[1]) : 50000;
+  uint32_t iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+  if (nodes == 0 || iterations == 0) {
+    std::cerr << "usage: " << argv[0] << " [nodes] [iterations] [files...]"
+              << std::endl;
+    return 1;
+  }
+
+  fs::path stagingRoot = fs::temp_directory_path() / "ParseBenchmark";
+  fs::remove_all(stagingRoot);
+  fs::create_directories(stagingRoot);
+
+  std::vector<fs::path> files;
+  for (int i = 3; i < argc; ++i) {
+    files.push_back(stageScene(argv[i], stagingRoot));
+  }
+  if (files.empty()) {
+    files.push_back(
+        stageScene(fs::path(SCENES_PATH) / "GI" / "GI.gltf", stagingRoot));
+    fs::path synthetic = stagingRoot / "synthetic";
+    fs::create_directories(synthetic);
+    files.push_back(writeSynthetic(synthetic, nodes));
+  }
+
+  for (const auto &file : files) {
+    benchmark(file, iterations);
+  }
+  fs::remove_all(stagingRoot);
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "TransformHierarchy.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+
+// usage: TransformBenchmark [chains] [depth] [iterations]
+// world matrices of a synthetic forest of deep chains, three ways: walking
+// the parent chain per node as vkglTF::Node::getMatrix did, a full
+// TransformHierarchy update and one where a few nodes moved
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct Trs {
+  glm::vec3 translation;
+  glm::quat rotation;
+  glm::vec3 scale;
+};
+
+glm::mat4 composeTrs(const Trs &trs) {
+  return glm::translate(glm::mat4(1.0f), trs.translation) *
+         glm::mat4_cast(trs.rotation) * glm::scale(glm::mat4(1.0f), trs.scale);
+}
+
+double millisecondsSince(Clock::time_point start, uint32_t iterations) {
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+  return elapsed.count() / iterations;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t chains = argc > 1 ? std::atoi(argv[1]) : 64;
+  uint32_t depth = argc > 2 ? std::atoi(argv[2]) : 256;
+  uint32_t iterations = argc > 3 ? std::atoi(argv[3]) : 20;
+  if (chains == 0 || depth == 0 || iterations == 0) {
+    std::cerr << "usage: " << argv[0] << " [chains] [depth] [iterations]"
+              << std::endl;
+    return 1;
+  }
+  const uint32_t count = chains * depth;
+
+  // chain c is nodes c, c + chains, c + 2 * chains, ..., so source order
+  // interleaves the chains and the hierarchy has to reorder them
+  std::vector<int32_t> parents(count);
+  std::vector<Trs> locals(count);
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  for (uint32_t node = 0; node < count; ++node) {
+    parents[node] = node < chains ? -1 : static_cast<int32_t>(node - chains);
+    glm::vec3 axis = glm::normalize(
+        glm::vec3(unit(random), unit(random), unit(random)) + 1e-3f);
+    locals[node] = {glm::vec3(unit(random), unit(random), unit(random)),
+                    glm::angleAxis(0.1f * unit(random), axis), glm::vec3(1.0f)};
+  }
+
+  hiddenpiggy::TransformHierarchy hierarchy;
+  hierarchy.build(parents);
+  for (uint32_t node = 0; node < count; ++node) {
+    hierarchy.setTranslation(node, locals[node].translation);
+    hierarchy.setRotation(node, locals[node].rotation);
+    hierarchy.setScale(node, locals[node].scale);
+  }
+  hierarchy.update();
+
+  // the checksums keep the work from being optimized away and show the
+  // three agree
+  float naiveSum = 0.0f;
+  auto start = Clock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    naiveSum = 0.0f;
+    for (uint32_t node = 0; node < count; ++node) {
+      glm::mat4 m = composeTrs(locals[node]);
+      for (int32_t p = parents[node]; p >= 0; p = parents[p]) {
+        m = composeTrs(locals[p]) * m;
+      }
+      naiveSum += m[3][0];
+    }
+  }
+  double naiveTime = millisecondsSince(start, iterations);
+
+  float fullSum = 0.0f;
+  start = Clock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    hierarchy.markAllDirty();
+    hierarchy.update();
+  }
+  double fullTime = millisecondsSince(start, iterations);
+  for (uint32_t node = 0; node < count; ++node) {
+    fullSum += hierarchy.getWorldMatrix(node)[3][0];
+  }
+
+  // a handful of nodes in the bottom quarter of their chains move, like
+  // animated limbs on a static skeleton
+  const uint32_t moved = std::max(1u, chains / 8);
+  uint32_t recomputed = 0;
+  start = Clock::now();
+  for (uint32_t it = 0; it < iterations; ++it) {
+    for (uint32_t i = 0; i < moved; ++i) {
+      uint32_t level = depth - 1 - random() % std::max(1u, depth / 4);
+      uint32_t node = level * chains + random() % chains;
+      hierarchy.setTranslation(node, hierarchy.getTranslation(node));
+    }
+    recomputed += hierarchy.update();
+  }
+  double sparseTime = millisecondsSince(start, iterations);
+
+  std::cout << count << " nodes in " << chains << " chains of depth " << depth
+            << std::endl;
+  std::cout << "parent walk:       " << naiveTime << " ms" << std::endl;
+  std::cout << "flattened, full:   " << fullTime << " ms" << std::endl;
+  std::cout << "flattened, sparse: " << sparseTime << " ms, "
+            << recomputed / iterations << " nodes recomputed per update"
+            << std::endl;
+  std::cout << "checksums: " << naiveSum << " " << fullSum << std::endl;
+  return 0;
+}